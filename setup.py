@@ -189,6 +189,7 @@ stfio_module = Extension(
         'src/libstfio/abf/axon2/ProtocolReaderABF2.cpp',
         'src/libstfio/abf/axon2/SimpleStringCache.cpp',
         'src/libstfio/abf/axon2/abf2headr.cpp',
+        'src/libstfio/ascii/asciilib.cpp',
         'src/libstfio/atf/atflib.cpp',
         'src/libstfio/axg/AxoGraph_ReadWrite.cpp',
         'src/libstfio/axg/axglib.cpp',
@@ -206,8 +207,11 @@ stfio_module = Extension(
 	'src/libstfio/intan/common.cpp',
 	'src/libstfio/intan/intanlib.cpp',
 	'src/libstfio/intan/streams.cpp',
+        'src/libstfio/tdms/tdmslib.cpp',
         'src/libstfio/recording.cpp',
         'src/libstfio/section.cpp',
+        'src/libstfio/mappedfile.cpp',
+        'src/libstfio/envelope.cpp',
         'src/libstfio/stfio.cpp',
         'src/libstfnum/fit.cpp',
         'src/libstfnum/funclib.cpp',
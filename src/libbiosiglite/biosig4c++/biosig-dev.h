@@ -466,6 +466,8 @@ typedef struct HDR_STRUCT {
 		uint32_t	SegSel[5];	/* segment selection in a hirachical data formats, e.g. sweeps in HEKA/PatchMaster format */
 		enum B4C_ERROR	B4C_ERRNUM;	/* error code */
 		char		flag_collapsed_rawdata; /* 0 if rawdata contain obsolete channels, too. 	*/
+		void*		mmapBase;	/* start of the file mapping if rawdata points into it, NULL otherwise */
+		size_t		mmapSize;	/* size of the file mapping */
 	} AS ATT_ALI;
 
 	void *aECG;				/* used as an pointer to (non-standard) auxilary information - mostly used for hacks */
@@ -78,6 +78,11 @@ int VERBOSE_LEVEL __attribute__ ((visibility ("default") )) = 0;	// this variabl
   #define FILESEP '/'
 #endif
 
+#if defined(__linux__) && !defined(WITHOUT_MMAP)
+  #include <sys/mman.h>
+  #define WITH_RAWDATA_MMAP
+#endif
+
 #define min(a,b)        (((a) < (b)) ? (a) : (b))
 #define max(a,b)        (((a) > (b)) ? (a) : (b))
 
@@ -685,6 +690,69 @@ int iferror(HDRTYPE* hdr) {
 	return(ferror(hdr->FILE.FID));
 }
 
+/*------------------------------------------------------------------------
+	raw data mapping: instead of copying the data section of an
+	uncompressed local file into hdr->AS.rawdata, it is mapped into memory.
+	The mapping is private, so that rawdata can still be modified in place
+	(e.g. by collapse_rawdata) without changing the file.
+ ------------------------------------------------------------------------*/
+static void rawdata_free(HDRTYPE* hdr) {
+#ifdef WITH_RAWDATA_MMAP
+	if (hdr->AS.mmapBase != NULL) {
+		munmap(hdr->AS.mmapBase, hdr->AS.mmapSize);
+		hdr->AS.mmapBase = NULL;
+		hdr->AS.mmapSize = 0;
+		hdr->AS.rawdata  = NULL;
+		hdr->AS.first    = 0;
+		hdr->AS.length   = 0;
+		return;
+	}
+#endif
+	free(hdr->AS.rawdata);
+	hdr->AS.rawdata = NULL;
+}
+
+/* maps all blocks of the data section, returns the number of mapped blocks
+   or 0 if the file can not be mapped (compressed, network, write mode, ...) */
+static size_t rawdata_mmap(HDRTYPE* hdr) {
+#ifdef WITH_RAWDATA_MMAP
+	if ((hdr->FILE.OPEN != 1) || hdr->FILE.COMPRESSION || (hdr->FILE.FID == NULL)
+	 || (hdr->AS.bpb == 0) || (hdr->NRec <= 0))
+		return(0);
+
+	struct stat st;
+	int fd = fileno(hdr->FILE.FID);
+	if ((fd < 0) || fstat(fd, &st) || !S_ISREG(st.st_mode) || ((size_t)st.st_size <= hdr->HeadLen))
+		return(0);
+
+	size_t nrec = min((size_t)hdr->NRec, ((size_t)st.st_size - hdr->HeadLen) / hdr->AS.bpb);
+	if (nrec == 0) return(0);
+
+	// the offset of a mapping must be a multiple of the page size
+	size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t offset   = hdr->HeadLen - hdr->HeadLen % pagesize;
+	size_t size     = hdr->HeadLen - offset + nrec * hdr->AS.bpb;
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)offset);
+	if (base == MAP_FAILED) {
+		if (VERBOSE_LEVEL>7) fprintf(stdout,"%s (line %i): mmap failed (%s)\n",__func__,__LINE__,strerror(errno));
+		return(0);
+	}
+	madvise(base, size, MADV_SEQUENTIAL);
+
+	// an earlier mapping is replaced, e.g. when its rawdata has been collapsed
+	rawdata_free(hdr);
+	hdr->AS.mmapBase = base;
+	hdr->AS.mmapSize = size;
+	hdr->AS.rawdata  = (uint8_t*)base + (hdr->HeadLen - offset);
+	hdr->AS.first    = 0;
+	hdr->AS.length   = nrec;
+	hdr->AS.flag_collapsed_rawdata = 0;
+	return(nrec);
+#else
+	return(0);
+#endif
+}
+
 
 /*------------------------------------------------------------------------
 	sort event table according to EVENT.POS
@@ -1179,6 +1247,8 @@ HDRTYPE* constructHDR(const unsigned NS, const unsigned N_EVENT)
 	hdr->TYPE = noFile;
 	hdr->VERSION = 2.0;
 	hdr->AS.rawdata = NULL; 		//(uint8_t*) malloc(0);
+	hdr->AS.mmapBase = NULL;
+	hdr->AS.mmapSize = 0;
 	hdr->AS.flag_collapsed_rawdata = 0;	// is rawdata not collapsed
 	hdr->AS.first = 0;
 	hdr->AS.length  = 0;  			// no data loaded
@@ -1410,7 +1480,7 @@ void destructHDR(HDRTYPE* hdr) {
 
 	// in case of SCPv3, rawdata can be loaded into Header
 	if ( (hdr->AS.rawdata < hdr->AS.Header) || (hdr->AS.rawdata > (hdr->AS.Header+hdr->HeadLen)) )
-		if (hdr->AS.rawdata != NULL) free(hdr->AS.rawdata);
+		if (hdr->AS.rawdata != NULL) rawdata_free(hdr);
 
 	if (VERBOSE_LEVEL>7)  fprintf(stdout,"destructHDR: free HDR.data.block @%p\n",hdr->data.block);
 
@@ -12596,6 +12666,11 @@ size_t sread_raw(size_t start, size_t length, HDRTYPE* hdr, char flag, void *buf
 		if (VERBOSE_LEVEL>7) fprintf(stdout,"sread-raw from network: 222 count=%i\n",(int)count);
 	}
 #endif
+	else if ((buf == NULL) && (hdr->TYPE != CFS) && (hdr->TYPE != SMR) && (rawdata_mmap(hdr) > start)) {
+		// whole data section is mapped into hdr->AS.rawdata, no file-IO
+		hdr->FILE.POS = start;
+		count = min(nelem, hdr->AS.length - start);
+	}
 	else {
 		
 		assert(hdr->TYPE != CFS);	// CFS data has been already cached in SOPEN
@@ -12619,6 +12694,7 @@ size_t sread_raw(size_t start, size_t length, HDRTYPE* hdr, char flag, void *buf
 		// allocate AS.rawdata
 		void* tmpptr = buf;
 		if (buf == NULL) {
+			if (hdr->AS.mmapBase != NULL) rawdata_free(hdr);
 			tmpptr = realloc(hdr->AS.rawdata, hdr->AS.bpb*nelem);
 			if ((tmpptr!=NULL) || (hdr->AS.bpb*nelem==0)) {
 				if (VERBOSE_LEVEL>7) fprintf(stdout,"%s (line %i)  %i %i \n",__func__,__LINE__,(int)hdr->AS.bpb,(int)nelem);
@@ -12635,7 +12711,7 @@ size_t sread_raw(size_t start, size_t length, HDRTYPE* hdr, char flag, void *buf
 
 		// read data
 		count = ifread(tmpptr, hdr->AS.bpb, nelem, hdr);
-		if (buf != NULL) {
+		if (buf == NULL) {
 			hdr->AS.flag_collapsed_rawdata = 0;	// is rawdata not collapsed
 			hdr->AS.first = start;
 			hdr->AS.length= count;
@@ -12668,6 +12744,207 @@ int cachingWholeFile(HDRTYPE* hdr) {
 
 
 
+/****************************************************************************/
+/**	SREAD block decoders                                               **/
+/****************************************************************************/
+/*
+	The common sample types are converted, checked for overflow and calibrated
+	one block (all samples of a channel within a record) at a time, instead of
+	sample by sample through the generic switch in sread. The operations are
+	the same as in the generic path, so that the results are bit-identical.
+	Exotic types (12 and 24 bit, Nihon-Kohden) are left to the generic path.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SREAD_BLOCK_SSE2
+#include <emmintrin.h>
+#if (__GNUC__ >= 5) || defined(__clang__)
+#define SREAD_BLOCK_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+struct sread_block_cal {
+	double DigMin, DigMax, Cal, Off;
+	char OVERFLOWDETECTION, UCAL;
+};
+
+/* decodes n samples that are step bytes apart into dst */
+typedef void (*sread_block_fun)(const uint8_t *src, size_t step, size_t n, biosig_data_type *dst, const struct sread_block_cal *c);
+
+static inline biosig_data_type sread_block_calibrate(biosig_data_type sample_value, const struct sread_block_cal *c) {
+	// overflow and saturation detection
+	if ((c->OVERFLOWDETECTION) && ((sample_value <= c->DigMin) || (sample_value >= c->DigMax)))
+		sample_value = NAN; 	// missing value
+	if (!c->UCAL)	// scaling
+		sample_value = sample_value * c->Cal + c->Off;
+	return sample_value;
+}
+
+static inline uint16_t sread_block_u16(const uint8_t *p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint32_t sread_block_u32(const uint8_t *p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint64_t sread_block_u64(const uint8_t *p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline float sread_block_f32(uint32_t u) { float v; memcpy(&v, &u, sizeof(v)); return v; }
+static inline double sread_block_f64(uint64_t u) { double v; memcpy(&v, &u, sizeof(v)); return v; }
+
+#define SREAD_BLOCK_SCALAR(NAME, EXPR) \
+static void NAME(const uint8_t *src, size_t step, size_t n, biosig_data_type *dst, const struct sread_block_cal *c) { \
+	size_t k; \
+	for (k = 0; k < n; k++, src += step) \
+		dst[k] = sread_block_calibrate((biosig_data_type)(EXPR), c); \
+}
+
+SREAD_BLOCK_SCALAR(sread_block_i16,      (int16_t)sread_block_u16(src))
+SREAD_BLOCK_SCALAR(sread_block_i16_swap, (int16_t)bswap_16(sread_block_u16(src)))
+SREAD_BLOCK_SCALAR(sread_block_u16n,     sread_block_u16(src))
+SREAD_BLOCK_SCALAR(sread_block_u16_swap, (uint16_t)bswap_16(sread_block_u16(src)))
+SREAD_BLOCK_SCALAR(sread_block_i32,      (int32_t)sread_block_u32(src))
+SREAD_BLOCK_SCALAR(sread_block_i32_swap, (int32_t)bswap_32(sread_block_u32(src)))
+SREAD_BLOCK_SCALAR(sread_block_u32n,     sread_block_u32(src))
+SREAD_BLOCK_SCALAR(sread_block_u32_swap, (uint32_t)bswap_32(sread_block_u32(src)))
+SREAD_BLOCK_SCALAR(sread_block_f32n,     sread_block_f32(sread_block_u32(src)))
+SREAD_BLOCK_SCALAR(sread_block_f32_swap, sread_block_f32(bswap_32(sread_block_u32(src))))
+SREAD_BLOCK_SCALAR(sread_block_f64n,     sread_block_f64(sread_block_u64(src)))
+SREAD_BLOCK_SCALAR(sread_block_f64_swap, sread_block_f64(bswap_64(sread_block_u64(src))))
+
+#ifdef SREAD_BLOCK_SSE2
+/* contiguous, native byte order; the tail is done by the scalar decoders */
+static inline __m128d sread_block_calibrate_sse2(__m128d v, const struct sread_block_cal *c) {
+	if (c->OVERFLOWDETECTION) {
+		__m128d m = _mm_or_pd(_mm_cmple_pd(v, _mm_set1_pd(c->DigMin)), _mm_cmpge_pd(v, _mm_set1_pd(c->DigMax)));
+		v = _mm_or_pd(_mm_andnot_pd(m, v), _mm_and_pd(m, _mm_set1_pd(NAN)));
+	}
+	if (!c->UCAL)
+		v = _mm_add_pd(_mm_mul_pd(v, _mm_set1_pd(c->Cal)), _mm_set1_pd(c->Off));
+	return v;
+}
+
+static void sread_block_i16_sse2(const uint8_t *src, size_t step, size_t n, biosig_data_type *dst, const struct sread_block_cal *c) {
+	size_t k;
+	for (k = 0; k + 8 <= n; k += 8) {
+		__m128i x  = _mm_loadu_si128((const __m128i*)(src + 2*k));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_pd(dst+k,   sread_block_calibrate_sse2(_mm_cvtepi32_pd(lo), c));
+		_mm_storeu_pd(dst+k+2, sread_block_calibrate_sse2(_mm_cvtepi32_pd(_mm_shuffle_epi32(lo, 0xEE)), c));
+		_mm_storeu_pd(dst+k+4, sread_block_calibrate_sse2(_mm_cvtepi32_pd(hi), c));
+		_mm_storeu_pd(dst+k+6, sread_block_calibrate_sse2(_mm_cvtepi32_pd(_mm_shuffle_epi32(hi, 0xEE)), c));
+	}
+	sread_block_i16(src + 2*k, step, n - k, dst + k, c);
+}
+
+static void sread_block_i32_sse2(const uint8_t *src, size_t step, size_t n, biosig_data_type *dst, const struct sread_block_cal *c) {
+	size_t k;
+	for (k = 0; k + 4 <= n; k += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(src + 4*k));
+		_mm_storeu_pd(dst+k,   sread_block_calibrate_sse2(_mm_cvtepi32_pd(x), c));
+		_mm_storeu_pd(dst+k+2, sread_block_calibrate_sse2(_mm_cvtepi32_pd(_mm_shuffle_epi32(x, 0xEE)), c));
+	}
+	sread_block_i32(src + 4*k, step, n - k, dst + k, c);
+}
+
+static void sread_block_f32_sse2(const uint8_t *src, size_t step, size_t n, biosig_data_type *dst, const struct sread_block_cal *c) {
+	size_t k;
+	for (k = 0; k + 4 <= n; k += 4) {
+		__m128 x = _mm_loadu_ps((const float*)(src + 4*k));
+		_mm_storeu_pd(dst+k,   sread_block_calibrate_sse2(_mm_cvtps_pd(x), c));
+		_mm_storeu_pd(dst+k+2, sread_block_calibrate_sse2(_mm_cvtps_pd(_mm_movehl_ps(x, x)), c));
+	}
+	sread_block_f32n(src + 4*k, step, n - k, dst + k, c);
+}
+#endif // SREAD_BLOCK_SSE2
+
+#ifdef SREAD_BLOCK_AVX2
+/* FMA is deliberately not enabled: fusing would change the rounding of Cal*x+Off */
+__attribute__ ((target ("avx2")))
+static inline __m256d sread_block_calibrate_avx2(__m256d v, const struct sread_block_cal *c) {
+	if (c->OVERFLOWDETECTION) {
+		__m256d m = _mm256_or_pd(_mm256_cmp_pd(v, _mm256_set1_pd(c->DigMin), _CMP_LE_OQ),
+		                         _mm256_cmp_pd(v, _mm256_set1_pd(c->DigMax), _CMP_GE_OQ));
+		v = _mm256_blendv_pd(v, _mm256_set1_pd(NAN), m);
+	}
+	if (!c->UCAL)
+		v = _mm256_add_pd(_mm256_mul_pd(v, _mm256_set1_pd(c->Cal)), _mm256_set1_pd(c->Off));
+	return v;
+}
+
+__attribute__ ((target ("avx2")))
+static void sread_block_i16_avx2(const uint8_t *src, size_t step, size_t n, biosig_data_type *dst, const struct sread_block_cal *c) {
+	size_t k;
+	for (k = 0; k + 8 <= n; k += 8) {
+		__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + 2*k)));
+		_mm256_storeu_pd(dst+k,   sread_block_calibrate_avx2(_mm256_cvtepi32_pd(_mm256_castsi256_si128(x)), c));
+		_mm256_storeu_pd(dst+k+4, sread_block_calibrate_avx2(_mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1)), c));
+	}
+	sread_block_i16(src + 2*k, step, n - k, dst + k, c);
+}
+
+__attribute__ ((target ("avx2")))
+static void sread_block_i32_avx2(const uint8_t *src, size_t step, size_t n, biosig_data_type *dst, const struct sread_block_cal *c) {
+	size_t k;
+	for (k = 0; k + 4 <= n; k += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(src + 4*k));
+		_mm256_storeu_pd(dst+k, sread_block_calibrate_avx2(_mm256_cvtepi32_pd(x), c));
+	}
+	sread_block_i32(src + 4*k, step, n - k, dst + k, c);
+}
+
+__attribute__ ((target ("avx2")))
+static void sread_block_f32_avx2(const uint8_t *src, size_t step, size_t n, biosig_data_type *dst, const struct sread_block_cal *c) {
+	size_t k;
+	for (k = 0; k + 4 <= n; k += 4) {
+		__m128 x = _mm_loadu_ps((const float*)(src + 4*k));
+		_mm256_storeu_pd(dst+k, sread_block_calibrate_avx2(_mm256_cvtps_pd(x), c));
+	}
+	sread_block_f32n(src + 4*k, step, n - k, dst + k, c);
+}
+#endif // SREAD_BLOCK_AVX2
+
+/*
+	returns the decoder for a channel with type GDFTYP and samples that are
+	step bytes apart, or NULL if the generic path has to be used.
+ */
+static sread_block_fun sread_block_select(uint16_t GDFTYP, char SWAP, size_t step) {
+	char contiguous = (step == (GDFTYP_BITS[GDFTYP]>>3));
+	(void)contiguous;
+	switch (GDFTYP) {
+	case 3:
+		if (SWAP) return sread_block_i16_swap;
+#ifdef SREAD_BLOCK_AVX2
+		if (contiguous && __builtin_cpu_supports("avx2")) return sread_block_i16_avx2;
+#endif
+#ifdef SREAD_BLOCK_SSE2
+		if (contiguous) return sread_block_i16_sse2;
+#endif
+		return sread_block_i16;
+	case 4:
+		return SWAP ? sread_block_u16_swap : sread_block_u16n;
+	case 5:
+		if (SWAP) return sread_block_i32_swap;
+#ifdef SREAD_BLOCK_AVX2
+		if (contiguous && __builtin_cpu_supports("avx2")) return sread_block_i32_avx2;
+#endif
+#ifdef SREAD_BLOCK_SSE2
+		if (contiguous) return sread_block_i32_sse2;
+#endif
+		return sread_block_i32;
+	case 6:
+		return SWAP ? sread_block_u32_swap : sread_block_u32n;
+	case 16:
+		if (SWAP) return sread_block_f32_swap;
+#ifdef SREAD_BLOCK_AVX2
+		if (contiguous && __builtin_cpu_supports("avx2")) return sread_block_f32_avx2;
+#endif
+#ifdef SREAD_BLOCK_SSE2
+		if (contiguous) return sread_block_f32_sse2;
+#endif
+		return sread_block_f32n;
+	case 17:
+		return SWAP ? sread_block_f64_swap : sread_block_f64n;
+	default:
+		return NULL;
+	}
+}
+
 /****************************************************************************/
 /**	SREAD : segment-based                                              **/
 /****************************************************************************/
@@ -12704,6 +12981,7 @@ size_t sread(biosig_data_type* data, size_t start, size_t length, HDRTYPE* hdr)
 	size_t			count,k1,k2,k4,k5=0,NS;//bi,bi8;
 	size_t			toffset;	// time offset for rawdata
 	biosig_data_type	*data1=NULL;
+	biosig_data_type	*blockbuf=NULL;	// decoded block of a channel that is resampled or stored row-based
 
 
 	if (VERBOSE_LEVEL>6)
@@ -12806,6 +13084,53 @@ size_t sread(biosig_data_type* data, size_t start, size_t length, HDRTYPE* hdr)
 
 		union {int16_t i16; uint16_t u16; uint32_t i32; float f32; uint64_t i64; double f64;} u;
 
+		size_t step = stride * SZ >> 3;
+		sread_block_fun block = (VERBOSE_LEVEL>8) ? NULL : sread_block_select(GDFTYP, SWAP, step);
+		if (block != NULL) {
+			struct sread_block_cal cal;
+			cal.DigMin = CHptr->DigMin;
+			cal.DigMax = CHptr->DigMax;
+			cal.Cal    = CHptr->Cal;
+			cal.Off    = CHptr->Off;
+			cal.OVERFLOWDETECTION = hdr->FLAG.OVERFLOWDETECTION;
+			cal.UCAL   = hdr->FLAG.UCAL;
+			char direct = !hdr->FLAG.ROW_BASED_CHANNELS && (DIV == 1);
+			if (!direct && (blockbuf == NULL)) {
+				blockbuf = (biosig_data_type*) malloc(hdr->SPR * sizeof(biosig_data_type));
+				if (blockbuf == NULL) {
+					biosigERROR(hdr, B4C_MEMORY_ALLOCATION_FAILED, "memory allocation failed - not enough memory");
+					return(0);
+				}
+			}
+			for (k4 = 0; k4 < count; k4++) {
+				uint8_t *ptr1;
+#ifndef  ONLYGDF
+				if (hdr->TYPE == FEF) {
+					ptr1 = CHptr->bufptr;
+				}
+				else
+#endif //ONLYGDF
+					ptr1 = hdr->AS.rawdata + (k4+toffset)*hdr->AS.bpb + CHptr->bi;
+
+				if (direct) {
+					block(ptr1, step, CHptr->SPR, data1 + k2*count*hdr->SPR + k4*hdr->SPR, &cal);
+					continue;
+				}
+				block(ptr1, step, CHptr->SPR, blockbuf, &cal);
+				// resampling 1->DIV samples
+				for (k5 = 0; k5 < CHptr->SPR; k5++) {
+					size_t k3;
+					if (hdr->FLAG.ROW_BASED_CHANNELS) {
+						for (k3=0; k3 < DIV; k3++)
+							data1[k2 + (k4*hdr->SPR + k5*DIV + k3)*NS] = blockbuf[k5]; // row-based channels
+					} else {
+						for (k3=0; k3 < DIV; k3++)
+							data1[k2*count*hdr->SPR + k4*hdr->SPR + k5*DIV + k3] = blockbuf[k5]; // column-based channels
+					}
+				}
+			}
+		}
+		else
 		// TODO:  MIT data types
 		for (k4 = 0; k4 < count; k4++)
 		{  	uint8_t *ptr1;
@@ -12998,6 +13323,7 @@ size_t sread(biosig_data_type* data, size_t start, size_t length, HDRTYPE* hdr)
 		default:
 			if (VERBOSE_LEVEL > 7) fprintf(stdout,"%s (line %i) GDFTYP=%i %i %i \n", __FILE__, __LINE__, GDFTYP, (int)k1, (int)k2);
 			biosigERROR(hdr, B4C_DATATYPE_UNSUPPORTED, "Error SREAD: datatype not supported");
+			free(blockbuf);
 			return(-1);
 
 		}	// end switch
@@ -13029,6 +13355,7 @@ size_t sread(biosig_data_type* data, size_t start, size_t length, HDRTYPE* hdr)
 	}
 	k2++;
 	}}
+	free(blockbuf);
 
 	if (hdr->FLAG.ROW_BASED_CHANNELS) {
 		hdr->data.size[0] = k2;			// rows
@@ -14,6 +14,7 @@
 
 
 
+#include <algorithm>
 #include <string>
 #include <iomanip>
 #include <vector>
@@ -27,11 +28,23 @@
 
 #include "./abflib.h"
 #include "../recording.h"
+#include "../mappedfile.h"
 
 namespace stfio {
 
 std::string ABF1Error(const std::string& fName, int nError);
 
+MappedFilePtr mapABFFile(const std::string& fName);
+
+bool mapABFSections(const MappedFilePtr& mapped, LONGLONG llOffset, std::size_t nPoints,
+                    const std::vector<UINT>& uOffsets, const std::vector<float>& fFactors,
+                    const std::vector<float>& fShifts, bool bIntegerData,
+                    const std::string& label, const std::vector<int>& channelMap,
+                    const importRequest& request, Recording& ReturnData, std::size_t nSection);
+
+void readABFWindow(const std::vector<Vector_double>& episode, std::size_t start, std::size_t n,
+                   const std::vector<double*>& dest);
+
 }
 
 std::string stfio::ABF1Error(const std::string& fName, int nError) {
@@ -43,7 +56,69 @@ std::string stfio::ABF1Error(const std::string& fName, int nError) {
     return std::string( &errorMsg[0] );
 }
 
-void stfio::importABFFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
+stfio::MappedFilePtr stfio::mapABFFile(const std::string& fName) {
+    try {
+        return MappedFilePtr(new MappedFile(fName));
+    }
+    catch (const std::runtime_error&) {
+        // Sections will be decoded into memory instead.
+        return MappedFilePtr();
+    }
+}
+
+// Creates lazily decoded sections for the selected channels of a multiplexed block of data.
+// channelMap holds the index of each channel in ReturnData, or -1 if it's not selected;
+// only the data points selected by request are mapped.
+// Returns false, leaving ReturnData untouched, if the block exceeds the file.
+bool stfio::mapABFSections(const MappedFilePtr& mapped, LONGLONG llOffset, std::size_t nPoints,
+                           const std::vector<UINT>& uOffsets, const std::vector<float>& fFactors,
+                           const std::vector<float>& fShifts, bool bIntegerData,
+                           const std::string& label, const std::vector<int>& channelMap,
+                           const importRequest& request, Recording& ReturnData, std::size_t nSection)
+{
+    std::size_t numberChannels = uOffsets.size();
+    std::size_t start = 0, n = 0;
+    request.Window(nPoints, start, n);
+    std::size_t frameSize = numberChannels * (bIntegerData ? sizeof(short) : sizeof(float));
+    std::vector<SectionSourcePtr> sources(numberChannels);
+    try {
+        for (std::size_t nChannel=0; nChannel < numberChannels; ++nChannel) {
+            if (channelMap[nChannel] < 0) {
+                continue;
+            }
+            sources[nChannel] = SectionSourcePtr(
+                new MappedSectionSource(mapped, (std::size_t)llOffset + start*frameSize, n, numberChannels,
+                                        uOffsets[nChannel],
+                                        bIntegerData ? MappedSectionSource::int16 : MappedSectionSource::float32,
+                                        fFactors[nChannel], fShifts[nChannel]));
+        }
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+    for (std::size_t nChannel=0; nChannel < numberChannels; ++nChannel) {
+        if (channelMap[nChannel] >= 0) {
+            ReturnData[channelMap[nChannel]][nSection] = Section(sources[nChannel], label);
+        }
+    }
+    return true;
+}
+
+// Copies a window of a de-multiplexed episode to the selected channels;
+// dest holds NULL for channels that are not selected.
+void stfio::readABFWindow(const std::vector<Vector_double>& episode, std::size_t start, std::size_t n,
+                          const std::vector<double*>& dest)
+{
+    for (std::size_t nChannel=0; nChannel < dest.size(); ++nChannel) {
+        if (dest[nChannel] != NULL && n > 0) {
+            std::copy(&episode[nChannel][start], &episode[nChannel][start]+n, dest[nChannel]);
+        }
+    }
+}
+
+void stfio::importABFFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg,
+                          const importRequest& request)
+{
     ABF2_FileInfo fileInfo;
 
     // Open file:
@@ -100,14 +175,16 @@ void stfio::importABFFile(const std::string &fName, Recording &ReturnData, Progr
 #endif
     
     if (CABF2ProtocolReader::CanOpen( (void*)&fileInfo, sizeof(fileInfo) )) {
-        importABF2File( std::string(fName.c_str()), ReturnData, progDlg );
+        importABF2File( std::string(fName.c_str()), ReturnData, progDlg, request );
     } else {
-        importABF1File( std::string(fName.c_str()), ReturnData, progDlg );
+        importABF1File( std::string(fName.c_str()), ReturnData, progDlg, request );
     }
 }
 
 
-void stfio::importABF2File(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
+void stfio::importABF2File(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg,
+                           const importRequest& request)
+{
 
     CABF2ProtocolReader abf2;
     std::wstring wfName;
@@ -167,153 +244,222 @@ void stfio::importABF2File(const std::string &fName, Recording &ReturnData, Prog
         }
         finalSections = 1;
     }
+    ABFLONG grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
+    if (gapfree) {
+        grandsize = pFH->lActualAcqLength / numberChannels;
+        Vector_double test_size(0);
+        ABFLONG maxsize = test_size.max_size();
+        if (grandsize <= 0 || grandsize >= maxsize) {
+            progDlg.Update(0, "Gapfree file is too large for a single section." \
+                           "It will be segmented.\nFile opening may be very slow.");
+            gapfree=false;
+            grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
+            finalSections=numberSections;
+        }
+    }
+
+    // Data points are decoded lazily from a read-only mapping of the file
+    // whenever its layout allows it:
+    stfio::MappedFilePtr mapped = mapABFFile(fName);
+    std::vector<UINT> uOffsets(numberChannels);
+    std::vector<float> fFactors(numberChannels, 1.0f), fShifts(numberChannels, 0.0f);
+    std::vector<int> channelMap(numberChannels, -1);
+    int numberSelected = 0;
     for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
-        int progbar = (int)(((double)nChannel/(double)numberChannels)*100.0);
-        progDlg.Update(progbar, "Memory allocation");
-        ABFLONG grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
+        if (!ABF2H_GetChannelOffset(pFH, pFH->nADCSamplingSeq[nChannel], &uOffsets[nChannel])) {
+            mapped.reset();
+        }
+        if (pFH->nDataFormat == ABF_INTEGERDATA) {
+            ABF2H_GetADCtoUUFactors(pFH, pFH->nADCSamplingSeq[nChannel],
+                                    &fFactors[nChannel], &fShifts[nChannel]);
+        }
+        if (request.HasChannel(nChannel)) {
+            channelMap[nChannel] = numberSelected++;
+        }
+    }
+
+    // Allocate all selected channels up front so that every episode can be
+    // scattered straight into its final sections:
+    progDlg.Update(0, "Memory allocation");
+    std::size_t sectionEnd = request.SectionEnd(finalSections);
+    ReturnData.resize(numberSelected);
+    for (int nChannel=0; nChannel < numberSelected; ++nChannel) {
+        ReturnData[nChannel].resize(sectionEnd - request.firstSection);
+    }
+    bool skipEpisodes = (numberSelected == 0 || sectionEnd == request.firstSection);
+    std::size_t windowStart = 0, windowSize = 0;
+    if (gapfree && !skipEpisodes) {
         std::ostringstream label;
-        label  
-               << fName
-               << ", gapfree section";
-        if (gapfree) {
-            grandsize = pFH->lActualAcqLength / numberChannels;
-            Vector_double test_size(0);
-            ABFLONG maxsize = test_size.max_size()
-#if defined(_MSC_VER)
-                // doesn't seem to return the correct size on Windows.
-                ;
-#else
-                ;
-#endif
-            
-            if (grandsize <= 0 || grandsize >= maxsize) {
-                    
-                progDlg.Update(progbar, "Gapfree file is too large for a single section." \
-                               "It will be segmented.\nFile opening may be very slow.");
-                
-                gapfree=false;
-                grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
-                finalSections=numberSections;
+        label
+            << fName
+            << ", gapfree section";
+        request.Window(grandsize, windowStart, windowSize);
+        LONGLONG llOffset = 0;
+        skipEpisodes = mapped &&
+            ABF2_GetEpisodeDataOffset(hFile, pFH, 1, &llOffset, NULL, &nError) &&
+            mapABFSections(mapped, llOffset, grandsize, uOffsets, fFactors, fShifts,
+                           pFH->nDataFormat == ABF_INTEGERDATA, label.str(), channelMap,
+                           request, ReturnData, 0);
+        if (!skipEpisodes) {
+            for (int nChannel=0; nChannel < numberSelected; ++nChannel) {
+                ReturnData[nChannel][0].resize(windowSize);
+                ReturnData[nChannel][0].SetSectionDescription(label.str());
             }
         }
-        Channel TempChannel(finalSections, grandsize);
-        Section TempSectionGrand(grandsize, label.str());
-        for (int nEpisode=1; nEpisode<=numberSections;++nEpisode) {
-            int progbar =
-                // Channel contribution:
-                (int)(((double)nChannel/(double)numberChannels)*100.0+
-                      // Section contribution:
-                      (double)(nEpisode-1)/(double)numberSections*(100.0/numberChannels));
-            std::ostringstream progStr;
-            progStr << "Reading channel #" << nChannel + 1 << " of " << numberChannels
-                    << ", Section #" << nEpisode << " of " << numberSections;
-            progDlg.Update(progbar, progStr.str());
-            
-            UINT uNumSamples = 0;
-            if (gapfree) {
-                if (nEpisode == numberSections) {
-                    uNumSamples = grandsize - (nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels;
+    }
+
+    // Each episode is read from disk and de-multiplexed only once, independent
+    // of the number of channels. Episodes that are only partly selected are
+    // de-multiplexed into a scratch buffer first:
+    std::vector<double*> channelBuffers(numberChannels), sectionBuffers(numberChannels);
+    std::vector<Vector_double> episode(numberChannels);
+    ABFLONG nSection = 0;
+    std::size_t nFileSection = 0;
+    for (int nEpisode=1; nEpisode<=numberSections && !skipEpisodes; ++nEpisode) {
+        int progbar = (int)((double)(nEpisode-1)/(double)numberSections*100.0);
+        std::ostringstream progStr;
+        progStr << "Reading section #" << nEpisode << " of " << numberSections;
+        progDlg.Update(progbar, progStr.str());
+
+        UINT uNumSamples = 0;
+        if (gapfree) {
+            if (nEpisode == numberSections) {
+                uNumSamples = grandsize - (nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels;
 #ifdef _STFDEBUG
-                    std::cout << "Last section size " << uNumSamples << std::endl;
+                std::cout << "Last section size " << uNumSamples << std::endl;
 #endif
-                } else {
-                    uNumSamples = pFH->lNumSamplesPerEpisode / numberChannels;
-                }
             } else {
-                if (!ABF2_GetNumSamples(hFile, pFH, nEpisode, &uNumSamples, &nError)) {
-                    std::ostringstream errorMsg;
-                    errorMsg << "Exception while calling ABF2_GetNumSamples() "
-                             << "for episode # "
-                             << nEpisode << "\n"
-                             << ABF1Error(fName, nError);
-                    ReturnData.resize(0);
-                    ABF_Close(hFile,&nError);
-                    throw std::runtime_error(errorMsg.str());
-                }
+                uNumSamples = pFH->lNumSamplesPerEpisode / numberChannels;
             }
-            // Use a vector here because memory allocation can
-            // be controlled more easily:
-            // request memory:
-            if (uNumSamples > 0) {
-                Vector_float TempSection(uNumSamples, 0.0);
-                unsigned int uNumSamplesW;
-                if (!ABF2_ReadChannel(hFile, pFH, pFH->nADCSamplingSeq[nChannel],nEpisode,TempSection,
-                                      &uNumSamplesW,&nError))
-                {
-                    std::string errorMsg("Exception while calling ABF2_ReadChannel():\n");
-                    errorMsg += ABF1Error(fName, nError);
-                    ReturnData.resize(0);
-                    ABF_Close(hFile,&nError);
-                    throw std::runtime_error(errorMsg);
-                }
-                if (uNumSamples!=uNumSamplesW && !gapfree) {
-                    ABF_Close(hFile,&nError);
-                    throw std::runtime_error("Exception while calling ABF2_ReadChannel()");
-                }
-                if (!gapfree) {
-                    std::ostringstream label;
-                    label
-                        << fName
-                        << ", Section # " << nEpisode;
-                    Section TempSectionT(TempSection.size(),label.str());
-                    std::copy(TempSection.begin(),TempSection.end(),&TempSectionT[0]);
-                    try {
-                        TempChannel.InsertSection(TempSectionT,nEpisode-1);
-                    }
-                    catch (...) {
-                        ABF_Close(hFile,&nError);
-                        throw;
-                    }
-                } else {
-                    if ((nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels + TempSection.size() <= TempSectionGrand.size()) {
-                        std::copy(TempSection.begin(),TempSection.end(),
-                                  &TempSectionGrand[(nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels]);
-                    }
-    #ifdef _STFDEBUG
-                    else {
-                        std::cout << "Overflow while copying gapfree sections" << std::endl;
-                    }
-    #endif
-                }
-            } else {
-                TempChannel.resize(TempChannel.size()-1);
+        } else {
+            if (!ABF2_GetNumSamples(hFile, pFH, nEpisode, &uNumSamples, &nError)) {
+                std::ostringstream errorMsg;
+                errorMsg << "Exception while calling ABF2_GetNumSamples() "
+                         << "for episode # "
+                         << nEpisode << "\n"
+                         << ABF1Error(fName, nError);
+                ReturnData.resize(0);
+                ABF_Close(hFile,&nError);
+                throw std::runtime_error(errorMsg.str());
             }
         }
+        if (uNumSamples == 0) {
+            continue;
+        }
+        // The selected data points of this episode:
+        std::size_t start = 0, n = 0;
         if (gapfree) {
-            try {
-                TempChannel.InsertSection(TempSectionGrand,0);
+            ABFLONG offset = (nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels;
+            if (offset + (ABFLONG)uNumSamples > grandsize) {
+#ifdef _STFDEBUG
+                std::cout << "Overflow while copying gapfree sections" << std::endl;
+#endif
+                continue;
             }
-            catch (...) {
-                ABF_Close(hFile,&nError);
-                throw;
+            // Skip chunks outside of the selected window:
+            std::size_t chunkStart = offset, chunkEnd = offset + uNumSamples;
+            if (chunkEnd <= windowStart || chunkStart >= windowStart + windowSize) {
+                continue;
+            }
+            start = (windowStart > chunkStart) ? windowStart - chunkStart : 0;
+            n = std::min(chunkEnd, windowStart + windowSize) - (chunkStart + start);
+            for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+                sectionBuffers[nChannel] = (channelMap[nChannel] < 0) ? NULL :
+                    &ReturnData[channelMap[nChannel]][0][chunkStart + start - windowStart];
+            }
+        } else {
+            // Empty episodes don't count as sections:
+            std::size_t nRequested = nFileSection++;
+            if (nRequested < request.firstSection) {
+                continue;
+            }
+            if (nRequested >= sectionEnd) {
+                break;
+            }
+            std::ostringstream label;
+            label
+                << fName
+                << ", Section # " << nEpisode;
+            LONGLONG llOffset = 0;
+            UINT uEpisodeSize = 0;
+            if (mapped &&
+                ABF2_GetEpisodeDataOffset(hFile, pFH, nEpisode, &llOffset, &uEpisodeSize, &nError) &&
+                uEpisodeSize / numberChannels == uNumSamples &&
+                mapABFSections(mapped, llOffset, uNumSamples, uOffsets, fFactors, fShifts,
+                               pFH->nDataFormat == ABF_INTEGERDATA, label.str(), channelMap,
+                               request, ReturnData, nSection))
+            {
+                nSection++;
+                continue;
+            }
+            request.Window(uNumSamples, start, n);
+            for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+                sectionBuffers[nChannel] = NULL;
+                if (channelMap[nChannel] < 0) {
+                    continue;
+                }
+                Section& sec = ReturnData[channelMap[nChannel]][nSection];
+                sec.resize(n);
+                sec.SetSectionDescription(label.str());
+                if (n > 0) {
+                    sectionBuffers[nChannel] = &sec[0];
+                }
+            }
+            nSection++;
+            if (n == 0) {
+                continue;
             }
         }
-        try {
-            if ((int)ReturnData.size()<numberChannels) {
-                ReturnData.resize(numberChannels);
+        bool partial = (start > 0 || n < uNumSamples);
+        for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+            channelBuffers[nChannel] = sectionBuffers[nChannel];
+            if (partial && sectionBuffers[nChannel] != NULL) {
+                episode[nChannel].resize(uNumSamples);
+                channelBuffers[nChannel] = &episode[nChannel][0];
             }
-            ReturnData.InsertChannel(TempChannel,nChannel);
         }
-        catch (...) {
+        unsigned int uNumSamplesW;
+        if (!ABF2_ReadChannels(hFile, pFH, nEpisode, &channelBuffers[0], uNumSamples,
+                               &uNumSamplesW, &nError))
+        {
+            std::string errorMsg("Exception while calling ABF2_ReadChannels():\n");
+            errorMsg += ABF1Error(fName, nError);
+            ReturnData.resize(0);
+            ABF_Close(hFile,&nError);
+            throw std::runtime_error(errorMsg);
+        }
+        if (uNumSamples!=uNumSamplesW && !gapfree) {
             ReturnData.resize(0);
             ABF_Close(hFile,&nError);
-            throw;
+            throw std::runtime_error("Exception while calling ABF2_ReadChannels()");
+        }
+        if (partial) {
+            readABFWindow(episode, start, n, sectionBuffers);
+        }
+    }
+
+    progDlg.Update(100, "Completing channel reading\n");
+    for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+        if (channelMap[nChannel] < 0) {
+            continue;
+        }
+        Channel& ch = ReturnData[channelMap[nChannel]];
+        if (!gapfree) {
+            // drop sections of empty episodes:
+            ch.resize(nSection);
         }
-        
-        progbar = (int)(((double)(nChannel+1)/(double)numberChannels)*100.0);
-        progDlg.Update(progbar, "Completing channel reading\n");
 
         std::string channel_name( pFH->sADCChannelName[pFH->nADCSamplingSeq[nChannel]] );
         if (channel_name.find("  ")<channel_name.size()) {
             channel_name.erase(channel_name.begin()+channel_name.find("  "),channel_name.end());
         }
-        ReturnData[nChannel].SetChannelName(channel_name);
+        ch.SetChannelName(channel_name);
 
         std::string channel_units( pFH->sADCUnits[pFH->nADCSamplingSeq[nChannel]] );
         if (channel_units.find("  ") < channel_units.size()) {
             channel_units.erase(channel_units.begin() + channel_units.find("  "),channel_units.end());
         }
-        ReturnData[nChannel].SetYUnits(channel_units);
+        ch.SetYUnits(channel_units);
     }
 
     if (!ABF_Close(hFile,&nError)) {
@@ -342,7 +488,9 @@ void stfio::importABF2File(const std::string &fName, Recording &ReturnData, Prog
     abf2.Close();
 }
 
-void stfio::importABF1File(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
+void stfio::importABF1File(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg,
+                           const importRequest& request)
+{
     
     int hFile = 0;
     ABFFileHeader FH;
@@ -387,81 +535,132 @@ void stfio::importABF1File(const std::string &fName, Recording &ReturnData, Prog
         throw std::runtime_error("Error while calling stfio::importABFFile():\n"
             "lActualEpisodes>dwMaxEpi");
     }
+
+    // Data points are decoded lazily from a read-only mapping of the file
+    // whenever its layout allows it:
+    stfio::MappedFilePtr mapped = mapABFFile(fName);
+    std::vector<UINT> uOffsets(numberChannels);
+    std::vector<float> fFactors(numberChannels, 1.0f), fShifts(numberChannels, 0.0f);
+    std::vector<int> channelMap(numberChannels, -1);
+    int numberSelected = 0;
     for (int nChannel=0;nChannel<numberChannels;++nChannel) {
-        Channel TempChannel(numberSections);
-        for (DWORD dwEpisode=1;dwEpisode<=(DWORD)numberSections;++dwEpisode) {
-            int progbar = // Channel contribution:
-                (int)(((double)nChannel/(double)numberChannels)*100.0+
-                      // Section contribution:
-                      (double)(dwEpisode-1)/(double)numberSections*(100.0/numberChannels));
-            std::ostringstream progStr;
-            progStr << "Reading channel #" << nChannel + 1 << " of " << numberChannels
-                    << ", Section #" << dwEpisode << " of " << numberSections;
-            progDlg.Update(progbar, progStr.str());
-            
-            unsigned int uNumSamples=0;
-            if (!ABF_GetNumSamples(hFile,&FH,dwEpisode,&uNumSamples,&nError)) {
-                std::string errorMsg( "Exception while calling ABF_GetNumSamples():\n" );
-                errorMsg += ABF1Error(fName, nError);
-                ReturnData.resize(0);
-                ABF_Close(hFile,&nError);
-                throw std::runtime_error(errorMsg);
-            }
-            // Use a vector here because memory allocation can
-            // be controlled more easily:
-            // request memory:
-            Vector_float TempSection(uNumSamples, 0.0);
-            unsigned int uNumSamplesW=0;
-            if (!ABF_ReadChannel(hFile, &FH, FH.nADCSamplingSeq[nChannel], dwEpisode, TempSection,
-                                 &uNumSamplesW, &nError))
-            {
-                std::string errorMsg("Exception while calling ABF_ReadChannel():\n");
-                errorMsg += ABF1Error(fName, nError);
-                ReturnData.resize(0);
-                ABF_Close(hFile,&nError);
-                throw std::runtime_error(errorMsg);
-            }
-            if (uNumSamples!=uNumSamplesW) {
-                ABF_Close(hFile,&nError);
-                throw std::runtime_error("Exception while calling ABF_ReadChannel()");
-            }
-            std::ostringstream label;
-            label
-                << fName
-                << ", Section # " << dwEpisode;
-            Section TempSectionT(TempSection.size(),label.str());
-            std::copy(TempSection.begin(),TempSection.end(),&TempSectionT[0]);
-            try {
-                TempChannel.InsertSection(TempSectionT,dwEpisode-1);
+        if (!ABFH_GetChannelOffset(&FH, FH.nADCSamplingSeq[nChannel], &uOffsets[nChannel])) {
+            mapped.reset();
+        }
+        if (FH.nDataFormat == ABF_INTEGERDATA) {
+            ABFH_GetADCtoUUFactors(&FH, FH.nADCSamplingSeq[nChannel],
+                                   &fFactors[nChannel], &fShifts[nChannel]);
+        }
+        if (request.HasChannel(nChannel)) {
+            channelMap[nChannel] = numberSelected++;
+        }
+    }
+
+    // Allocate all selected channels up front so that every episode can be
+    // scattered straight into its final sections:
+    DWORD dwFirstEpisode = (DWORD)request.firstSection+1;
+    DWORD dwEndEpisode = (DWORD)request.SectionEnd(numberSections)+1;
+    ReturnData.resize(numberSelected);
+    for (int nChannel=0;nChannel<numberSelected;++nChannel) {
+        ReturnData[nChannel].resize(dwEndEpisode-dwFirstEpisode);
+    }
+    if (numberSelected == 0) {
+        dwEndEpisode = dwFirstEpisode;
+    }
+
+    // Each selected episode is read from disk and de-multiplexed only once, independent
+    // of the number of channels. Episodes that are only partly selected are
+    // de-multiplexed into a scratch buffer first:
+    std::vector<double*> channelBuffers(numberChannels), sectionBuffers(numberChannels);
+    std::vector<Vector_double> episode(numberChannels);
+    for (DWORD dwEpisode=dwFirstEpisode;dwEpisode<dwEndEpisode;++dwEpisode) {
+        int progbar = (int)((double)(dwEpisode-1)/(double)numberSections*100.0);
+        std::ostringstream progStr;
+        progStr << "Reading section #" << dwEpisode << " of " << numberSections;
+        progDlg.Update(progbar, progStr.str());
+
+        unsigned int uNumSamples=0;
+        if (!ABF_GetNumSamples(hFile,&FH,dwEpisode,&uNumSamples,&nError)) {
+            std::string errorMsg( "Exception while calling ABF_GetNumSamples():\n" );
+            errorMsg += ABF1Error(fName, nError);
+            ReturnData.resize(0);
+            ABF_Close(hFile,&nError);
+            throw std::runtime_error(errorMsg);
+        }
+        std::ostringstream label;
+        label
+            << fName
+            << ", Section # " << dwEpisode;
+        LONGLONG llOffset = 0;
+        UINT uEpisodeSize = 0;
+        if (mapped &&
+            ABF_GetEpisodeDataOffset(hFile, &FH, dwEpisode, &llOffset, &uEpisodeSize, &nError) &&
+            uEpisodeSize / numberChannels == uNumSamples &&
+            mapABFSections(mapped, llOffset, uNumSamples, uOffsets, fFactors, fShifts,
+                           FH.nDataFormat == ABF_INTEGERDATA, label.str(), channelMap,
+                           request, ReturnData, dwEpisode-dwFirstEpisode))
+        {
+            continue;
+        }
+        std::size_t start = 0, n = 0;
+        request.Window(uNumSamples, start, n);
+        bool partial = (start > 0 || n < uNumSamples);
+        for (int nChannel=0;nChannel<numberChannels;++nChannel) {
+            sectionBuffers[nChannel] = channelBuffers[nChannel] = NULL;
+            if (channelMap[nChannel] < 0) {
+                continue;
             }
-            catch (...) {
-                ABF_Close(hFile,&nError);
-                throw;
+            Section& sec = ReturnData[channelMap[nChannel]][dwEpisode-dwFirstEpisode];
+            sec.resize(n);
+            sec.SetSectionDescription(label.str());
+            if (n > 0) {
+                sectionBuffers[nChannel] = &sec[0];
+                if (partial) {
+                    episode[nChannel].resize(uNumSamples);
+                    channelBuffers[nChannel] = &episode[nChannel][0];
+                } else {
+                    channelBuffers[nChannel] = sectionBuffers[nChannel];
+                }
             }
         }
-        try {
-            if ((int)ReturnData.size()<numberChannels) {
-                ReturnData.resize(numberChannels);
-            }
-            ReturnData.InsertChannel(TempChannel,nChannel);
+        if (n == 0) {
+            continue;
         }
-        catch (...) {
+        unsigned int uNumSamplesW=0;
+        if (!ABF_ReadChannels(hFile, &FH, dwEpisode, &channelBuffers[0], uNumSamples,
+                              &uNumSamplesW, &nError))
+        {
+            std::string errorMsg("Exception while calling ABF_ReadChannels():\n");
+            errorMsg += ABF1Error(fName, nError);
             ReturnData.resize(0);
             ABF_Close(hFile,&nError);
-            throw;
+            throw std::runtime_error(errorMsg);
         }
+        if (uNumSamples!=uNumSamplesW) {
+            ReturnData.resize(0);
+            ABF_Close(hFile,&nError);
+            throw std::runtime_error("Exception while calling ABF_ReadChannels()");
+        }
+        if (partial) {
+            readABFWindow(episode, start, n, sectionBuffers);
+        }
+    }
 
+    for (int nChannel=0;nChannel<numberChannels;++nChannel) {
+        if (channelMap[nChannel] < 0) {
+            continue;
+        }
         std::string channel_name( FH.sADCChannelName[FH.nADCSamplingSeq[nChannel]] );
         if (channel_name.find("  ")<channel_name.size()) {
             channel_name.erase(channel_name.begin()+channel_name.find("  "),channel_name.end());
         }
-        ReturnData[nChannel].SetChannelName(channel_name);
+        ReturnData[channelMap[nChannel]].SetChannelName(channel_name);
 
         std::string channel_units( FH.sADCUnits[FH.nADCSamplingSeq[nChannel]] );
         if (channel_units.find("  ") < channel_units.size()) {
             channel_units.erase(channel_units.begin() + channel_units.find("  "),channel_units.end());
         }
-        ReturnData[nChannel].SetYUnits(channel_units);
+        ReturnData[channelMap[nChannel]].SetYUnits(channel_units);
     }
 
     if (!ABF_Close(hFile,&nError)) {
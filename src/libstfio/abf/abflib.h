@@ -31,24 +31,30 @@ namespace stfio {
  *  \param ReturnData On entry, an empty Recording object. On exit,
  *         the data stored in \e fName.
  *  \param progress True if the progress dialog should be updated.
+ *  \param request Channels, sections and data points to be read.
  */
-void importABFFile(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg);
+void importABFFile(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg,
+                   const importRequest& request = importRequest());
  
  //! Open an ABF1 file and store its contents to a Recording object.
 /*! \param fName The full path to the file to be opened.
  *  \param ReturnData On entry, an empty Recording object. On exit,
  *         the data stored in \e fName.
  *  \param progress True if the progress dialog should be updated.
+ *  \param request Channels, sections and data points to be read.
  */
-void importABF1File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg);
+void importABF1File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg,
+                    const importRequest& request = importRequest());
  
  //! Open an ABF2 file and store its contents to a Recording object.
 /*! \param fName The full path to the file to be opened.
  *  \param ReturnData On entry, an empty Recording object. On exit,
  *         the data stored in \e fName.
  *  \param progress True if the progress dialog should be updated.
+ *  \param request Channels, sections and data points to be read.
  */
-void importABF2File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg);
+void importABF2File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg,
+                    const importRequest& request = importRequest());
 
 }
 
@@ -2459,6 +2459,250 @@ BOOL WINAPI ABF2_ReadChannel(int nFile, const ABF2FileHeader *pFH, int nChannel,
     return TRUE;
 }
 
+//===============================================================================================
+// FUNCTION: DemultiplexToDoubles
+// PURPOSE:  Scatters a multiplexed episode into one destination array per channel in a single
+//           pass, converting 2byte ints to UserUnits on the fly.
+// INPUT:
+//   pvSource        the multiplexed episode as read from the file.
+//   uEpisodeSize    the number of samples in the episode (all channels).
+//   uNumChannels    the number of multiplexed channels (the skip factor).
+//   puOffsets       the offset of each channel into the multiplexed data.
+//   pfFactor        scaling factor for each channel (integer data only).
+//   pfShift         offset for each channel (integer data only).
+//   bIntegerData    TRUE for 2byte integer data, FALSE for 4byte float data.
+//   ppdDestination  one destination array per channel; NULL entries are skipped.
+//   uDestArrayLen   the capacity of each destination array.
+//
+static void DemultiplexToDoubles(const void *pvSource, UINT uEpisodeSize, UINT uNumChannels,
+                                 const UINT *puOffsets, const float *pfFactor, const float *pfShift,
+                                 BOOL bIntegerData, double **ppdDestination, UINT uDestArrayLen)
+{
+    UINT uFrames = uEpisodeSize / uNumChannels;
+    if (uFrames > uDestArrayLen)
+        uFrames = uDestArrayLen;
+
+    if (bIntegerData)
+    {
+        const ADC_VALUE *pnSource = (const ADC_VALUE *)pvSource;
+        for (UINT i=0; i<uFrames; i++, pnSource+=uNumChannels)
+        {
+            for (UINT c=0; c<uNumChannels; c++)
+            {
+                // Compute in float precision to give the same results as ABF_ReadChannel.
+                if (ppdDestination[c])
+                    ppdDestination[c][i] = (float)(pnSource[puOffsets[c]] * pfFactor[c] + pfShift[c]);
+            }
+        }
+    }
+    else
+    {
+        const float *pfSource = (const float *)pvSource;
+        for (UINT i=0; i<uFrames; i++, pfSource+=uNumChannels)
+        {
+            for (UINT c=0; c<uNumChannels; c++)
+            {
+                if (ppdDestination[c])
+                    ppdDestination[c][i] = pfSource[puOffsets[c]];
+            }
+        }
+    }
+}
+
+//===============================================================================================
+// FUNCTION: ABF_ReadChannels
+// PURPOSE:  This function reads a complete multiplexed episode from the data file once and
+//           de-multiplexes all channels into "UserUnits" in a single pass.
+//
+// ppdBuffers must hold pFH->nADCNumChannels pointers, in the order of pFH->nADCSamplingSeq.
+// Each non-NULL pointer must have room for uBufferSize doubles. Channels with a NULL pointer
+// are skipped.
+//
+BOOL WINAPI ABF_ReadChannels(int nFile, const ABFFileHeader *pFH, DWORD dwEpisode,
+                             double **ppdBuffers, UINT uBufferSize, UINT *puNumSamples, int *pnError)
+{
+    CFileDescriptor *pFI = NULL;
+    if (!GetFileDescriptor(&pFI, nFile, pnError))
+        return FALSE;
+
+    if (!pFI->CheckEpisodeNumber(dwEpisode))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+
+    UINT uNumChannels = (UINT)pFH->nADCNumChannels;
+    std::vector<UINT> uOffsets(uNumChannels);
+    std::vector<float> fFactors(uNumChannels, 1.0f), fShifts(uNumChannels, 0.0f);
+    for (UINT c=0; c<uNumChannels; c++)
+    {
+        int nChannel = pFH->nADCSamplingSeq[c];
+        if (!ABFH_GetChannelOffset(pFH, nChannel, &uOffsets[c]))
+            return ErrorReturn(pnError, ABF_EINVALIDCHANNEL);
+        if (pFH->nDataFormat == ABF_INTEGERDATA)
+            ABFH_GetADCtoUUFactors( pFH, nChannel, &fFactors[c], &fShifts[c]);
+    }
+
+    // Set the sample size in the data.
+    UINT uSampleSize = SampleSize(pFH);
+
+    // Only create the read buffer on demand, it is freed when the file is closed.
+    if (!pFI->GetReadBuffer())
+    {      
+        if (!pFI->AllocReadBuffer(pFH->lNumSamplesPerEpisode * uSampleSize))
+            return ErrorReturn(pnError, ABF_OUTOFMEMORY);
+    }
+
+    // Read the whole episode from the ABF file only if it is not already cached.
+    UINT uEpisodeSize = pFI->GetCachedEpisodeSize();
+    if (dwEpisode != pFI->GetCachedEpisode())
+    {         
+        uEpisodeSize = (UINT)pFH->lNumSamplesPerEpisode;
+        if (!ABF_MultiplexRead(nFile, pFH, dwEpisode, pFI->GetReadBuffer(), pFH->lNumSamplesPerEpisode * uSampleSize, &uEpisodeSize, pnError))
+        {
+            pFI->SetCachedEpisode(UINT(-1), 0);
+            return FALSE;
+        }
+        pFI->SetCachedEpisode(dwEpisode, uEpisodeSize);
+    }
+
+    DemultiplexToDoubles(pFI->GetReadBuffer(), uEpisodeSize, uNumChannels, &uOffsets[0],
+                         &fFactors[0], &fShifts[0], pFH->nDataFormat == ABF_INTEGERDATA,
+                         ppdBuffers, uBufferSize);
+
+    // Return the length of the data block.
+    if (puNumSamples)
+        *puNumSamples = uEpisodeSize / uNumChannels;
+    return TRUE;
+}
+
+//===============================================================================================
+// FUNCTION: ABF2_ReadChannels
+// PURPOSE:  This function reads a complete multiplexed episode from the data file once and
+//           de-multiplexes all channels into "UserUnits" in a single pass.
+//
+// ppdBuffers must hold pFH->nADCNumChannels pointers, in the order of pFH->nADCSamplingSeq.
+// Each non-NULL pointer must have room for uBufferSize doubles. Channels with a NULL pointer
+// are skipped.
+//
+BOOL WINAPI ABF2_ReadChannels(int nFile, const ABF2FileHeader *pFH, DWORD dwEpisode,
+                              double **ppdBuffers, UINT uBufferSize, UINT *puNumSamples, int *pnError)
+{
+    CFileDescriptor *pFI = NULL;
+    if (!GetFileDescriptor(&pFI, nFile, pnError))
+        return FALSE;
+
+    if (!pFI->CheckEpisodeNumber(dwEpisode))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+
+    UINT uNumChannels = (UINT)pFH->nADCNumChannels;
+    std::vector<UINT> uOffsets(uNumChannels);
+    std::vector<float> fFactors(uNumChannels, 1.0f), fShifts(uNumChannels, 0.0f);
+    for (UINT c=0; c<uNumChannels; c++)
+    {
+        int nChannel = pFH->nADCSamplingSeq[c];
+        if (!ABF2H_GetChannelOffset(pFH, nChannel, &uOffsets[c]))
+            return ErrorReturn(pnError, ABF_EINVALIDCHANNEL);
+        if (pFH->nDataFormat == ABF_INTEGERDATA)
+            ABF2H_GetADCtoUUFactors( pFH, nChannel, &fFactors[c], &fShifts[c]);
+    }
+
+    // Set the sample size in the data.
+    UINT uSampleSize = ABF2_SampleSize(pFH);
+
+    // Only create the read buffer on demand, it is freed when the file is closed.
+    if (!pFI->GetReadBuffer())
+    {      
+        if (!pFI->AllocReadBuffer(pFH->lNumSamplesPerEpisode * uSampleSize))
+            return ErrorReturn(pnError, ABF_OUTOFMEMORY);
+    }
+
+    // Read the whole episode from the ABF file only if it is not already cached.
+    UINT uEpisodeSize = pFI->GetCachedEpisodeSize();
+    if (dwEpisode != pFI->GetCachedEpisode())
+    {         
+        uEpisodeSize = (UINT)pFH->lNumSamplesPerEpisode;
+        if (!ABF2_MultiplexRead(nFile, pFH, dwEpisode, pFI->GetReadBuffer(), pFH->lNumSamplesPerEpisode * uSampleSize, &uEpisodeSize, pnError))
+        {
+            pFI->SetCachedEpisode(UINT(-1), 0);
+            return FALSE;
+        }
+        pFI->SetCachedEpisode(dwEpisode, uEpisodeSize);
+    }
+
+    DemultiplexToDoubles(pFI->GetReadBuffer(), uEpisodeSize, uNumChannels, &uOffsets[0],
+                         &fFactors[0], &fShifts[0], pFH->nDataFormat == ABF_INTEGERDATA,
+                         ppdBuffers, uBufferSize);
+
+    // Return the length of the data block.
+    if (puNumSamples)
+        *puNumSamples = uEpisodeSize / uNumChannels;
+    return TRUE;
+}
+
+//===============================================================================================
+// FUNCTION: ABF_GetEpisodeDataOffset
+// PURPOSE:  Returns the location of a multiplexed episode in the file without reading it, so that
+//           the data can be accessed through other means (e.g. a memory-mapped view).
+// INPUT:
+//   nFile           the file index into the g_FileData structure array
+//   dwEpisode       the episode number. Episodes start at 1
+// 
+// OUTPUT:
+//   pllFileOffset   the byte offset of the first sample of the episode in the file
+//   puSizeInSamples the number of samples in the episode (all channels)
+// 
+BOOL WINAPI ABF_GetEpisodeDataOffset(int nFile, const ABFFileHeader *pFH, DWORD dwEpisode,
+                                     LONGLONG *pllFileOffset, UINT *puSizeInSamples, int *pnError)
+{
+    CFileDescriptor *pFI = NULL;
+    if (!GetFileDescriptor(&pFI, nFile, pnError))
+        return FALSE;
+   
+    if (!pFI->CheckEpisodeNumber(dwEpisode))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+
+    Synch SynchEntry;
+    if (!GetSynchEntry( pFH, pFI, dwEpisode, &SynchEntry ))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+
+    if (pllFileOffset)
+        *pllFileOffset = LONGLONG(GetDataOffset(pFH)) + SynchEntry.dwFileOffset;
+    if (puSizeInSamples)
+        *puSizeInSamples = UINT(SynchEntry.dwLength);
+    return TRUE;
+}
+
+//===============================================================================================
+// FUNCTION: ABF2_GetEpisodeDataOffset
+// PURPOSE:  Returns the location of a multiplexed episode in the file without reading it, so that
+//           the data can be accessed through other means (e.g. a memory-mapped view).
+// INPUT:
+//   nFile           the file index into the g_FileData structure array
+//   dwEpisode       the episode number. Episodes start at 1
+// 
+// OUTPUT:
+//   pllFileOffset   the byte offset of the first sample of the episode in the file
+//   puSizeInSamples the number of samples in the episode (all channels)
+// 
+BOOL WINAPI ABF2_GetEpisodeDataOffset(int nFile, const ABF2FileHeader *pFH, DWORD dwEpisode,
+                                      LONGLONG *pllFileOffset, UINT *puSizeInSamples, int *pnError)
+{
+    CFileDescriptor *pFI = NULL;
+    if (!GetFileDescriptor(&pFI, nFile, pnError))
+        return FALSE;
+   
+    if (!pFI->CheckEpisodeNumber(dwEpisode))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+
+    Synch SynchEntry;
+    if (!ABF2_GetSynchEntry( pFH, pFI, dwEpisode, &SynchEntry ))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+
+    if (pllFileOffset)
+        *pllFileOffset = LONGLONG(ABF2_GetDataOffset(pFH)) + SynchEntry.dwFileOffset;
+    if (puSizeInSamples)
+        *puSizeInSamples = UINT(SynchEntry.dwLength);
+    return TRUE;
+}
+
 #if 0
 //===============================================================================================
 // FUNCTION: ABF_ReadRawChannel
@@ -132,6 +132,14 @@ BOOL WINAPI ABF_ReadChannel(int nFile, const ABFFileHeader *pFH, int nChannel, D
                             Vector_float& pfBuffer, UINT *puNumSamples, int *pnError);
 BOOL WINAPI ABF2_ReadChannel(int nFile, const ABF2FileHeader *pFH, int nChannel, DWORD dwEpisode, 
                              Vector_float& pfBuffer, UINT *puNumSamples, int *pnError);
+BOOL WINAPI ABF_ReadChannels(int nFile, const ABFFileHeader *pFH, DWORD dwEpisode,
+                             double **ppdBuffers, UINT uBufferSize, UINT *puNumSamples, int *pnError);
+BOOL WINAPI ABF2_ReadChannels(int nFile, const ABF2FileHeader *pFH, DWORD dwEpisode,
+                              double **ppdBuffers, UINT uBufferSize, UINT *puNumSamples, int *pnError);
+BOOL WINAPI ABF_GetEpisodeDataOffset(int nFile, const ABFFileHeader *pFH, DWORD dwEpisode,
+                                     LONGLONG *pllFileOffset, UINT *puSizeInSamples, int *pnError);
+BOOL WINAPI ABF2_GetEpisodeDataOffset(int nFile, const ABF2FileHeader *pFH, DWORD dwEpisode,
+                                      LONGLONG *pllFileOffset, UINT *puSizeInSamples, int *pnError);
 /*                                   
 BOOL WINAPI ABF_ReadRawChannel(int nFile, const ABFFileHeader *pFH, int nChannel, DWORD dwEpisode, 
                                void *pvBuffer, UINT *puNumSamples, int *pnError);
@@ -12,136 +12,605 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "./asciilib.h"
+#include "../mappedfile.h"
+
+namespace {
 
-#if 0
-wxString stf::NextWord( wxString& str ) {
-    int next_space = str.Find( wxT(' ') );
-	int next_tab = str.Find( wxT('\t') );
-	int next_nline = str.Find( wxT('\n') );
-	if ( next_space == wxNOT_FOUND && next_tab == wxNOT_FOUND && next_nline == wxNOT_FOUND )
-	    return wxT("\0");
-	wxString retStr = wxT("");
-	// wxNOT_FOUND is -1!
-	if ( next_space != wxNOT_FOUND && ( next_space < next_tab || next_tab == wxNOT_FOUND ) && ( next_space < next_nline || next_nline == wxNOT_FOUND ) ) {
-		retStr = str.BeforeFirst( wxT(' ') );
-		str = str.AfterFirst( wxT(' ') );
-	}
-	if ( next_tab != wxNOT_FOUND && ( next_tab < next_space || next_space == wxNOT_FOUND ) && ( next_tab < next_nline || next_nline == wxNOT_FOUND ) ) {
-		retStr = str.BeforeFirst( wxT('\t') );
-		str = str.AfterFirst( wxT('\t') );
-	}
-	if ( next_nline != wxNOT_FOUND && ( next_nline < next_tab || next_tab == wxNOT_FOUND ) && ( next_nline < next_space || next_space == wxNOT_FOUND ) ) {
-		retStr = str.BeforeFirst( wxT('\n') );
-		str = str.AfterFirst( wxT('\n') );
-	}
-	return retStr;
+// Minimal size of a block of text that is scanned by one thread:
+const std::size_t MIN_BLOCK = 1 << 20;
+// Rows that are formatted into one buffer when writing:
+const int BLOCK_ROWS = 16384;
+
+// Strips the directory off a full path name, like stf::noPath() in the GUI.
+std::string noPath(const std::string& fName) {
+    std::size_t sep = fName.find_last_of("/\\");
+    return (sep == std::string::npos) ? fName : fName.substr(sep+1);
 }
+
+int maxThreads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
 #endif
+}
 
-void stf::importASCIIFile( const wxString& fName, int hLinesToSkip, int nColumns,
-        bool firstIsTime, bool toSection, Recording& ReturnRec, bool progress )
-{
-    wxProgressDialog progDlg( wxT("Importing text file"), wxT("Starting..."), 100,
-            NULL, wxPD_SMOOTH | wxPD_AUTO_HIDE | wxPD_APP_MODAL | wxPD_CAN_SKIP );
+inline bool isDelimiter(char c) {
+    return c==' ' || c=='\t' || c==',' || c=='\r';
+}
+
+// Exact powers of ten for the fast path of parseNumber.
+const double exactPowers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parses a number that ends at a delimiter, a line break or the end of
+// the buffer. Decimal numbers with up to 15 significant digits and a
+// decimal exponent of at most 22 are converted with a single correctly
+// rounded multiplication or division; everything else, including nan and
+// inf, is passed to strtod. Returns NULL if there is no valid number.
+const char* parseNumber(const char* p, const char* end, double& value) {
+    const char* token = p;
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool anyDigit = false;
+    while (p != end && *p >= '0' && *p <= '9') {
+        anyDigit = true;
+        if (digits < 19) {
+            mantissa = mantissa*10 + (*p - '0');
+            if (mantissa != 0)
+                ++digits;
+        } else {
+            ++exponent;
+            ++digits;
+        }
+        ++p;
+    }
+    if (p != end && *p == '.') {
+        ++p;
+        while (p != end && *p >= '0' && *p <= '9') {
+            anyDigit = true;
+            if (digits < 19) {
+                mantissa = mantissa*10 + (*p - '0');
+                if (mantissa != 0)
+                    ++digits;
+                --exponent;
+            } else {
+                ++digits;
+            }
+            ++p;
+        }
+    }
+    bool fast = anyDigit;
+    if (fast && p != end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negExp = false;
+        if (p != end && (*p == '-' || *p == '+')) {
+            negExp = (*p == '-');
+            ++p;
+        }
+        if (p == end || *p < '0' || *p > '9') {
+            fast = false;
+        }
+        int e = 0;
+        while (p != end && *p >= '0' && *p <= '9') {
+            if (e < 10000)
+                e = e*10 + (*p - '0');
+            ++p;
+        }
+        exponent += negExp ? -e : e;
+    }
+    if (fast && (p == end || isDelimiter(*p) || *p == '\n') &&
+        digits <= 15 && exponent >= -22 && exponent <= 22)
+    {
+        double v = (double)mantissa;
+        v = exponent < 0 ? v / exactPowers[-exponent] : v * exactPowers[exponent];
+        value = negative ? -v : v;
+        return p;
+    }
 
-    //Open ASCII file and copy its contents to ReturnData:
+    // Slow path; strtod needs a terminated copy of the token:
+    p = token;
+    while (p != end && !isDelimiter(*p) && *p != '\n') {
+        ++p;
+    }
+    char buffer[64];
+    std::size_t length = p - token;
+    if (length == 0 || length >= sizeof(buffer)) {
+        return NULL;
+    }
+    memcpy(buffer, token, length);
+    buffer[length] = '\0';
+    char* stop = NULL;
+    value = strtod(buffer, &stop);
+    if (stop != buffer + length) {
+        return NULL;
+    }
+    return p;
+}
 
-    wxFileInputStream fStream( fName );
-    wxTextInputStream tStream( fStream );
+// Shortest round-trip formatting of doubles with the Grisu2 algorithm of
+// F. Loitsch, "Printing floating-point numbers quickly and accurately with
+// integers", PLDI 2010. The digits always read back to the same double and
+// are the shortest possible ones for all but a tiny fraction of numbers.
 
-    // Read header:
-    wxString header;
-    for(int n_h=0; n_h<hLinesToSkip; n_h++) {
-        if ( fStream.Eof() ) {
-            ReturnRec.resize(0);
-            throw std::runtime_error("Unexpected end of file; aborting file import.");
+// A floating point number f * 2^e with a 64 bit significand.
+struct DiyFp {
+    DiyFp(unsigned long long f_, int e_) : f(f_), e(e_) {}
+
+    explicit DiyFp(double d) {
+        unsigned long long bits;
+        memcpy(&bits, &d, sizeof(bits));
+        int biased_e = (int)((bits >> 52) & 0x7FF);
+        unsigned long long significand = bits & ((1ULL << 52) - 1);
+        if (biased_e != 0) {
+            f = significand + (1ULL << 52);
+            e = biased_e - 1075;
+        } else {
+            f = significand;
+            e = -1074;
         }
-        header << tStream.ReadLine() << wxT("\n");
     }
 
-    double time[2];
-    // Read data:
-    // use vectors temporarily to push back values:
-    std::vector<Vector_double > tempVec(nColumns-int(firstIsTime));
-    std::vector<Vector_double >::iterator it_vd;
-    // Reserve memory right here to speed up file reading a little:
-    for ( it_vd = tempVec.begin(); it_vd != tempVec.end(); ++it_vd ) {
-        // it_vd->reserve( 32768 );
+    DiyFp operator-(const DiyFp& rhs) const {
+        return DiyFp(f - rhs.f, e);
+    }
+
+    // Upper 64 bits of the rounded product.
+    DiyFp operator*(const DiyFp& rhs) const {
+        const unsigned long long M32 = 0xFFFFFFFFULL;
+        unsigned long long a = f >> 32, b = f & M32, c = rhs.f >> 32, d = rhs.f & M32;
+        unsigned long long ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+        unsigned long long tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (1ULL << 31);
+        return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+    }
+
+    DiyFp Normalize() const {
+        DiyFp res = *this;
+        while (!(res.f & (1ULL << 63))) {
+            res.f <<= 1;
+            res.e--;
+        }
+        return res;
+    }
+
+    // Boundaries of the interval of numbers that round to this one.
+    void NormalizedBoundaries(DiyFp& minus, DiyFp& plus) const {
+        plus = DiyFp((f << 1) + 1, e - 1).Normalize();
+        minus = (f == (1ULL << 52)) ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+        minus.f <<= minus.e - plus.e;
+        minus.e = plus.e;
+    }
+
+    unsigned long long f;
+    int e;
+};
+
+// Normalized significands and binary exponents of 10^-348, 10^-340, ..., 10^340.
+const unsigned long long cachedPowersF[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+const int cachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066,
+};
+
+const unsigned long long powers10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// Cached power of ten that brings the binary exponent e into the range of
+// DigitGen; K receives the negated decimal exponent.
+DiyFp GetCachedPower(int e, int& K) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if (dk - k > 0.0)
+        k++;
+    int index = (k >> 3) + 1;
+    K = -(-348 + index*8);
+    return DiyFp(cachedPowersF[index], cachedPowersE[index]);
+}
+
+void GrisuRound(char* buffer, int len, unsigned long long delta, unsigned long long rest,
+                unsigned long long ten_kappa, unsigned long long wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+int CountDecimalDigits(unsigned int n) {
+    int digits = 1;
+    while (digits < 10 && n >= powers10[digits])
+        ++digits;
+    return digits;
+}
+
+void DigitGen(const DiyFp& W, const DiyFp& Mp, unsigned long long delta,
+              char* buffer, int& len, int& K)
+{
+    const DiyFp one(1ULL << -Mp.e, Mp.e);
+    const DiyFp wp_w = Mp - W;
+    unsigned int p1 = (unsigned int)(Mp.f >> -one.e);
+    unsigned long long p2 = Mp.f & (one.f - 1);
+    int kappa = CountDecimalDigits(p1);
+    len = 0;
+    while (kappa > 0) {
+        unsigned int d = (unsigned int)(p1 / powers10[kappa-1]);
+        p1 %= (unsigned int)powers10[kappa-1];
+        if (d || len)
+            buffer[len++] = (char)('0' + d);
+        kappa--;
+        unsigned long long tmp = ((unsigned long long)p1 << -one.e) + p2;
+        if (tmp <= delta) {
+            K += kappa;
+            GrisuRound(buffer, len, delta, tmp, powers10[kappa] << -one.e, wp_w.f);
+            return;
+        }
     }
-    int n_time=0;
-    int nline = 0;
-    bool skip = false;
     for (;;) {
-        if (fStream.Eof())
-            break;
-        nline++;
-        if ( std::div(nline, 100).rem == 0 ) {
-            if ( skip ) {
-                ReturnRec.resize(0);
-                throw std::runtime_error("File import aborted by user.");
-            }
-            if (progress) {
-                wxString progMsg( wxT("Reading line #") );
-                progMsg << nline;
-                progDlg.Pulse( progMsg, &skip );
-            }
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d || len)
+            buffer[len++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            K += kappa;
+            int index = -kappa;
+            GrisuRound(buffer, len, delta, p2, one.f, wp_w.f * (index < 20 ? powers10[index] : 0));
+            return;
+        }
+    }
+}
+
+// Writes the digits of a finite, positive double; returns the number of
+// digits and sets K so that value = digits * 10^K.
+int Grisu2(double value, char* buffer, int& K) {
+    const DiyFp v(value);
+    DiyFp w_m(0, 0), w_p(0, 0);
+    v.NormalizedBoundaries(w_m, w_p);
+    const DiyFp c_mk = GetCachedPower(w_p.e, K);
+    const DiyFp W = v.Normalize() * c_mk;
+    DiyFp Wp = w_p * c_mk;
+    DiyFp Wm = w_m * c_mk;
+    Wm.f++;
+    Wp.f--;
+    int len = 0;
+    DigitGen(W, Wp, Wp.f - Wm.f, buffer, len, K);
+    return len;
+}
+
+// Formats a double like printf's %g, with the shortest digits that read
+// back to the same value. Returns the number of characters written.
+int formatNumber(double x, char* buffer) {
+    char* p = buffer;
+    if (x != x) {
+        memcpy(p, "nan", 3);
+        return 3;
+    }
+    if (x < 0 || (x == 0 && 1/x < 0)) {
+        *p++ = '-';
+        x = -x;
+    }
+    if (x == 0) {
+        *p++ = '0';
+        return (int)(p - buffer);
+    }
+    if (x > 1.7976931348623157e308) {
+        memcpy(p, "inf", 3);
+        return (int)(p - buffer) + 3;
+    }
+    char digits[24];
+    int K = 0;
+    int n = Grisu2(x, digits, K);
+    // Decimal exponent of the first digit:
+    int exp10 = n + K - 1;
+    if (exp10 < -4 || exp10 >= 17) {
+        *p++ = digits[0];
+        if (n > 1) {
+            *p++ = '.';
+            memcpy(p, digits+1, n-1);
+            p += n-1;
+        }
+        p += sprintf(p, "e%c%02d", exp10 < 0 ? '-' : '+', exp10 < 0 ? -exp10 : exp10);
+    } else if (exp10 < 0) {
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = -1; i > exp10; --i)
+            *p++ = '0';
+        memcpy(p, digits, n);
+        p += n;
+    } else if (exp10 + 1 >= n) {
+        memcpy(p, digits, n);
+        p += n;
+        for (int i = n; i <= exp10; ++i)
+            *p++ = '0';
+    } else {
+        memcpy(p, digits, exp10+1);
+        p += exp10+1;
+        *p++ = '.';
+        memcpy(p, digits+exp10+1, n-exp10-1);
+        p += n-exp10-1;
+    }
+    return (int)(p - buffer);
+}
+
+const char* lineEnd(const char* p, const char* end) {
+    const char* nl = (const char*)memchr(p, '\n', end-p);
+    return nl == NULL ? end : nl;
+}
+
+bool isBlank(const char* p, const char* end) {
+    for (; p != end; ++p) {
+        if (!isDelimiter(*p))
+            return false;
+    }
+    return true;
+}
+
+}
+
+stfio::TextColumnParser::TextColumnParser(const char* begin, const char* end)
+    : blocks(), firstRow(), firstLine(), nrows(0)
+{
+    // Split the buffer into blocks that start at the beginning of a line:
+    std::size_t size = end - begin;
+    std::size_t nblocks = std::max((std::size_t)1,
+                                   std::min(size / MIN_BLOCK, (std::size_t)maxThreads()*4));
+    blocks.push_back(begin);
+    for (std::size_t nb = 1; nb < nblocks; ++nb) {
+        const char* p = std::max(blocks.back(), begin + nb*(size/nblocks));
+        p = lineEnd(p, end);
+        if (p != end)
+            ++p;
+        blocks.push_back(p);
+    }
+    blocks.push_back(end);
+
+    // Count rows and lines of each block:
+    nblocks = blocks.size()-1;
+    std::vector<std::size_t> rowCount(nblocks), lineCount(nblocks);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int nb = 0; nb < (int)nblocks; ++nb) {
+        std::size_t nr = 0, nl = 0;
+        for (const char* p = blocks[nb]; p != blocks[nb+1]; ) {
+            const char* le = lineEnd(p, blocks[nb+1]);
+            if (!isBlank(p, le))
+                ++nr;
+            ++nl;
+            p = (le == blocks[nb+1]) ? le : le+1;
         }
-        // calculate sampling rate from first two time values:
-        if (firstIsTime) {
-            double tempTime = tStream.ReadDouble();
-            if (n_time<2) {
-                time[n_time++]=tempTime;
+        rowCount[nb] = nr;
+        lineCount[nb] = nl;
+    }
+    firstRow.resize(nblocks);
+    firstLine.resize(nblocks);
+    std::size_t nl = 0;
+    for (std::size_t nb = 0; nb < nblocks; ++nb) {
+        firstRow[nb] = nrows;
+        firstLine[nb] = nl;
+        nrows += rowCount[nb];
+        nl += lineCount[nb];
+    }
+}
+
+void stfio::TextColumnParser::parse(const std::vector<double*>& dest) const {
+    std::size_t nblocks = firstRow.size();
+    // Exceptions can't leave a parallel region; the first bad line of
+    // each block is recorded instead:
+    std::vector<std::size_t> badLine(nblocks, 0);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int nb = 0; nb < (int)nblocks; ++nb) {
+        std::size_t row = firstRow[nb], line = firstLine[nb];
+        for (const char* p = blocks[nb]; p != blocks[nb+1]; ) {
+            const char* le = lineEnd(p, blocks[nb+1]);
+            ++line;
+            if (!isBlank(p, le)) {
+                for (std::size_t nc = 0; nc < dest.size(); ++nc) {
+                    while (p != le && isDelimiter(*p))
+                        ++p;
+                    double value = 0;
+                    p = (p == le) ? NULL : parseNumber(p, le, value);
+                    if (p == NULL) {
+                        break;
+                    }
+                    if (dest[nc] != NULL)
+                        dest[nc][row] = value;
+                }
+                if (p == NULL) {
+                    badLine[nb] = line;
+                    break;
+                }
+                ++row;
             }
+            p = (le == blocks[nb+1]) ? le : le+1;
         }
+    }
+    for (std::size_t nb = 0; nb < nblocks; ++nb) {
+        if (badLine[nb] != 0) {
+            std::ostringstream errorMsg;
+            errorMsg << "Couldn't read " << dest.size() << " numbers from data line "
+                     << badLine[nb];
+            throw std::runtime_error(errorMsg.str());
+        }
+    }
+}
 
-        if (fStream.Eof())
-            break;
-        for (int n_col=0;n_col<nColumns-int(firstIsTime);++n_col) {
-            tempVec[n_col].push_back( tStream.ReadDouble() );
+const char* stfio::skipLines(const char* begin, const char* end, int nLines) {
+    for (int n = 0; n < nLines && begin != end; ++n) {
+        begin = lineEnd(begin, end);
+        if (begin != end)
+            ++begin;
+    }
+    return begin;
+}
+
+void stfio::writeTextColumns(const std::string& fName, const std::string& header,
+                             const std::vector<const double*>& columns,
+                             const std::vector<std::size_t>& sizes,
+                             double dt, const char* eol)
+{
+    FILE* fp = fopen(fName.c_str(), "wb");
+    if (fp == NULL) {
+        throw std::runtime_error("Couldn't open " + fName + " for writing");
+    }
+    bool ok = (fwrite(header.data(), 1, header.size(), fp) == header.size());
+
+    std::size_t nrows = 0;
+    for (std::size_t nc = 0; nc < sizes.size(); ++nc) {
+        nrows = std::max(nrows, sizes[nc]);
+    }
+    int ncolumns = (int)columns.size() + (dt > 0 ? 1 : 0);
+    std::size_t eolLength = strlen(eol);
+
+    // Blocks of rows are formatted in parallel and written in order:
+    int nblocks = (int)((nrows + BLOCK_ROWS - 1) / BLOCK_ROWS);
+    int batch = maxThreads();
+    std::vector<std::string> buffers(batch);
+    for (int first = 0; first < nblocks && ok; first += batch) {
+        int last = std::min(first + batch, nblocks);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (int nb = first; nb < last; ++nb) {
+            std::string& out = buffers[nb-first];
+            out.clear();
+            out.reserve((std::size_t)BLOCK_ROWS * ncolumns * 12);
+            std::size_t rowEnd = std::min(nrows, (std::size_t)(nb+1)*BLOCK_ROWS);
+            char number[32];
+            for (std::size_t row = (std::size_t)nb*BLOCK_ROWS; row < rowEnd; ++row) {
+                if (dt > 0) {
+                    out.append(number, formatNumber(row*dt, number));
+                }
+                for (std::size_t nc = 0; nc < columns.size(); ++nc) {
+                    if (dt > 0 || nc > 0)
+                        out += '\t';
+                    double value = (row < sizes[nc]) ? columns[nc][row] : 0.0;
+                    out.append(number, formatNumber(value, number));
+                }
+                out.append(eol, eolLength);
+            }
+        }
+        for (int nb = first; nb < last && ok; ++nb) {
+            const std::string& out = buffers[nb-first];
+            ok = (fwrite(out.data(), 1, out.size(), fp) == out.size());
         }
     }
-    if ( tempVec.empty() ) {
-        ReturnRec.resize(0);
-        throw std::runtime_error("Empty text file; aborting file import.");
+    if (fclose(fp) != 0 || !ok) {
+        throw std::runtime_error("Error while writing " + fName);
     }
-    // insert vectors:
-    int n_sec=0, n_ch=0;
-    if (toSection) {
-        n_sec=nColumns-int(firstIsTime);
-        n_ch=1;
-    } else {
-        n_sec=1;
-        n_ch=nColumns-int(firstIsTime);
+}
+
+void stfio::importASCIIFile(const std::string& fName, int hLinesToSkip, int nColumns,
+                            bool firstIsTime, bool toSection, Recording& ReturnRec,
+                            ProgressInfo& progDlg)
+{
+    if (nColumns <= int(firstIsTime)) {
+        throw std::runtime_error("No data columns; aborting file import.");
+    }
+    MappedFile file(fName);
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    const char* data = stfio::skipLines(begin, end, hLinesToSkip);
+    std::string header(begin, data);
+
+    progDlg.Update(0, "Finding lines");
+    TextColumnParser parser(data, end);
+    if (parser.rows() == 0) {
+        throw std::runtime_error("Empty text file; aborting file import.");
     }
+
+    // Sections are allocated first and filled by the parser:
+    int n_data = nColumns-int(firstIsTime);
+    int n_sec = toSection ? n_data : 1;
+    int n_ch = toSection ? 1 : n_data;
     ReturnRec.resize(n_ch);
-    std::vector<Channel> TempChannel(n_ch,Channel(n_sec));
-    for (int n_insert=0;n_insert<nColumns-int(firstIsTime);++n_insert) {
-        Section TempSection(tempVec[n_insert].size());
-        std::copy(tempVec[n_insert].begin(),tempVec[n_insert].end(),&TempSection[0]);
-        try {
+    std::vector<double*> dest;
+    Vector_double time;
+    if (firstIsTime) {
+        time.resize(parser.rows());
+        dest.push_back(&time[0]);
+    }
+    for (int n_c = 0; n_c < n_ch; ++n_c) {
+        ReturnRec[n_c].resize(n_sec);
+        for (int n_s = 0; n_s < n_sec; ++n_s) {
+            std::ostringstream label;
             if (toSection) {
-                std::ostringstream label;
-                label << stf::noPath(fName) << ", Section # " << n_insert+1;
-                TempSection.SetSectionDescription(label.str());
-                TempChannel[0].InsertSection(TempSection,n_insert);
+                label << noPath(fName) << ", Section # " << n_s+1;
             } else {
-                std::ostringstream label;
                 label << fName << ", Section # 1";
-                TempSection.SetSectionDescription(label.str());
-                TempChannel[n_insert].InsertSection(TempSection,0);
             }
+            ReturnRec[n_c][n_s] = Section(parser.rows(), label.str());
+            dest.push_back(&ReturnRec[n_c][n_s].get_w()[0]);
         }
-        catch (...) {throw;}
     }
-    for (std::size_t n_ch=0;n_ch<TempChannel.size();++n_ch) {
-        try {
-            ReturnRec.InsertChannel(TempChannel[n_ch],n_ch);
-        }
-        catch (...) {throw;}
+
+    progDlg.Update(50, "Reading data");
+    try {
+        parser.parse(dest);
+    }
+    catch (...) {
+        ReturnRec.resize(0);
+        throw;
     }
 
-    if (firstIsTime) {
+    if (firstIsTime && time.size() > 1) {
         if (time[1]-time[0] <= 0) {
             ReturnRec.resize(0);
             throw std::runtime_error("Negative sampling interval\n"
@@ -149,38 +618,23 @@ void stf::importASCIIFile( const wxString& fName, int hLinesToSkip, int nColumns
         }
         ReturnRec.SetXScale(time[1]-time[0]);
     }
-#if (wxCHECK_VERSION(2, 9, 0) || defined(MODULE_ONLY))
-    ReturnRec.SetFileDescription( header.ToStdString() );
-#else
-    ReturnRec.SetFileDescription(std::string(header.mb_str()));
-#endif    
+    ReturnRec.SetFileDescription(header);
 }
 
-bool stf::exportASCIIFile(const wxString& fName, const Section& Export) {
-    wxString out( stf::sectionToString(Export) );
-    ofstreamMan ASCIIfile( fName );
-    ASCIIfile.myStream.Write( out );
+bool stfio::exportASCIIFile(const std::string& fName, const Section& Export, double dt) {
+    std::ostringstream header;
+    header << Export.size() << "\n";
+    std::vector<const double*> columns(1, Export.get().empty() ? NULL : &Export.get()[0]);
+    std::vector<std::size_t> sizes(1, Export.size());
+    stfio::writeTextColumns(fName, header.str(), columns, sizes, dt, "\n");
     return true;
 }
 
-bool stf::exportASCIIFile(const wxString& fName, const Channel& Export) {
-    wxProgressDialog progDlg( wxT("Exporting channel"), wxT("Starting..."), 100,
-            NULL, wxPD_SMOOTH | wxPD_AUTO_HIDE | wxPD_APP_MODAL );
-
+bool stfio::exportASCIIFile(const std::string& fName, const Channel& Export, double dt) {
     for (std::size_t n_s=0;n_s<Export.size();++n_s) {
-        // create new filename:
-        wxString newFName;
-        newFName << fName << wxT("_") << (int)n_s << wxT(".txt");
-        wxString progStr;
-        progStr << wxT("Writing section #") << (int)n_s + 1 << wxT(" of ") << (int)Export.size()
-        << wxT("\nto file: ") << newFName;
-        progDlg.Update(
-                // Section contribution:
-                (int)((double)n_s/(double)Export.size()*100.0),
-                progStr
-        );
-        ofstreamMan ASCIIfile( newFName );
-        ASCIIfile.myStream.Write( stf::sectionToString(Export[n_s]) );
+        std::ostringstream newFName;
+        newFName << fName << "_" << (int)n_s << ".txt";
+        stfio::exportASCIIFile(newFName.str(), Export[n_s], dt);
     }
     return true;
 }
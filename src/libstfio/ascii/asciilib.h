@@ -26,6 +26,65 @@
 
 namespace stfio {
 
+//! Finds the data lines of a text buffer and parses them into columns.
+/*! The buffer is split into blocks at line boundaries, and the blocks are
+ *  scanned and parsed in parallel if OpenMP is enabled. Every line that
+ *  contains anything but white space is a row; values are separated by
+ *  tabs, commas or spaces.
+ */
+class StfioDll TextColumnParser {
+public:
+    //! Constructor. Counts the rows of the buffer.
+    /*! \param begin First character of the data lines.
+     *  \param end One past the last character of the data lines.
+     */
+    TextColumnParser(const char* begin, const char* end);
+
+    //! Number of rows.
+    /*! \return The number of non-empty lines.
+     */
+    std::size_t rows() const { return nrows; }
+
+    //! Parses the leading values of every row.
+    /*! Throws std::runtime_error if a row has fewer than dest.size() values.
+     *  \param dest Column j of row i is written to dest[j][i]; columns with
+     *         a NULL pointer are skipped. Each column has to hold rows() values.
+     */
+    void parse(const std::vector<double*>& dest) const;
+
+private:
+    std::vector<const char*> blocks;
+    std::vector<std::size_t> firstRow, firstLine;
+    std::size_t nrows;
+};
+
+//! Skips lines of a text buffer.
+/*! \param begin First character of the buffer.
+ *  \param end One past the last character of the buffer.
+ *  \param nLines Number of lines to skip.
+ *  \return The beginning of the next line, or \e end if the buffer has
+ *          fewer lines.
+ */
+StfioDll const char* skipLines(const char* begin, const char* end, int nLines);
+
+//! Writes columns of numbers to a text file.
+/*! Numbers are written with the fewest digits that read back to the same
+ *  double. Blocks of rows are formatted in parallel if OpenMP is enabled.
+ *  Throws std::runtime_error if the file can't be written.
+ *  \param fName Full path to the file to be written.
+ *  \param header Text that is written before the numbers.
+ *  \param columns Pointers to the values of each column.
+ *  \param sizes Number of values of each column; missing values of shorter
+ *         columns are written as 0.
+ *  \param dt If positive, a first column with the time of each row (row * dt)
+ *         is added.
+ *  \param eol The end-of-line sequence.
+ */
+StfioDll void writeTextColumns(const std::string& fName, const std::string& header,
+                               const std::vector<const double*>& columns,
+                               const std::vector<std::size_t>& sizes,
+                               double dt, const char* eol);
+
 //! Open an ASCII file and store its contents to a Recording object.
 /*! \param fName Full path to the file to be read.
  *  \param hLinesToSkip Header lines to skip.
@@ -48,20 +107,19 @@ void importASCIIFile(const std::string& fName,
 //! Export a Section to a text file.
 /*! \param fName Full path to the file to be written.
  *  \param Export The section to be exported.
+ *  \param dt The sampling interval.
  *  \return true upon success, false otherwise.
  */
-bool exportASCIIFile(const std::string& fName, const Section& Export);
+bool exportASCIIFile(const std::string& fName, const Section& Export, double dt);
 
-//! Export a Channel to a text file.
-/*! \param fName Full path to the file to be written.
+//! Export a Channel to text files.
+/*! Every section is written to a file of its own, named fName_n.txt.
+ *  \param fName Full path of the files to be written, without extension.
  *  \param Export The channel to be exported.
+ *  \param dt The sampling interval.
  *  \return true upon success, false otherwise.
  */
-bool exportASCIIFile(const std::string& fName, const Channel& Export);
- 
-#if 0
-std::string NextWord( std::string& str );
-#endif
+bool exportASCIIFile(const std::string& fName, const Channel& Export, double dt);
 
 }
 
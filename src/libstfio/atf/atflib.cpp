@@ -12,208 +12,147 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
-#include <iostream>
 #include <sstream>
+#include <stdexcept>
 
 #include "./atflib.h"
 #include "../recording.h"
+#include "../mappedfile.h"
+#include "../ascii/asciilib.h"
 
-namespace stfio {
-    std::string ATFError(const std::string& fName, int nError);
+namespace {
+
+// Reads the next double-quoted string of a line.
+const char* readQuoted(const char* p, const char* end, std::string& value) {
+    while (p != end && *p != '"' && *p != '\n')
+        ++p;
+    if (p == end || *p != '"')
+        return NULL;
+    const char* start = ++p;
+    while (p != end && *p != '"' && *p != '\n')
+        ++p;
+    if (p == end || *p != '"')
+        return NULL;
+    value = std::string(start, p);
+    return p+1;
 }
 
-std::string stfio::ATFError(const std::string& fName, int nError) {
-    int nMaxLen=320;
-    std::vector<char> errorMsg(nMaxLen);
-    ATF_BuildErrorText(nError, fName.c_str(),&errorMsg[0], nMaxLen );
-    return std::string( &errorMsg[0] );
+// Splits a column title of the form "Title (units)".
+void splitTitle(const std::string& title, std::string& name, std::string& units) {
+    std::size_t open = title.rfind('(');
+    if (!title.empty() && title[title.size()-1] == ')' && open != std::string::npos) {
+        units = title.substr(open+1, title.size()-open-2);
+        name = title.substr(0, open);
+        while (!name.empty() && name[name.size()-1] == ' ')
+            name.erase(name.size()-1);
+    } else {
+        name = title;
+        units = "";
+    }
 }
 
-bool stfio::exportATFFile(const std::string& fName, const Recording& WData) {
-    int nColumns=1+(int)WData[0].size() /*time + number of sections*/, nFileNum;
-    int nError;
+}
 
-    if (!ATF_OpenFile(fName.c_str(),ATF_WRITEONLY,&nColumns,&nFileNum,&nError)) {
-        std::string errorMsg("Exception while calling ATF_OpenFile():\n");
-        errorMsg += ATFError(fName,nError);
-        throw std::runtime_error(errorMsg);
-    }
-    // Write sections to columns:
-    // First column is time:
-    for (int n_c=0;n_c<nColumns;++n_c) {
-        std::string columnTitle,columnUnits;
-        if (n_c==0) {
-            columnTitle = "Time";
-            columnUnits = WData.GetXUnits();
-        } else {
-            std::ostringstream titleStr;
-            titleStr << "Section[" << n_c-1 << "]";
-            columnTitle = titleStr.str();
-            columnUnits = WData[0].GetYUnits();
-        }
-        if (!ATF_SetColumnTitle(nFileNum, columnTitle.c_str(), &nError)) {
-            std::string errorMsg("Exception while calling ATF_SetColumnTitle():\n");
-            errorMsg+=ATFError(fName,nError);
-            throw std::runtime_error(errorMsg);
-        }
-        if (!ATF_SetColumnUnits(nFileNum, columnUnits.c_str(),&nError)) {
-            std::string errorMsg("Exception while calling ATF_SetColumnUnits():\n");
-            errorMsg+=ATFError(fName,nError);
-            throw std::runtime_error(errorMsg);
-        }
-    }
-    // Write data line by line:
-    std::size_t max_size=WData[0][0].size();
-    // check for equal section sizes:
-    for (int n_s=1;n_s<(int)WData[0].size();++n_s) {
-        if (WData[0][n_s].size() > max_size) {
-            max_size=WData[0][n_s].size();
-        }
-    }
-    for (int n_l=0;n_l < (int)max_size; ++n_l) {
-        for (int n_c=0;n_c<nColumns;++n_c) {
-            if (n_c==0) {
-                // Write time:
-                double time=n_l*WData.GetXScale();
-                if (!ATF_WriteDataRecord1(nFileNum,time,&nError)) {
-                    std::string errorMsg("Exception while calling ATF_WriteDataRecord1():\n");
-                    errorMsg+=ATFError(fName,nError);
-                    throw std::runtime_error(errorMsg);
-                }
-            } else {
-                double toWrite = (n_l < (int)WData[0][n_c-1].size()) ?
-                        (double)WData[0][n_c-1][n_l] :
-                0.0;
-                        if (!ATF_WriteDataRecord1(nFileNum,toWrite,&nError)) {
-                            std::string errorMsg("Exception while calling ATF_WriteDataRecord1():\n");
-                            errorMsg+=ATFError(fName,nError);
-                            throw std::runtime_error(errorMsg);
-                        }
-            }
-        }
-        if (!ATF_WriteEndOfLine(nFileNum,&nError)) {
-            std::string errorMsg("Exception while calling ATF_WriteEndOfLine():\n");
-            errorMsg+=ATFError(fName,nError);
-            throw std::runtime_error(errorMsg);
-        }
-    }
-    if (!ATF_CloseFile(nFileNum)) {
-        std::string errorMsg("Exception while calling ATF_CloseFile():\n");
-        errorMsg += "Error while closing ATF file";
-        throw std::runtime_error(errorMsg);
+bool stfio::exportATFFile(const std::string& fName, const Recording& WData) {
+    // First column is time, followed by one column per section:
+    std::size_t nSections = WData[0].size();
+    std::ostringstream header;
+    header << "ATF\t1.0\r\n"
+           << "0\t" << nSections+1 << "\r\n"
+           << "\"Time (" << WData.GetXUnits() << ")\"";
+    std::vector<const double*> columns(nSections);
+    std::vector<std::size_t> sizes(nSections);
+    for (std::size_t n_s=0; n_s<nSections; ++n_s) {
+        header << "\t\"Section[" << n_s << "] (" << WData[0].GetYUnits() << ")\"";
+        const Vector_double& data = WData[0][n_s].get();
+        columns[n_s] = data.empty() ? NULL : &data[0];
+        sizes[n_s] = data.size();
     }
+    header << "\r\n";
+    stfio::writeTextColumns(fName, header.str(), columns, sizes, WData.GetXScale(), "\r\n");
     return true;
 }
 
 void stfio::importATFFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
-    int nColumns, nFileNum;
-    int nError;
-    const int nMaxText=64;
-
-    if (!ATF_OpenFile(fName.c_str(),ATF_READONLY,&nColumns,&nFileNum,&nError)) {
-        std::string errorMsg("Exception while calling ATF_OpenFile():\n");
-        errorMsg+=ATFError(fName,nError);
-        throw std::runtime_error(errorMsg);
+    MappedFile file(fName);
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    if (file.size() < 3 || std::string(begin, begin+3) != "ATF") {
+        throw std::runtime_error("Error while opening ATF file:\nFile identifier not found");
     }
+
+    // Second line: number of optional header records and number of columns.
+    const char* p = stfio::skipLines(begin, end, 1);
+    int nHeaders = 0, nColumns = 0;
+    std::istringstream counts(std::string(p, stfio::skipLines(p, end, 1)));
+    counts >> nHeaders;
+    counts.ignore(1);
+    counts >> nColumns;
     // Assume that the first column is time:
-    if (nColumns==0) {
+    if (!counts || nColumns<=0) {
         std::string errorMsg("Error while opening ATF file:\nFile appears to be empty");
         throw std::runtime_error(errorMsg);
     }
-    long sectionSize;
-    if (!ATF_CountDataLines(nFileNum,&sectionSize,&nError)) {
-        std::string errorMsg("Exception while calling ATF_CountDataLines():\n");
-        errorMsg+=ATFError(fName,nError);
-        throw std::runtime_error(errorMsg);
+    p = stfio::skipLines(p, end, 1+nHeaders);
+
+    // Column titles and units:
+    std::vector<std::string> titles(nColumns), units(nColumns);
+    const char* titleEnd = stfio::skipLines(p, end, 1);
+    for (int n_c=0; n_c<nColumns; ++n_c) {
+        std::string title;
+        p = readQuoted(p, titleEnd, title);
+        if (p == NULL) {
+            throw std::runtime_error("Error while opening ATF file:\nCouldn't read column titles");
+        }
+        splitTitle(title, titles[n_c], units[n_c]);
     }
 
+    progDlg.Update(0, "Finding lines");
+    stfio::TextColumnParser parser(titleEnd, end);
+    std::size_t sectionSize = parser.rows();
+
     // If first column contains time values, determine sampling interval:
-    std::vector<char> titleVec(nMaxText);
-    if (!ATF_GetColumnTitle(nFileNum,0,&titleVec[0],nMaxText,&nError)) {
-        std::string errorMsg("Exception while calling ATF_GetColumnTitle():\n");
-        errorMsg+=ATFError(fName,nError);
-        throw std::runtime_error(errorMsg);
-    }
-    std::string titleString(titleVec.begin(),titleVec.end());
+    const std::string& titleString = titles[0];
     int timeInFirstColumn=0;
     if (titleString.find("time")!=std::string::npos ||
             titleString.find("Time")!=std::string::npos ||
             titleString.find("TIME")!=std::string::npos)
     {
-        // Read sampling information from first two time values:
-        double time[2];
-        for (int n_l=0;n_l<2;++n_l) {
-            if (!ATF_ReadDataColumn(nFileNum,0,&time[n_l],&nError)) {
-                std::string errorMsg("Exception while calling ATF_ReadDataColumn():\n");
-                errorMsg+=ATFError(fName,nError);
-                throw std::runtime_error(errorMsg);
-            }
-        }
-        if (!ATF_RewindFile(nFileNum,&nError)) {
-            std::string errorMsg("Exception while calling ATF_RewindFile():\n");
-            errorMsg+=ATFError(fName,nError);
-            throw std::runtime_error(errorMsg);
-        }
-
-        ReturnData.SetXScale(time[1]-time[0]);
         timeInFirstColumn=1;
     }
+
+    // Sections are allocated first and filled by the parser:
     ReturnData.resize(1);
-    Channel TempChannel(nColumns-timeInFirstColumn);
+    ReturnData[0].resize(nColumns-timeInFirstColumn);
+    std::vector<double*> dest(nColumns, (double*)NULL);
+    Vector_double time;
+    if (timeInFirstColumn) {
+        time.resize(sectionSize);
+        if (sectionSize != 0)
+            dest[0] = &time[0];
+    }
     for (int n_c=timeInFirstColumn;n_c<nColumns;++n_c) {
-        int progbar = (double)100.0*(n_c+1-timeInFirstColumn)/(double)(nColumns-timeInFirstColumn);
-
-        std::ostringstream progStr;
-        progStr << "Section #" << n_c+1-timeInFirstColumn << " of " << nColumns-timeInFirstColumn;
-        progDlg.Update(progbar, progStr.str());
         std::ostringstream label;
         label
             << fName 
             << ", Section # " << n_c-timeInFirstColumn+1;
-        Section TempSection(sectionSize,label.str());
-        for (int n_l=0;n_l<sectionSize;++n_l) {
-            if (!ATF_ReadDataColumn(nFileNum,n_c,&TempSection[n_l],&nError)) {
-                std::string errorMsg("Exception while calling ATF_ReadDataColumn():\n");
-                errorMsg+=ATFError(fName,nError);
-                ReturnData.resize(0);
-                throw std::runtime_error(errorMsg);
-            }
-        }
-        if (n_c-timeInFirstColumn==0) {
-            std::vector<char> unitsVec(nMaxText);
-            if (!ATF_GetColumnUnits(nFileNum,n_c,&unitsVec[0],nMaxText,&nError)) {
-                std::string errorMsg("Exception while calling ATF_GetColumnUnits():\n");
-                errorMsg+=ATFError(fName,nError);
-                ReturnData.resize(0);
-                throw std::runtime_error(errorMsg);
-            }
-            ReturnData[0].SetYUnits(std::string(&unitsVec[0]));
-        }
-        try {
-            TempChannel.InsertSection(TempSection,n_c-timeInFirstColumn);
-        }
-        catch (...) {
-            throw;
-        }
-        // Rewind file before reading next column:
-        if (!ATF_RewindFile(nFileNum,&nError)) {
-            std::string errorMsg("Exception while calling ATF_RewindFile():\n");
-            errorMsg+=ATFError(fName,nError);
-            ReturnData.resize(0);
-            throw std::runtime_error(errorMsg);
-        }
+        ReturnData[0][n_c-timeInFirstColumn] = Section(sectionSize,label.str());
+        if (sectionSize != 0)
+            dest[n_c] = &ReturnData[0][n_c-timeInFirstColumn].get_w()[0];
     }
+    if (nColumns > timeInFirstColumn)
+        ReturnData[0].SetYUnits(units[timeInFirstColumn]);
+
+    progDlg.Update(50, "Reading data");
     try {
-        ReturnData.InsertChannel(TempChannel,0);
+        parser.parse(dest);
     }
     catch (...) {
         ReturnData.resize(0);
         throw;
     }
-
-    if (!ATF_CloseFile(nFileNum)) {
-        std::string errorMsg("Exception while calling ATF_CloseFile():\n");
-        errorMsg += "Error while closing ATF file";
-        throw std::runtime_error(errorMsg);
+    // Read sampling information from first two time values:
+    if (time.size() > 1) {
+        ReturnData.SetXScale(time[1]-time[0]);
     }
 }
@@ -18,11 +18,15 @@
  *  \brief Import and export Axon text files.
  */
 
+/*
+Files are read and written by the text engine in ascii/asciilib.h
+instead of the line-by-line functions of the Axon ATF library.
+*/
+
 #ifndef _ATFLIB_H
 #define _ATFLIB_H
 
 #include "./../stfio.h"
-#include "./../abf/axon/AxAtfFio32/axatffio32.h"
 
 class Recording;
 
@@ -14,12 +14,15 @@
 
 // Copyright 2012,2013,2017 Alois Schloegl, IST Austria
 
+#include <algorithm>
 #include <sstream>
 
 #include "../stfio.h"
 
     #if defined(WITH_BIOSIGLITE)
         #include "../../libbiosiglite/biosig4c++/biosig2.h"
+        /* needed to switch off channels with CHANNEL_TYPE::OnOff */
+        #include "../../libbiosiglite/biosig4c++/biosig-dev.h"
     #else
         #include <biosig.h>
     #endif
@@ -55,6 +58,7 @@ stfio::filetype stfio_file_type(HDRTYPE* hdr) {
         case AXG:	return stfio::axg;
         case IBW:	return stfio::igor;
         case SMR:	return stfio::son;
+        case TDMS:	return stfio::tdms;
         default:	return stfio::none;
         }
 }
@@ -65,7 +69,35 @@ bool stfio::check_biosig_version(int a, int b, int c) {
 }
 #endif
 
-stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
+#ifdef __LIBBIOSIG2_H__
+/* Selects the channels to be read by sread(), and returns the column of every
+   selected channel in the data block. Unselected channels are switched off if
+   the channel headers are accessible; otherwise, they are read, but not copied. */
+static std::vector<int> select_channels(HDRTYPE* hdr, const stfio::importRequest& request) {
+    int numberOfChannels = biosig_get_number_of_channels(hdr);
+    std::vector<CHANNEL_TYPE*> unselected;
+    std::vector<int> columns;
+    for (int ch=0; ch < numberOfChannels; ++ch) {
+        if (request.HasChannel(ch)) {
+            columns.push_back(ch);
+        } else {
+            unselected.push_back(biosig_get_channel(hdr, ch));
+        }
+    }
+#if defined(WITH_BIOSIGLITE)
+    for (size_t k=0; k < unselected.size(); ++k) {
+        unselected[k]->OnOff = 0;
+    }
+    for (size_t k=0; k < columns.size(); ++k) {
+        columns[k] = (int)k;
+    }
+#endif
+    return columns;
+}
+#endif
+
+stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg,
+                                        const importRequest& request) {
 
     std::string errorMsg("Exception while calling std::importBSFile():\n");
     std::string yunits;
@@ -96,8 +128,8 @@ stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &Ret
         return type;
     }
     enum FileFormat biosig_filetype=biosig_get_filetype(hdr);
-    if (biosig_filetype==ATF || biosig_filetype==ABF2 || biosig_filetype==HDF ) {
-        // ATF, ABF2 and HDF5 support should be handled by importATF, and importABF, and importHDF5 not importBiosig
+    if (biosig_filetype==ATF || biosig_filetype==ABF2 || biosig_filetype==HDF || biosig_filetype==TDMS ) {
+        // ATF, ABF2, HDF5 and TDMS support should be handled by importATF, importABF, importHDF5 and importTDMS, not importBiosig
         ReturnData.resize(0);
         destructHDR(hdr);
         return type;
@@ -118,7 +150,8 @@ stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &Ret
     double fs = biosig_get_eventtable_samplerate(hdr);
     size_t numberOfEvents = biosig_get_number_of_events(hdr);
     size_t nsections = biosig_get_number_of_segments(hdr);
-    ReturnData.InitSectionMarkerList(nsections);
+    size_t sectionEnd = request.SectionEnd(nsections);
+    ReturnData.InitSectionMarkerList(sectionEnd - request.firstSection);
     std::vector<size_t> SegIndexList(nsections+1);
     SegIndexList[0] = 0;
     SegIndexList[nsections] = biosig_get_number_of_samples(hdr);
@@ -142,7 +175,8 @@ stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &Ret
             annotationTableDesc += std::string( str );
 
             size_t currentSectionNumber = (pos < SegIndexList[n]) ? n : (n+1);
-            ReturnData.SetSectionType(currentSectionNumber-1, typ);
+            if (request.HasSection(currentSectionNumber-1, nsections))
+                ReturnData.SetSectionType(currentSectionNumber-1-request.firstSection, typ);
             // TODO: Description of EvenTypes
             // ReturnData.SetEventDescription( currentSectionNumber-1, desc);
         }
@@ -168,8 +202,41 @@ stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &Ret
     /*************************************************************************
         read bulk data
      *************************************************************************/
-    biosig_data_type *data = biosig_get_data(hdr, 0);
-    size_t SPR = biosig_get_number_of_samples(hdr);
+    std::vector<int> columns = select_channels(hdr, request);
+    numberOfChannels = columns.size();
+
+    // Only the records that span the selected sections and data points are read:
+    size_t firstSample = SegIndexList[nsections], endSample = 0;
+    for (size_t ns=request.firstSection; ns < sectionEnd; ns++) {
+        if (SegIndexList[ns+1] < SegIndexList[ns]) {
+            ReturnData.resize(0);
+            destructHDR(hdr);
+            return type;
+        }
+        size_t start = 0, n = 0;
+        request.Window(SegIndexList[ns+1]-SegIndexList[ns], start, n);
+        if (n == 0) {
+            continue;
+        }
+        firstSample = std::min(firstSample, SegIndexList[ns]+start);
+        endSample = std::max(endSample, SegIndexList[ns]+start+n);
+    }
+    size_t NRec = biosig_get_number_of_records(hdr);
+    size_t SPR = (NRec > 0) ? biosig_get_number_of_samples(hdr) / NRec : 0;   // samples per record
+    size_t firstRecord = 0, numberOfRecords = 0;
+    if (SPR > 0 && endSample > firstSample) {
+        firstRecord = firstSample / SPR;
+        numberOfRecords = (endSample + SPR - 1) / SPR - firstRecord;
+    }
+    biosig_data_type *data = NULL;
+    size_t rows = 0, cols = 0;
+    if (numberOfRecords > 0 && numberOfChannels > 0) {
+        biosig_reset_flag(hdr, BIOSIG_FLAG_ROW_BASED_CHANNELS);
+        sread(NULL, firstRecord, numberOfRecords, hdr);
+        biosig_get_datablock(hdr, &data, &rows, &cols);
+    }
+    // index of the first sample in the data block:
+    size_t blockStart = firstRecord * SPR;
 
 #ifdef _STFDEBUG
     std::cout << "Number of events: " << numberOfEvents << std::endl;
@@ -177,18 +244,15 @@ stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &Ret
 #endif
 
     for (int NS=0; NS < numberOfChannels; ) {
-        CHANNEL_TYPE *hc = biosig_get_channel(hdr, NS);
-        Channel TempChannel(nsections);
+        CHANNEL_TYPE *hc = biosig_get_channel(hdr, columns[NS]);
+        Channel TempChannel(sectionEnd - request.firstSection);
         TempChannel.SetChannelName(biosig_channel_get_label(hc));
         TempChannel.SetYUnits(biosig_channel_get_physdim(hc));
 
-        for (size_t ns=1; ns<=nsections; ns++) {
-            if (SegIndexList[ns]-SegIndexList[ns-1] < 0) {
-                ReturnData.resize(0);
-                destructHDR(hdr);
-                return type;
-            }
+        for (size_t ns=request.firstSection+1; ns<=sectionEnd; ns++) {
             size_t SPS = SegIndexList[ns]-SegIndexList[ns-1];	// length of segment, samples per segment
+            size_t start = 0, n = 0;
+            request.Window(SPS, start, n);
 
             int progbar = int(100.0 * (1.0 * ns / nsections + NS) / numberOfChannels);
             std::ostringstream progStr;
@@ -196,14 +260,22 @@ stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &Ret
                 << ", Section #" << ns << " of " << nsections;
             progDlg.Update(progbar, progStr.str());
 
-            Section TempSection(SPS, "");
-
-            std::copy(&(data[NS*SPR + SegIndexList[ns-1]]),
-			    &(data[NS*SPR + SegIndexList[ns]]),
-			    TempSection.get_w().begin() );
+            Section TempSection(n, "");
+
+            if (n > 0) {
+                size_t first = SegIndexList[ns-1] + start - blockStart;
+                if (data == NULL || first + n > rows) {
+                    ReturnData.resize(0);
+                    destructHDR(hdr);
+                    return type;
+                }
+                std::copy(&(data[columns[NS]*rows + first]),
+                          &(data[columns[NS]*rows + first + n]),
+                          TempSection.get_w().begin() );
+            }
 
             try {
-                TempChannel.InsertSection(TempSection, ns-1);
+                TempChannel.InsertSection(TempSection, ns-1-request.firstSection);
             }
             catch (...) {
                 ReturnData.resize(0);
@@ -53,8 +53,12 @@ StfioDll bool check_biosig_version(int a, int b, int c);
  *  Return value: in case of success stfio::biosig is returned,
  *    if the file format is recognized, the corresponding filetype is returned,
  *    if the filetype is not recognized or not supported. stfio::none is returned.
+ *
+ *  Only the records that span the sections and data points selected by \e request
+ *    are read. With libbiosiglite, unselected channels are switched off before reading.
  */
-stfio::filetype importBiosigFile(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg);
+stfio::filetype importBiosigFile(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg,
+                                 const importRequest& request = importRequest());
 
 //! Export a Recording to a GDF file using biosig.
 /*! \param fName Full path to the file to be written.
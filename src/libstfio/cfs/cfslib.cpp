@@ -20,6 +20,7 @@
 #include "./cfs.h"
 
 #include "../recording.h"
+#include "../compactsource.h"
 
 namespace stfio {
 
@@ -316,7 +317,9 @@ bool stfio::exportCFSFile(const std::string& fName, const Recording& WData, stfi
     return true;
 }
 
-int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg) {
+int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg,
+                         const importRequest& request)
+{
 
     std::string errorMsg;
     // Open old CFS File (read only) - see manual of CFS file system
@@ -345,7 +348,12 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
         throw std::runtime_error(errorMsg);
 
     //memory allocation
-    ReturnData.resize(channelsAvail);
+    short channelsSelected=0;
+    for (short n_channel=0; n_channel < channelsAvail; ++n_channel) {
+        if (request.HasChannel(n_channel))
+            channelsSelected++;
+    }
+    ReturnData.resize(channelsSelected);
 
     //Variables to store the Descriptions of a single variable as text
     std::string	file_description,    //File variable
@@ -382,8 +390,10 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
     TCFSKind dataKind;
     short spacing, other;
     float xScale=1.0;
-    std::size_t empty_channels=0;
+    std::size_t empty_channels=0, n_out=0;
     for (short n_channel=0; n_channel < channelsAvail; ++n_channel) {
+        if (!request.HasChannel(n_channel))
+            continue;
 
         //Get constant information for a particular data channel -
         //see manual of CFS file system.
@@ -425,11 +435,14 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
         outputstream << "XOffset=" <<  xOffset << "\n";
         scaling += outputstream.str();
 
-        Channel TempChannel(dataSections);
+        // Empty sections are dropped, so that the selected sections are
+        // counted among the non-empty ones:
+        std::size_t sectionEnd = request.SectionEnd(dataSections);
+        Channel TempChannel(sectionEnd-request.firstSection);
         TempChannel.SetChannelName(channel_name);
         TempChannel.SetYUnits(yUnits);
-        std::size_t empty_sections=0;
-        for (int n_section=0; n_section < dataSections; ++n_section) {
+        std::size_t n_nonempty=0;
+        for (int n_section=0; n_section < dataSections && n_nonempty < sectionEnd; ++n_section) {
             int progbar =
                 // Channel contribution:
                 (int)(((double)n_channel/(double)channelsAvail)*100.0+
@@ -448,12 +461,22 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
             GetDSChan(CFSFile.myHandle,(short)n_channel,(WORD)n_section+1,&startOffset,
                 &points[n_section],&yScale,&yOffset,&xScale,&xOffset);
             if (CFSError(errorMsg))	throw std::runtime_error(errorMsg);
+            if (points[n_section] == 0)
+                continue;
+            if (n_nonempty++ < request.firstSection)
+                continue;
             std::ostringstream label;
             label << fName << ", Section # " << n_section+1;
-            Section TempSection(
-                (int)(points[n_section]),
-                label.str()
-            );
+            // Only the selected data points are read:
+            std::size_t start=0, n_points=0;
+            request.Window(points[n_section], start, n_points);
+            // Samples are kept in their compact format and scaled on access:
+            Vector_float fTempSection;
+            std::vector<short> TempSection_raw;
+            if (dataType == RL4)
+                fTempSection.resize(n_points);
+            else
+                TempSection_raw.resize(n_points);
             //-----------------------------------------------------
             //The following part was modified to read data sections
             //larger than 64 KB as e.g. produced by Igor.
@@ -466,10 +489,12 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
 
             //Calculation of the number of blocks depending on the data format:
             //RL4 - 4 byte floating point numbers (2 byte int numbers otherwise)
-            if (dataType == RL4)
-                nBlocks=(int)(((points[n_section]*4-1)/CFSMAXBYTES) + 1);
+            if (n_points == 0)
+                nBlocks=0;
+            else if (dataType == RL4)
+                nBlocks=(int)(((n_points*4-1)/CFSMAXBYTES) + 1);
             else
-                nBlocks=(int)(((points[n_section]*2-1)/CFSMAXBYTES) + 1);
+                nBlocks=(int)(((n_points*2-1)/CFSMAXBYTES) + 1);
 
             for (int b=0; b < nBlocks; ++b) {
                 //Begin loop: storage of blocks
@@ -479,16 +504,16 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
                     //- see manual of CFS file system
                     //Temporary arrays to store blocks:
                     if (b == nBlocks - 1)
-                        nBlockBytes=points[n_section]*4 - b*CFSMAXBYTES;
+                        nBlockBytes=n_points*4 - b*CFSMAXBYTES;
                     else
                         nBlockBytes=CFSMAXBYTES;
                     Vector_float fTempSection_small(nBlockBytes);
                     GetChanData(CFSFile.myHandle, (short)n_channel, (WORD)n_section+1,
-                        b*CFSMAXBYTES/4, (WORD)nBlockBytes/4, &fTempSection_small[0],
-                        4*(points[n_section]+1));
+                        start + b*CFSMAXBYTES/4, (WORD)nBlockBytes/4, &fTempSection_small[0],
+                        4*(n_points+1));
                     if (CFSError(errorMsg))	throw std::runtime_error(errorMsg);
                     for (int n=0; n<nBlockBytes/4; ++n) {
-                        TempSection[n + b*CFSMAXBYTES/4]=
+                        fTempSection[n + b*CFSMAXBYTES/4]=
                             fTempSection_small[n]* yScale +
                             yOffset;
                     }
@@ -497,40 +522,40 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
                     //Read data of the current channel and data section
                     //- see manual of CFS file system
                     if (b == nBlocks - 1)
-                        nBlockBytes=points[n_section]*2 - b*CFSMAXBYTES;
+                        nBlockBytes=n_points*2 - b*CFSMAXBYTES;
                     else
                         nBlockBytes=CFSMAXBYTES;
                     std::vector<short> TempSection_small(nBlockBytes);
                     GetChanData(CFSFile.myHandle, (short)n_channel, (WORD)n_section+1,
-                        b*CFSMAXBYTES/2, (WORD)nBlockBytes/2, &TempSection_small[0],
-                        2*(points[n_section]+1));
+                        start + b*CFSMAXBYTES/2, (WORD)nBlockBytes/2, &TempSection_small[0],
+                        2*(n_points+1));
                     if (CFSError(errorMsg))	throw std::runtime_error(errorMsg);
-                    for (int n=0; n<nBlockBytes/2; ++n) {
-                        TempSection[n + b*CFSMAXBYTES/2]=
-                            TempSection_small[n]* yScale +
-                            yOffset;
-                    }
+                    std::copy(TempSection_small.begin(), TempSection_small.begin()+nBlockBytes/2,
+                              TempSection_raw.begin() + b*CFSMAXBYTES/2);
                 }
             }	//End loop: storage of blocks
             //-----------------------------------------------------
             //End of the modified part to read data sections larger than
             //64kB (as produced e.g. by Igor)
             //-----------------------------------------------------
+            stfio::SectionSourcePtr source;
+            if (dataType == RL4)
+                source.reset(new stfio::Float32SectionSource(fTempSection));
+            else
+                source.reset(new stfio::ScaledSectionSource<short, float>(TempSection_raw, yScale, yOffset));
+            Section TempSection(source, label.str());
             try {
-                if (TempSection.size()!=0) {
-                    TempChannel.InsertSection(TempSection,n_section-empty_sections);
-                } else {
-                    empty_sections++;
-                    TempChannel.resize(TempChannel.size()-1);
-                }
+                TempChannel.InsertSection(TempSection,n_nonempty-1-request.firstSection);
             }
             catch (...) {
                 throw;
             }
         }	//End loop: n_section
+        // drop the slots of missing sections:
+        TempChannel.resize(n_nonempty > request.firstSection ? n_nonempty-request.firstSection : 0);
         try {
             if (TempChannel.size()!=0) {
-                ReturnData.InsertChannel(TempChannel,n_channel-empty_channels);
+                ReturnData.InsertChannel(TempChannel,n_out-empty_channels);
             } else {
                 empty_channels++;
                 ReturnData.resize(ReturnData.size()-1);
@@ -540,6 +565,7 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
             ReturnData.resize(0);
             throw;
         }
+        n_out++;
     }	//Begin loop: n_channel
     ReturnData.SetXScale(xScale);
     ReturnData.SetFileDescription(file_description + '\0');
@@ -31,9 +31,11 @@ namespace stfio {
  *  \param ReturnData On entry, an empty Recording object. On exit,
  *         the data stored in \e fName.
  *  \param progress Set to true if a progress dialog should be updated.
+ *  \param request Channels, sections and data points to be read.
  *  \return 0 upon success, a negative error code upon failure.
  */
-int importCFSFile(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg);
+int importCFSFile(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg,
+                  const importRequest& request = importRequest());
 
 //! Export a Recording to a CFS file.
 /*! \param fName Full path to the file to be written.
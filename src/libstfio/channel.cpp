@@ -34,15 +34,7 @@ SectionArray(c_n_sections, Section(section_size)) {}
 Channel::~Channel(void) {}
 
 void Channel::InsertSection(const Section& c_Section, std::size_t pos) {
-    try {
-        if (SectionArray.at(pos).size() != c_Section.size()) {
-            SectionArray.at(pos).resize(c_Section.size());
-        }
-        SectionArray.at(pos) = c_Section;
-    }
-    catch (...) {
-        throw;
-    }
+    SectionArray.at(pos) = c_Section;
 }
 
 const Section& Channel::at(std::size_t at_) const {
@@ -0,0 +1,108 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file compactsource.h
+ *  \author Christoph Schmidt-Hieber
+ *  \brief Section sources that keep samples in their native, compact format.
+ */
+
+#ifndef _COMPACTSOURCE_H
+#define _COMPACTSOURCE_H
+
+#include <stdexcept>
+
+#include "./stfio.h"
+
+namespace stfio {
+
+/*! \addtogroup stfio
+ *  @{
+ */
+
+//! Holds raw samples of type T and scales them to physical units on access.
+/*! Sample i is converted to double((S)(raw[i]*factor + shift)). The scaling
+ *  type S should be the one that the importer used before, so that the
+ *  decoded values don't change: float for Axon and CFS files, double for
+ *  HEKA files. A section of 16 bit samples needs a quarter of the memory of
+ *  decoded doubles until it is accessed; the source is then dropped.
+ */
+template <typename T, typename S>
+class ScaledSectionSource : public SectionSource {
+public:
+    //! Constructor
+    /*! \param raw_ Raw samples; swapped into the source to avoid a copy.
+     *  \param factor_ Scaling factor.
+     *  \param shift_ Offset that is added after scaling.
+     */
+    ScaledSectionSource(std::vector<T>& raw_, S factor_, S shift_)
+        : raw(), factor(factor_), shift(shift_)
+    {
+        raw.swap(raw_);
+    }
+
+    std::size_t size() const { return raw.size(); }
+
+    bool resident() const { return true; }
+
+    void read(std::size_t start, std::size_t n, double* dest) const {
+        if (start > raw.size() || n > raw.size()-start) {
+            throw std::out_of_range("subscript out of range in class ScaledSectionSource");
+        }
+        const T* src = raw.empty() ? NULL : &raw[start];
+        for (std::size_t i = 0; i < n; ++i) {
+            dest[i] = (S)(src[i] * factor + shift);
+        }
+    }
+
+private:
+    std::vector<T> raw;
+    S factor, shift;
+};
+
+//! Holds samples in single precision.
+/*! For formats that store samples as 32 bit floats in physical units.
+ */
+class Float32SectionSource : public SectionSource {
+public:
+    //! Constructor
+    /*! \param samples_ Samples; swapped into the source to avoid a copy.
+     */
+    explicit Float32SectionSource(Vector_float& samples_)
+        : samples()
+    {
+        samples.swap(samples_);
+    }
+
+    std::size_t size() const { return samples.size(); }
+
+    bool resident() const { return true; }
+
+    void read(std::size_t start, std::size_t n, double* dest) const {
+        if (start > samples.size() || n > samples.size()-start) {
+            throw std::out_of_range("subscript out of range in class Float32SectionSource");
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            dest[i] = samples[start+i];
+        }
+    }
+
+private:
+    Vector_float samples;
+};
+
+/*@}*/
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <stdexcept>
+
+#include "./envelope.h"
+
+stfio::MinMaxPyramid::MinMaxPyramid(const Vector_double& data)
+    : npoints(data.size()), mins(), maxs()
+{
+    // Only complete blocks are summarised; the remainder is read from the data:
+    int nblocks = (int)(npoints / BlockSize);
+    if (nblocks == 0) {
+        return;
+    }
+    mins.push_back(Vector_double(nblocks));
+    maxs.push_back(Vector_double(nblocks));
+    Vector_double& min0 = mins.back();
+    Vector_double& max0 = maxs.back();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int nb = 0; nb < nblocks; ++nb) {
+        const double* block = &data[nb*BlockSize];
+        double bmin = block[0], bmax = block[0];
+        for (std::size_t n = 1; n < BlockSize; ++n) {
+            if (block[n] < bmin) bmin = block[n];
+            if (block[n] > bmax) bmax = block[n];
+        }
+        min0[nb] = bmin;
+        max0[nb] = bmax;
+    }
+
+    while (mins.back().size() >= Fanout) {
+        const Vector_double& lowmin = mins.back();
+        const Vector_double& lowmax = maxs.back();
+        std::size_t nup = lowmin.size() / Fanout;
+        Vector_double upmin(nup), upmax(nup);
+        for (std::size_t nb = 0; nb < nup; ++nb) {
+            double bmin = lowmin[nb*Fanout], bmax = lowmax[nb*Fanout];
+            for (std::size_t n = 1; n < Fanout; ++n) {
+                if (lowmin[nb*Fanout+n] < bmin) bmin = lowmin[nb*Fanout+n];
+                if (lowmax[nb*Fanout+n] > bmax) bmax = lowmax[nb*Fanout+n];
+            }
+            upmin[nb] = bmin;
+            upmax[nb] = bmax;
+        }
+        mins.push_back(upmin);
+        maxs.push_back(upmax);
+    }
+}
+
+void stfio::MinMaxPyramid::MinMax(const Vector_double& data, std::size_t start, std::size_t end,
+                                  double& ymin, double& ymax) const
+{
+    if (start >= end || end > npoints || data.size() != npoints) {
+        throw std::out_of_range("range out of bounds in stfio::MinMaxPyramid::MinMax");
+    }
+    ymin = data[start];
+    ymax = data[start];
+
+    // Data points at the borders that don't fill a complete block:
+    std::size_t lo = start, hi = end;
+    while (lo < hi && lo % BlockSize != 0) {
+        if (data[lo] < ymin) ymin = data[lo];
+        if (data[lo] > ymax) ymax = data[lo];
+        ++lo;
+    }
+    while (hi > lo && hi % BlockSize != 0) {
+        --hi;
+        if (data[hi] < ymin) ymin = data[hi];
+        if (data[hi] > ymax) ymax = data[hi];
+    }
+
+    // Ascend the pyramid with the blocks in between:
+    std::size_t blo = lo / BlockSize, bhi = hi / BlockSize;
+    for (std::size_t level = 0; level < mins.size() && blo < bhi; ++level) {
+        const Vector_double& lmin = mins[level];
+        const Vector_double& lmax = maxs[level];
+        bool top = (level+1 == mins.size());
+        while (blo < bhi && (top || blo % Fanout != 0)) {
+            if (lmin[blo] < ymin) ymin = lmin[blo];
+            if (lmax[blo] > ymax) ymax = lmax[blo];
+            ++blo;
+        }
+        while (bhi > blo && bhi % Fanout != 0) {
+            --bhi;
+            if (lmin[bhi] < ymin) ymin = lmin[bhi];
+            if (lmax[bhi] > ymax) ymax = lmax[bhi];
+        }
+        blo /= Fanout;
+        bhi /= Fanout;
+    }
+}
@@ -0,0 +1,83 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file envelope.h
+ *  \author Christoph Schmidt-Hieber
+ *  \brief Multi-resolution min/max summaries of sampled waveforms.
+ */
+
+#ifndef _ENVELOPE_H
+#define _ENVELOPE_H
+
+#include "./stfio.h"
+
+namespace stfio {
+
+/*! \addtogroup stfio
+ *  @{
+ */
+
+//! A min/max pyramid of a sampled waveform.
+/*! Level 0 holds the extrema of consecutive blocks of BlockSize data points;
+ *  every further level combines Fanout blocks of the level below. The extrema
+ *  of an arbitrary range can then be obtained from at most
+ *  2*(BlockSize + Fanout*levels) values, independent of the length of the
+ *  range. The pyramid needs about 1/12 of the memory of the data points.
+ *  It doesn't keep a reference to the data points, which therefore have to be
+ *  passed to MinMax() again.
+ */
+class StfioDll MinMaxPyramid {
+public:
+    //! Number of data points that are summarised by a block of the lowest level.
+    static const std::size_t BlockSize = 32;
+
+    //! Number of blocks that are combined into a block of the next level.
+    static const std::size_t Fanout = 4;
+
+    //! Builds the pyramid.
+    /*! \param data The data points.
+     */
+    explicit MinMaxPyramid(const Vector_double& data);
+
+    //! Retrieve the number of summarised data points.
+    /*! \return The number of data points.
+     */
+    std::size_t size() const { return npoints; }
+
+    //! Retrieve the number of levels.
+    /*! \return The number of levels.
+     */
+    std::size_t levels() const { return mins.size(); }
+
+    //! Finds the extrema of a range of data points.
+    /*! Throws std::out_of_range if the range is empty or exceeds the data.
+     *  \param data The data points that the pyramid was built from.
+     *  \param start Index of the first data point.
+     *  \param end Index after the last data point.
+     *  \param ymin On exit, the minimum within [start, end).
+     *  \param ymax On exit, the maximum within [start, end).
+     */
+    void MinMax(const Vector_double& data, std::size_t start, std::size_t end,
+                double& ymin, double& ymax) const;
+
+private:
+    std::size_t npoints;
+    std::vector<Vector_double> mins, maxs;
+};
+
+/*@}*/
+
+}
+
+#endif
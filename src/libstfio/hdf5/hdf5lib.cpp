@@ -18,12 +18,15 @@
 #else
   #include "H5TA.h"
 #endif
+#include <algorithm>
 #include <cmath>
+#include <limits>
 #include <sstream>
 #include <iostream>
 
 #include "./hdf5lib.h"
 #include "../recording.h"
+#include "../compactsource.h"
 
 const static unsigned int DATELEN = 128;
 const static unsigned int TIMELEN = 128;
@@ -45,7 +48,353 @@ typedef struct st {
     char yunits[UNITLEN];
 } st;
 
-bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg) {
+namespace {
+
+// Length of the chunks of channel datasets; channel datasets are written and
+// read in blocks of this many data points:
+const hsize_t CHUNKLEN = 131072;
+
+// Selects data points start to start+n-1 of section n_s in a channel dataset.
+hid_t selectChannelSection(hid_t dataset_id, hsize_t n_s, hsize_t start, hsize_t n) {
+    hid_t dataspace_id = H5Dget_space(dataset_id);
+    hsize_t offset[2] = { n_s, start };
+    hsize_t count[2] = { 1, n };
+    H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, count, NULL);
+    return dataspace_id;
+}
+
+// Reads data points start to start+n-1 of section n_s from a channel dataset.
+herr_t readChannelSection(hid_t dataset_id, hid_t mem_type, hsize_t n_s, hsize_t start, hsize_t n,
+                          void* dest)
+{
+    if (n == 0) {
+        return 0;
+    }
+    hid_t dataspace_id = selectChannelSection(dataset_id, n_s, start, n);
+    hid_t memspace_id = H5Screate_simple(1, &n, NULL);
+    herr_t status = H5Dread(dataset_id, mem_type, memspace_id, dataspace_id, H5P_DEFAULT, dest);
+    H5Sclose(memspace_id);
+    H5Sclose(dataspace_id);
+    return status;
+}
+
+// Reads data points start to start+n-1 of a one-dimensional section dataset.
+herr_t readSectionWindow(hid_t loc_id, const char* dset_name, hsize_t start, hsize_t n, float* dest) {
+    if (n == 0) {
+        return 0;
+    }
+    hid_t dataset_id = H5Dopen2(loc_id, dset_name, H5P_DEFAULT);
+    if (dataset_id < 0) {
+        return -1;
+    }
+    hid_t dataspace_id = H5Dget_space(dataset_id);
+    herr_t status = H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, &start, NULL, &n, NULL);
+    hid_t memspace_id = H5Screate_simple(1, &n, NULL);
+    if (status >= 0) {
+        status = H5Dread(dataset_id, H5T_IEEE_F32LE, memspace_id, dataspace_id, H5P_DEFAULT, dest);
+    }
+    H5Sclose(memspace_id);
+    H5Sclose(dataspace_id);
+    H5Dclose(dataset_id);
+    return status;
+}
+
+// True unless x is NaN or infinite.
+bool isFinite(double x) {
+    return x - x == 0.0;
+}
+
+// Writes the section names of a channel to a fixed-length string dataset.
+herr_t writeSectionNames(hid_t channel_group, const Channel& channel) {
+    std::vector<std::string> names(channel.size());
+    std::size_t length = 1;
+    for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+        std::ostringstream section_name; section_name << channel[n_s].GetSectionDescription();
+        if ( section_name.str() == "" ) {
+            section_name << "sec" << n_s;
+        }
+        names[n_s] = section_name.str();
+        length = std::max(length, names[n_s].length());
+    }
+    std::vector<char> data(names.size()*length, '\0');
+    for (std::size_t n_s=0; n_s < names.size(); ++n_s) {
+        std::copy(names[n_s].begin(), names[n_s].end(), data.begin()+n_s*length);
+    }
+    hsize_t dims[1] = { names.size() };
+    hid_t string_type = H5Tcopy( H5T_C_S1 );
+    H5Tset_size( string_type, length );
+    herr_t status = H5LTmake_dataset(channel_group, "names", 1, dims, string_type, &data[0]);
+    H5Tclose(string_type);
+    return status;
+}
+
+// Reads the section names written by writeSectionNames(). Files without
+// section names get "sec<n>", as with the per-section layout.
+std::vector<std::string> readSectionNames(hid_t channel_group, hsize_t n_sections) {
+    std::vector<std::string> names(n_sections);
+    for (hsize_t n_s=0; n_s < n_sections; ++n_s) {
+        std::ostringstream section_name; section_name << "sec" << n_s;
+        names[n_s] = section_name.str();
+    }
+    if (n_sections == 0 || H5LTfind_dataset(channel_group, "names") <= 0) {
+        return names;
+    }
+    hsize_t dims = 0;
+    H5T_class_t class_id;
+    size_t length = 0;
+    if (H5LTget_dataset_info(channel_group, "names", &dims, &class_id, &length) < 0 ||
+        class_id != H5T_STRING || dims != n_sections || length == 0)
+    {
+        throw std::runtime_error("Inconsistent section names in stfio::importHDF5File");
+    }
+    std::vector<char> data(n_sections*length, '\0');
+    hid_t string_type = H5Tcopy( H5T_C_S1 );
+    H5Tset_size( string_type, length );
+    herr_t status = H5LTread_dataset(channel_group, "names", string_type, &data[0]);
+    H5Tclose(string_type);
+    if (status < 0) {
+        throw std::runtime_error("Exception while reading section names in stfio::importHDF5File");
+    }
+    for (hsize_t n_s=0; n_s < n_sections; ++n_s) {
+        const char* name = &data[n_s*length];
+        names[n_s] = std::string(name, std::find(name, name+length, '\0'));
+    }
+    return names;
+}
+
+// Writes a channel to a single chunked dataset of sections x data points.
+// Throws if int16 storage is requested for a channel with NaN or infinite samples.
+herr_t exportChannelDataset(hid_t channel_group, const Recording& WData, std::size_t n_c,
+                            const stfio::hdf5ExportSettings& settings, stfio::ProgressInfo& progDlg)
+{
+    const Channel& channel = WData[n_c];
+    hsize_t n_sections = channel.size();
+    hsize_t max_length = 0;
+    std::vector<long long> lengths(n_sections);
+    for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+        lengths[n_s] = channel[n_s].size();
+        max_length = std::max(max_length, (hsize_t)channel[n_s].size());
+    }
+
+    Vector_double buffer(std::min(max_length, CHUNKLEN));
+    std::vector<short> buffer16(settings.int16 ? buffer.size() : 0);
+
+    // Integers are scaled to the full range of the channel:
+    double scale = 1.0, offset = 0.0;
+    if (settings.int16) {
+        double ymin = std::numeric_limits<double>::infinity();
+        double ymax = -ymin;
+        for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+            for (std::size_t start=0; start < channel[n_s].size(); start += buffer.size()) {
+                std::size_t n = std::min(buffer.size(), channel[n_s].size()-start);
+                channel[n_s].GetWindow(start, n, &buffer[0]);
+                for (std::size_t n_p=0; n_p < n; ++n_p) {
+                    if (!isFinite(buffer[n_p])) {
+                        throw std::runtime_error("Can't store NaN or infinite samples as 16 bit integers "
+                                                 "in stfio::exportHDF5File");
+                    }
+                    ymin = std::min(ymin, buffer[n_p]);
+                    ymax = std::max(ymax, buffer[n_p]);
+                }
+            }
+        }
+        if (ymax > ymin) {
+            scale = (ymax-ymin) / 65534.0;
+            offset = (ymax+ymin) / 2.0;
+        } else if (ymax == ymin) {
+            offset = ymin;
+        }
+    }
+
+    hsize_t dims[2] = { n_sections, max_length };
+    hid_t dataspace_id = H5Screate_simple(2, dims, NULL);
+    hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
+    if (n_sections > 0 && max_length > 0) {
+        // One chunk never spans several sections, so that sections can be read on their own:
+        hsize_t chunk[2] = { 1, buffer.size() };
+        H5Pset_chunk(plist_id, 2, chunk);
+        if (settings.compression > 0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0) {
+            if (settings.shuffle) {
+                H5Pset_shuffle(plist_id);
+            }
+            H5Pset_deflate(plist_id, std::min(settings.compression, 9));
+        }
+    }
+    hid_t dataset_id = H5Dcreate2(channel_group, "data", settings.int16 ? H5T_STD_I16LE : H5T_IEEE_F32LE,
+                                  dataspace_id, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+    H5Pclose(plist_id);
+    H5Sclose(dataspace_id);
+    if (dataset_id < 0) {
+        return -1;
+    }
+
+    herr_t status = 0;
+    for (std::size_t n_s=0; n_s < channel.size() && status >= 0; ++n_s) {
+        int progbar =
+            // Channel contribution:
+            (int)(((double)n_c/(double)WData.size())*100.0+
+                  // Section contribution:
+                  (double)(n_s)/(double)channel.size()*(100.0/WData.size()));
+        std::ostringstream progStr;
+        progStr << "Writing channel #" << n_c + 1 << " of " << WData.size()
+                << ", Section #" << n_s << " of " << channel.size();
+        progDlg.Update(progbar, progStr.str());
+
+        // Lazily decoded sections are written block by block without being materialised:
+        for (std::size_t start=0; start < channel[n_s].size() && status >= 0; start += buffer.size()) {
+            hsize_t n = std::min(buffer.size(), channel[n_s].size()-start);
+            channel[n_s].GetWindow(start, n, &buffer[0]);
+            hid_t filespace_id = selectChannelSection(dataset_id, n_s, start, n);
+            hid_t memspace_id = H5Screate_simple(1, &n, NULL);
+            if (settings.int16) {
+                for (std::size_t n_p=0; n_p < n; ++n_p) {
+                    buffer16[n_p] = (short)floor((buffer[n_p]-offset)/scale + 0.5);
+                }
+                status = H5Dwrite(dataset_id, H5T_NATIVE_SHORT, memspace_id, filespace_id, H5P_DEFAULT, &buffer16[0]);
+            } else {
+                status = H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, memspace_id, filespace_id, H5P_DEFAULT, &buffer[0]);
+            }
+            H5Sclose(memspace_id);
+            H5Sclose(filespace_id);
+        }
+    }
+    H5Dclose(dataset_id);
+    if (status < 0) {
+        return status;
+    }
+
+    if (n_sections > 0) {
+        status = H5LTmake_dataset(channel_group, "lengths", 1, &n_sections, H5T_NATIVE_LLONG, &lengths[0]);
+        if (status >= 0) {
+            status = writeSectionNames(channel_group, channel);
+        }
+        if (status < 0) {
+            return status;
+        }
+    }
+    double dt = WData.GetXScale();
+    if (H5LTset_attribute_double(channel_group, "data", "dt", &dt, 1) < 0 ||
+        H5LTset_attribute_string(channel_group, "data", "xunits", WData.GetXUnits().c_str()) < 0 ||
+        H5LTset_attribute_string(channel_group, "data", "yunits", channel.GetYUnits().c_str()) < 0)
+    {
+        return -1;
+    }
+    if (settings.int16) {
+        if (H5LTset_attribute_double(channel_group, "data", "scale", &scale, 1) < 0 ||
+            H5LTset_attribute_double(channel_group, "data", "offset", &offset, 1) < 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Reads a string attribute of a dataset.
+std::string readStringAttribute(hid_t loc_id, const char* obj_name, const char* attr_name) {
+    hsize_t dims;
+    H5T_class_t class_id;
+    size_t type_size;
+    if (H5LTget_attribute_info(loc_id, obj_name, attr_name, &dims, &class_id, &type_size) < 0) {
+        return "";
+    }
+    std::vector<char> attr(type_size+1, 0);
+    if (H5LTget_attribute_string(loc_id, obj_name, attr_name, &attr[0]) < 0) {
+        return "";
+    }
+    return std::string(&attr[0]);
+}
+
+// Reads a channel that was written with exportChannelDataset(). Every selected
+// section is read with a hyperslab of its own that only spans the selected data
+// points, and kept in the stored sample format. The sections are stored from
+// the front of TempChannel.
+void importChannelDataset(hid_t channel_group, int n_c, int numberChannels, Channel& TempChannel,
+                          double& dt, std::string& yunits, const stfio::importRequest& request,
+                          stfio::ProgressInfo& progDlg)
+{
+    hid_t dataset_id = H5Dopen2(channel_group, "data", H5P_DEFAULT);
+    if (dataset_id < 0) {
+        throw std::runtime_error("Exception while opening channel data in stfio::importHDF5File");
+    }
+    hid_t dataspace_id = H5Dget_space(dataset_id);
+    hsize_t dims[2] = { 0, 0 };
+    int rank = H5Sget_simple_extent_dims(dataspace_id, dims, NULL);
+    H5Sclose(dataspace_id);
+    hid_t type_id = H5Dget_type(dataset_id);
+    bool int16 = (H5Tget_class(type_id) == H5T_INTEGER);
+    H5Tclose(type_id);
+    if (rank != 2 || dims[0] != TempChannel.size()) {
+        H5Dclose(dataset_id);
+        throw std::runtime_error("Inconsistent channel data in stfio::importHDF5File");
+    }
+
+    std::vector<long long> lengths(dims[0]);
+    if (dims[0] > 0 && H5LTread_dataset(channel_group, "lengths", H5T_NATIVE_LLONG, &lengths[0]) < 0) {
+        H5Dclose(dataset_id);
+        throw std::runtime_error("Exception while reading section lengths in stfio::importHDF5File");
+    }
+    double scale = 1.0, offset = 0.0;
+    if (H5LTget_attribute_double(channel_group, "data", "dt", &dt) < 0 ||
+        (int16 && (H5LTget_attribute_double(channel_group, "data", "scale", &scale) < 0 ||
+                   H5LTget_attribute_double(channel_group, "data", "offset", &offset) < 0)))
+    {
+        H5Dclose(dataset_id);
+        throw std::runtime_error("Exception while reading channel attributes in stfio::importHDF5File");
+    }
+    yunits = readStringAttribute(channel_group, "data", "yunits");
+    std::vector<std::string> names;
+    try {
+        names = readSectionNames(channel_group, dims[0]);
+    }
+    catch (...) {
+        H5Dclose(dataset_id);
+        throw;
+    }
+
+    hsize_t sectionEnd = request.SectionEnd(dims[0]);
+    for (hsize_t n_s=request.firstSection; n_s < sectionEnd; ++n_s) {
+        int progbar =
+            // Channel contribution:
+            (int)(((double)n_c/(double)numberChannels)*100.0+
+                  // Section contribution:
+                  (double)(n_s)/(double)dims[0]*(100.0/numberChannels));
+        std::ostringstream progStr;
+        progStr << "Reading channel #" << n_c + 1 << " of " << numberChannels
+                << ", Section #" << n_s+1 << " of " << dims[0];
+        progDlg.Update(progbar, progStr.str());
+
+        hsize_t length = (hsize_t)lengths[n_s];
+        if (lengths[n_s] < 0 || length > dims[1]) {
+            H5Dclose(dataset_id);
+            throw std::runtime_error("Inconsistent section length in stfio::importHDF5File");
+        }
+        // Keep the samples in the stored format until they are accessed:
+        std::size_t start = 0, n = 0;
+        request.Window(length, start, n);
+        stfio::SectionSourcePtr source;
+        herr_t status;
+        if (int16) {
+            std::vector<short> raw(n);
+            status = readChannelSection(dataset_id, H5T_NATIVE_SHORT, n_s, start, n, raw.empty() ? NULL : &raw[0]);
+            source.reset(new stfio::ScaledSectionSource<short, double>(raw, scale, offset));
+        } else {
+            Vector_float samples(n);
+            status = readChannelSection(dataset_id, H5T_NATIVE_FLOAT, n_s, start, n, samples.empty() ? NULL : &samples[0]);
+            source.reset(new stfio::Float32SectionSource(samples));
+        }
+        if (status < 0) {
+            H5Dclose(dataset_id);
+            throw std::runtime_error("Exception while reading data in stfio::importHDF5File");
+        }
+        TempChannel.InsertSection(Section(source, names[n_s]), n_s-request.firstSection);
+    }
+    H5Dclose(dataset_id);
+}
+
+}
+
+bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg,
+                           const hdf5ExportSettings& settings) {
     
     hid_t file_id = H5Fcreate(fName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
     
@@ -183,6 +532,27 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
             throw std::runtime_error(errorMsg);
         }
 
+        if (settings.channelDatasets) {
+            try {
+                status = exportChannelDataset(channel_group, WData, n_c, settings, progDlg);
+            }
+            catch (...) {
+                H5Gclose(channel_group);
+                H5Gclose(channels_group);
+                H5Fclose(file_id);
+                H5close();
+                throw;
+            }
+            H5Gclose(channel_group);
+            if (status < 0) {
+                std::string errorMsg("Exception while writing channel data in stfio::exportHDF5File");
+                H5Fclose(file_id);
+                H5close();
+                throw std::runtime_error(errorMsg);
+            }
+            continue;
+        }
+
         int max_log10 = 0;
         if (WData[n_c].size() > 1) {
             max_log10 = int(log10((double)WData[n_c].size()-1.0));
@@ -302,7 +672,9 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
     return (status >= 0);
 }
 
-void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg) {
+void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg,
+                           const importRequest& request)
+{
     /* Create a new file using default properties. */
     hid_t file_id = H5Fopen(fName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
     
@@ -366,9 +738,21 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
     }
     ReturnData.SetComment(comment);
 
+    int numberSelected = 0;
+    for (int n_c=0;n_c<numberChannels;++n_c) {
+        if (request.HasChannel(n_c)) {
+            numberSelected++;
+        }
+    }
+
     double dt = 1.0;
     std::string yunits = "";
+    int n_out = 0;
     for (int n_c=0;n_c<numberChannels;++n_c) {
+        // Groups of unselected channels are not opened at all:
+        if (!request.HasChannel(n_c)) {
+            continue;
+        }
         /* Calculate the size and the offsets of our struct members in memory */
         size_t ct_offset[NFIELDS] = { HOFFSET( ct, n_sections ) };
         ct ct_buf[1];
@@ -410,12 +794,19 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
         }
         Channel TempChannel(ct_buf[0].n_sections);
         TempChannel.SetChannelName( channel_name.str() );
+        if (H5Lexists(channel_group, "data", H5P_DEFAULT) > 0) {
+            // Single dataset per channel; there are no section groups to be read below:
+            importChannelDataset(channel_group, n_c, numberChannels, TempChannel, dt, yunits, request, progDlg);
+            TempChannel.resize(request.SectionEnd(ct_buf[0].n_sections) - request.firstSection);
+            ct_buf[0].n_sections = 0;
+        }
         int max_log10 = 0;
         if (ct_buf[0].n_sections > 1) {
             max_log10 = int(log10((double)ct_buf[0].n_sections-1.0));
         }
 
-        for (int n_s=0; n_s < ct_buf[0].n_sections; ++n_s) {
+        int sectionEnd = (int)request.SectionEnd(ct_buf[0].n_sections);
+        for (int n_s=(int)request.firstSection; n_s < sectionEnd; ++n_s) {
             int progbar =
                 // Channel contribution:
                 (int)(((double)n_c/(double)numberChannels)*100.0+
@@ -454,20 +845,21 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
                 std::string errorMsg("Exception while reading data information in stfio::importHDF5File");
                 throw std::runtime_error(errorMsg);
             }
-            Vector_float TempSection(sdims);
-            status = H5LTread_dataset(file_id, data_path.str().c_str(), H5T_IEEE_F32LE, &TempSection[0]);
+            std::size_t start = 0, n = 0;
+            request.Window(sdims, start, n);
+            Vector_float TempSection(n);
+            status = readSectionWindow(file_id, data_path.str().c_str(), start, n,
+                                       TempSection.empty() ? NULL : &TempSection[0]);
             if (status < 0) {
                 std::string errorMsg("Exception while reading data in stfio::importHDF5File");
                 throw std::runtime_error(errorMsg);
             }
 
-            Section TempSectionT(TempSection.size(), section_name.str());
-            for (std::size_t cp = 0; cp < TempSectionT.size(); ++cp) {
-                TempSectionT[cp] = double(TempSection[cp]);
-            }
-            // std::copy(TempSection.begin(),TempSection.end(),&TempSectionT[0]);
+            // Keep the samples in single precision until they are accessed:
+            Section TempSectionT(stfio::SectionSourcePtr(new stfio::Float32SectionSource(TempSection)),
+                                 section_name.str());
             try {
-                TempChannel.InsertSection(TempSectionT,n_s);
+                TempChannel.InsertSection(TempSectionT,n_s-request.firstSection);
             }
             catch (...) {
                 throw;
@@ -495,12 +887,16 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
             yunits = st_buf[0].yunits;
             H5Gclose( section_group );
         }
+        if (ct_buf[0].n_sections > 0) {
+            TempChannel.resize(sectionEnd - request.firstSection);
+        }
         try {
-            if ((int)ReturnData.size()<numberChannels) {
-                ReturnData.resize(numberChannels);
+            if ((int)ReturnData.size()<numberSelected) {
+                ReturnData.resize(numberSelected);
             }
-            ReturnData.InsertChannel(TempChannel,n_c);
-            ReturnData[n_c].SetYUnits( yunits );
+            ReturnData.InsertChannel(TempChannel,n_out);
+            ReturnData[n_out].SetYUnits( yunits );
+            n_out++;
         }
         catch (...) {
             ReturnData.resize(0);
@@ -31,15 +31,27 @@ namespace stfio {
  *  \param ReturnData On entry, an empty Recording object. On exit,
  *         the data stored in \e fName.
  *  \param progress True if the progress dialog should be updated.
+ *  \param request Channels, sections and data points to be read. Unselected
+ *         channels and sections are skipped, and only the selected data points
+ *         of a section are read from the file.
  */
-void importHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg);
+void importHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg,
+                    const importRequest& request = importRequest());
 
 //! Export a Recording to a HDF5 file.
-/*! \param fName Full path to the file to be written.
+/*! By default, every section is written to a dataset of its own. With
+ *  hdf5ExportSettings::channelDatasets, each channel is written to a single
+ *  chunked dataset of sections x data points instead; shorter sections are
+ *  padded, and their lengths and names are stored in separate datasets.
+ *  Channels with NaN or infinite samples can't be stored as 16 bit integers;
+ *  exporting them with hdf5ExportSettings::int16 throws std::runtime_error.
+ *  \param fName Full path to the file to be written.
  *  \param WData The data to be exported.
+ *  \param settings The layout of the file.
  *  \return The HDF5 file handle.
  */
-StfioDll  bool exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg);
+StfioDll  bool exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg,
+                              const hdf5ExportSettings& settings = hdf5ExportSettings());
 
 }
 
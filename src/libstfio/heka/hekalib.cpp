@@ -37,6 +37,7 @@
 
 #include "./hekalib.h"
 #include "../recording.h"
+#include "../compactsource.h"
 
 #define C_ASSERT(e) extern void __C_ASSERT__(int [(e)?1:-1])
 #define ByteSwap16(x) ByteSwap((unsigned char *) &x,sizeof(x))
@@ -758,9 +759,23 @@ void ReadData(FILE* fh, const Tree& tree, Recording& RecordingInOut,
                 return;
             }
 
+            double factor = 1.0;
+            if (std::string(tree.TraceList[nc].TrYUnit) == "V") {
+                RecordingInOut[nc].SetYUnits("mV");
+                factor = 1.0e3;
+            } else if (std::string(tree.TraceList[nc].TrYUnit) == "A") {
+                RecordingInOut[nc].SetYUnits("pA");
+                factor = 1.0e12;
+            } else {
+                RecordingInOut[nc].SetYUnits(tree.TraceList[nc].TrYUnit);
+            }
+            factor *=  tree.TraceList[nc].TrDataScaler;
+            double shift = tree.TraceList[nc].TrZeroData;
+
             int npoints = tree.TraceList[nstree].TrDataPoints;
-            RecordingInOut[nc][ns].resize(npoints);
 
+            // Integer and single precision samples are kept in their native
+            // format and scaled when the section is accessed:
             fseek(fh, tree.TraceList[nstree].TrData, SEEK_SET);
             switch (int(tree.TraceList[nstree].TrDataFormat)) {
              case 0: {
@@ -771,8 +786,8 @@ void ReadData(FILE* fh, const Tree& tree, Recording& RecordingInOut,
                      throw std::runtime_error("getBundleHeader: Error in fread()");
                  if (tree.needsByteSwap) 
                      std::for_each(tmpSection.begin(), tmpSection.end(), ShortByteSwap);
-
-                 std::copy(tmpSection.begin(), tmpSection.end(), RecordingInOut[nc][ns].get_w().begin());
+                 RecordingInOut[nc][ns] = Section(stfio::SectionSourcePtr(
+                     new stfio::ScaledSectionSource<short, double>(tmpSection, factor, shift)));
                  break;
              }
              case 1: {
@@ -783,7 +798,8 @@ void ReadData(FILE* fh, const Tree& tree, Recording& RecordingInOut,
                      throw std::runtime_error("getBundleHeader: Error in fread()");
                  if (tree.needsByteSwap) 
                      std::for_each(tmpSection.begin(), tmpSection.end(), IntByteSwap);
-                 std::copy(tmpSection.begin(), tmpSection.end(), RecordingInOut[nc][ns].get_w().begin());
+                 RecordingInOut[nc][ns] = Section(stfio::SectionSourcePtr(
+                     new stfio::ScaledSectionSource<int, double>(tmpSection, factor, shift)));
                  break;
              }
              case 2: {
@@ -794,7 +810,8 @@ void ReadData(FILE* fh, const Tree& tree, Recording& RecordingInOut,
                      throw std::runtime_error("getBundleHeader: Error in fread()");
                  if (tree.needsByteSwap) 
                      std::for_each(tmpSection.begin(), tmpSection.end(), FloatByteSwap);
-                 std::copy(tmpSection.begin(), tmpSection.end(), RecordingInOut[nc][ns].get_w().begin());
+                 RecordingInOut[nc][ns] = Section(stfio::SectionSourcePtr(
+                     new stfio::ScaledSectionSource<float, double>(tmpSection, factor, shift)));
                  break;
              }
              case 3: {
@@ -805,25 +822,15 @@ void ReadData(FILE* fh, const Tree& tree, Recording& RecordingInOut,
                      throw std::runtime_error("getBundleHeader: Error in fread()");
                  if (tree.needsByteSwap) 
                      std::for_each(tmpSection.begin(), tmpSection.end(), DoubleByteSwap);
+                 RecordingInOut[nc][ns].resize(npoints);
                  std::copy(tmpSection.begin(), tmpSection.end(), RecordingInOut[nc][ns].get_w().begin());
+                 RecordingInOut[nc][ns].get_w() = stfio::vec_scal_mul(RecordingInOut[nc][ns].get(), factor);
+                 RecordingInOut[nc][ns].get_w() = stfio::vec_scal_plus(RecordingInOut[nc][ns].get(), shift);
                  break;
              }
              default:
                  throw std::runtime_error("Unknown data format while reading heka file");
             }
-            double factor = 1.0;
-            if (std::string(tree.TraceList[nc].TrYUnit) == "V") {
-                RecordingInOut[nc].SetYUnits("mV");
-                factor = 1.0e3;
-            } else if (std::string(tree.TraceList[nc].TrYUnit) == "A") {
-                RecordingInOut[nc].SetYUnits("pA");
-                factor = 1.0e12;
-            } else {
-                RecordingInOut[nc].SetYUnits(tree.TraceList[nc].TrYUnit);
-            }
-            factor *=  tree.TraceList[nc].TrDataScaler;
-            RecordingInOut[nc][ns].get_w() = stfio::vec_scal_mul(RecordingInOut[nc][ns].get(), factor);
-            RecordingInOut[nc][ns].get_w() = stfio::vec_scal_plus(RecordingInOut[nc][ns].get(), tree.TraceList[nc].TrZeroData);
         }
         RecordingInOut[nc].SetChannelName(tree.TraceList[nc].TrLabel);
         
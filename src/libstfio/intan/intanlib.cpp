@@ -24,6 +24,8 @@ http://www.intantech.com/files/Intan_CLAMP_software_compiled_v1_0.zip
 as of 2016-11-05
 */
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include "intanlib.h"
@@ -185,59 +187,80 @@ IntanHeader read_header(BinaryReader& binreader) {
     return hIntan;
 }
 
-std::vector<std::vector<float> > read_data(BinaryReader& binreader, const IntanHeader& hIntan) {
-    uint64_t bytes_remaining = binreader.bytesRemaining();
-    uint64_t length = bytes_remaining / (4+4+4+4);
-    std::vector<uint32_t> timestamps(length);
-    std::vector<float> applied(length);
-    std::vector<float> totalClamp(length);
-    std::vector<std::vector<float> > channels(2);
-    channels[0].resize(length);
-    channels[1].resize(length);
-    for (unsigned int idata = 0; idata < length; ++idata) {
-        binreader >> timestamps[idata];
-        binreader >> applied[idata]; 
-        binreader >> channels[1][idata];
-        binreader >> channels[0][idata];
-        float vfactor = 1e3; // V -> mV
-        float ifactor = 1e12; // A -> pA
-        if (hIntan.Settings.isVoltageClamp) {
-            channels[0][idata] *= ifactor;
-            channels[1][idata] *= vfactor;
-        } else {
-            channels[1][idata] *= ifactor;
-            channels[0][idata] *= vfactor;
-        }
+// Number of records that are read from the file and decoded at once:
+static const std::size_t BLOCK_RECORDS = 65536;
+
+// Decodes a little-endian 32 bit float.
+inline float decode_float(const unsigned char* p) {
+    uint32_t bits = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Deinterleaves a float field of n records, scaling it on the way.
+void decode_float_field(const unsigned char* block, std::size_t n, std::size_t record_size,
+                        std::size_t field_offset, float factor, double* dest) {
+    const unsigned char* p = block + field_offset;
+    for (std::size_t idata = 0; idata < n; ++idata, p += record_size) {
+        dest[idata] = decode_float(p) * factor;
     }
+}
 
-    return channels;
+// Deinterleaves an ADC field of n records, converting it on the way.
+void decode_adc_field(const unsigned char* block, std::size_t n, std::size_t record_size,
+                      std::size_t field_offset, double* dest) {
+    const unsigned char* p = block + field_offset;
+    for (std::size_t idata = 0; idata < n; ++idata, p += record_size) {
+        uint16_t tmpui = p[0] | (p[1] << 8);
+        dest[idata] = (float)(tmpui*0.0003125 - (1<<15));
+    }
 }
 
-std::vector<std::vector<float> > read_aux_data(BinaryReader& binreader, uint16_t numADCs) {
-    uint64_t bytes_remaining = binreader.bytesRemaining();
-    uint64_t length = bytes_remaining / (4+2+2+2*numADCs);
-    std::vector<uint32_t> timestamps(length);
-    std::vector<uint16_t> digitalIn(length);
-    std::vector<uint16_t> digitalOut(length);
-    std::vector<std::vector<float> > adc(numADCs);
-    for (unsigned int iadc = 0; iadc < numADCs; ++iadc) {
-        adc[iadc].resize(length);
+// Records are of fixed size, so that the records before the selected window
+// are skipped without reading them. The records are then read in blocks, and
+// the fields of the selected channels are decoded straight into dest; channels
+// with a NULL destination, time stamps and the applied signal are skipped.
+void read_data(BinaryReader& binreader, const IntanHeader& hIntan,
+               std::size_t start, std::size_t length, double* dest[2]) {
+    const std::size_t record_size = 4+4+4+4;
+    // Channel 1 precedes channel 0 in a record:
+    const std::size_t field_offset[2] = { 12, 8 };
+    const float vfactor = 1e3; // V -> mV
+    const float ifactor = 1e12; // A -> pA
+    float factor[2] = { vfactor, ifactor };
+    if (hIntan.Settings.isVoltageClamp) {
+        std::swap(factor[0], factor[1]);
     }
-    for (unsigned int idata = 0; idata < length; ++idata) {
-        binreader >> timestamps[idata];
-        binreader >> digitalIn[idata]; 
-        binreader >> digitalOut[idata];
-        for (unsigned int iadc = 0; iadc < numADCs; ++iadc) {
-            uint16_t tmpui;
-            binreader >> tmpui;
-            adc[iadc][idata] = tmpui*0.0003125 - (1<<15);
+    binreader.skip(start * record_size);
+    std::vector<unsigned char> block(std::min(length, BLOCK_RECORDS) * record_size);
+    for (std::size_t first = 0; first < length; first += BLOCK_RECORDS) {
+        std::size_t n = std::min(BLOCK_RECORDS, length - first);
+        binreader.read(reinterpret_cast<char*>(&block[0]), n * record_size);
+        for (unsigned int nchan = 0; nchan < 2; ++nchan) {
+            if (dest[nchan] != NULL) {
+                decode_float_field(&block[0], n, record_size, field_offset[nchan],
+                                   factor[nchan], dest[nchan] + first);
+            }
         }
     }
+}
 
-    return adc;
+// Only the first ADC channel is imported, so that the other ones are not decoded.
+void read_aux_data(BinaryReader& binreader, uint16_t numADCs,
+                   std::size_t start, std::size_t length, double* dest) {
+    const std::size_t record_size = 4+2+2+2*numADCs;
+    binreader.skip(start * record_size);
+    std::vector<unsigned char> block(std::min(length, BLOCK_RECORDS) * record_size);
+    for (std::size_t first = 0; first < length; first += BLOCK_RECORDS) {
+        std::size_t n = std::min(BLOCK_RECORDS, length - first);
+        binreader.read(reinterpret_cast<char*>(&block[0]), n * record_size);
+        decode_adc_field(&block[0], n, record_size, 8, dest + first);
+    }
 }
 
-void stfio::importIntanFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
+void stfio::importIntanFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg,
+                            const importRequest& request) {
     unique_ptr<FileInStream> fs(new FileInStream());
 
 #ifdef _WINDOWS
@@ -251,51 +274,52 @@ void stfio::importIntanFile(const std::string &fName, Recording &ReturnData, Pro
     unique_ptr<BinaryReader> binreader(new BinaryReader(move(fs)));
 
     IntanHeader hIntan = read_header(*binreader);
+    // The whole recording is stored in a single section:
+    bool readSection = request.HasSection(0, 1);
+    std::size_t start = 0, length = 0;
     if (hIntan.datatype == 0) {
-        std::vector<std::vector<float> > channels = read_data(*binreader, hIntan);
-        ReturnData.resize(channels.size());
+        request.Window(binreader->bytesRemaining() / (4+4+4+4), start, length);
         ReturnData.SetXScale(1e3/hIntan.Settings.samplingRate);
         ReturnData.SetXUnits("ms");
         int mon = hIntan.date_Month-1;
         int year = hIntan.date_Year - 1900;
         ReturnData.SetDateTime(year, mon, hIntan.date_Day,
                                hIntan.date_Hour, hIntan.date_Minute, hIntan.date_Second);
-        for (unsigned int nchan = 0; nchan < channels.size(); ++nchan) {
-            // ReturnData[nchan].resize(hIntan.Settings.waveform.size());
-            ReturnData[nchan].resize(1);
-        }
+        const char* yunits[2] = { "mV", "pA" };
         if (hIntan.Settings.isVoltageClamp) {
-            ReturnData[0].SetYUnits("pA");
-            ReturnData[1].SetYUnits("mV");
-        } else {
-            ReturnData[1].SetYUnits("pA");
-            ReturnData[0].SetYUnits("mV");
+            std::swap(yunits[0], yunits[1]);
         }
-        unsigned int nsec = 0;
-        for (unsigned int nchan = 0; nchan < channels.size(); ++nchan) {
-            ReturnData[nchan][nsec].resize(channels[nchan].size());
-            std::copy(channels[nchan].begin(), channels[nchan].end(),
-                      ReturnData[nchan][nsec].get_w().begin());
+        // Allocate the sections first, so that the data can be decoded into them:
+        double* dest[2] = { NULL, NULL };
+        for (unsigned int nchan = 0; nchan < 2; ++nchan) {
+            if (!request.HasChannel(nchan)) {
+                continue;
+            }
+            ReturnData.resize(ReturnData.size()+1);
+            Channel& ch = ReturnData[ReturnData.size()-1];
+            ch.SetYUnits(yunits[nchan]);
+            if (readSection) {
+                ch.resize(1);
+                ch[0].resize(length);
+                if (length > 0) {
+                    dest[nchan] = &ch[0].get_w()[0];
+                }
+            }
+        }
+        if (readSection) {
+            read_data(*binreader, hIntan, start, length, dest);
         }
 
-        // for (std::vector<Segment>::const_iterator it = hIntan.Settings.waveform.begin();
-        //      it != hIntan.Settings.waveform.end();
-        //      ++it)
-        // {
-        //     for (unsigned int nchan = 0; nchan < channels.size(); ++nchan) {
-        //         ReturnData[nchan][nsec].resize(it->endIndex - it->startIndex);
-        //         std::copy(&(channels[nchan][it->startIndex]), &(channels[nchan][it->endIndex]),
-        //                   ReturnData[nchan][nsec].get_w().begin());
-        //     }
-        //     nsec++;
-        // }
-
-    } else {
-        std::vector<std::vector<float> > aux_data = read_aux_data(*binreader, hIntan.numADCs);
+    } else if (request.HasChannel(0)) {
         ReturnData.resize(1);
-        ReturnData[0].resize(1);
-        ReturnData[0][0].resize(aux_data[0].size());
-        std::copy(aux_data[0].begin(), aux_data[0].end(), ReturnData[0][0].get_w().begin());
+        if (readSection && hIntan.numADCs > 0) {
+            request.Window(binreader->bytesRemaining() / (4+2+2+2*hIntan.numADCs), start, length);
+            ReturnData[0].resize(1);
+            ReturnData[0][0].resize(length);
+            if (length > 0) {
+                read_aux_data(*binreader, hIntan.numADCs, start, length, &ReturnData[0][0].get_w()[0]);
+            }
+        }
     }
 
 }
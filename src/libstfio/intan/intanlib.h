@@ -137,8 +137,10 @@ namespace stfio {
  *  \param ReturnData On entry, an empty Recording object. On exit,
  *         the data stored in \e fName.
  *  \param progress True if the progress dialog should be updated.
+ *  \param request Channels, sections and data points to be read.
  */
-    void importIntanFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg);
+    void importIntanFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg,
+                         const importRequest& request = importRequest());
 
 }
 #endif
\ No newline at end of file
@@ -98,6 +98,13 @@ int FileInStream::read(char* data, int len) {
     return static_cast<int>(filestream->gcount());
 }
 
+void FileInStream::skip(uint64_t len) {
+    if (len > bytesRemaining()) {
+        throw runtime_error("No more data");
+    }
+    filestream->seekg(static_cast<std::streamoff>(len), filestream->cur);
+}
+
 //  ------------------------------------------------------------------------
 #if __cplusplus > 199711L
     BinaryReader::BinaryReader(unique_ptr<FileInStream>&& other_) :
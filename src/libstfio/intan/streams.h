@@ -69,6 +69,7 @@ public:
 
     virtual bool open(const FILENAME& filename); // Opens with new name
     virtual int read(char* data, int len) override;
+    void skip(uint64_t len);
     uint64_t bytesRemaining() override;
     std::istream::pos_type currentPos() override;
 
@@ -91,6 +92,9 @@ public:
 
     uint64_t bytesRemaining() { return other->bytesRemaining();  }
     std::istream::pos_type currentPos() { return other->currentPos(); }
+    void skip(uint64_t len) { other->skip(len); }
+    // Reads len raw bytes, e.g. a block of records that is decoded at once.
+    int read(char* data, int len) { return other->read(data, len); }
 
 protected:
     friend BinaryReader& operator>>(BinaryReader& istream, int32_t& value);
@@ -0,0 +1,163 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include "./mappedfile.h"
+
+stfio::MappedFile::MappedFile(const std::string& fName)
+    : start(NULL), length(0)
+#ifdef _WIN32
+    , hMapping(NULL)
+#else
+    , fd(-1)
+#endif
+{
+#ifdef _WIN32
+    // Let other programs rename, delete or append to the file while it is mapped:
+    HANDLE hFile = CreateFileA(fName.c_str(), GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Couldn't open " + fName);
+    }
+    LARGE_INTEGER fsize;
+    if (!GetFileSizeEx(hFile, &fsize) || (ULONGLONG)fsize.QuadPart > (ULONGLONG)(std::size_t)-1) {
+        CloseHandle(hFile);
+        throw std::runtime_error("Couldn't determine size of " + fName);
+    }
+    length = (std::size_t)fsize.QuadPart;
+    if (length == 0) {
+        CloseHandle(hFile);
+        return;
+    }
+    hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    // The mapping keeps its own reference to the file:
+    CloseHandle(hFile);
+    if (hMapping == NULL) {
+        throw std::runtime_error("Couldn't map " + fName);
+    }
+    start = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (start == NULL) {
+        CloseHandle(hMapping);
+        throw std::runtime_error("Couldn't map " + fName);
+    }
+#else
+    fd = open(fName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Couldn't open " + fName);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (unsigned long long)st.st_size > (unsigned long long)(std::size_t)-1) {
+        close(fd);
+        throw std::runtime_error("Couldn't determine size of " + fName);
+    }
+    length = (std::size_t)st.st_size;
+    if (length == 0) {
+        close(fd);
+        fd = -1;
+        return;
+    }
+    void* addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Couldn't map " + fName);
+    }
+    // The descriptor is kept to detect truncation in truncated():
+    start = (const char*)addr;
+#endif
+}
+
+stfio::MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (start != NULL) {
+        UnmapViewOfFile(start);
+    }
+    if (hMapping != NULL) {
+        CloseHandle(hMapping);
+    }
+#else
+    if (start != NULL) {
+        munmap((void*)start, length);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
+
+bool stfio::MappedFile::truncated() const {
+#ifdef _WIN32
+    return false;
+#else
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    return fstat(fd, &st) != 0 || (unsigned long long)st.st_size < (unsigned long long)length;
+#endif
+}
+
+stfio::MappedSectionSource::MappedSectionSource(const MappedFilePtr& file_, std::size_t offset_,
+                                                std::size_t npoints_, std::size_t stride_,
+                                                std::size_t channel_, SampleType type_,
+                                                float factor_, float shift_)
+    : file(file_), offset(offset_), npoints(npoints_), stride(stride_), channel(channel_),
+      type(type_), factor(factor_), shift(shift_)
+{
+    std::size_t sampleSize = (type == int16) ? sizeof(short) : sizeof(float);
+    if (npoints > 0) {
+        std::size_t last = offset + ((npoints-1)*stride + channel + 1) * sampleSize;
+        if (!file || channel >= stride || last > file->size()) {
+            throw std::runtime_error("Section exceeds the mapped file");
+        }
+    }
+}
+
+void stfio::MappedSectionSource::read(std::size_t start, std::size_t n, double* dest) const {
+    if (start > npoints || n > npoints-start) {
+        throw std::out_of_range("subscript out of range in class MappedSectionSource");
+    }
+    if (file->truncated()) {
+        throw std::runtime_error("The file has been truncated while it was open");
+    }
+    if (type == int16) {
+        const char* src = file->data() + offset + (start*stride + channel) * sizeof(short);
+        const std::size_t step = stride * sizeof(short);
+        for (std::size_t i = 0; i < n; ++i, src += step) {
+            short sample;
+            std::memcpy(&sample, src, sizeof(short));
+            // float precision gives the same results as ABF_ReadChannel:
+            dest[i] = (float)(sample * factor + shift);
+        }
+    } else {
+        const char* src = file->data() + offset + (start*stride + channel) * sizeof(float);
+        const std::size_t step = stride * sizeof(float);
+        for (std::size_t i = 0; i < n; ++i, src += step) {
+            float sample;
+            std::memcpy(&sample, src, sizeof(float));
+            dest[i] = sample;
+        }
+    }
+}
@@ -0,0 +1,129 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file mappedfile.h
+ *  \author Christoph Schmidt-Hieber
+ *  \brief Read-only memory-mapped files and lazily decoded sections backed by them.
+ */
+
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#include "./stfio.h"
+
+namespace stfio {
+
+/*! \addtogroup stfio
+ *  @{
+ */
+
+//! A file that is mapped read-only into the address space.
+/*! Pages are only loaded by the operating system when they are accessed,
+ *  so mapping a large file is cheap. The mapping is released when the
+ *  object is destroyed. Other programs may still rename, delete or append
+ *  to the file; truncating it can be detected with truncated().
+ */
+class StfioDll MappedFile {
+public:
+    //! Maps a file.
+    /*! Throws std::runtime_error if the file can't be mapped.
+     *  \param fName Full path to the file.
+     */
+    explicit MappedFile(const std::string& fName);
+
+    //! Destructor. Unmaps the file.
+    ~MappedFile();
+
+    //! Start of the mapped file contents.
+    /*! \return Pointer to the first byte of the file.
+     */
+    const char* data() const { return start; }
+
+    //! Size of the mapped file.
+    /*! \return The file size in bytes.
+     */
+    std::size_t size() const { return length; }
+
+    //! Checks whether the file has become shorter than the mapping.
+    /*! Accessing pages beyond the end of a truncated file raises SIGBUS on
+     *  POSIX systems, so readers check this before touching the mapping.
+     *  On Windows, mapped files can't be truncated.
+     *  \return true if the file is now shorter than size().
+     */
+    bool truncated() const;
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* start;
+    std::size_t length;
+#ifdef _WIN32
+    void* hMapping;
+#else
+    int fd;
+#endif
+};
+
+#if (__cplusplus < 201103)
+typedef boost::shared_ptr<MappedFile> MappedFilePtr;
+#else
+typedef std::shared_ptr<MappedFile> MappedFilePtr;
+#endif
+
+//! Decodes one channel of multiplexed samples from a MappedFile.
+/*! Sample i is read from byte offset
+ *  offset + (i*stride + channel) * sizeof(sample) and converted to
+ *  (float)(sample*factor + shift) for integer samples, matching the
+ *  conversion of the Axon file library.
+ */
+class StfioDll MappedSectionSource : public SectionSource {
+public:
+    //! Sample types that can be decoded.
+    enum SampleType {
+        int16,  /*!< 16 bit signed integers, little endian. */
+        float32 /*!< 32 bit IEEE floats, little endian. */
+    };
+
+    //! Constructor
+    /*! Throws std::runtime_error if the samples exceed the mapped file.
+     *  \param file The mapped file.
+     *  \param offset Byte offset of the first multiplexed frame.
+     *  \param npoints Number of data points of this channel.
+     *  \param stride Number of multiplexed channels.
+     *  \param channel Position of this channel within a frame.
+     *  \param type Sample type.
+     *  \param factor Scaling factor for integer samples.
+     *  \param shift Offset for integer samples.
+     */
+    MappedSectionSource(const MappedFilePtr& file, std::size_t offset, std::size_t npoints,
+                        std::size_t stride, std::size_t channel, SampleType type,
+                        float factor=1.0f, float shift=0.0f);
+
+    std::size_t size() const { return npoints; }
+
+    void read(std::size_t start, std::size_t n, double* dest) const;
+
+private:
+    MappedFilePtr file;
+    std::size_t offset, npoints, stride, channel;
+    SampleType type;
+    float factor, shift;
+};
+
+/*@}*/
+
+}
+
+#endif
@@ -171,22 +171,8 @@ void Recording::SetDateTime(int year, int month, int mday,int hour, int minute,
 }
 
 void Recording::InsertChannel(Channel& c_Channel, std::size_t pos) {
-    try {
-        if ( ChannelArray.at(pos).size() <= c_Channel.size() ) {
-            ChannelArray.at(pos).resize( c_Channel.size() );
-        }
-        // Resize sections if necessary:
-        std::size_t n_sec = 0;
-        for ( sec_it sit = c_Channel.get().begin(); sit != c_Channel.get().end(); ++sit ) {
-            if ( ChannelArray.at(pos).at(n_sec).size() <= sit->size() ) {
-                ChannelArray.at(pos).at(n_sec).get_w().resize( sit->size() );
-            }
-            n_sec++;
-        }
-    }
-    catch (...) {
-        throw;
-    }
+    // No need to allocate the sections before assignment; this would
+    // also decode sections that are stored in a compact format.
     ChannelArray.at(pos) = c_Channel;
 }
 
@@ -12,8 +12,53 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#if (__cplusplus < 201103)
+#  include <boost/exception_ptr.hpp>
+#else
+#  include <exception>
+#endif
+
 #include "./stfio.h"
 #include "./section.h"
+#include "./envelope.h"
+
+namespace {
+
+#if (__cplusplus < 201103)
+typedef boost::exception_ptr exception_ptr;
+using boost::current_exception;
+using boost::rethrow_exception;
+#else
+typedef std::exception_ptr exception_ptr;
+using std::current_exception;
+using std::rethrow_exception;
+#endif
+
+}
+
+namespace stfio {
+
+// Decodes a range of the data points of another source:
+class WindowSectionSource : public SectionSource {
+public:
+    WindowSectionSource(const SectionSourcePtr& source_, std::size_t start_, std::size_t npoints_)
+        : source(source_), start(start_), npoints(npoints_)
+    {}
+
+    std::size_t size() const { return npoints; }
+
+    void read(std::size_t first, std::size_t n, double* dest) const {
+        source->read(start+first, n, dest);
+    }
+
+    bool resident() const { return source->resident(); }
+
+private:
+    SectionSourcePtr source;
+    std::size_t start, npoints;
+};
+
+}
 
 // Definitions------------------------------------------------------------
 // Default constructor definition
@@ -21,22 +66,60 @@
 // within the constructor, see [1]248 and [2]28
 
 Section::Section(void)
-    : section_description(), x_scale(1.0), data(0)
+    : section_description(), x_scale(1.0), data(0), source(), npoints(0), pending(false), envelope()
 {}
 
 Section::Section( const Vector_double& valA, const std::string& label )
-    : section_description(label), x_scale(1.0), data(valA)
+    : section_description(label), x_scale(1.0), data(valA), source(), npoints(0), pending(false), envelope()
 {}
 
 Section::Section(std::size_t size, const std::string& label)
-    : section_description(label), x_scale(1.0), data(size)
+    : section_description(label), x_scale(1.0), data(size), source(), npoints(0), pending(false), envelope()
 {}
 
+Section::Section(const stfio::SectionSourcePtr& source_, const std::string& label)
+    : section_description(label), x_scale(1.0), data(0), source(source_),
+      npoints(source_ ? source_->size() : 0), pending(source_.get() != NULL), envelope()
+{}
+
+Section::Section(const Section& other)
+    : section_description(other.section_description), x_scale(other.x_scale), data(), source(),
+      npoints(other.npoints), pending(false), envelope()
+{
+    stfio::SectionSourcePtr src;
+    if (other.PendingSource(src)) {
+        source = src;
+        pending.store(true, stfio::memory_order_relaxed);
+    } else {
+        data = other.data;
+        source = other.source;
+#ifdef _OPENMP
+#pragma omp critical(stfio_section_envelope)
+#endif
+        envelope = other.envelope;
+    }
+}
+
 Section::~Section(void) {
 }
 
+Section& Section::operator=(const Section& other) {
+    if (this != &other) {
+        Section copy(other);
+        section_description.swap(copy.section_description);
+        x_scale = copy.x_scale;
+        data.swap(copy.data);
+        source.swap(copy.source);
+        npoints = copy.npoints;
+        pending.store(copy.pending.load(stfio::memory_order_relaxed), stfio::memory_order_release);
+        envelope.swap(copy.envelope);
+    }
+    return *this;
+}
+
 
 double Section::at(std::size_t at_) const {
+    if (IsPending()) Materialize();
     if (at_>=data.size()) {
         std::out_of_range e("subscript out of range in class Section");
         throw (e);
@@ -45,6 +128,7 @@ double Section::at(std::size_t at_) const {
 }
 
 double& Section::at(std::size_t at_) {
+    Modify();
     if (at_>=data.size()) {
         std::out_of_range e("subscript out of range in class Section");
         throw (e);
@@ -58,3 +142,131 @@ void Section::SetXScale( double value ) {
     else
         throw std::runtime_error( "Attempt to set x-scale <= 0" );
 }
+
+void Section::Materialize() const {
+    // Sections may be shared between threads (e.g. OpenMP loops in libstfnum),
+    // so the first access has to be serialised. Threads that see pending
+    // cleared (with acquire semantics) also see the decoded data.
+    // Exceptions must not leave the critical section, so errors of the
+    // source are rethrown after it:
+    exception_ptr error;
+#ifdef _OPENMP
+#pragma omp critical(stfio_section_materialize)
+#endif
+    {
+        try {
+            if (pending.load(stfio::memory_order_relaxed)) {
+                Vector_double decoded(npoints);
+                if (!decoded.empty()) {
+                    source->read(0, decoded.size(), &decoded[0]);
+                }
+                data.swap(decoded);
+                if (source->resident()) {
+                    source.reset();
+                }
+                pending.store(false, stfio::memory_order_release);
+            }
+        }
+        catch (...) {
+            error = current_exception();
+        }
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+bool Section::PendingSource(stfio::SectionSourcePtr& src) const {
+    if (!IsPending()) {
+        return false;
+    }
+    bool isPending = false;
+#ifdef _OPENMP
+#pragma omp critical(stfio_section_materialize)
+#endif
+    {
+        isPending = pending.load(stfio::memory_order_relaxed);
+        if (isPending) {
+            src = source;
+        }
+    }
+    return isPending;
+}
+
+void Section::Detach() {
+    if (IsPending()) Materialize();
+    source.reset();
+}
+
+void Section::Release() {
+    if (source && !IsPending()) {
+        Vector_double().swap(data);
+        npoints = source->size();
+        pending.store(true, stfio::memory_order_release);
+    }
+}
+
+void Section::GetMinMax(std::size_t start, std::size_t end, double& ymin, double& ymax) const {
+    if (IsPending()) Materialize();
+    stfio::MinMaxPyramidPtr pyramid;
+#ifdef _OPENMP
+#pragma omp critical(stfio_section_envelope)
+#endif
+    {
+        if (!envelope) {
+            envelope.reset(new stfio::MinMaxPyramid(data));
+        }
+        pyramid = envelope;
+    }
+    pyramid->MinMax(data, start, end, ymin, ymax);
+}
+
+void Section::GetWindow(std::size_t start, std::size_t n, Vector_double& dest) const {
+    if (start > size() || n > size()-start) {
+        std::out_of_range e("window out of range in class Section");
+        throw (e);
+    }
+    dest.resize(n);
+    if (n == 0) {
+        return;
+    }
+    GetWindow(start, n, &dest[0]);
+}
+
+void Section::GetWindow(std::size_t start, std::size_t n, double* dest) const {
+    if (start > size() || n > size()-start) {
+        std::out_of_range e("window out of range in class Section");
+        throw (e);
+    }
+    if (n == 0) {
+        return;
+    }
+    stfio::SectionSourcePtr src;
+    if (PendingSource(src)) {
+        src->read(start, n, dest);
+    } else {
+        std::copy(data.begin()+start, data.begin()+start+n, dest);
+    }
+}
+
+Section Section::Window(std::size_t start, std::size_t n) const {
+    if (start > size() || n > size()-start) {
+        std::out_of_range e("window out of range in class Section");
+        throw (e);
+    }
+    if (start == 0 && n == size()) {
+        return *this;
+    }
+    Section sec;
+    stfio::SectionSourcePtr src;
+    if (PendingSource(src)) {
+        sec.source.reset(new stfio::WindowSectionSource(src, start, n));
+        sec.npoints = n;
+        sec.pending.store(true, stfio::memory_order_relaxed);
+    } else {
+        sec.data.assign(data.begin()+start, data.begin()+start+n);
+    }
+    sec.section_description = section_description;
+    sec.x_scale = x_scale;
+    return sec;
+}
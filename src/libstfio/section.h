@@ -31,7 +31,68 @@
  *  @{
  */
 
+namespace stfio {
+
+//! Decodes the data points of a Section on demand.
+/*! Used as a storage backend for lazily materialised sections, e.g.
+ *  sections that are backed by a memory-mapped file. Implementations
+ *  must be safe to call from several threads at once.
+ */
+class StfioDll SectionSource {
+public:
+    virtual ~SectionSource() {}
+
+    //! Retrieve the number of data points.
+    /*! \return The number of data points.
+     */
+    virtual std::size_t size() const = 0;
+
+    //! Decodes a range of data points.
+    /*! \param start Index of the first data point.
+     *  \param n Number of data points; start+n must not exceed size().
+     *  \param dest Destination array with room for n data points.
+     */
+    virtual void read(std::size_t start, std::size_t n, double* dest) const = 0;
+
+    //! Indicates whether the source holds its data points in memory.
+    /*! A Section drops a resident source once it has decoded the data points,
+     *  so that the data aren't held twice.
+     *  \return true if the data points are held in memory.
+     */
+    virtual bool resident() const { return false; }
+};
+
+class MinMaxPyramid;
+
+#if (__cplusplus < 201103)
+typedef boost::shared_ptr<SectionSource> SectionSourcePtr;
+typedef boost::shared_ptr<const MinMaxPyramid> MinMaxPyramidPtr;
+typedef boost::atomic<bool> atomic_bool;
+using boost::memory_order_acquire;
+using boost::memory_order_release;
+using boost::memory_order_relaxed;
+#else
+typedef std::shared_ptr<SectionSource> SectionSourcePtr;
+typedef std::shared_ptr<const MinMaxPyramid> MinMaxPyramidPtr;
+typedef std::atomic<bool> atomic_bool;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_relaxed;
+#endif
+
+}
+
 //! Represents a continuously sampled sweep of data points
+/*! A Section either holds its data points in memory or, if it was constructed
+ *  from a stfio::SectionSource, decodes them on first access. Size queries and
+ *  GetWindow() do not require the data to be materialised. Read-only access
+ *  keeps the source so that the decoded data can be dropped again with
+ *  Release(); write access detaches the section from its source.
+ *
+ *  The const member functions may be called from several threads at once;
+ *  the first access decodes the data under a lock. Write access and
+ *  Release() must not run while other threads read the section.
+ */
 class StfioDll Section {
 public:
     // Construction/Destruction-----------------------------------------------
@@ -56,21 +117,41 @@ public:
             const std::string& label="\0"
     );
 
+    //! Constructs a lazily materialised section.
+    /*! \param source Decoder that provides the data points on first access.
+     *  \param label An optional section label string.
+     */
+    explicit Section(
+            const stfio::SectionSourcePtr& source,
+            const std::string& label="\0"
+    );
+
+    //! Copy constructor.
+    /*! \param other The section to be copied.
+     */
+    Section(const Section& other);
+
     //! Destructor
     ~Section();
 
+    //! Assignment operator.
+    /*! \param other The section to be copied.
+     *  \return A reference to this section.
+     */
+    Section& operator=(const Section& other);
+
     // Operators--------------------------------------------------------------
     //! Unchecked access. Returns a non-const reference.
     /*! \param at Data point index.
      *  \return Copy of the data point with index at.
      */
-    double& operator[](std::size_t at) { return data[at]; }
+    double& operator[](std::size_t at) { Modify(); return data[at]; }
 
     //! Unchecked access. Returns a copy.
     /*! \param at Data point index.
      *  \return Reference to the data point with index at.
      */
-    double operator[](std::size_t at) const { return data[at]; }
+    double operator[](std::size_t at) const { if (IsPending()) Materialize(); return data[at]; }
 
     // Public member functions------------------------------------------------
 
@@ -93,26 +174,81 @@ public:
      *  to access the valarray.
      *  \return The valarray containing the data points.
      */
-    const Vector_double& get() const { return data; }
+    const Vector_double& get() const { if (IsPending()) Materialize(); return data; }
 
     //! Low-level access to the valarray (read and write).
     /*! An explicit function is used instead of implicit type conversion
      *  to access the valarray.
      *  \return The valarray containing the data points.
      */
-    Vector_double& get_w() { return data; }
+    Vector_double& get_w() { Modify(); return data; }
 
     //! Resize the Section to a new number of data points; deletes all previously stored data when gcc is used.
     /*! Note that in the gcc implementation of std::vector, resizing will
      *  delete all the original data. This is different from std::vector::resize().
      *  \param new_size The new number of data points.
      */
-    void resize(std::size_t new_size) { data.resize(new_size); }
+    void resize(std::size_t new_size) { Modify(); data.resize(new_size); }
 
     //! Retrieve the number of data points.
     /*! \return The number of data points.
      */
-    size_t size() const { return data.size(); }
+    size_t size() const { return IsPending() ? npoints : data.size(); }
+
+    //! Copies a range of data points without materialising the whole section.
+    /*! Throws std::out_of_range if the range exceeds the section.
+     *  \param start Index of the first data point.
+     *  \param n Number of data points.
+     *  \param dest Receives the n data points.
+     */
+    void GetWindow(std::size_t start, std::size_t n, Vector_double& dest) const;
+
+    //! Copies a range of data points into an array without materialising the whole section.
+    /*! Throws std::out_of_range if the range exceeds the section.
+     *  \param start Index of the first data point.
+     *  \param n Number of data points.
+     *  \param dest Destination array with room for n data points.
+     */
+    void GetWindow(std::size_t start, std::size_t n, double* dest) const;
+
+    //! Creates a section from a range of data points.
+    /*! If the data points haven't been decoded yet, the new section decodes
+     *  only its own range on first access. Throws std::out_of_range if the
+     *  range exceeds the section.
+     *  \param start Index of the first data point.
+     *  \param n Number of data points.
+     *  \return A section with the same x scaling and description.
+     */
+    Section Window(std::size_t start, std::size_t n) const;
+
+    //! Decodes all data points if they are not held in memory yet.
+    void Materialize() const;
+
+    //! Indicates whether the data points are held in memory.
+    /*! \return false if the data points still have to be decoded from a stfio::SectionSource.
+     */
+    bool IsMaterialized() const { return !IsPending(); }
+
+    //! Drops the decoded data points if they can be decoded again from an unmodified source.
+    /*! Sections that don't have a source, that have been written to or whose
+     *  source was resident (see stfio::SectionSource::resident()) are left unchanged.
+     *  Must not be called while other threads read the section, and invalidates
+     *  references returned by get().
+     */
+    void Release();
+
+    //! Finds the extrema of a range of data points.
+    /*! Uses a stfio::MinMaxPyramid that is built on first use and dropped
+     *  when the data points are modified, so that repeated queries (e.g. when
+     *  drawing a long section at different zoom levels) don't have to scan
+     *  the whole range. Throws std::out_of_range if the range is empty or
+     *  exceeds the section.
+     *  \param start Index of the first data point.
+     *  \param end Index after the last data point.
+     *  \param ymin On exit, the minimum within [start, end).
+     *  \param ymax On exit, the maximum within [start, end).
+     */
+    void GetMinMax(std::size_t start, std::size_t end, double& ymin, double& ymax) const;
 
     //! Sets the x scaling.
     /*! \param value The x scaling.
@@ -143,8 +279,32 @@ public:
     // The sampling interval:
     double x_scale;
 
-    // The data:
-    Vector_double data;
+    // Decodes the data on first access and drops the source:
+    void Detach();
+
+    // Pairs with the release store in Materialize(), so that the decoded
+    // data are visible once pending is seen to be false:
+    bool IsPending() const { return pending.load(stfio::memory_order_acquire); }
+
+    // Returns true and a copy of the source if the data haven't been
+    // decoded yet; checked under the lock that Materialize() holds:
+    bool PendingSource(stfio::SectionSourcePtr& src) const;
+
+    // Called before the data are handed out for writing:
+    void Modify() {
+        if (source) Detach();
+        if (envelope) envelope.reset();
+    }
+
+    // The data; filled from source on first access if pending is set:
+    mutable Vector_double data;
+    mutable stfio::SectionSourcePtr source;
+    // Number of data points of source:
+    std::size_t npoints;
+    mutable stfio::atomic_bool pending;
+
+    // Min/max pyramid of the data; built on first use:
+    mutable stfio::MinMaxPyramidPtr envelope;
 };
 
 /*@}*/
@@ -25,10 +25,15 @@
 
 
 #include <sstream>
+#include <limits>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "stfio.h"
 
-// TODO #include "./ascii/asciilib.h"
+#include "./ascii/asciilib.h"
 #include "./hdf5/hdf5lib.h"
 #include "./abf/abflib.h"
 #include "./atf/atflib.h"
@@ -39,6 +44,7 @@
 #endif
 #include "./cfs/cfslib.h"
 #include "./intan/intanlib.h"
+#include "./tdms/tdmslib.h"
 #ifndef TEST_MINIMAL
   #include "./heka/hekalib.h"
 #else
@@ -138,81 +144,273 @@ stfio::findExtension(stfio::filetype ftype) {
     }
 }
 
-bool stfio::importFile(
+namespace {
+
+// Counts of sniffFile(); the file formats of several files may be
+// identified at the same time.
+stfio::sniffStatistics sniffCounts;
+
+// Number of bytes read by sniffFile(). HDF5 signatures may follow a user
+// block of up to 2048 bytes.
+const std::size_t SNIFF_SIZE = 2048 + 8;
+
+unsigned int readLE32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+unsigned int readBE32(const unsigned char* p) {
+    return p[3] | (p[2] << 8) | (p[1] << 16) | ((unsigned int)p[0] << 24);
+}
+
+bool hasMagic(const unsigned char* buf, std::size_t size, const char* magic,
+              std::size_t len, std::size_t offset=0) {
+    return size >= offset+len && memcmp(buf+offset, magic, len) == 0;
+}
+
+// Checks the fixed-format fields of an EDF header: the start date and time
+// ("dd.mm.yy" and "hh.mm.ss") and the header size, which is 256 bytes plus
+// 256 bytes per signal.
+bool isEDFHeader(const unsigned char* buf, std::size_t size) {
+    if (size < 256) {
+        return false;
+    }
+    for (std::size_t offset = 168; offset < 184; offset += 8) {
+        for (std::size_t i = 0; i < 8; ++i) {
+            bool separator = (i == 2 || i == 5);
+            if (separator ? buf[offset+i] != '.' : !isdigit(buf[offset+i])) {
+                return false;
+            }
+        }
+    }
+    std::string headerBytes((const char*)buf+184, 8);
+    std::string nSignals((const char*)buf+252, 4);
+    int nSig = atoi(nSignals.c_str());
+    return nSig > 0 && atol(headerBytes.c_str()) == 256L*(nSig+1);
+}
+
+stfio::fileSignature makeSignature(stfio::filetype type, const char* format, double version) {
+    stfio::fileSignature signature;
+    signature.type = type;
+    signature.format = format;
+    signature.version = version;
+    return signature;
+}
+
+// Reads a version number such as "2.20" from a text signature.
+double textVersion(const unsigned char* buf, std::size_t size, std::size_t offset, std::size_t len) {
+    if (size < offset+len) {
+        return 0.0;
+    }
+    std::string text((const char*)buf+offset, len);
+    return atof(text.c_str());
+}
+
+stfio::fileSignature identifyFormat(const unsigned char* buf, std::size_t size) {
+    // Axon binary files; ABF1 stores its version as a float and ABF2 as
+    // bytes (major, minor) in the upper half of a 32-bit integer:
+    if (hasMagic(buf, size, "ABF ", 4) && size >= 8) {
+        unsigned int bits = readLE32(buf+4);
+        float version = 0;
+        memcpy(&version, &bits, sizeof(float));
+        return makeSignature(stfio::abf, "ABF", version);
+    }
+    if (hasMagic(buf, size, "ABF2", 4) && size >= 8) {
+        return makeSignature(stfio::abf, "ABF2", buf[7] + buf[6]/100.0);
+    }
+    const char hdf5Magic[] = "\x89HDF\r\n\x1a\n";
+    for (std::size_t offset = 0; offset <= 2048; offset = (offset == 0) ? 512 : offset*2) {
+        if (hasMagic(buf, size, hdf5Magic, 8, offset)) {
+            double version = (size > offset+8) ? buf[offset+8] : 0.0;
+            return makeSignature(stfio::hdf5, "HDF5", version);
+        }
+    }
+    if (hasMagic(buf, size, "CEDFILE", 7)) {
+        return makeSignature(stfio::cfs, "CFS", 0.0);
+    }
+    if (hasMagic(buf, size, "DAT1", 4)) {
+        return makeSignature(stfio::heka, "HEKA", 1.0);
+    }
+    if (hasMagic(buf, size, "DAT2", 4)) {
+        return makeSignature(stfio::heka, "HEKA", 2.0);
+    }
+    if (hasMagic(buf, size, "AxGr", 4) && size >= 6) {
+        return makeSignature(stfio::axg, "AXG", (buf[4] << 8) | buf[5]);
+    }
+    if (hasMagic(buf, size, "axgx", 4) && size >= 8) {
+        return makeSignature(stfio::axg, "AXGX", readBE32(buf+4));
+    }
+    if (size >= 8 && readLE32(buf) == 0xf3b1a481) {
+        // Intan CLAMP files; the magic number is followed by 16-bit major
+        // and minor versions:
+        return makeSignature(stfio::intan, "Intan", (buf[4] | (buf[5] << 8)) + (buf[6] | (buf[7] << 8))/10.0);
+    }
+    if (hasMagic(buf, size, "TDSm", 4) && size >= 12) {
+        return makeSignature(stfio::tdms, "TDMS", (readLE32(buf+8) == 4713) ? 2.0 : 1.0);
+    }
+    if (hasMagic(buf, size, "ATF", 3)) {
+        return makeSignature(stfio::atf, "ATF", textVersion(buf, size, 4, 3));
+    }
+    // Formats that are only read by libbiosig:
+    if (hasMagic(buf, size, "GDF ", 4)) {
+        return makeSignature(stfio::biosig, "GDF", textVersion(buf, size, 4, 4));
+    }
+    if (hasMagic(buf, size, "\xff" "BIOSEMI", 8)) {
+        return makeSignature(stfio::biosig, "BDF", 0.0);
+    }
+    if (hasMagic(buf, size, "0       ", 8) && isEDFHeader(buf, size)) {
+        return makeSignature(stfio::biosig, "EDF", 0.0);
+    }
+    return stfio::fileSignature();
+}
+
+}
+
+stfio::fileSignature stfio::sniffFile(const std::string& fName) {
+    std::vector<unsigned char> buf(SNIFF_SIZE);
+    std::size_t size = 0;
+    FILE* fp = fopen(fName.c_str(), "rb");
+    if (fp != NULL) {
+        size = fread(&buf[0], 1, buf.size(), fp);
+        fclose(fp);
+    }
+    stfio::fileSignature signature = identifyFormat(&buf[0], size);
+    if (signature.type != stfio::none) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+        sniffCounts.hits++;
+    } else {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+        sniffCounts.misses++;
+    }
+    return signature;
+}
+
+stfio::sniffStatistics stfio::getSniffStatistics() {
+    return sniffCounts;
+}
+
+void stfio::resetSniffStatistics() {
+    sniffCounts = stfio::sniffStatistics();
+}
+
+namespace {
+
+// Reads a file like importFile() and returns the file type whose reader
+// was eventually used in usedType.
+bool importFileType(
         const std::string& fName,
         stfio::filetype type,
         Recording& ReturnData,
         const stfio::txtImportSettings& txtImport,
-        ProgressInfo& progDlg
+        stfio::ProgressInfo& progDlg,
+        const stfio::importRequest& request,
+        stfio::filetype& usedType
 ) {
     try {
+        // The file header is read once to find the reader; the type that was
+        // passed in is only used if the format isn't identified:
+        stfio::fileSignature signature = stfio::sniffFile(fName);
+        if (signature.type != stfio::none && signature.type != stfio::biosig) {
+            type = signature.type;
+        }
 
 #if (defined(WITH_BIOSIG) || defined(WITH_BIOSIG2))
-       // make use of automated file type identification
-
+        // Identified formats go straight to their own readers. HEKA files and
+        // all other files are passed to libbiosig first, which also identifies
+        // the formats that sniffFile() doesn't know:
+        bool nativeReader = false;
+        switch (signature.type) {
+        case stfio::hdf5:
+        case stfio::intan:
+        case stfio::tdms:
 #ifndef WITHOUT_ABF
-        if (!check_biosig_version(1,6,3)) {
+        case stfio::abf:
+        case stfio::atf:
+#endif
+#ifndef WITHOUT_AXG
+        case stfio::axg:
+#endif
+#ifndef TEST_MINIMAL
+        case stfio::cfs:
+#endif
+            nativeReader = true;
+            break;
+        default:
+            break;
+        }
+        if (!nativeReader) {
             try {
-                // workaround for older versions of libbiosig
-                stfio::importABFFile(fName, ReturnData, progDlg);
-                return true;
+                stfio::filetype type1 = stfio::importBiosigFile(fName, ReturnData, progDlg, request);
+                switch (type1) {
+                case stfio::biosig:
+                    usedType = stfio::biosig;
+                    return true;    // succeeded
+                case stfio::none:
+                    break;          // do nothing, use input argument for deciding on type
+                default:
+                    type = type1;   // filetype is recognized and should be used below
+                }
             }
             catch (...) {
-#ifndef NDEBUG
-                fprintf(stdout,"%s (line %i): importABF attempted\n",__FILE__,__LINE__);
-#endif
-            };
-       }
-#endif // WITHOUT_ABF
-
-       // if this point is reached, import ABF was not applied or not successful
-        try {
-            stfio::filetype type1 = stfio::importBiosigFile(fName, ReturnData, progDlg);
-            switch (type1) {
-            case stfio::biosig:
-                return true;    // succeeded
-            case stfio::none:
-                break;          // do nothing, use input argument for deciding on type
-            default:
-                type = type1;   // filetype is recognized and should be used below
-            }
-        }
-        catch (...) {
                 // this should never occur, importBiosigFile should always return without exception
                 std::cout << "importBiosigFile failed with an exception - this is a bug";
+            }
         }
 #endif
 
         switch (type) {
         case stfio::hdf5: {
-            stfio::importHDF5File(fName, ReturnData, progDlg);
+            stfio::importHDF5File(fName, ReturnData, progDlg, request);
             break;
         }
 #ifndef WITHOUT_ABF
         case stfio::abf: {
-            stfio::importABFFile(fName, ReturnData, progDlg);
+            stfio::importABFFile(fName, ReturnData, progDlg, request);
             break;
         }
         case stfio::atf: {
             stfio::importATFFile(fName, ReturnData, progDlg);
+            stfio::applyImportRequest(ReturnData, request);
             break;
         }
 #endif
 #ifndef WITHOUT_AXG
         case stfio::axg: {
             stfio::importAXGFile(fName, ReturnData, progDlg);
+            stfio::applyImportRequest(ReturnData, request);
             break;
         }
 #endif
         case stfio::intan: {
-            stfio::importIntanFile(fName, ReturnData, progDlg);
+            stfio::importIntanFile(fName, ReturnData, progDlg, request);
+            break;
+        }
+        case stfio::tdms: {
+            stfio::importTDMSFile(fName, ReturnData, progDlg, request);
+            break;
+        }
+        case stfio::ascii: {
+            stfio::importASCIIFile( fName, txtImport.hLines, txtImport.ncolumns,
+                    txtImport.firstIsTime, txtImport.toSection, ReturnData, progDlg );
+            if (!txtImport.firstIsTime) {
+                ReturnData.SetXScale(1.0/txtImport.sr);
+            }
+            if (ReturnData.size()>0)
+                ReturnData[0].SetYUnits(txtImport.yUnits);
+            if (ReturnData.size()>1)
+                ReturnData[1].SetYUnits(txtImport.yUnitsCh2);
+            ReturnData.SetXUnits(txtImport.xUnits);
+            stfio::applyImportRequest(ReturnData, request);
             break;
         }
 
 #ifndef TEST_MINIMAL
         case stfio::cfs: {
             {
-            int res = stfio::importCFSFile(fName, ReturnData, progDlg);
+            int res = stfio::importCFSFile(fName, ReturnData, progDlg, request);
          /*
             // disable old Heka import - its broken and will not be fixed, use biosig instead
             if (res==-7) {
@@ -246,29 +444,89 @@ bool stfio::importFile(
             stfio::SON::importSONFile(fName,ReturnData);
             break;
         }
-        case stfio::ascii: {
-            stfio::importASCIIFile( fName, txtImport.hLines, txtImport.ncolumns,
-                    txtImport.firstIsTime, txtImport.toSection, ReturnData );
-            if (!txtImport.firstIsTime) {
-                ReturnData.SetXScale(1.0/txtImport.sr);
-            }
-            if (ReturnData.size()>0)
-                ReturnData[0].SetYUnits(txtImport.yUnits);
-            if (ReturnData.size()>1)
-                ReturnData[1].SetYUnits(txtImport.yUnitsCh2);
-            ReturnData.SetXUnits(txtImport.xUnits);
-            break;
-        }
 #endif
     }
     catch (...) {
         throw;
     }
+    usedType = type;
     return true;
 }
 
+}
+
+bool stfio::importFile(
+        const std::string& fName,
+        stfio::filetype type,
+        Recording& ReturnData,
+        const stfio::txtImportSettings& txtImport,
+        ProgressInfo& progDlg,
+        const stfio::importRequest& request
+) {
+    stfio::filetype usedType = stfio::none;
+    return importFileType(fName, type, ReturnData, txtImport, progDlg, request, usedType);
+}
+
+stfio::fileMetadata stfio::importMetadata(const std::string& fName, stfio::filetype type) {
+    // All channels and sections, but no data points:
+    stfio::importRequest request;
+    request.firstPoint = std::numeric_limits<std::size_t>::max();
+
+    Recording header;
+    stfio::txtImportSettings txtImport;
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    stfio::filetype usedType = stfio::none;
+    if (!importFileType(fName, type, header, txtImport, progDlg, request, usedType)) {
+        throw std::runtime_error("Couldn't read " + fName);
+    }
+
+    stfio::fileMetadata metadata;
+    metadata.type = usedType;
+    metadata.dt = header.GetXScale();
+    metadata.xUnits = header.GetXUnits();
+    for (std::size_t nChannel=0; nChannel < header.size(); ++nChannel) {
+        metadata.channelNames.push_back(header[nChannel].GetChannelName());
+        metadata.yUnits.push_back(header[nChannel].GetYUnits());
+        metadata.nSections.push_back(header[nChannel].size());
+    }
+    metadata.datetime = header.GetDateTime();
+    metadata.comment = header.GetComment();
+    metadata.fileDescription = header.GetFileDescription();
+    metadata.globalSectionDescription = header.GetGlobalSectionDescription();
+    return metadata;
+}
+
+void stfio::applyImportRequest(Recording& Data, const stfio::importRequest& request) {
+    if (request.IsComplete()) {
+        return;
+    }
+    std::size_t nSelected = 0;
+    for (std::size_t nChannel=0; nChannel < Data.size(); ++nChannel) {
+        if (!request.HasChannel(nChannel)) {
+            continue;
+        }
+        // Move the selected channels to the front without copying their sections:
+        Channel& ch = Data[nSelected];
+        if (nSelected != nChannel) {
+            ch.get().swap(Data[nChannel].get());
+            ch.SetChannelName(Data[nChannel].GetChannelName());
+            ch.SetYUnits(Data[nChannel].GetYUnits());
+        }
+        std::deque<Section> sections;
+        std::size_t end = request.SectionEnd(ch.size());
+        for (std::size_t nSection=request.firstSection; nSection < end; ++nSection) {
+            std::size_t start = 0, n = 0;
+            request.Window(ch[nSection].size(), start, n);
+            sections.push_back(ch[nSection].Window(start, n));
+        }
+        ch.get().swap(sections);
+        nSelected++;
+    }
+    Data.resize(nSelected);
+}
+
 bool stfio::exportFile(const std::string& fName, stfio::filetype type, const Recording& Data,
-                       ProgressInfo& progDlg)
+                       ProgressInfo& progDlg, const stfio::hdf5ExportSettings& hdf5Export)
 {
     try {
         switch (type) {
@@ -289,7 +547,7 @@ bool stfio::exportFile(const std::string& fName, stfio::filetype type, const Rec
             break;
         }
         case stfio::hdf5: {
-            stfio::exportHDF5File(fName, Data, progDlg);
+            stfio::exportHDF5File(fName, Data, progDlg, hdf5Export);
             break;
         }
         case stfio::igor: {
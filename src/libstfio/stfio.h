@@ -27,15 +27,20 @@
 #include <iostream>
 #if (__cplusplus < 201103)
 #  include <boost/function.hpp>
+#  include <boost/shared_ptr.hpp>
+#  include <boost/atomic.hpp>
 #else
 #  include <algorithm>
 #  include <functional>
+#  include <memory>
+#  include <atomic>
 #endif
 #include <vector>
 #include <deque>
 #include <map>
 #include <string>
 #include <cmath>
+#include <ctime>
 
 #ifdef _MSC_VER
 #pragma warning( disable : 4251 )  // Disable warning messages
@@ -152,6 +157,80 @@ struct txtImportSettings {
     std::string xUnits;    /*!< x units string. */
 };
 
+//! HDF5 export settings
+struct hdf5ExportSettings {
+  hdf5ExportSettings() : channelDatasets(false),compression(0),shuffle(true),int16(false) {}
+
+    bool channelDatasets;  /*!< Store each channel as one chunked 2D dataset rather than one dataset per section. */
+    int compression;       /*!< Deflate compression level of channel datasets (1-9); 0 disables compression. */
+    bool shuffle;          /*!< Apply the shuffle filter before compressing channel datasets. */
+    bool int16;            /*!< Store channel datasets as 16 bit integers with scale and offset attributes; fails for NaN or infinite samples. */
+};
+
+//! Selects the part of a file that is read by importFile()
+/*! A default-constructed request reads the whole file. Readers that support
+ *  it skip unselected channels, sections and data points at the I/O level;
+ *  for all other file types, the selection is applied after reading.
+ *  Selected channels are returned in the order in which they are stored in the file.
+ */
+struct importRequest {
+  importRequest() : channels(),firstSection(0),nSections(0),firstPoint(0),nPoints(0) {}
+
+    std::vector<std::size_t> channels; /*!< Indices of the channels to be read; empty selects all channels. */
+    std::size_t firstSection;  /*!< Index of the first section to be read. */
+    std::size_t nSections;     /*!< Number of sections to be read; 0 selects all remaining sections. */
+    std::size_t firstPoint;    /*!< Index of the first data point to be read from each section. */
+    std::size_t nPoints;       /*!< Number of data points per section; 0 reads up to the end of each section. */
+
+    //! Indicates whether the whole file is selected.
+    bool IsComplete() const {
+        return channels.empty() && firstSection==0 && nSections==0 && firstPoint==0 && nPoints==0;
+    }
+
+    //! Indicates whether a channel is selected.
+    /*! \param n Index of the channel in the file.
+     */
+    bool HasChannel(std::size_t n) const {
+        if (channels.empty())
+            return true;
+        for (std::size_t i=0; i<channels.size(); ++i) {
+            if (channels[i]==n)
+                return true;
+        }
+        return false;
+    }
+
+    //! Index after the last selected section.
+    /*! \param total Number of sections in the file.
+     *  \return An index between firstSection and total; equal to firstSection if no section is selected.
+     */
+    std::size_t SectionEnd(std::size_t total) const {
+        if (firstSection >= total)
+            return firstSection;
+        if (nSections==0 || nSections > total-firstSection)
+            return total;
+        return firstSection+nSections;
+    }
+
+    //! Indicates whether a section is selected.
+    /*! \param n Index of the section in the file.
+     *  \param total Number of sections in the file.
+     */
+    bool HasSection(std::size_t n, std::size_t total) const {
+        return n >= firstSection && n < SectionEnd(total);
+    }
+
+    //! Clips the selected data points to a section.
+    /*! \param size Number of data points in the section.
+     *  \param start On exit, index of the first selected data point.
+     *  \param n On exit, number of selected data points.
+     */
+    void Window(std::size_t size, std::size_t& start, std::size_t& n) const {
+        start = (firstPoint < size) ? firstPoint : size;
+        n = (nPoints==0 || nPoints > size-start) ? size-start : nPoints;
+    }
+};
+
 //! File types
 enum filetype {
     atf,    /*!< Axon text file. */
@@ -169,6 +248,41 @@ enum filetype {
     none    /*!< Undefined file type. */
 };
 
+//! File format, as identified by sniffFile().
+struct fileSignature {
+    fileSignature() : type(none), format(), version(0.0) {}
+
+    stfio::filetype type; /*!< The reader for the file; biosig for formats that only libbiosig reads,
+                               none if the format wasn't identified. */
+    std::string format;   /*!< Name of the format, e.g. "ABF2" or "HDF5"; empty if it wasn't identified. */
+    double version;       /*!< Version of the format; 0 if the signature doesn't contain it. */
+};
+
+//! Counts of the files identified by sniffFile().
+struct sniffStatistics {
+    sniffStatistics() : hits(0), misses(0) {}
+
+    std::size_t hits;   /*!< Number of files whose format was identified. */
+    std::size_t misses; /*!< Number of files whose format wasn't identified. */
+};
+
+//! File header information, as returned by importMetadata().
+struct fileMetadata {
+    fileMetadata() : type(none), dt(0.0), xUnits(), channelNames(), yUnits(), nSections(),
+                     datetime(), comment(), fileDescription(), globalSectionDescription() {}
+
+    stfio::filetype type;               /*!< The file type that was used to read the file. */
+    double dt;                          /*!< Sampling interval. */
+    std::string xUnits;                 /*!< Units of the sampling interval. */
+    std::vector<std::string> channelNames; /*!< Name of each channel. */
+    std::vector<std::string> yUnits;    /*!< Units of each channel. */
+    std::vector<std::size_t> nSections; /*!< Number of sections of each channel. */
+    struct tm datetime;                 /*!< Date and time of recording. */
+    std::string comment;                /*!< Comment on the recording. */
+    std::string fileDescription;        /*!< File description. */
+    std::string globalSectionDescription; /*!< Description common to all sections. */
+};
+
   
 #ifndef TEST_MINIMAL
 //! Attempts to determine the filetype from the filter extension.
@@ -186,12 +300,32 @@ findType(const std::string& ext);
 StfioDll std::string
 findExtension(stfio::filetype ftype);
 
+//! Identifies the format of a file from its first bytes.
+/*! Only reads the beginning of the file, once, and doesn't throw.
+ *  \param fName The full path name of the file.
+ *  \return The file format; its type is none if the format wasn't identified.
+ */
+StfioDll stfio::fileSignature
+sniffFile(const std::string& fName);
+
+//! Returns how many files sniffFile() has identified so far.
+StfioDll stfio::sniffStatistics
+getSniffStatistics();
+
+//! Resets the counts returned by getSniffStatistics().
+StfioDll void
+resetSniffStatistics();
+
 //! Generic file import.
-/*! \param fName The full path name of the file. 
+/*! The format is identified with sniffFile() first, and the file is passed
+ *  straight to the reader for that format; \e type is only used for files
+ *  whose format isn't identified.
+ *  \param fName The full path name of the file. 
  *  \param type The file type. 
  *  \param ReturnData Will contain the file data on return.
  *  \param txtImport The text import filter settings.
  *  \param ProgressInfo Progress indicator
+ *  \param request Channels, sections and data points to be read.
  *  \return true if the file has successfully been read, false otherwise.
  */
 StfioDll bool 
@@ -200,19 +334,42 @@ importFile(
         stfio::filetype type,
         Recording& ReturnData,
         const stfio::txtImportSettings& txtImport,
-        stfio::ProgressInfo& progDlg
+        stfio::ProgressInfo& progDlg,
+        const stfio::importRequest& request = stfio::importRequest()
 );
 
+//! Reads the header information of a file without its sample data.
+/*! Channels and sections are read with an empty selection of data points,
+ *  so that readers which honour an importRequest only parse the file headers.
+ *  Throws std::runtime_error if the file can't be read.
+ *  \param fName The full path name of the file.
+ *  \param type The file type, used if the format isn't identified from the file.
+ *  \return The header information, including the file type that was read.
+ */
+StfioDll stfio::fileMetadata
+importMetadata(const std::string& fName, stfio::filetype type);
+
+//! Restricts a Recording to the selection of an import request.
+/*! Used for file types whose readers can't skip data while reading.
+ *  Lazily decoded sections are windowed without decoding them.
+ *  \param Data The recording, as read from the whole file.
+ *  \param request Channels, sections and data points to be kept.
+ */
+StfioDll void
+applyImportRequest(Recording& Data, const stfio::importRequest& request);
+
 //! Generic file export.
 /*! \param fName The full path name of the file. 
  *  \param type The file type. 
  *  \param Data Data to be written
  *  \param ProgressInfo Progress indicator
+ *  \param hdf5Export Layout of HDF5 files; ignored for other file types.
  *  \return true if the file has successfully been written, false otherwise.
  */
 StfioDll bool
 exportFile(const std::string& fName, stfio::filetype type, const Recording& Data,
-           ProgressInfo& progDlg);
+           ProgressInfo& progDlg,
+           const stfio::hdf5ExportSettings& hdf5Export = stfio::hdf5ExportSettings());
 
 //! Produce new recording with concatenated sections
 /*! \param src Source recording
@@ -0,0 +1,677 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file tdmslib.cpp
+ *  \author Christoph Schmidt-Hieber
+ *  \brief Reads National Instruments TDMS files, e.g. from Mantis.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#if __cplusplus > 199711L
+#include <cstdint>
+#else
+#include <boost/cstdint.hpp>
+#endif
+
+#include "tdmslib.h"
+#include "../recording.h"
+
+namespace {
+
+// Flags in the table of contents of a segment lead-in:
+const uint32_t kTocMetaData = 1 << 1;
+const uint32_t kTocNewObjList = 1 << 2;
+const uint32_t kTocRawData = 1 << 3;
+const uint32_t kTocInterleavedData = 1 << 5;
+const uint32_t kTocBigEndian = 1 << 6;
+const uint32_t kTocDAQmxRawData = 1 << 7;
+
+// Special values of the raw data index of an object:
+const uint32_t NO_RAW_DATA = 0xFFFFFFFF;
+const uint32_t SAME_RAW_DATA = 0x00000000;
+const uint32_t DAQMX_FORMAT_CHANGING_SCALER = 0x69120000;
+const uint32_t DAQMX_DIGITAL_LINE_SCALER = 0x69130000;
+
+const uint64_t INCOMPLETE_SEGMENT = 0xFFFFFFFFFFFFFFFFULL;
+const std::size_t LEAD_IN_SIZE = 28;
+
+// Raw data are read from the file in blocks of this size:
+const std::size_t BLOCK_SIZE = 1 << 20;
+
+enum tdsDataType {
+    tdsTypeVoid = 0,
+    tdsTypeI8 = 1,
+    tdsTypeI16 = 2,
+    tdsTypeI32 = 3,
+    tdsTypeI64 = 4,
+    tdsTypeU8 = 5,
+    tdsTypeU16 = 6,
+    tdsTypeU32 = 7,
+    tdsTypeU64 = 8,
+    tdsTypeSingleFloat = 9,
+    tdsTypeDoubleFloat = 10,
+    tdsTypeExtendedFloat = 11,
+    tdsTypeSingleFloatWithUnit = 0x19,
+    tdsTypeDoubleFloatWithUnit = 0x1A,
+    tdsTypeExtendedFloatWithUnit = 0x1B,
+    tdsTypeString = 0x20,
+    tdsTypeBoolean = 0x21,
+    tdsTypeTimeStamp = 0x44,
+    tdsTypeComplexSingleFloat = 0x08000c,
+    tdsTypeComplexDoubleFloat = 0x10000d
+};
+
+// Size of a value in bytes, or 0 for strings and unsupported types.
+std::size_t type_size(uint32_t type) {
+    switch (type) {
+     case tdsTypeI8:
+     case tdsTypeU8:
+     case tdsTypeBoolean:
+         return 1;
+     case tdsTypeI16:
+     case tdsTypeU16:
+         return 2;
+     case tdsTypeI32:
+     case tdsTypeU32:
+     case tdsTypeSingleFloat:
+     case tdsTypeSingleFloatWithUnit:
+         return 4;
+     case tdsTypeI64:
+     case tdsTypeU64:
+     case tdsTypeDoubleFloat:
+     case tdsTypeDoubleFloatWithUnit:
+     case tdsTypeComplexSingleFloat:
+         return 8;
+     case tdsTypeExtendedFloat:
+     case tdsTypeExtendedFloatWithUnit:
+     case tdsTypeTimeStamp:
+     case tdsTypeComplexDoubleFloat:
+         return 16;
+     default:
+         return 0;
+    }
+}
+
+// Whether values of a type can be imported as double.
+bool is_numeric(uint32_t type) {
+    switch (type) {
+     case tdsTypeI8:
+     case tdsTypeI16:
+     case tdsTypeI32:
+     case tdsTypeI64:
+     case tdsTypeU8:
+     case tdsTypeU16:
+     case tdsTypeU32:
+     case tdsTypeU64:
+     case tdsTypeSingleFloat:
+     case tdsTypeSingleFloatWithUnit:
+     case tdsTypeDoubleFloat:
+     case tdsTypeDoubleFloatWithUnit:
+     case tdsTypeBoolean:
+         return true;
+     default:
+         return false;
+    }
+}
+
+bool host_is_big_endian() {
+    const uint16_t one = 1;
+    return *reinterpret_cast<const unsigned char*>(&one) == 0;
+}
+
+template <typename T>
+T from_bytes(const char* p, bool swap) {
+    T value;
+    if (swap) {
+        char tmp[sizeof(T)];
+        std::reverse_copy(p, p+sizeof(T), tmp);
+        memcpy(&value, tmp, sizeof(T));
+    } else {
+        memcpy(&value, p, sizeof(T));
+    }
+    return value;
+}
+
+template <typename T>
+void decode(const char* src, std::size_t n, std::size_t stride, bool swap, double* dest) {
+    for (std::size_t i = 0; i < n; ++i, src += stride) {
+        dest[i] = static_cast<double>(from_bytes<T>(src, swap));
+    }
+}
+
+// Converts n values that are stride bytes apart to double.
+void decode_values(const char* src, std::size_t n, std::size_t stride, uint32_t type, bool swap,
+                   double* dest) {
+    switch (type) {
+     case tdsTypeI8: decode<int8_t>(src, n, stride, swap, dest); break;
+     case tdsTypeI16: decode<int16_t>(src, n, stride, swap, dest); break;
+     case tdsTypeI32: decode<int32_t>(src, n, stride, swap, dest); break;
+     case tdsTypeI64: decode<int64_t>(src, n, stride, swap, dest); break;
+     case tdsTypeU8:
+     case tdsTypeBoolean: decode<uint8_t>(src, n, stride, swap, dest); break;
+     case tdsTypeU16: decode<uint16_t>(src, n, stride, swap, dest); break;
+     case tdsTypeU32: decode<uint32_t>(src, n, stride, swap, dest); break;
+     case tdsTypeU64: decode<uint64_t>(src, n, stride, swap, dest); break;
+     case tdsTypeSingleFloat:
+     case tdsTypeSingleFloatWithUnit: decode<float>(src, n, stride, swap, dest); break;
+     case tdsTypeDoubleFloat:
+     case tdsTypeDoubleFloatWithUnit: decode<double>(src, n, stride, swap, dest); break;
+     default:
+         throw std::runtime_error("Unsupported data type in TDMS file");
+    }
+}
+
+class TdmsReader {
+public:
+    TdmsReader(const std::string& fName) : file(fName.c_str(), std::ios::in | std::ios::binary) {
+        if (!file) {
+            throw std::runtime_error("Couldn't open file");
+        }
+        file.seekg(0, std::ios::end);
+        fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0, std::ios::beg);
+    }
+
+    uint64_t size() const { return fileSize; }
+
+    void seek(uint64_t pos) {
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(pos), std::ios::beg);
+    }
+
+    void read(char* data, std::size_t n) {
+        file.read(data, n);
+        if (file.fail()) {
+            throw std::runtime_error("Unexpected end of TDMS file");
+        }
+    }
+
+    template <typename T>
+    T get(bool swap) {
+        char tmp[sizeof(T)];
+        read(tmp, sizeof(T));
+        return from_bytes<T>(tmp, swap);
+    }
+
+    std::string get_string(bool swap) {
+        uint32_t length = get<uint32_t>(swap);
+        if (length > fileSize) {
+            throw std::runtime_error("Invalid string in TDMS file");
+        }
+        std::string str(length, '\0');
+        if (length > 0) {
+            read(&str[0], length);
+        }
+        return str;
+    }
+
+private:
+    std::ifstream file;
+    uint64_t fileSize;
+};
+
+struct TdmsObject {
+    std::string path;
+    uint32_t dataType;
+    uint64_t nValues;     // values per chunk, from the last raw data index
+    uint64_t totalSize;   // bytes per chunk, for strings only
+    bool hasData;         // whether the object has raw data in the current segment
+    uint64_t length;      // total number of values in the file
+    std::map<std::string, double> numbers;
+    std::map<std::string, std::string> strings;
+
+    TdmsObject(const std::string& path_)
+        : path(path_), dataType(tdsTypeVoid), nValues(0), totalSize(0), hasData(false), length(0)
+    {}
+};
+
+// An object with raw data in a segment:
+struct TdmsSegmentObject {
+    std::size_t object;
+    uint32_t dataType;
+    uint64_t nValues;     // values per chunk
+    uint64_t offset;      // of the first value in a chunk, or in a row of interleaved data
+};
+
+struct TdmsSegment {
+    uint64_t rawOffset;   // file position of the raw data
+    uint64_t chunkSize;
+    uint64_t nChunks;
+    uint64_t rowSize;     // bytes per row of interleaved data, 0 for contiguous data
+    bool swap;
+    std::vector<TdmsSegmentObject> objects;
+};
+
+struct TdmsIndex {
+    std::vector<TdmsObject> objects;
+    std::map<std::string, std::size_t> paths;
+    std::vector<TdmsSegment> segments;
+};
+
+void read_property(TdmsReader& reader, bool swap, TdmsObject& object) {
+    std::string name = reader.get_string(swap);
+    uint32_t type = reader.get<uint32_t>(swap);
+    if (type == tdsTypeString) {
+        object.strings[name] = reader.get_string(swap);
+        return;
+    }
+    std::size_t size = type_size(type);
+    if (size == 0) {
+        throw std::runtime_error("Unsupported property type in TDMS file");
+    }
+    char value[16];
+    reader.read(value, size);
+    if (is_numeric(type)) {
+        decode_values(value, 1, size, type, swap, &object.numbers[name]);
+    }
+}
+
+void read_metadata(TdmsReader& reader, bool swap, TdmsIndex& index,
+                   std::vector<std::size_t>& segmentObjects) {
+    uint32_t nObjects = reader.get<uint32_t>(swap);
+    for (uint32_t n = 0; n < nObjects; ++n) {
+        std::string path = reader.get_string(swap);
+        std::map<std::string, std::size_t>::const_iterator it = index.paths.find(path);
+        std::size_t nObject = 0;
+        if (it == index.paths.end()) {
+            nObject = index.objects.size();
+            index.paths[path] = nObject;
+            index.objects.push_back(TdmsObject(path));
+        } else {
+            nObject = it->second;
+        }
+        TdmsObject& object = index.objects[nObject];
+
+        uint32_t rawIndex = reader.get<uint32_t>(swap);
+        if (rawIndex == NO_RAW_DATA) {
+            object.hasData = false;
+        } else if (rawIndex == DAQMX_FORMAT_CHANGING_SCALER || rawIndex == DAQMX_DIGITAL_LINE_SCALER) {
+            throw std::runtime_error("DAQmx raw data in TDMS files are not supported");
+        } else if (rawIndex == SAME_RAW_DATA) {
+            object.hasData = true;
+        } else {
+            object.dataType = reader.get<uint32_t>(swap);
+            uint32_t dimension = reader.get<uint32_t>(swap);
+            if (dimension != 1) {
+                throw std::runtime_error("Invalid array dimension in TDMS file");
+            }
+            object.nValues = reader.get<uint64_t>(swap);
+            object.totalSize = (object.dataType == tdsTypeString) ? reader.get<uint64_t>(swap) : 0;
+            object.hasData = true;
+        }
+
+        uint32_t nProperties = reader.get<uint32_t>(swap);
+        for (uint32_t nProperty = 0; nProperty < nProperties; ++nProperty) {
+            read_property(reader, swap, object);
+        }
+
+        if (std::find(segmentObjects.begin(), segmentObjects.end(), nObject) == segmentObjects.end()) {
+            segmentObjects.push_back(nObject);
+        }
+    }
+}
+
+// Indexes the raw data of a segment, which start at rawOffset and end at segmentEnd.
+void add_segment(TdmsIndex& index, const std::vector<std::size_t>& segmentObjects,
+                 uint64_t rawOffset, uint64_t segmentEnd, uint32_t toc) {
+    TdmsSegment segment;
+    segment.rawOffset = rawOffset;
+    segment.chunkSize = 0;
+    segment.rowSize = 0;
+    segment.swap = ((toc & kTocBigEndian) != 0) != host_is_big_endian();
+    bool interleaved = (toc & kTocInterleavedData) != 0;
+    for (std::size_t n = 0; n < segmentObjects.size(); ++n) {
+        const TdmsObject& object = index.objects[segmentObjects[n]];
+        // Objects without raw data bytes, such as empty string channels, would
+        // otherwise leave a chunk size of 0:
+        if (!object.hasData || object.nValues == 0 ||
+            (object.dataType == tdsTypeString && object.totalSize == 0)) {
+            continue;
+        }
+        std::size_t size = type_size(object.dataType);
+        if (size == 0 && (interleaved || object.dataType != tdsTypeString)) {
+            throw std::runtime_error("Unsupported data type in TDMS file");
+        }
+        TdmsSegmentObject segmentObject;
+        segmentObject.object = segmentObjects[n];
+        segmentObject.dataType = object.dataType;
+        segmentObject.nValues = object.nValues;
+        if (interleaved) {
+            if (!segment.objects.empty() && object.nValues != segment.objects[0].nValues) {
+                throw std::runtime_error("Interleaved channels of different lengths in TDMS file");
+            }
+            segmentObject.offset = segment.rowSize;
+            segment.rowSize += size;
+        } else {
+            segmentObject.offset = segment.chunkSize;
+            segment.chunkSize += (object.dataType == tdsTypeString) ?
+                object.totalSize : object.nValues * size;
+        }
+        segment.objects.push_back(segmentObject);
+    }
+    if (segment.objects.empty()) {
+        return;
+    }
+    if (interleaved) {
+        segment.chunkSize = segment.rowSize * segment.objects[0].nValues;
+    }
+    segment.nChunks = (segmentEnd > rawOffset) ? (segmentEnd - rawOffset) / segment.chunkSize : 0;
+    for (std::size_t n = 0; n < segment.objects.size(); ++n) {
+        index.objects[segment.objects[n].object].length += segment.objects[n].nValues * segment.nChunks;
+    }
+    index.segments.push_back(segment);
+}
+
+// Parses the metadata of all segments and indexes their raw data.
+TdmsIndex read_index(TdmsReader& reader) {
+    TdmsIndex index;
+    std::vector<std::size_t> segmentObjects;
+    uint64_t pos = 0;
+    while (pos + LEAD_IN_SIZE <= reader.size()) {
+        reader.seek(pos);
+        char tag[4];
+        reader.read(tag, 4);
+        if (memcmp(tag, "TDSm", 4) != 0) {
+            throw std::runtime_error("Invalid segment in TDMS file");
+        }
+        // The ToC mask is always little-endian; the rest of the segment,
+        // including the remainder of the lead-in, follows kTocBigEndian:
+        uint32_t toc = reader.get<uint32_t>(host_is_big_endian());
+        bool swap = ((toc & kTocBigEndian) != 0) != host_is_big_endian();
+        reader.get<uint32_t>(swap); // version
+        uint64_t nextOffset = reader.get<uint64_t>(swap);
+        uint64_t rawDataOffset = reader.get<uint64_t>(swap);
+        if (toc & kTocDAQmxRawData) {
+            throw std::runtime_error("DAQmx raw data in TDMS files are not supported");
+        }
+        uint64_t dataStart = pos + LEAD_IN_SIZE;
+        uint64_t segmentEnd = reader.size();
+        if (nextOffset != INCOMPLETE_SEGMENT && nextOffset <= reader.size() - dataStart) {
+            segmentEnd = dataStart + nextOffset;
+        }
+        if (toc & kTocMetaData) {
+            if (toc & kTocNewObjList) {
+                segmentObjects.clear();
+            }
+            read_metadata(reader, swap, index, segmentObjects);
+        }
+        if (toc & kTocRawData) {
+            add_segment(index, segmentObjects, dataStart + rawDataOffset, segmentEnd, toc);
+        }
+        if (segmentEnd == reader.size()) {
+            break;
+        }
+        pos = segmentEnd;
+    }
+    return index;
+}
+
+// Values [start, start+n) of an object that are decoded into data.
+struct TdmsDestination {
+    std::size_t object;
+    uint64_t start;
+    uint64_t n;
+    double* data;
+};
+
+// Reads the raw data of several objects in a single pass through the file.
+void read_values(TdmsReader& reader, const TdmsIndex& index, const std::vector<TdmsDestination>& dest) {
+    // Index of the first value of the current chunk of every destination:
+    std::vector<uint64_t> pos(dest.size(), 0);
+    std::vector<const TdmsSegmentObject*> present(dest.size());
+    std::vector<char> block;
+    for (std::size_t nSeg = 0; nSeg < index.segments.size(); ++nSeg) {
+        const TdmsSegment& segment = index.segments[nSeg];
+        bool any = false;
+        for (std::size_t nd = 0; nd < dest.size(); ++nd) {
+            present[nd] = NULL;
+            for (std::size_t no = 0; no < segment.objects.size(); ++no) {
+                if (segment.objects[no].object == dest[nd].object) {
+                    present[nd] = &segment.objects[no];
+                    any = true;
+                    break;
+                }
+            }
+        }
+        for (uint64_t nChunk = 0; nChunk < segment.nChunks && any; ++nChunk) {
+            uint64_t chunkOffset = segment.rawOffset + nChunk * segment.chunkSize;
+            // Rows of interleaved data that are needed by any destination:
+            uint64_t firstRow = segment.objects[0].nValues, endRow = 0;
+            for (std::size_t nd = 0; nd < dest.size(); ++nd) {
+                const TdmsSegmentObject* so = present[nd];
+                if (so == NULL) {
+                    continue;
+                }
+                uint64_t a = std::max(dest[nd].start, pos[nd]);
+                uint64_t b = std::min(dest[nd].start + dest[nd].n, pos[nd] + so->nValues);
+                if (a < b) {
+                    if (segment.rowSize > 0) {
+                        firstRow = std::min(firstRow, a - pos[nd]);
+                        endRow = std::max(endRow, b - pos[nd]);
+                    } else {
+                        // Contiguous values of an object are read in blocks:
+                        std::size_t size = type_size(so->dataType);
+                        uint64_t nBlock = std::max<uint64_t>(1, BLOCK_SIZE / size);
+                        for (uint64_t first = a; first < b; first += nBlock) {
+                            std::size_t count = std::min(nBlock, b - first);
+                            block.resize(count * size);
+                            reader.seek(chunkOffset + so->offset + (first - pos[nd]) * size);
+                            reader.read(&block[0], block.size());
+                            decode_values(&block[0], count, size, so->dataType, segment.swap,
+                                          dest[nd].data + (first - dest[nd].start));
+                        }
+                    }
+                }
+            }
+            // Interleaved rows are read in blocks and decoded for all destinations:
+            uint64_t rowsPerBlock = std::max<uint64_t>(1, BLOCK_SIZE / std::max<uint64_t>(1, segment.rowSize));
+            for (uint64_t row = firstRow; row < endRow; row += rowsPerBlock) {
+                uint64_t nRows = std::min(rowsPerBlock, endRow - row);
+                block.resize(nRows * segment.rowSize);
+                reader.seek(chunkOffset + row * segment.rowSize);
+                reader.read(&block[0], block.size());
+                for (std::size_t nd = 0; nd < dest.size(); ++nd) {
+                    const TdmsSegmentObject* so = present[nd];
+                    if (so == NULL) {
+                        continue;
+                    }
+                    uint64_t a = std::max(dest[nd].start, pos[nd] + row);
+                    uint64_t b = std::min(dest[nd].start + dest[nd].n, pos[nd] + row + nRows);
+                    if (a < b) {
+                        decode_values(&block[(a - pos[nd] - row) * segment.rowSize + so->offset],
+                                      b - a, segment.rowSize, so->dataType, segment.swap,
+                                      dest[nd].data + (a - dest[nd].start));
+                    }
+                }
+            }
+            for (std::size_t nd = 0; nd < dest.size(); ++nd) {
+                if (present[nd] != NULL) {
+                    pos[nd] += present[nd]->nValues;
+                }
+            }
+        }
+    }
+}
+
+// Splits an object path such as /'group'/'channel' into its names.
+std::vector<std::string> split_path(const std::string& path) {
+    std::vector<std::string> names;
+    // The root object has the path "/":
+    std::size_t i = (path == "/") ? 1 : 0;
+    while (i < path.size()) {
+        if (path[i] != '/' || i+1 >= path.size() || path[i+1] != '\'') {
+            throw std::runtime_error("Invalid object path in TDMS file");
+        }
+        std::string name;
+        for (i += 2; i < path.size(); ++i) {
+            if (path[i] == '\'') {
+                // Quotes within names are doubled:
+                if (i+1 < path.size() && path[i+1] == '\'') {
+                    name += '\'';
+                    ++i;
+                } else {
+                    break;
+                }
+            } else {
+                name += path[i];
+            }
+        }
+        names.push_back(name);
+        ++i;
+    }
+    return names;
+}
+
+std::string lower(std::string str) {
+    for (std::size_t i = 0; i < str.size(); ++i) {
+        str[i] = std::tolower(static_cast<unsigned char>(str[i]));
+    }
+    return str;
+}
+
+// Reads the sampling rate from the file properties; the value may be stored as a string.
+bool sampling_rate(const TdmsObject& root, const std::string& name, double& sr) {
+    std::map<std::string, double>::const_iterator num = root.numbers.find(name);
+    if (num != root.numbers.end()) {
+        sr = num->second;
+        return true;
+    }
+    std::map<std::string, std::string>::const_iterator str = root.strings.find(name);
+    if (str != root.strings.end()) {
+        sr = std::strtod(str->second.c_str(), NULL);
+        return true;
+    }
+    return false;
+}
+
+}
+
+void stfio::importTDMSFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg,
+                           const importRequest& request) {
+    TdmsReader reader(fName);
+    progDlg.Update(0, "Reading TDMS metadata");
+    TdmsIndex index = read_index(reader);
+
+    // Groups and their channels with numeric data, in the order of the file:
+    std::vector<std::string> groupNames;
+    std::vector<std::vector<std::size_t> > groupChannels;
+    std::map<std::string, std::size_t> groups;
+    for (std::size_t nObject = 0; nObject < index.objects.size(); ++nObject) {
+        std::vector<std::string> names = split_path(index.objects[nObject].path);
+        if (names.empty()) {
+            continue;
+        }
+        std::map<std::string, std::size_t>::const_iterator it = groups.find(names[0]);
+        std::size_t nGroup = 0;
+        if (it == groups.end()) {
+            nGroup = groupNames.size();
+            groups[names[0]] = nGroup;
+            groupNames.push_back(names[0]);
+            groupChannels.push_back(std::vector<std::size_t>());
+        } else {
+            nGroup = it->second;
+        }
+        const TdmsObject& object = index.objects[nObject];
+        if (names.size() == 2 && object.length > 0 && is_numeric(object.dataType)) {
+            groupChannels[nGroup].push_back(nObject);
+        }
+    }
+
+    // Sampling interval from the time channel, or else from the file properties:
+    double dt = 1.0;
+    bool hasTime = false;
+    for (std::size_t nGroup = 0; nGroup < groupNames.size() && !hasTime; ++nGroup) {
+        if (lower(groupNames[nGroup]) != "time" || groupChannels[nGroup].empty()) {
+            continue;
+        }
+        std::size_t nObject = groupChannels[nGroup][0];
+        uint64_t length = index.objects[nObject].length;
+        if (length > 1) {
+            double times[2];
+            std::vector<TdmsDestination> dest(2);
+            dest[0].object = dest[1].object = nObject;
+            dest[0].start = 0;
+            dest[1].start = length-1;
+            dest[0].n = dest[1].n = 1;
+            dest[0].data = &times[0];
+            dest[1].data = &times[1];
+            read_values(reader, index, dest);
+            dt = (times[1]-times[0]) / (length-1);
+            hasTime = true;
+        }
+    }
+    std::map<std::string, std::size_t>::const_iterator root = index.paths.find("/");
+    if (!hasTime && root != index.paths.end()) {
+        double sr = 0;
+        if (sampling_rate(index.objects[root->second], "Sampling Rate", sr) ||
+            sampling_rate(index.objects[root->second], "Sampling Rate(AI)", sr))
+        {
+            dt = (sr > 0) ? 1e3/sr : 1.0/25.0;
+        }
+    }
+
+    // Analog input and output groups are imported as channels:
+    std::vector<std::size_t> selected;
+    std::size_t nChannel = 0;
+    for (std::size_t nGroup = 0; nGroup < groupNames.size(); ++nGroup) {
+        std::string prefix = lower(groupNames[nGroup].substr(0, 2));
+        if ((prefix != "ai" && prefix != "ao") || groupChannels[nGroup].empty()) {
+            continue;
+        }
+        if (request.HasChannel(nChannel++)) {
+            selected.push_back(nGroup);
+        }
+    }
+
+    // Allocate all sections first, so that the data can be decoded into them:
+    ReturnData.resize(selected.size());
+    std::vector<TdmsDestination> dest;
+    for (std::size_t nc = 0; nc < selected.size(); ++nc) {
+        const std::vector<std::size_t>& channels = groupChannels[selected[nc]];
+        Channel& ch = ReturnData[nc];
+        ch.SetChannelName(groupNames[selected[nc]]);
+        std::map<std::string, std::string>::const_iterator unit =
+            index.objects[channels[0]].strings.find("unit_string");
+        if (unit != index.objects[channels[0]].strings.end()) {
+            ch.SetYUnits(unit->second);
+        }
+        std::size_t end = request.SectionEnd(channels.size());
+        ch.resize(end > request.firstSection ? end - request.firstSection : 0);
+        for (std::size_t ns = 0; ns < ch.size(); ++ns) {
+            std::size_t nObject = channels[request.firstSection + ns];
+            std::size_t start = 0, n = 0;
+            request.Window(index.objects[nObject].length, start, n);
+            ch[ns].resize(n);
+            if (n > 0) {
+                TdmsDestination d;
+                d.object = nObject;
+                d.start = start;
+                d.n = n;
+                d.data = &ch[ns].get_w()[0];
+                dest.push_back(d);
+            }
+        }
+    }
+    progDlg.Update(50, "Reading TDMS data");
+    read_values(reader, index, dest);
+    ReturnData.SetXScale(dt);
+}
@@ -0,0 +1,56 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file tdmslib.h
+ *  \author Christoph Schmidt-Hieber
+ *  \brief Reads National Instruments TDMS files, e.g. from Mantis.
+ */
+
+/*
+The file format is described in
+http://www.ni.com/white-paper/5696/en
+
+The data are arranged as in the former Python importer (nptdms):
+every group whose name starts with "ai" or "ao" becomes a channel, and
+every TDMS channel of such a group becomes a section. The sampling
+interval is taken from a "Time" group if there is one, and from the
+"Sampling Rate" or "Sampling Rate(AI)" property of the file otherwise.
+*/
+
+#ifndef TDMSLIB_H
+#define TDMSLIB_H
+
+#include "./../stfio.h"
+
+class Recording;
+
+namespace stfio {
+
+//! Open a TDMS file and store its contents to a Recording object.
+/*! The segment metadata are parsed once to build an index of the raw
+ *  data, which are then read in blocks and decoded straight into the
+ *  sections. DAQmx raw data are not supported.
+ *  \param fName The full path to the file to be opened.
+ *  \param ReturnData On entry, an empty Recording object. On exit,
+ *         the data stored in \e fName.
+ *  \param progDlg Progress indicator.
+ *  \param request Channels, sections and data points to be read. Only the
+ *         selected data points are read from the file.
+ */
+void importTDMSFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg,
+                    const importRequest& request = importRequest());
+
+}
+
+#endif
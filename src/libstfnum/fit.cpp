@@ -17,28 +17,60 @@
 
 #include <float.h>
 #include <cmath>
+#include <algorithm>
+#include <sstream>
 
 namespace stfnum {
 // C-style functions for Lourakis' routines:
 void c_func_lour(double *p, double* hx, int m, int n, void *adata);
 void c_jac_lour(double *p, double *j, int m, int n, void *adata);
 
-// Helper functions for lmFit to store the function at global scope:
-void saveFunc(stfnum::Func func);
-void saveJac(stfnum::Jac jac);
-
-// A struct that will be passed as a pointer to
+// The fit context that will be passed as a pointer to
 // Lourakis' C-functions. It is used to:
-// (1) specify which parameters are to be fitted, and
-// (2) pass the constant parameters
-// (3) the sampling interval
+// (1) pass the function and its Jacobian,
+// (2) specify which parameters are to be fitted,
+// (3) pass the constant parameters,
+// (4) the x-values of the data points, and
+// (5) provide scratch memory so that no memory has to be
+//     allocated while iterating.
+// Every call to lmFit owns its context, so that several
+// fits can run concurrently.
 struct fitInfo {
-    fitInfo(const std::deque<bool>& fit_p_arg,
+    fitInfo(const stfnum::storedFunc& fitFunc_arg,
+            const std::deque<bool>& fit_p_arg,
             const Vector_double& const_p_arg,
-            double dt_arg)
-        :   fit_p(fit_p_arg), const_p(const_p_arg),
-            dt(dt_arg)
-    {}
+            double dt, std::size_t n_data)
+        :   fitFunc(fitFunc_arg),
+            fit_p(fit_p_arg), const_p(const_p_arg),
+            x(n_data), p_f(fit_p_arg.size()), jac_f(), work()
+    {
+        for (std::size_t n_x=0; n_x<n_data; ++n_x) {
+            x[n_x] = (double)n_x*dt;
+        }
+        // The derivatives of the constants are only needed
+        // temporarily if there are any constants:
+        if (!const_p.empty()) {
+            jac_f.resize(n_data*fit_p.size());
+        }
+    }
+
+    // Combines the parameters that are fitted (p) with
+    // the constant parameters in p_f:
+    void merge(const double* p) {
+        for (std::size_t n_tp=0, n_p=0, n_f=0; n_tp<fit_p.size(); ++n_tp) {
+            // if the parameter needs to be fitted...
+            if (fit_p[n_tp]) {
+                // ... take it from *p, ...
+                p_f[n_tp] = p[n_p++];
+            } else {
+                // ... otherwise, take it from const_p:
+                p_f[n_tp] = const_p[n_f++];
+            }
+        }
+    }
+
+    // The function and its Jacobian:
+    const stfnum::storedFunc& fitFunc;
 
     // Specifies for each parameter whether the client
     // wants to fit it (true) or to keep it constant (false)
@@ -48,71 +80,45 @@ struct fitInfo {
     // will be kept constant:
     Vector_double const_p;
 
-    // sampling interval
-    double dt;
-};
-}
+    // x-values of the data points:
+    Vector_double x;
 
-// Functions stored at global scope to be called by c_func_lour
-// and c_jac_lour
-stfnum::Func func_lour;
-stfnum::Jac jac_lour; 
+    // All parameters, including constants:
+    Vector_double p_f;
 
-void stfnum::saveFunc(stfnum::Func func) {
-    func_lour=func;
-}
+    // Derivatives of all parameters, including constants:
+    Vector_double jac_f;
 
-void stfnum::saveJac(stfnum::Jac jac) {
-    jac_lour=jac;
+    // Working memory for Lourakis' routines:
+    Vector_double work;
+};
 }
 
 void stfnum::c_func_lour(double *p, double* hx, int m, int n, void *adata) {
     // m: the number of parameters that are to be fitted
-    // adata: pointer to a struct that (1) specifies which parameters are to be fitted
-    //		  and (2) contains the constant parameters
+    // adata: pointer to the fit context
     fitInfo *fInfo=static_cast<fitInfo*>(adata);
-    // total number of parameters, including constants:
-    int tot_p=(int)fInfo->fit_p.size();
-    // all parameters, including constants:
-    Vector_double p_f(tot_p);
-    for (int n_tp=0, n_p=0, n_f=0;n_tp<tot_p;++n_tp) {
-        // if the parameter needs to be fitted...
-        if (fInfo->fit_p[n_tp]) {
-            // ... take it from *p, ...
-            p_f[n_tp] = p[n_p++];
-        } else {
-            // ... otherwise, take it from the fInfo struct:
-            p_f[n_tp] = fInfo->const_p[n_f++];
-        }
-    }
-    for (int n_x=0;n_x<n;++n_x) {
-        hx[n_x]=func_lour( (double)n_x*fInfo->dt, p_f);
-    }	
+    fInfo->merge(p);
+    fInfo->fitFunc.eval(&fInfo->x[0], n, fInfo->p_f, hx);
 }
 
 void stfnum::c_jac_lour(double *p, double *jac, int m, int n, void *adata) {
     // m: the number of parameters that are to be fitted
-    // adata: pointer to a struct that (1) specifies which parameters are to be fitted
-    //		  and (2) contains the constant parameters
+    // adata: pointer to the fit context
     fitInfo *fInfo=static_cast<fitInfo*>(adata);
+    fInfo->merge(p);
+    if (fInfo->jac_f.empty()) {
+        // all parameters are fitted:
+        fInfo->fitFunc.evalJac(&fInfo->x[0], n, fInfo->p_f, jac);
+        return;
+    }
     // total number of parameters, including constants:
     int tot_p=(int)fInfo->fit_p.size();
-    // all parameters, including constants:
-    Vector_double p_f(tot_p);
-    for (int n_tp=0,n_p=0,n_f=0;n_tp<tot_p;++n_tp) {
-        // if the parameter needs to be fitted...
-        if (fInfo->fit_p[n_tp]) {
-            // ... take it from *p, ...
-            p_f[n_tp] = p[n_p++];
-        } else {
-            // ... otherwise, take it from the fInfo struct:
-            p_f[n_tp] = fInfo->const_p[n_f++];
-        }
-    }
-    for (int n_x=0,n_j=0;n_x<n;++n_x) {
-        // jac_f will calculate the derivatives of all parameters,
-        // including the constants...
-        Vector_double jac_f(jac_lour((double)n_x*fInfo->dt,p_f));
+    // jac_f will contain the derivatives of all parameters,
+    // including the constants...
+    fInfo->fitFunc.evalJac(&fInfo->x[0], n, fInfo->p_f, &fInfo->jac_f[0]);
+    const double* jac_f=&fInfo->jac_f[0];
+    for (int n_x=0,n_j=0;n_x<n;++n_x,jac_f+=tot_p) {
         // ... but we only need the derivatives of the non-constants...
         for (int n_tp=0;n_tp<tot_p;++n_tp) {
             // ... hence, we will eliminate the derivatives of the constants:
@@ -197,10 +203,6 @@ double stfnum::lmFit( const Vector_double& data, double dt,
         }
     }
 
-    // Store the functions at global scope:
-    saveFunc(fitFunc.func);
-    saveJac(fitFunc.jac);
-
     double info_id[LM_INFO_SZ];
     Vector_double data_ptr(data);
     Vector_double xyscale(4);
@@ -245,7 +247,14 @@ double stfnum::lmFit( const Vector_double& data, double dt,
     if (can_scale)
         dt_finfo = 1.0/data_ptr.size();
 
-    fitInfo fInfo( p_fit_bool, p_const, dt_finfo );
+    // Allocate working memory once for all passes:
+    int n_data = (int)data.size();
+    fitInfo fInfo( fitFunc, p_fit_bool, p_const, dt_finfo, n_data );
+    std::size_t worksz = LM_DIF_WORKSZ(n_fitted, n_data);
+    if ((std::size_t)LM_BC_DER_WORKSZ(n_fitted, n_data) > worksz) {
+        worksz = LM_BC_DER_WORKSZ(n_fitted, n_data);
+    }
+    fInfo.work.resize(worksz);
 
     // make l-value of opts:
     Vector_double opts_l(5);
@@ -289,22 +298,22 @@ double stfnum::lmFit( const Vector_double& data, double dt,
                 if ( !constrained ) {
                     dlevmar_dif( c_func_lour, &p_toFit[0], &data_ptr[0], n_fitted, 
                             (int)data.size(), (int)opts[4], &opts_l[0], info_id,
-                            NULL, NULL, &fInfo );
+                            &fInfo.work[0], NULL, &fInfo );
                 } else {
                     dlevmar_bc_dif( c_func_lour, &p_toFit[0], &data_ptr[0], n_fitted, 
                             (int)data.size(), &constrains_lm_lb[0], &constrains_lm_ub[0], NULL,
-                            (int)opts[4], &opts_l[0], info_id, NULL, NULL, &fInfo );
+                            (int)opts[4], &opts_l[0], info_id, &fInfo.work[0], NULL, &fInfo );
                 }
             } else {
                 if ( !constrained ) {
                     dlevmar_der( c_func_lour, c_jac_lour, &p_toFit[0], &data_ptr[0], 
                             n_fitted, (int)data.size(), (int)opts[4], &opts_l[0], info_id,
-                            NULL, NULL, &fInfo );                
+                            &fInfo.work[0], NULL, &fInfo );                
                 } else {
                     dlevmar_bc_der( c_func_lour,  c_jac_lour, &p_toFit[0], 
                             &data_ptr[0], n_fitted, (int)data.size(), &constrains_lm_lb[0], 
                             &constrains_lm_ub[0], NULL, (int)opts[4], &opts_l[0], info_id,
-                            NULL, NULL, &fInfo );
+                            &fInfo.work[0], NULL, &fInfo );
                 }
             }
             it++;
@@ -403,6 +412,160 @@ double stfnum::lmFit( const Vector_double& data, double dt,
     return info_id[1];
 }
 
+stfnum::FitJob::FitJob()
+    : data(), dt(1.0), fitFunc(NULL), opts(LM_default_opts()), use_scaling(true), p(),
+      chisqr(0.0), warning(0), info(), warmStarted(false), failed(false), error()
+{}
+
+stfnum::FitJob::FitJob(const Vector_double& data_, double dt_, const stfnum::storedFunc& fitFunc_,
+                       const Vector_double& p_, const Vector_double& opts_, bool use_scaling_)
+    : data(data_), dt(dt_), fitFunc(&fitFunc_), opts(opts_), use_scaling(use_scaling_), p(p_),
+      chisqr(0.0), warning(0), info(), warmStarted(false), failed(false), error()
+{}
+
+namespace stfnum {
+// Fits a single job, starting from p_start; errors are stored in the job:
+void runFitJob(stfnum::FitJob& job, const Vector_double& p_start) {
+    job.p = p_start;
+    job.failed = false;
+    job.error = "";
+    try {
+        if (job.fitFunc == NULL) {
+            throw std::runtime_error("No function to be fitted in stfnum::lmFitBatch");
+        }
+        job.chisqr = lmFit(job.data, job.dt, *job.fitFunc, job.opts, job.use_scaling,
+                           job.p, job.info, job.warning);
+    }
+    catch (const std::exception& e) {
+        job.failed = true;
+        job.error = e.what();
+    }
+}
+
+// Shows the number of finished jobs; sets skipped if the batch was cancelled:
+void updateBatchProgress(stfio::ProgressInfo& progDlg, int n_done, int n_jobs, bool& skipped) {
+    std::ostringstream progStr;
+    progStr << "Fitting job # " << n_done << " of " << n_jobs;
+    progDlg.Update((int)((double)n_done / (double)n_jobs * 100.0), progStr.str(), &skipped);
+}
+}
+
+std::size_t stfnum::lmFitBatch(std::vector<stfnum::FitJob>& jobs, bool warm_start,
+                               stfio::ProgressInfo& progDlg)
+{
+    int n_jobs = (int)jobs.size();
+    if (n_jobs == 0) {
+        return 0;
+    }
+    // Jobs are processed in chains of neighbouring jobs. Without warm start,
+    // every job is a chain of its own so that the load is balanced dynamically:
+    int n_chains = n_jobs;
+    if (warm_start) {
+        n_chains = 1;
+#ifdef _OPENMP
+        n_chains = std::min(omp_get_max_threads(), n_jobs);
+#endif
+    }
+
+    int n_done = 0;
+    bool skipped = false;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic) nowait
+#endif
+    for (int n_c = 0; n_c < n_chains; ++n_c) {
+        int first = (int)((long long)n_c * n_jobs / n_chains);
+        int last = (int)((long long)(n_c+1) * n_jobs / n_chains);
+        const FitJob* prev = NULL;
+        for (int n_j = first; n_j < last; ++n_j) {
+            FitJob& job = jobs[n_j];
+            bool skip;
+#ifdef _OPENMP
+#pragma omp critical(stfnum_batchfit)
+#endif
+            skip = skipped;
+            if (skip) {
+                job.failed = true;
+                job.error = "Skipped";
+                prev = NULL;
+#ifdef _OPENMP
+#pragma omp critical(stfnum_batchfit)
+#endif
+                n_done++;
+                continue;
+            }
+
+            Vector_double p_init(job.p);
+            job.warmStarted = false;
+            if (warm_start && prev != NULL && !prev->failed && prev->warning == 0 &&
+                prev->fitFunc == job.fitFunc && prev->p.size() == job.p.size())
+            {
+                // Only the fitted parameters are taken from the previous solution:
+                Vector_double p_warm(p_init);
+                for (std::size_t n_p = 0; n_p < p_warm.size(); ++n_p) {
+                    if (job.fitFunc->pInfo[n_p].toFit) {
+                        p_warm[n_p] = prev->p[n_p];
+                    }
+                }
+                runFitJob(job, p_warm);
+                job.warmStarted = !job.failed && job.warning == 0;
+            }
+            if (!job.warmStarted) {
+                runFitJob(job, p_init);
+            }
+            prev = &job;
+
+#ifdef _OPENMP
+#pragma omp critical(stfnum_batchfit)
+#endif
+            {
+                n_done++;
+                bool master = true;
+#ifdef _OPENMP
+                // Progress dialogs may only be updated from the calling thread:
+                master = (omp_get_thread_num() == 0);
+#endif
+                if (master) {
+                    updateBatchProgress(progDlg, n_done, n_jobs, skipped);
+                }
+            }
+        }
+    }
+
+#ifdef _OPENMP
+    // The calling thread may run out of chains long before the other threads,
+    // in particular with one chain per thread. It keeps refreshing the progress
+    // dialog, so that the batch can still be cancelled, until all jobs are done:
+    if (omp_get_thread_num() == 0) {
+        double lastUpdate = omp_get_wtime();
+        for (bool done = false; !done; ) {
+            // Don't hold up the other threads' updates by polling too often:
+            if (omp_get_wtime() - lastUpdate < 0.05) {
+                continue;
+            }
+#pragma omp critical(stfnum_batchfit)
+            {
+                done = (n_done == n_jobs);
+                if (!done) {
+                    updateBatchProgress(progDlg, n_done, n_jobs, skipped);
+                }
+            }
+            lastUpdate = omp_get_wtime();
+        }
+    }
+#endif
+    }
+
+    std::size_t n_failed = 0;
+    for (int n_j = 0; n_j < n_jobs; ++n_j) {
+        n_failed += jobs[n_j].failed;
+    }
+    return n_failed;
+}
+
 double stfnum::flin(double x, const Vector_double& p) { return p[0]*x + p[1]; }
 
 //! Dummy function to be passed to stfnum::storedFunc for linear functions.
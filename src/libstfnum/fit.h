@@ -66,6 +66,54 @@ double StfioDll lmFit(const Vector_double& data, double dt,
                       const stfnum::storedFunc& fitFunc, const Vector_double& opts,
                       bool use_scaling, Vector_double& p, std::string& info, int& warning );
 
+//! A non-linear least-squares fit that is run by stfnum::lmFitBatch.
+struct StfioDll FitJob {
+    //! Default constructor.
+    FitJob();
+
+    //! Constructor
+    /*! \param data_ The data to be fitted.
+     *  \param dt_ The sampling interval of \e data_.
+     *  \param fitFunc_ The function to be fitted; has to outlive the job.
+     *  \param p_ Initial parameter guess.
+     *  \param opts_ Options controlling Lourakis' implementation of the algorithm.
+     *  \param use_scaling_ Whether to scale x and y-amplitudes to 1.0
+     */
+    FitJob(const Vector_double& data_, double dt_, const stfnum::storedFunc& fitFunc_,
+           const Vector_double& p_, const Vector_double& opts_, bool use_scaling_=true);
+
+    Vector_double data;                  /*!< The data to be fitted. */
+    double dt;                           /*!< The sampling interval of \e data. */
+    const stfnum::storedFunc* fitFunc;   /*!< The function to be fitted. */
+    Vector_double opts;                  /*!< Options for stfnum::lmFit(). */
+    bool use_scaling;                    /*!< Whether to scale x and y-amplitudes to 1.0 */
+    Vector_double p;                     /*!< Initial guess on entry, best-fit parameters on return. */
+
+    double chisqr;                       /*!< Sum of squared errors of the best fit. */
+    int warning;                         /*!< Warning code as returned by stfnum::lmFit(). */
+    std::string info;                    /*!< Why the fit stopped iterating. */
+    bool warmStarted;                    /*!< True if the fit started from the solution of the previous job. */
+    bool failed;                         /*!< True if the fit threw an exception or was skipped. */
+    std::string error;                   /*!< Error message if \e failed is true. */
+};
+
+//! Runs a batch of independent non-linear least-squares fits concurrently.
+/*! Each job is fitted with stfnum::lmFit(); errors are recorded in the job
+ *  instead of being thrown. With \e warm_start, the jobs are split into one
+ *  contiguous block per thread, and each fit within a block starts from the
+ *  best-fit parameters of the previous job if that one converged with the
+ *  same function. Fixed parameters are always taken from the job itself.
+ *  If a warm-started fit does not converge, it is repeated from the job's
+ *  own initial guess.
+ *  \param jobs The fits to be performed; will contain the results on return.
+ *  \param warm_start Whether to start from the solution of the previous job.
+ *  \param progDlg Progress indicator; only updated from the calling thread,
+ *         which keeps polling it for cancellation until all jobs are done.
+ *  \return The number of jobs that failed.
+ */
+std::size_t StfioDll lmFitBatch(std::vector<stfnum::FitJob>& jobs, bool warm_start,
+                                stfio::ProgressInfo& progDlg);
+
 //! Linear function.
 /*! \f[f(x)=p_0 x + p_1\f]
  *  \param x Function argument.
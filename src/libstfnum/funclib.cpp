@@ -14,6 +14,7 @@
 
 #include <cfloat>
 #include <cmath>
+#include <algorithm>
 #include <sstream>
 
 #include "./fit.h"
@@ -25,12 +26,14 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     
     // Monoexponential function, free fit:
     std::vector<stfnum::parInfo> parInfoMExp=getParInfoExp(1);
-    funcList.push_back(stfnum::storedFunc("Monoexponential",parInfoMExp,fexp,fexp_init,fexp_jac,true));
+    funcList.push_back(stfnum::storedFunc("Monoexponential",parInfoMExp,fexp,fexp_init,fexp_jac,true,
+                                         defaultOutput,fexp_batch,fexp_jac_batch));
 
     // Monoexponential function, offset fixed to baseline:
     parInfoMExp[2].toFit=false;
     funcList.push_back(stfnum::storedFunc("Monoexponential, offset fixed to baseline",
-                                         parInfoMExp,fexp,fexp_init,fexp_jac,true));
+                                         parInfoMExp,fexp,fexp_init,fexp_jac,true,
+                                         defaultOutput,fexp_batch,fexp_jac_batch));
 
     // Monoexponential function, starting with a delay, start fixed to baseline:
     std::vector<stfnum::parInfo> parInfoMExpDe(4);
@@ -39,17 +42,20 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoMExpDe[2].toFit=true; parInfoMExpDe[2].desc="tau"; parInfoMExpDe[0].scale=stfnum::xscale; parInfoMExpDe[0].unscale=stfnum::xunscale;
     parInfoMExpDe[3].toFit=true; parInfoMExpDe[3].desc="Peak"; parInfoMExpDe[0].scale=stfnum::yscale; parInfoMExpDe[0].unscale=stfnum::yunscale;
     funcList.push_back(stfnum::storedFunc("Monoexponential with delay, start fixed to baseline",
-                                         parInfoMExpDe,fexpde,fexpde_init,stfnum::nojac,false));
+                                         parInfoMExpDe,fexpde,fexpde_init,stfnum::nojac,false,
+                                         defaultOutput,fexpde_batch));
 
     // Biexponential function, free fit:
     std::vector<stfnum::parInfo> parInfoBExp=getParInfoExp(2);
     funcList.push_back(stfnum::storedFunc(
-                                       "Biexponential",parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                       "Biexponential",parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau,
+                                       fexp_batch,fexp_jac_batch));
 
     // Biexponential function, offset fixed to baseline:
     parInfoBExp[4].toFit=false;
     funcList.push_back(stfnum::storedFunc("Biexponential, offset fixed to baseline",
-                                         parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                         parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau,
+                                         fexp_batch,fexp_jac_batch));
 
     // Biexponential function, starting with a delay, start fixed to baseline:
     std::vector<stfnum::parInfo> parInfoBExpDe(5);
@@ -63,21 +69,25 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     // parInfoBExpDe[4].constrained = true; parInfoBExpDe[4].constr_lb = 1.0e-16; parInfoBExpDe[4].constr_ub = DBL_MAX;
     funcList.push_back(stfnum::storedFunc(
                                        "Biexponential with delay, start fixed to baseline, delay constrained to > 0",
-                                       parInfoBExpDe,fexpbde,fexpbde_init,stfnum::nojac,false));
+                                       parInfoBExpDe,fexpbde,fexpbde_init,stfnum::nojac,false,
+                                       defaultOutput,fexpbde_batch));
 
     // Triexponential function, free fit:
     std::vector<stfnum::parInfo> parInfoTExp=getParInfoExp(3);
     funcList.push_back(stfnum::storedFunc(
-                                       "Triexponential",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                       "Triexponential",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau,
+                                       fexp_batch,fexp_jac_batch));
 
     // Triexponential function, free fit, different initialization:
     funcList.push_back(stfnum::storedFunc(
-                                       "Triexponential, initialize for PSCs/PSPs",parInfoTExp,fexp,fexp_init2,fexp_jac,true,outputWTau));
+                                       "Triexponential, initialize for PSCs/PSPs",parInfoTExp,fexp,fexp_init2,fexp_jac,true,outputWTau,
+                                       fexp_batch,fexp_jac_batch));
 
     // Triexponential function, offset fixed to baseline:
     parInfoTExp[6].toFit=false;
     funcList.push_back(stfnum::storedFunc(
-                                       "Triexponential, offset fixed to baseline",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                       "Triexponential, offset fixed to baseline",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau,
+                                       fexp_batch,fexp_jac_batch));
 
     // Alpha function:
     std::vector<stfnum::parInfo> parInfoAlpha(3);
@@ -85,7 +95,8 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoAlpha[1].toFit=true; parInfoAlpha[1].desc="Rate";
     parInfoAlpha[2].toFit=true; parInfoAlpha[2].desc="Offset";
     funcList.push_back(stfnum::storedFunc(
-                                       "Alpha function", parInfoAlpha,falpha,falpha_init,falpha_jac,true));
+                                       "Alpha function", parInfoAlpha,falpha,falpha_init,falpha_jac,true,
+                                       defaultOutput,falpha_batch,falpha_jac_batch));
 
     // HH gNa function:
     std::vector<stfnum::parInfo> parInfoHH(4);
@@ -94,11 +105,13 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoHH[2].toFit=true; parInfoHH[2].desc="tau_h";
     parInfoHH[3].toFit=false; parInfoHH[3].desc="offset";
     funcList.push_back(stfnum::storedFunc(
-                                         "Hodgkin-Huxley g_Na function, offset fixed to baseline", parInfoHH, fHH, fHH_init, stfnum::nojac, false));
+                                         "Hodgkin-Huxley g_Na function, offset fixed to baseline", parInfoHH, fHH, fHH_init, stfnum::nojac, false,
+                                         defaultOutput, fHH_batch));
 
     // power of 1 gNa function:
     funcList.push_back(stfnum::storedFunc(
-                                         "power of 1 g_Na function, offset fixed to baseline", parInfoHH, fgnabiexp, fgnabiexp_init, fgnabiexp_jac, true));
+                                         "power of 1 g_Na function, offset fixed to baseline", parInfoHH, fgnabiexp, fgnabiexp_init, fgnabiexp_jac, true,
+                                         defaultOutput, fgnabiexp_batch, fgnabiexp_jac_batch));
 
     // Gaussian
     std::vector<stfnum::parInfo> parInfoGauss(3);
@@ -110,7 +123,8 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoGauss[2].desc="width"; parInfoGauss[2].scale = stfnum::xscale; parInfoGauss[2].unscale = stfnum::xunscale;
 
     funcList.push_back(stfnum::storedFunc(
-                                       "Gaussian", parInfoGauss, fgauss, fgauss_init, fgauss_jac, true));
+                                       "Gaussian", parInfoGauss, fgauss, fgauss_init, fgauss_jac, true,
+                                       defaultOutput, fgauss_batch, fgauss_jac_batch));
 
     // Triexponential function, starting with a delay, start fixed to baseline:
     std::vector<stfnum::parInfo> parInfoTExpDe(7);
@@ -125,7 +139,8 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoTExpDe[6].toFit=true;  parInfoTExpDe[6].desc="ptau1b"; parInfoTExpDe[6].scale=stfnum::noscale; parInfoTExpDe[6].unscale=stfnum::noscale;
     funcList.push_back(stfnum::storedFunc(
                                        "Triexponential with delay, start fixed to baseline, delay constrained to > 0",
-                                       parInfoTExpDe,fexptde,fexptde_init,stfnum::nojac,false));
+                                       parInfoTExpDe,fexptde,fexptde_init,stfnum::nojac,false,
+                                       defaultOutput,fexptde_batch));
 
     return funcList;
 }
@@ -150,6 +165,35 @@ Vector_double stfnum::fexp_jac(double x, const Vector_double& p) {
     return jac;
 }
 
+void stfnum::fexp_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    std::fill(out, out+n, 0.0);
+    for (std::size_t n_p=0;n_p<p.size()-1;n_p+=2) {
+        const double amp=p[n_p], tau=p[n_p+1];
+        for (std::size_t n_x=0;n_x<n;++n_x) {
+            out[n_x]+=amp*exp(-x[n_x]/tau);
+        }
+    }
+    const double offset=p[p.size()-1];
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        out[n_x]+=offset;
+    }
+}
+
+void stfnum::fexp_jac_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    const std::size_t np=p.size();
+    for (std::size_t n_p=0;n_p<np-1;n_p+=2) {
+        const double amp=p[n_p], tau=p[n_p+1];
+        for (std::size_t n_x=0;n_x<n;++n_x) {
+            double e=exp(-x[n_x]/tau);
+            out[n_x*np+n_p]=e;
+            out[n_x*np+n_p+1]=amp*x[n_x]*e/(tau*tau);
+        }
+    }
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        out[n_x*np+np-1]=1.0;
+    }
+}
+
 void stfnum::fexp_init(const Vector_double& data, double base, double peak, double RTLoHi, double HalfWidth, double dt, Vector_double& pInit ) {
     // Find out direction:
     bool increasing = data[0] < data[data.size()-1];
@@ -244,6 +288,13 @@ double stfnum::fexpde(double x, const Vector_double& p) {
     }
 }
 
+void stfnum::fexpde_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        double e1=exp((p[1]-x[n_x])/p[2]);
+        out[n_x] = x[n_x]<p[1] ? p[0] : (p[0]-p[3])*e1 + p[3];
+    }
+}
+
 #if 0
 Vector_double stfnum::fexpde_jac(double x, const Vector_double& p) {
     Vector_double jac(4);
@@ -287,6 +338,14 @@ double stfnum::fexpbde(double x, const Vector_double& p) {
     }
 }
 
+void stfnum::fexpbde_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        double e1=exp((p[1]-x[n_x])/p[2]);
+        double e2=exp((p[1]-x[n_x])/p[4]);
+        out[n_x] = x[n_x]<p[1] ? p[0] : p[3]*e1 - p[3]*e2 + p[0];
+    }
+}
+
 double stfnum::fexptde(double x, const Vector_double& p) {
     if (x<p[1]) {
         return p[0];
@@ -301,6 +360,15 @@ double stfnum::fexptde(double x, const Vector_double& p) {
     }
 }
 
+void stfnum::fexptde_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        double e1=exp((p[1]-x[n_x])/p[2]);
+        double e2=exp((p[1]-x[n_x])/p[4]);
+        double e3=exp((p[1]-x[n_x])/p[5]);
+        out[n_x] = x[n_x]<p[1] ? p[0] : p[6]*p[3]*e1 + (1.0-p[6])*p[3]*e3 - p[3]*e2 + p[0];
+    }
+}
+
 #if 0
 Vector_double stfnum::fexpbde_jac(double x, const Vector_double& p) {
     Vector_double jac(5);
@@ -388,6 +456,20 @@ Vector_double stfnum::falpha_jac(double x, const Vector_double& p) {
     return jac;
 }
 
+void stfnum::falpha_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        out[n_x] = p[0]*x[n_x]/p[1]*exp(1-x[n_x]/p[1]) + p[2];
+    }
+}
+
+void stfnum::falpha_jac_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    for (std::size_t n_x=0;n_x<n;++n_x, out+=3) {
+        out[0] = x[n_x]*exp(1-x[n_x]/p[1])/p[1];
+        out[1] = out[0]*( x[n_x]*p[0]/(p[1]*p[1]) - p[0]/p[1] );
+        out[2] = 1.0;
+    }
+}
+
 void stfnum::falpha_init(const Vector_double& data, double base, double peak, double RTLoHi, double HalfWidth, double dt, Vector_double& pInit ) {
         double maxT = stfnum::whereis( data, peak )*dt;
 
@@ -410,6 +492,14 @@ double stfnum::fHH(double x, const Vector_double& p) {
     return p[0] * (m*m*m) * h + p[3];
 }
 
+void stfnum::fHH_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        double m = 1 - exp(-x[n_x]/p[1]);
+        double h = exp(-x[n_x]/p[2]);
+        out[n_x] = p[0] * (m*m*m) * h + p[3];
+    }
+}
+
 double stfnum::fgnabiexp(double x, const Vector_double& p) {
     // p[0]: gprime_na
     // p[1]: tau_m
@@ -420,6 +510,14 @@ double stfnum::fgnabiexp(double x, const Vector_double& p) {
     return p[0] * m * h + p[3];
 }
 
+void stfnum::fgnabiexp_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        double m = 1-exp(-x[n_x]/p[1]);
+        double h = exp(-x[n_x]/p[2]);
+        out[n_x] = p[0] * m * h + p[3];
+    }
+}
+
 double stfnum::fgauss(double x, const Vector_double& pars) {
     double y=0.0, /* fac=0.0, */ ex=0.0, arg=0.0;
     int npars=static_cast<int>(pars.size());
@@ -432,6 +530,17 @@ double stfnum::fgauss(double x, const Vector_double& pars) {
     return y;
 }
 
+void stfnum::fgauss_batch(const double* x, std::size_t n, const Vector_double& pars, double* out) {
+    std::fill(out, out+n, 0.0);
+    int npars=static_cast<int>(pars.size());
+    for (int i=0; i < npars-1; i += 3) {
+        for (std::size_t n_x=0;n_x<n;++n_x) {
+            double arg=(x[n_x]-pars[i+1])/pars[i+2];
+            out[n_x] += pars[i] * exp(-arg*arg);
+        }
+    }
+}
+
 Vector_double stfnum::fgauss_jac(double x, const Vector_double& pars) {
     double ex=0.0, arg=0.0;
     int npars=static_cast<int>(pars.size());
@@ -446,6 +555,21 @@ Vector_double stfnum::fgauss_jac(double x, const Vector_double& pars) {
     return jac;
 }
 
+void stfnum::fgauss_jac_batch(const double* x, std::size_t n, const Vector_double& pars, double* out) {
+    int npars=static_cast<int>(pars.size());
+    std::fill(out, out+n*npars, 0.0);
+    for (int i=0; i < npars-1; i += 3) {
+        for (std::size_t n_x=0;n_x<n;++n_x) {
+            double* jac=&out[n_x*npars];
+            double arg=(x[n_x]-pars[i+1])/pars[i+2];
+            double ex=exp(-arg*arg);
+            jac[i] = ex;
+            jac[i+1] = 2.0*ex*pars[i]*(x[n_x]-pars[i+1]) / (pars[i+2]*pars[i+2]);
+            jac[i+2] = 2.0*ex*pars[i]*(x[n_x]-pars[i+1])*(x[n_x]-pars[i+1]) / (pars[i+2]*pars[i+2]*pars[i+2]);
+        }
+    }
+}
+
 void stfnum::fgauss_init(const Vector_double& data, double base, double peak, double RTLoHi, double HalfWidth, double dt, Vector_double& pInit ) {
     // Find the peak position in data:
     double maxT = stfnum::whereis( data, peak ) * dt;
@@ -488,6 +612,15 @@ Vector_double stfnum::fgnabiexp_jac(double x, const Vector_double& p) {
     return jac;
 }
 
+void stfnum::fgnabiexp_jac_batch(const double* x, std::size_t n, const Vector_double& p, double* out) {
+    for (std::size_t n_x=0;n_x<n;++n_x, out+=4) {
+        out[0] = ( 1-exp(-x[n_x]/p[1]) ) * exp(-x[n_x]/p[2]);
+        out[1] = -p[0] * x[n_x] * exp(-x[n_x]/p[1] - x[n_x]/p[2])  /(p[1]*p[1]);
+        out[2] = p[0] * x[n_x] * ( 1-exp(-x[n_x]/p[1]) ) * exp(-x[n_x]/p[2]) / (p[2]*p[2]);
+        out[3] = 1.0;
+    }
+}
+
 void stfnum::fgnabiexp_init(const Vector_double& data, double base, double peak, double RTLoHi, double HalfWidth, double dt, Vector_double& pInit ) {
     // Find the peak position in data:
     double maxT = stfnum::whereis( data, peak );
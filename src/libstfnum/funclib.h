@@ -63,6 +63,14 @@ namespace stfnum {
      */
     Vector_double fexp_jac(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fexp() at \e n x-values at once.
+    /*! See stfnum::BatchFunc. */
+    void fexp_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
+    //! Evaluates stfnum::fexp_jac() at \e n x-values at once.
+    /*! See stfnum::BatchJac. */
+    void fexp_jac_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
     //! Initialises parameters for fitting stfnum::fexp() to \e data.
     /*! This needs to be made more robust.
      *  \param data The waveform of the data for the fit.
@@ -106,6 +114,10 @@ namespace stfnum {
      */
     double fexpde(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fexpde() at \e n x-values at once.
+    /*! See stfnum::BatchFunc. */
+    void fexpde_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
 #if 0
     //! Computes the Jacobian of stfnum::fexpde().
     /*! \f{eqnarray*}
@@ -175,6 +187,10 @@ namespace stfnum {
      */
     double fexpbde(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fexpbde() at \e n x-values at once.
+    /*! See stfnum::BatchFunc. */
+    void fexpbde_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
     //! Triexponential function with delay. 
     /*! \f{eqnarray*}
      *      f(x)=
@@ -196,6 +212,10 @@ namespace stfnum {
      */
     double fexptde(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fexptde() at \e n x-values at once.
+    /*! See stfnum::BatchFunc. */
+    void fexptde_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
 #if 0
     //! Computes the Jacobian of stfnum::fexpde().
     /*! \f{eqnarray*}
@@ -284,6 +304,14 @@ namespace stfnum {
      *          \e j[2] contains the derivative with respect to \e p[2].
      */
     Vector_double falpha_jac(double x, const Vector_double& p);
+
+    //! Evaluates stfnum::falpha() at \e n x-values at once.
+    /*! See stfnum::BatchFunc. */
+    void falpha_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
+    //! Evaluates stfnum::falpha_jac() at \e n x-values at once.
+    /*! See stfnum::BatchJac. */
+    void falpha_jac_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
     
     //! Hodgkin-Huxley sodium conductance function.
     /*! \f[f(x)=p_0\left(1-\mathrm{e}^{\frac{-x}{p_1}}\right)^3\mathrm{e}^{\frac{-x}{p_2}} + p_3\f]
@@ -297,6 +325,10 @@ namespace stfnum {
      */
     double fHH(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fHH() at \e n x-values at once.
+    /*! See stfnum::BatchFunc. */
+    void fHH_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
     //! Computes the sum of an arbitrary number of Gaussians.
     /*! \f[
      *      f(x) = \sum_{i=0}^{n-1}p_{3i}\mathrm{e}^{- \left( \frac{x-p_{3i+1}}{p_{3i+2}} \right) ^2}
@@ -316,6 +348,14 @@ namespace stfnum {
     //! Computes the Jacobian of a sum of Gaussians.
     Vector_double fgauss_jac(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fgauss() at \e n x-values at once.
+    /*! See stfnum::BatchFunc. */
+    void fgauss_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
+    //! Evaluates stfnum::fgauss_jac() at \e n x-values at once.
+    /*! See stfnum::BatchJac. */
+    void fgauss_jac_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
     //! power of 1 sodium conductance function.
     /*! \f[f(x)=p_0\left(1-\mathrm{e}^{\frac{-x}{p_1}}\right)\mathrm{e}^{\frac{-x}{p_2}} + p_3\f]
      *  \param x Function argument.
@@ -356,6 +396,14 @@ namespace stfnum {
      */
     Vector_double fgnabiexp_jac(double x, const Vector_double& p);
 
+    //! Evaluates stfnum::fgnabiexp() at \e n x-values at once.
+    /*! See stfnum::BatchFunc. */
+    void fgnabiexp_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
+    //! Evaluates stfnum::fgnabiexp_jac() at \e n x-values at once.
+    /*! See stfnum::BatchJac. */
+    void fgnabiexp_jac_batch(const double* x, std::size_t n, const Vector_double& p, double* out);
+
     //! Initialises parameters for fitting stfnum::falpha() to \e data.
     /*! \param data The waveform of the data for the fit.
      *  \param base Baseline of \e data.
@@ -28,7 +28,11 @@
 
 
 #ifdef LINSOLVERS_RETAIN_MEMORY
+#ifdef LM_THREAD_LOCAL
+#define __STATIC__ static LM_THREAD_LOCAL
+#else
 #define __STATIC__ static
+#endif
 #else
 #define __STATIC__ // empty
 #endif /* LINSOLVERS_RETAIN_MEMORY */
@@ -118,7 +122,11 @@ int AX_EQ_B_QR(LM_REAL *A, LM_REAL *B, LM_REAL *x, int m)
 __STATIC__ LM_REAL *buf=NULL;
 __STATIC__ int buf_sz=0;
 
+#ifdef LM_THREAD_LOCAL
+static LM_THREAD_LOCAL int nb=0; /* no __STATIC__ decl. here! */
+#else
 static int nb=0; /* no __STATIC__ decl. here! */
+#endif
 
 LM_REAL *a, *tau, *r, *work;
 int a_sz, tau_sz, r_sz, tot_sz;
@@ -277,7 +285,11 @@ int AX_EQ_B_QRLS(LM_REAL *A, LM_REAL *B, LM_REAL *x, int m, int n)
 __STATIC__ LM_REAL *buf=NULL;
 __STATIC__ int buf_sz=0;
 
+#ifdef LM_THREAD_LOCAL
+static LM_THREAD_LOCAL int nb=0; /* no __STATIC__ decl. here! */
+#else
 static int nb=0; /* no __STATIC__ decl. here! */
+#endif
 
 LM_REAL *a, *tau, *r, *work;
 int a_sz, tau_sz, r_sz, tot_sz;
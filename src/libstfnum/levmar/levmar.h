@@ -37,12 +37,22 @@
                       
 /* to avoid the overhead of repeated mallocs(), routines in Axb.c can be instructed to
  * retain working memory between calls. Such a choice, however, renders these routines
- * non-reentrant and is not safe in a shared memory multiprocessing environment.
+ * non-reentrant and is not safe in a shared memory multiprocessing environment, unless
+ * the memory is retained per thread (LM_THREAD_LOCAL, see below).
  * Bellow, an attempt is made to issue a warning if this option is turned on and OpenMP
- * is being used (note that this will work only if omp.h is included before levmar.h)
+ * is being used without thread-local storage (note that this will work only if omp.h
+ * is included before levmar.h)
  */
 #define LINSOLVERS_RETAIN_MEMORY
-#if (defined(_OPENMP))
+
+/* storage class for the working memory retained by the routines in Axb.c */
+#if defined(_MSC_VER)
+#define LM_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__ICC) || defined(__INTEL_COMPILER)
+#define LM_THREAD_LOCAL __thread
+#endif
+
+#if (defined(_OPENMP)) && !defined(LM_THREAD_LOCAL)
 # ifdef LINSOLVERS_RETAIN_MEMORY
 #  ifdef _MSC_VER
 #  pragma message("LINSOLVERS_RETAIN_MEMORY is not safe in a multithreaded environment and should be turned off!")
@@ -26,6 +26,12 @@
  */
 
 #include <stdexcept>
+#include <algorithm>
+#if (__cplusplus < 201103)
+#  include <boost/exception_ptr.hpp>
+#else
+#  include <exception>
+#endif
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -33,12 +39,238 @@
 #include "./stfnum.h"
 #include "./measure.h"
 
-int compareDouble(const void *a, const void *b)
+namespace {
+
+// Puts the values at the sorted positions [pfirst, plast) of a into place.
+void selectPositions(double* a, std::size_t first, std::size_t last,
+                     const std::size_t* pfirst, const std::size_t* plast)
+{
+    if (pfirst == plast)
+        return;
+    const std::size_t* mid = pfirst + (plast-pfirst)/2;
+    std::nth_element(a+first, a+*mid, a+last);
+    selectPositions(a, first, *mid, pfirst, mid);
+    selectPositions(a, *mid+1, last, mid+1, plast);
+}
+
+}
+
+double stfnum::OrderStatistics::median(const double* first, const double* last, double& iqr)
+{
+    if (last <= first) {
+        iqr = NAN;
+        return NAN;
+    }
+    std::size_t n = last - first;
+    scratch.assign(first, last);
+    double* a = &scratch[0];
+
+    // median and lower and upper bounds of both quartiles, with indices
+    // within [0,n-1]:
+    std::size_t m1 = (n-1)/2, m2 = n/2;
+    std::size_t q3a = std::min<long>((long)(n-1), (long)ceil(3*n/4.0-1));
+    std::size_t q3b = std::max<long>(0l, (long)floor(3*n/4.0-1));
+    std::size_t q1a = std::min<long>((long)(n-1), (long)ceil(  n/4.0-1));
+    std::size_t q1b = std::max<long>(0l, (long)floor(  n/4.0-1));
+
+    std::size_t pos[6] = {m1, m2, q3a, q3b, q1a, q1b};
+    std::sort(pos, pos+6);
+    std::size_t npos = std::unique(pos, pos+6) - pos;
+    selectPositions(a, 0, n, pos, pos+npos);
+
+    iqr = ((a[q3a] + a[q3b]) - (a[q1a] + a[q1b])) / 2;
+    if (n % 2)
+        return a[m2];
+    return (a[m1] + a[m2]) / 2;
+}
+
+void stfnum::OrderStatistics::setLower(std::size_t pos, std::size_t slot)
+{
+    lower[pos] = slot;
+    heapPos[slot] = 2*pos;
+}
+
+void stfnum::OrderStatistics::setUpper(std::size_t pos, std::size_t slot)
+{
+    upper[pos] = slot;
+    heapPos[slot] = 2*pos+1;
+}
+
+void stfnum::OrderStatistics::siftLower(std::size_t pos)
+{
+    std::size_t slot = lower[pos];
+    double value = scratch[slot];
+    while (pos > 0 && scratch[lower[(pos-1)/2]] < value) {
+        setLower(pos, lower[(pos-1)/2]);
+        pos = (pos-1)/2;
+    }
+    for (;;) {
+        std::size_t child = 2*pos+1;
+        if (child >= lower.size())
+            break;
+        if (child+1 < lower.size() && scratch[lower[child+1]] > scratch[lower[child]])
+            ++child;
+        if (!(value < scratch[lower[child]]))
+            break;
+        setLower(pos, lower[child]);
+        pos = child;
+    }
+    setLower(pos, slot);
+}
+
+void stfnum::OrderStatistics::siftUpper(std::size_t pos)
+{
+    std::size_t slot = upper[pos];
+    double value = scratch[slot];
+    while (pos > 0 && scratch[upper[(pos-1)/2]] > value) {
+        setUpper(pos, upper[(pos-1)/2]);
+        pos = (pos-1)/2;
+    }
+    for (;;) {
+        std::size_t child = 2*pos+1;
+        if (child >= upper.size())
+            break;
+        if (child+1 < upper.size() && scratch[upper[child+1]] < scratch[upper[child]])
+            ++child;
+        if (!(value > scratch[upper[child]]))
+            break;
+        setUpper(pos, upper[child]);
+        pos = child;
+    }
+    setUpper(pos, slot);
+}
+
+void stfnum::OrderStatistics::pushLower(std::size_t slot)
+{
+    lower.push_back(slot);
+    siftLower(lower.size()-1);
+}
+
+void stfnum::OrderStatistics::pushUpper(std::size_t slot)
+{
+    upper.push_back(slot);
+    siftUpper(upper.size()-1);
+}
+
+void stfnum::OrderStatistics::popLower()
+{
+    std::size_t last = lower.back();
+    lower.pop_back();
+    if (!lower.empty()) {
+        lower[0] = last;
+        siftLower(0);
+    }
+}
+
+void stfnum::OrderStatistics::popUpper()
+{
+    std::size_t last = upper.back();
+    upper.pop_back();
+    if (!upper.empty()) {
+        upper[0] = last;
+        siftUpper(0);
+    }
+}
+
+void stfnum::OrderStatistics::erase(std::size_t slot)
 {
-    return ( ( *(double*)a >  *(double*)b ) - ( *(double*)a < *(double*)b ) );
+    std::size_t pos = heapPos[slot] / 2;
+    if (heapPos[slot] % 2 == 0) {
+        std::size_t last = lower.back();
+        lower.pop_back();
+        if (pos < lower.size()) {
+            lower[pos] = last;
+            siftLower(pos);
+        }
+    } else {
+        std::size_t last = upper.back();
+        upper.pop_back();
+        if (pos < upper.size()) {
+            upper[pos] = last;
+            siftUpper(pos);
+        }
+    }
+    // rebalance:
+    if (lower.size() < upper.size()) {
+        std::size_t top = upper[0];
+        popUpper();
+        pushLower(top);
+    } else if (lower.size() > upper.size()+1) {
+        std::size_t top = lower[0];
+        popLower();
+        pushUpper(top);
+    }
+}
+
+void stfnum::OrderStatistics::insert(std::size_t slot, double value)
+{
+    scratch[slot] = value;
+    if (lower.empty() || value <= scratch[lower[0]]) {
+        pushLower(slot);
+        if (lower.size() > upper.size()+1) {
+            std::size_t top = lower[0];
+            popLower();
+            pushUpper(top);
+        }
+    } else {
+        pushUpper(slot);
+        if (upper.size() > lower.size()) {
+            std::size_t top = upper[0];
+            popUpper();
+            pushLower(top);
+        }
+    }
+}
+
+void stfnum::OrderStatistics::runningMedian(const double* data, std::size_t n, std::size_t width, double* out)
+{
+    if (width == 0) {
+        throw std::out_of_range("Width of the running median has to be at least one sampling point");
+    }
+    if (n == 0)
+        return;
+    std::size_t w = std::min(width, n);
+    scratch.resize(w);
+    heapPos.resize(w);
+    lower.clear();
+    upper.clear();
+    lower.reserve(w/2+2);
+    upper.reserve(w/2+2);
+    for (std::size_t i = 0; i < w; ++i) {
+        insert(i, data[i]);
+    }
+    // data[i] lives in slot i%w, and is replaced by data[i+w]:
+    for (std::size_t i = 0, slot = 0; i < n; ++i) {
+        if (lower.size() > upper.size())
+            out[i] = scratch[lower[0]];
+        else
+            out[i] = (scratch[lower[0]] + scratch[upper[0]]) / 2;
+        erase(slot);
+        if (i+w < n)
+            insert(slot, data[i+w]);
+        if (++slot == w)
+            slot = 0;
+    }
+}
+
+Vector_double stfnum::runningMedian(const Vector_double& data, std::size_t width)
+{
+    Vector_double out(data.size());
+    if (!data.empty()) {
+        OrderStatistics stats;
+        stats.runningMedian(&data[0], data.size(), width, &out[0]);
+    }
+    return out;
 }
 
 double stfnum::base(enum stfnum::baseline_method base_method, double& var, const std::vector<double>& data, std::size_t llb, std::size_t ulb)
+{
+    OrderStatistics stats;
+    return base(base_method, var, data, llb, ulb, stats);
+}
+
+double stfnum::base(enum stfnum::baseline_method base_method, double& var, const std::vector<double>& data, std::size_t llb, std::size_t ulb,
+                    OrderStatistics& stats)
 {
     if (data.size()==0) return 0;
     if (llb>ulb || ulb>=data.size()) {
@@ -50,41 +282,17 @@ double stfnum::base(enum stfnum::baseline_method base_method, double& var, const
     assert(n <= data.size());
 
     if (base_method == stfnum::median_iqr) {
-	// make  copy of the data for sorting
-        double *a = (double*)malloc(n * sizeof(double));
-        for (size_t i = 0; i < n; ++i) {
-            a[i] = data[i + llb];
-        }
-        qsort(a,n,sizeof(double),&compareDouble);
-
-	// get the median
-        if (n % 2)
-            base = a[(n-1)/2];
-        else {
-            n /=2;
-            base = (a[n-1] + a[n]) / 2;
-        }
-
-        /*
-         *  compute inter-quartile range (IQR) and return in "var"
-         *  interpolate as average of upper and lower bound
-         *  and make sure that indices are within [0,n-1] interval
-         */
-	double Q32 = a[std::min<long>((long)(n-1), (long)ceil(3*n/4.0-1))] + a[std::max<long>(0l, (long)floor(3*n/4.0-1))];
-	double Q12 = a[std::min<long>((long)(n-1), (long)ceil(  n/4.0-1))] + a[std::max<long>(0l, (long)floor(  n/4.0-1))];
-	var = (Q32 - Q12) / 2;
-
-        free(a);
-        return base;
+        // median and inter-quartile range (IQR), which is returned in "var"
+        return stats.median(&data[llb], &data[ulb]+1, var);
     }
     // else  if (method == mean_baseline)
 
     double sumY=0.0;
     //according to the pascal version, every value 
-    //within the window shall be summed up:
-#ifdef _OPENMP
-#pragma omp parallel for reduction(+:sumY)
-#endif
+    //within the window shall be summed up.
+    //The sums are computed serially, in a fixed order, so that the results
+    //don't depend on the number of threads; sections are measured in
+    //parallel by the callers instead (see MeasurementPlan):
     for (int i=(int)llb; i<=(int)ulb;++i) {
         sumY+=data[i];
     }
@@ -93,9 +301,6 @@ double stfnum::base(enum stfnum::baseline_method base_method, double& var, const
     // second pass to calculate the variance:
     double varS=0.0;
     double corr=0.0;
-#ifdef _OPENMP
-#pragma omp parallel for reduction(+:varS,corr)
-#endif
     for (int i=(int)llb; i<=(int)ulb;++i) {
         double diff=data[i]-base;
         varS+=diff*diff;
@@ -158,9 +363,7 @@ double stfnum::peak(const std::vector<double>& data, double base, std::size_t ll
     } else {
         if (pM==-1) { // calculate the average within the peak window
             double sumY=0; 
-#ifdef _OPENMP
-#pragma omp parallel for reduction(+:sumY)
-#endif
+            // summed in a fixed order, as in base():
             for (int i=(int)llp; i<=(int)ulp;++i) {
                 sumY+=data[i];
             }
@@ -312,21 +515,20 @@ double stfnum::risetime2(const std::vector<double>& data, double base, double am
 	fprintf(stdout,"%s %i:RISETIME2\n",__FILE__,__LINE__);
 #endif
 
+    // a single pass finds the last indices below and the first indices
+    // above both limits:
+    double absLo = fabs(lo*ampl), absHi = fabs(hi*ampl);
     for (k=(long)left; k<=(long)right; k++) {
 		double v = fabs(data[k]-base);
-		if (v < fabs(lo*ampl)) inner_tLoId = k;
-		if (v < fabs(hi*ampl)) outer_tHiId = k;
+		if (v < absLo) inner_tLoId = k;
+		if (v < absHi) outer_tHiId = k;
+		if (v > absLo && outer_tLoId < 0) outer_tLoId = k;
+		if (v > absHi && inner_tHiId < 0) inner_tHiId = k;
     }
 #ifndef NDEBUG
 	fprintf(stdout,"%s %i:RISETIME2 r:%f l:%f \n",__FILE__,__LINE__,right,left);
 #endif
 
-    for (k=(long)right; k>=(long)left; k--) {
-		double v = fabs(data[k]-base);
-		if (v > fabs(lo*ampl)) outer_tLoId = k;
-		if (v > fabs(hi*ampl)) inner_tHiId = k;
-    }
-
 #ifndef NDEBUG
 	fprintf(stdout,"%s %i:RISETIME2: %i %i %i %i\n",__FILE__,__LINE__,(int)outer_tLoId,(int)inner_tLoId,(int)inner_tHiId,(int)outer_tHiId);
 #endif
@@ -544,4 +746,370 @@ double stfnum::pslope(const std::vector<double>& data, std::size_t left, std::si
 }
 #endif // WITH_PSLOPE
 
+namespace {
+
+#if (__cplusplus < 201103)
+typedef boost::exception_ptr exception_ptr;
+using boost::current_exception;
+using boost::rethrow_exception;
+#else
+typedef std::exception_ptr exception_ptr;
+using std::current_exception;
+using std::rethrow_exception;
+#endif
+
+// Average of pM points around data[i], as in stfnum::peak().
+inline double boxcar(const double* data, int n, std::size_t i, int pM, int half)
+{
+    double peak=0.0;
+    int start = i-half;
+    if (start < 0)
+        start = 0;
+    int counter;
+    for (counter=start; counter <= start+pM-1 && counter < n; counter++)
+        peak+=data[counter];
+    return peak / (counter-start);
+}
+
+// true if peak is further away from base than max in direction dir.
+inline bool exceeds(stfnum::direction dir, double peak, double max, double base)
+{
+    switch (dir) {
+    case stfnum::both: return fabs(peak-base) > fabs (max-base);
+    case stfnum::up: return peak-base > max-base;
+    case stfnum::down: return peak-base < max-base;
+    default: return false;
+    }
+}
+
+}
+
+stfnum::MeasurementResults::MeasurementResults() :
+    base(NAN), baseSD(NAN), peak(NAN), maxT(NAN), threshold(NAN), thrT(NAN),
+    reference(NAN), ampl(NAN), rtLoHi(NAN), tLoIndex(0), tHiIndex(0), tLoReal(NAN),
+    innerLoRT(NAN), innerHiRT(NAN), outerLoRT(NAN), outerHiRT(NAN),
+    halfDuration(NAN), t50LeftIndex(0), t50RightIndex(0), t50LeftReal(NAN),
+    maxRise(NAN), maxRiseT(NAN), maxRiseY(NAN),
+    maxDecay(NAN), maxDecayT(NAN), maxDecayY(NAN), slopeRatio(0.0)
+{}
+
+stfnum::MeasurementKernel::MeasurementKernel(const MeasurementSettings& settings_) :
+    settings(settings_), baseStats(), diffs(), diffBeg(0)
+{}
+
+void stfnum::MeasurementKernel::peakAndSlopes(const std::vector<double>& data, MeasurementResults& r)
+{
+    const MeasurementSettings& s = settings;
+    std::size_t n = data.size(), w = s.windowLength;
+
+    // slopes are stored from the beginning to the end of the peak window,
+    // or as far as the trace allows:
+    diffBeg = s.peakBeg;
+    std::size_t diffEnd = diffBeg;
+    if (w > 0 && n > w && s.peakBeg <= s.peakEnd && s.peakBeg < n-w)
+        diffEnd = std::min(s.peakEnd, n-1-w) + 1;
+    diffs.resize(diffEnd-diffBeg);
+
+    const double* x = data.empty() ? NULL : &data[0];
+    double* d = diffs.empty() ? NULL : &diffs[0];
+    if (s.peakBeg > s.peakEnd || s.peakEnd >= n || s.pM <= 0) {
+        for (std::size_t i = diffBeg; i < diffEnd; ++i)
+            d[i-diffBeg] = x[i+w] - x[i];
+        r.peak = peak(data, r.base, s.peakBeg, s.peakEnd, s.pM, s.dir, r.maxT);
+        return;
+    }
+
+    // a single pass over the peak window computes the slopes and finds
+    // the peak:
+    int half = (s.pM-1)/2;
+    double max = x[s.peakBeg];
+    std::size_t maxI = s.peakBeg;
+    if (diffEnd > diffBeg)
+        d[0] = x[diffBeg+w] - x[diffBeg];
+    std::size_t i = s.peakBeg+1;
+    for (; i < diffEnd; ++i) {
+        d[i-diffBeg] = x[i+w] - x[i];
+        double peak = boxcar(x, (int)n, i, s.pM, half);
+        if (exceeds(s.dir, peak, max, r.base)) {
+            max = peak;
+            maxI = i;
+        }
+    }
+    for (; i <= s.peakEnd; ++i) {
+        double peak = boxcar(x, (int)n, i, s.pM, half);
+        if (exceeds(s.dir, peak, max, r.base)) {
+            max = peak;
+            maxI = i;
+        }
+    }
+    r.peak = max;
+    r.maxT = (double)maxI;
+}
+
+double stfnum::MeasurementKernel::thresholdFromSlopes(const std::vector<double>& data, double& thrT)
+{
+    const MeasurementSettings& s = settings;
+    std::size_t n = data.size(), w = s.windowLength;
+    std::size_t diffEnd = diffBeg + diffs.size();
+    if (n == 0 || s.peakBeg > s.peakEnd || s.peakEnd >= n || s.peakEnd + w > n ||
+        (s.peakBeg < s.peakEnd && (s.peakBeg < diffBeg || s.peakEnd > diffEnd)))
+    {
+        return threshold(data, s.peakBeg, s.peakEnd, s.slopeForThreshold, thrT, w);
+    }
+
+    thrT = -1;
+    double slope = s.slopeForThreshold * w;
+    for (std::size_t i = s.peakBeg; i < s.peakEnd; ++i) {
+        if (diffs[i-diffBeg] > slope) {
+            thrT = i + w/2.0;
+            return (data[i+w] + data[i]) / 2.0;
+        }
+    }
+    return 0.0;
+}
+
+double stfnum::MeasurementKernel::maxRiseFromSlopes(const std::vector<double>& data, double left, double right,
+                                                    double& maxRiseT, double& maxRiseY)
+{
+    std::size_t n = data.size(), w = settings.windowLength;
+    std::size_t diffEnd = diffBeg + diffs.size();
+    std::size_t rightc = lround(right);
+    std::size_t leftc  = lround(left);
+    // slopes from data[leftc] up to data[rightc]:
+    if (w == 0 || n <= w || leftc >= n-w || rightc >= n ||
+        (leftc + w <= rightc && (leftc < diffBeg || rightc-w >= diffEnd)))
+    {
+        return maxRise(data, left, right, maxRiseT, maxRiseY, w);
+    }
+
+    double maxRise = -INFINITY;
+    maxRiseT = NAN;
+    for (std::size_t i = leftc; i + w <= rightc; ++i) {
+        double diff = fabs(diffs[i-diffBeg]);
+        if (maxRise<diff) {
+            maxRise=diff;
+            maxRiseY=(data[i]+data[i+w])/2.0;
+            maxRiseT=(i+w/2.0);
+        }
+    }
+    return maxRise/w;
+}
+
+double stfnum::MeasurementKernel::maxDecayFromSlopes(const std::vector<double>& data, double left, double right,
+                                                     double& maxDecayT, double& maxDecayY)
+{
+    std::size_t n = data.size(), w = settings.windowLength;
+    std::size_t diffEnd = diffBeg + diffs.size();
+    std::size_t rightc = lround(right);
+    std::size_t leftc  = lround(left);
+    // slopes from data[leftc] up to data[rightc-1]:
+    if (w == 0 || n <= w || leftc >= n-w || rightc >= n ||
+        (leftc + w < rightc && (leftc < diffBeg || rightc-w-1 >= diffEnd)))
+    {
+        return maxDecay(data, left, right, maxDecayT, maxDecayY, w);
+    }
+
+    double maxDecay = -INFINITY;
+    maxDecayT = NAN;
+    for (std::size_t j = leftc; j + w < rightc; ++j) {
+        double diff = fabs(diffs[j-diffBeg]);
+        if (maxDecay<diff) {
+            maxDecay=diff;
+            maxDecayY=(data[j+w]+data[j])/2.0;
+            maxDecayT=(j+w/2.0);
+        }
+    }
+    return maxDecay/w;
+}
+
+stfnum::MeasurementResults stfnum::MeasurementKernel::Measure(const std::vector<double>& data)
+{
+    const MeasurementSettings& s = settings;
+    MeasurementResults r;
+
+    double var = 0.0;
+    r.base = base(s.baselineMethod, var, data, s.baseBeg, s.baseEnd, baseStats);
+    r.baseSD = sqrt(var);
+
+    // first pass over the peak window:
+    peakAndSlopes(data, r);
+    r.threshold = thresholdFromSlopes(data, r.thrT);
+
+    // reference is either from baseline or from threshold
+    r.reference = r.base;
+    if (!s.fromBase && r.thrT >= 0) {
+        r.reference = r.threshold;
+    }
+    r.ampl = r.peak - r.reference;
+
+    // rise time and half duration, starting from the beginning of the trace:
+    risetime2(data, r.reference, r.ampl, 0.0, r.maxT, s.rtFactor,
+              r.innerLoRT, r.innerHiRT, r.outerLoRT, r.outerHiRT);
+    r.rtLoHi = risetime(data, r.reference, r.ampl, 0.0, r.maxT, s.rtFactor,
+                        r.tLoIndex, r.tHiIndex, r.tLoReal);
+    r.halfDuration = t_half(data, r.reference, r.ampl, 0.0, (double)data.size()-1, r.maxT,
+                            r.t50LeftIndex, r.t50RightIndex, r.t50LeftReal);
+
+    // second pass over the slopes of the peak window:
+    r.maxRise = maxRiseFromSlopes(data, s.peakBeg, r.maxT, r.maxRiseT, r.maxRiseY);
+    double t_half_3 = r.t50RightIndex+2.0*(r.t50RightIndex-r.t50LeftIndex);
+    double right_decay = s.peakEnd<=t_half_3 ? s.peakEnd : t_half_3+1;
+    r.maxDecay = maxDecayFromSlopes(data, r.maxT, right_decay, r.maxDecayT, r.maxDecayY);
+
+    if (r.maxDecay != 0) r.slopeRatio = r.maxRise/r.maxDecay;
+    else r.slopeRatio = 0.0;
+
+    return r;
+}
+
+stfnum::ReferenceResults::ReferenceResults() :
+    base(NAN), peak(NAN), maxT(NAN), maxRiseT(NAN), maxRiseY(NAN),
+    t50LeftIndex(0), t50RightIndex(0), t50LeftReal(NAN),
+    rtLoHi(NAN), tLoIndex(0), tHiIndex(0), tLoReal(NAN)
+{}
+
+stfnum::ReferenceResults stfnum::MeasurementKernel::MeasureReference(const std::vector<double>& data)
+{
+    const MeasurementSettings& s = settings;
+    ReferenceResults r;
+
+    double var = 0.0;
+    r.base = base(s.baselineMethod, var, data, s.baseBeg, s.baseEnd, baseStats);
+    r.peak = peak(data, r.base, s.peakBeg, s.peakEnd, s.pM, s.dir, r.maxT);
+
+    // maximal slope in the rise before the peak:
+    const int searchRange = 100;
+    r.maxRiseT = 0.0;
+    r.maxRiseY = 0.0;
+    double left = r.maxT-searchRange>2.0 ? r.maxT-searchRange : 2.0;
+    try {
+        maxRise(data, left, r.maxT, r.maxRiseT, r.maxRiseY, s.windowLength);
+    }
+    catch (const std::out_of_range&) {
+        r.maxRiseT = 0.0;
+        r.maxRiseY = 0.0;
+        left = s.peakBeg;
+    }
+
+    // half-maximal amplitude and onset:
+    t_half(data, r.base, r.peak-r.base, left, (double)data.size(), r.maxT,
+           r.t50LeftIndex, r.t50RightIndex, r.t50LeftReal);
+    r.rtLoHi = risetime(data, r.base, r.peak-r.base, 0.0, r.maxT, 0.2,
+                        r.tLoIndex, r.tHiIndex, r.tLoReal);
+
+    return r;
+}
+
+stfnum::MeasurementPlan::MeasurementPlan(const MeasurementSettings& settings_, bool peakAtEnd_) :
+    settings(settings_), peakAtEnd(peakAtEnd_)
+{}
+
+template <class Results>
+std::vector<Results> stfnum::MeasurementPlan::measureSections(const Channel& channel, const std::vector<std::size_t>& sections,
+                                                              Results (MeasurementKernel::*measurement)(const std::vector<double>&)) const
+{
+    // check the indices before any work is split between threads:
+    for (std::size_t n = 0; n < sections.size(); ++n) {
+        channel.at(sections[n]);
+    }
+
+    std::vector<Results> results(sections.size());
+    // the first exception of any thread is passed on to the caller:
+    exception_ptr error;
+    int n_sections = (int)sections.size();
+#ifdef _OPENMP
+#pragma omp parallel if(n_sections > 1)
+#endif
+    {
+        MeasurementKernel kernel(settings);
+        MeasurementSettings sectionSettings(settings);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int n = 0; n < n_sections; ++n) {
+            const Section& sec = channel[sections[n]];
+            try {
+                if (peakAtEnd) {
+                    sectionSettings.peakEnd = sec.size() > 0 ? sec.size()-1 : 0;
+                    kernel.SetSettings(sectionSettings);
+                }
+                results[n] = (kernel.*measurement)(sec.get());
+            }
+            catch (...) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+                {
+                    if (!error)
+                        error = current_exception();
+                }
+            }
+        }
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+    return results;
+}
+
+std::vector<stfnum::MeasurementResults>
+stfnum::MeasurementPlan::Measure(const Channel& channel, const std::vector<std::size_t>& sections) const
+{
+    return measureSections<MeasurementResults>(channel, sections, &MeasurementKernel::Measure);
+}
+
+std::vector<stfnum::ReferenceResults>
+stfnum::MeasurementPlan::MeasureReference(const Channel& reference, const std::vector<std::size_t>& sections) const
+{
+    return measureSections<ReferenceResults>(reference, sections, &MeasurementKernel::MeasureReference);
+}
+
+stfnum::Table stfnum::MeasurementPlan::MeasureTable(const Channel& channel, const std::vector<std::size_t>& sections,
+                                                    double dt) const
+{
+    std::vector<MeasurementResults> results = Measure(channel, sections);
+
+    const char* labels[] = {
+        "Base", "Base SD", "Slope threshold", "Slope threshold time",
+        "Peak (from 0)", "Peak (from baseline)", "Peak (from threshold)", "Peak time",
+        "RT Lo-Hi%", "inner Rise Time Lo-Hi%", "outer Rise Time Lo-Hi%",
+        "duration Amp/2", "start Amp/2", "end Amp/2",
+        "Max. slope rise", "Max. slope decay", "Time of max. rise", "Time of max. decay",
+        "Slope ratio"
+    };
+    std::size_t nCols = sizeof(labels)/sizeof(labels[0]);
+    Table table(results.size(), nCols);
+    for (std::size_t nCol = 0; nCol < nCols; ++nCol) {
+        table.SetColLabel(nCol, labels[nCol]);
+    }
+
+    // convert to units of dt as wxStfDoc::Measure() does:
+    double sr = 1.0/dt;
+    for (std::size_t n = 0; n < results.size(); ++n) {
+        const MeasurementResults& r = results[n];
+        table.SetRowLabel(n, channel[sections[n]].GetSectionDescription());
+        std::size_t nCol = 0;
+        table.at(n, nCol++) = r.base;
+        table.at(n, nCol++) = r.baseSD;
+        table.at(n, nCol++) = r.threshold;
+        table.at(n, nCol++) = r.thrT*dt;
+        table.at(n, nCol++) = r.peak;
+        table.at(n, nCol++) = r.peak-r.base;
+        table.at(n, nCol++) = r.peak-r.threshold;
+        table.at(n, nCol++) = r.maxT*dt;
+        table.at(n, nCol++) = r.rtLoHi/sr;
+        table.at(n, nCol++) = r.innerHiRT/sr - r.innerLoRT/sr;
+        table.at(n, nCol++) = r.outerHiRT/sr - r.outerLoRT/sr;
+        table.at(n, nCol++) = r.halfDuration/sr;
+        table.at(n, nCol++) = r.t50LeftReal*dt;
+        table.at(n, nCol++) = (r.t50LeftReal+r.halfDuration)*dt;
+        table.at(n, nCol++) = r.maxRise*sr;
+        table.at(n, nCol++) = r.maxDecay*sr;
+        table.at(n, nCol++) = r.maxRiseT*dt;
+        table.at(n, nCol++) = r.maxDecayT*dt;
+        table.at(n, nCol++) = r.slopeRatio;
+    }
+    return table;
+}
+
 
@@ -32,6 +32,7 @@
 #include <vector>
 
 #include "../libstfio/stfio.h"
+#include "./stfnum.h"
 
 namespace stfnum {
 
@@ -39,6 +40,58 @@ namespace stfnum {
  *  @{
  */
 
+//! Order statistics of data windows.
+/*! Medians and quartiles are found by selection rather than by sorting, and
+ *  the working memory is kept between calls. Re-using one object for many
+ *  windows, e.g. for every cursor move or for every section of a batch
+ *  analysis, therefore doesn't allocate any memory once the largest window
+ *  has been seen. An object must not be shared between threads.
+ */
+class StfioDll OrderStatistics {
+public:
+    //! Median and interquartile range of a window.
+    /*! The values in [\e first, \e last) are left unchanged.
+     *  \param first Pointer to the first value of the window.
+     *  \param last Pointer past the last value of the window.
+     *  \param iqr On exit, the interquartile range, with each quartile
+     *         interpolated as the average of its lower and upper bound.
+     *  \return The median, or NAN if the window is empty.
+     */
+    double median(const double* first, const double* last, double& iqr);
+
+    //! Running median of a trace.
+    /*! The window is slid along the trace by a pair of heaps, so that every
+     *  step takes O(log(\e width)) time.
+     *  \param data Pointer to the first value of the trace.
+     *  \param n Number of values of the trace.
+     *  \param width Width of the window in sampling points.
+     *  \param out On exit, out[i] is the median of data[i] ... data[i+width-1].
+     *         The window is shortened towards the end of the trace so that
+     *         all of the remaining points are used. Has to hold n values.
+     */
+    void runningMedian(const double* data, std::size_t n, std::size_t width, double* out);
+
+private:
+    void pushLower(std::size_t slot);
+    void pushUpper(std::size_t slot);
+    void popLower();
+    void popUpper();
+    void erase(std::size_t slot);
+    void insert(std::size_t slot, double value);
+    void siftLower(std::size_t pos);
+    void siftUpper(std::size_t pos);
+    void setLower(std::size_t pos, std::size_t slot);
+    void setUpper(std::size_t pos, std::size_t slot);
+
+    std::vector<double> scratch;
+    // Running median: the values of the window, indexed by slot, and two
+    // heaps of slots. The lower half is a max-heap and the upper half a
+    // min-heap; the lower half holds one more value if the window size is
+    // odd. heapPos maps a slot to 2*position in the lower or to
+    // 2*position+1 in the upper half.
+    std::vector<std::size_t> lower, upper, heapPos;
+};
+
 //! Calculate the average of all sampling points between and including \e llb and \e ulb.
 /*! \param method: 0: mean and s.d.; 1: median
  *  \param var Will contain the variance on exit (only when method=0).
@@ -52,6 +105,22 @@ namespace stfnum {
 StfioDll
 double base(enum stfnum::baseline_method method, double& var, const std::vector<double>& data, std::size_t llb, std::size_t ulb);
 
+//! Calculate the baseline, re-using the working memory of \e stats.
+/*! Same as base() above, but the median is computed with the working memory
+ *  of \e stats. Use this variant for repeated measurements.
+ */
+StfioDll
+double base(enum stfnum::baseline_method method, double& var, const std::vector<double>& data, std::size_t llb, std::size_t ulb,
+            OrderStatistics& stats);
+
+//! Running median of a trace.
+/*! \param data The trace.
+ *  \param width Width of the window in sampling points.
+ *  \return A trace of the same size, see OrderStatistics::runningMedian().
+ */
+StfioDll
+Vector_double runningMedian(const Vector_double& data, std::size_t width);
+
 
 //! Find the peak value of \e data between \e llp and \e ulp.
 /*! Note that peaks will be detected by measuring from \e base, but the return value
@@ -194,6 +263,200 @@ double  maxDecay( const std::vector<double>& data, double left, double right, do
 double pslope( const std::vector<double>& data, std::size_t left, std::size_t right);
 
 #endif
+
+//! Settings of a measurement, see MeasurementKernel.
+struct StfioDll MeasurementSettings {
+    //! Default constructor.
+    MeasurementSettings() :
+        baseBeg(0), baseEnd(0), peakBeg(0), peakEnd(0), pM(1),
+        dir(stfnum::both), baselineMethod(stfnum::mean_sd),
+        slopeForThreshold(0), rtFactor(0.2), fromBase(true), windowLength(1)
+    {}
+
+    std::size_t baseBeg; /*!< First index of the baseline window. */
+    std::size_t baseEnd; /*!< Last index of the baseline window. */
+    std::size_t peakBeg; /*!< First index of the peak window. */
+    std::size_t peakEnd; /*!< Last index of the peak window. */
+    int pM; /*!< Number of points averaged for the peak, see peak(). */
+    stfnum::direction dir; /*!< Direction of the peak. */
+    stfnum::baseline_method baselineMethod; /*!< Mean or median baseline. */
+    double slopeForThreshold; /*!< Threshold slope per sampling point. */
+    double rtFactor; /*!< Lower rise time limit as a fraction of the amplitude, e.g. 0.2 for 20-80%. */
+    bool fromBase; /*!< Measure amplitudes from the baseline rather than from the threshold. */
+    std::size_t windowLength; /*!< Distance in sampling points used to compute slopes. */
+};
+
+//! Results of a measurement, see MeasurementKernel.
+/*! All times are given in units of sampling points, and all slopes per
+ *  sampling point.
+ */
+struct StfioDll MeasurementResults {
+    //! Default constructor.
+    MeasurementResults();
+
+    double base; /*!< Baseline, see base(). */
+    double baseSD; /*!< Square root of the variance or of the IQR returned by base(). */
+    double peak; /*!< Peak value, measured from 0. */
+    double maxT; /*!< Time of the peak. */
+    double threshold; /*!< Value at which the threshold slope is exceeded. */
+    double thrT; /*!< Time of the threshold crossing, or -1 if there is none. */
+    double reference; /*!< The baseline or the threshold, from which the amplitude is measured. */
+    double ampl; /*!< Amplitude of the event. */
+    double rtLoHi; /*!< Lo to hi rise time, see risetime(). */
+    std::size_t tLoIndex, tHiIndex; /*!< Sampling points next to the lo and hi crossings. */
+    double tLoReal; /*!< Interpolated time of the lo crossing. */
+    double innerLoRT, innerHiRT, outerLoRT, outerHiRT; /*!< See risetime2(). */
+    double halfDuration; /*!< Full width at half-maximal amplitude, see t_half(). */
+    std::size_t t50LeftIndex, t50RightIndex; /*!< Sampling points next to the half-maximal crossings. */
+    double t50LeftReal; /*!< Interpolated time of the left half-maximal crossing. */
+    double maxRise, maxRiseT, maxRiseY; /*!< Maximal slope of rise, see maxRise(). */
+    double maxDecay, maxDecayT, maxDecayY; /*!< Maximal slope of decay, see maxDecay(). */
+    double slopeRatio; /*!< maxRise / maxDecay, or 0 if there is no decay. */
+};
+
+//! Results of a measurement of a reference channel, see MeasurementKernel::MeasureReference().
+/*! All times are given in units of sampling points.
+ */
+struct StfioDll ReferenceResults {
+    //! Default constructor.
+    ReferenceResults();
+
+    double base; /*!< Baseline, see base(). */
+    double peak; /*!< Peak value, measured from 0. */
+    double maxT; /*!< Time of the peak. */
+    double maxRiseT, maxRiseY; /*!< Time and value of the maximal slope of rise before the peak. */
+    std::size_t t50LeftIndex, t50RightIndex; /*!< Sampling points next to the half-maximal crossings. */
+    double t50LeftReal; /*!< Interpolated time of the left half-maximal crossing. */
+    double rtLoHi; /*!< 20 to 80% rise time. */
+    std::size_t tLoIndex, tHiIndex; /*!< Sampling points next to the 20 and 80% crossings. */
+    double tLoReal; /*!< Interpolated time of the 20% crossing. */
+};
+
+//! Measures all kinetic properties of an event in a single sweep of its trace.
+/*! Computes the same values as calling base(), peak(), threshold(),
+ *  risetime2(), risetime(), t_half(), maxRise() and maxDecay() one after
+ *  another, but the slopes within the peak window are computed only once
+ *  into a buffer that is shared by the threshold and the slope searches.
+ *  The buffer and the working memory of the baseline are kept between
+ *  measurements, so that a kernel can be re-used for many traces without
+ *  allocating memory. A kernel must not be shared between threads.
+ */
+class StfioDll MeasurementKernel {
+public:
+    //! Constructor.
+    /*! \param settings The settings of the measurement.
+     */
+    explicit MeasurementKernel(const MeasurementSettings& settings=MeasurementSettings());
+
+    //! Measures a trace.
+    /*! \param data The trace.
+     *  \return The results of the measurement.
+     */
+    MeasurementResults Measure(const std::vector<double>& data);
+
+    //! Measures a trace of a reference channel, e.g. presynaptic action potentials.
+    /*! Uses the baseline and peak windows of the settings. The maximal rise
+     *  is searched within 100 sampling points before the peak, and the rise
+     *  time is always measured from 20 to 80%.
+     *  \param data The trace.
+     *  \return The results of the measurement.
+     */
+    ReferenceResults MeasureReference(const std::vector<double>& data);
+
+    //! Settings of the measurement.
+    /*! \return The settings of the measurement.
+     */
+    const MeasurementSettings& GetSettings() const { return settings; }
+
+    //! Changes the settings of the measurement.
+    /*! \param value The new settings.
+     */
+    void SetSettings(const MeasurementSettings& value) { settings = value; }
+
+private:
+    void peakAndSlopes(const std::vector<double>& data, MeasurementResults& r);
+    double thresholdFromSlopes(const std::vector<double>& data, double& thrT);
+    double maxRiseFromSlopes(const std::vector<double>& data, double left, double right,
+                             double& maxRiseT, double& maxRiseY);
+    double maxDecayFromSlopes(const std::vector<double>& data, double left, double right,
+                              double& maxDecayT, double& maxDecayY);
+
+    MeasurementSettings settings;
+    OrderStatistics baseStats;
+    // data[i+windowLength]-data[i] for i in [diffBeg, diffBeg+diffs.size()):
+    std::vector<double> diffs;
+    std::size_t diffBeg;
+};
+
+//! Measures many sections with the same settings.
+/*! A plan can be run against any list of sections of a channel. The
+ *  sections are split between OpenMP threads, each of which measures with a
+ *  MeasurementKernel of its own.
+ */
+class StfioDll MeasurementPlan {
+public:
+    //! Constructor.
+    /*! \param settings The settings of the measurement.
+     *  \param peakAtEnd true if the peak window should end at the last
+     *         sampling point of every section, regardless of settings.peakEnd.
+     */
+    explicit MeasurementPlan(const MeasurementSettings& settings=MeasurementSettings(), bool peakAtEnd=false);
+
+    //! Measures sections.
+    /*! Throws std::out_of_range if a section index is out of range.
+     *  \param channel The channel containing the sections.
+     *  \param sections Indices of the sections to be measured.
+     *  \return The results, in the order of \e sections.
+     */
+    std::vector<MeasurementResults> Measure(const Channel& channel, const std::vector<std::size_t>& sections) const;
+
+    //! Measures sections of a reference channel, see MeasurementKernel::MeasureReference().
+    /*! Throws std::out_of_range if a section index is out of range.
+     *  \param reference The channel containing the sections.
+     *  \param sections Indices of the sections to be measured.
+     *  \return The results, in the order of \e sections.
+     */
+    std::vector<ReferenceResults> MeasureReference(const Channel& reference, const std::vector<std::size_t>& sections) const;
+
+    //! Measures sections and puts the results into a table.
+    /*! Every section is a row, labeled with the section description, and
+     *  every measured value a column. Times are given in units of \e dt.
+     *  \param channel The channel containing the sections.
+     *  \param sections Indices of the sections to be measured.
+     *  \param dt The sampling interval.
+     *  \return The table of results.
+     */
+    Table MeasureTable(const Channel& channel, const std::vector<std::size_t>& sections, double dt) const;
+
+    //! Settings of the measurement.
+    /*! \return The settings of the measurement.
+     */
+    const MeasurementSettings& GetSettings() const { return settings; }
+
+    //! Changes the settings of the measurement.
+    /*! \param value The new settings.
+     */
+    void SetSettings(const MeasurementSettings& value) { settings = value; }
+
+    //! Whether the peak window ends at the last sampling point of every section.
+    /*! \return true if the peak window ends at the last sampling point.
+     */
+    bool GetPeakAtEnd() const { return peakAtEnd; }
+
+    //! Sets whether the peak window ends at the last sampling point of every section.
+    /*! \param value true if the peak window should end at the last sampling point.
+     */
+    void SetPeakAtEnd(bool value) { peakAtEnd = value; }
+
+private:
+    template <class Results>
+    std::vector<Results> measureSections(const Channel& channel, const std::vector<std::size_t>& sections,
+                                         Results (MeasurementKernel::*measurement)(const std::vector<double>&)) const;
+
+    MeasurementSettings settings;
+    bool peakAtEnd;
+};
+
 /*@}*/
 
 }
@@ -20,6 +20,9 @@
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <list>
+#include <map>
+#include <stdexcept>
 
 #include "stfnum.h"
 #include "fit.h"
@@ -170,6 +173,195 @@ int stfnum::fac(int arg) {
     }
 }
 
+namespace {
+
+// The most recently used plans are cached. FFTW's planner isn't thread-safe,
+// so that all access to it (including the destruction of plans) is serialised.
+struct FFTPlanKey {
+    std::size_t size;
+    std::size_t howmany;
+    stfnum::fft_direction direction;
+    bool aligned;
+    unsigned flags;
+
+    bool operator<(const FFTPlanKey& other) const {
+        if (size != other.size) return size < other.size;
+        if (howmany != other.howmany) return howmany < other.howmany;
+        if (direction != other.direction) return direction < other.direction;
+        if (aligned != other.aligned) return aligned < other.aligned;
+        return flags < other.flags;
+    }
+};
+
+// Maximal number of cached plans.
+const std::size_t FFT_PLAN_CACHE_SIZE = 32;
+
+// Destroys a plan once it is neither cached nor used anymore.
+struct FFTPlanDeleter {
+    void operator()(fftw_plan plan) const {
+#ifdef _OPENMP
+#pragma omp critical(stfnum_fftw_planner)
+#endif
+        fftw_destroy_plan(plan);
+    }
+};
+
+typedef std::list<std::pair<FFTPlanKey, stfnum::FFTPlanPtr> > FFTPlanList;
+
+// Cached plans, the most recently used one first:
+FFTPlanList fftPlans;
+std::map<FFTPlanKey, FFTPlanList::iterator> fftPlanIndex;
+unsigned fftPlannerFlags = FFTW_ESTIMATE;
+
+// Frequency response of a filter for a window of filter_size data points.
+Vector_double filterResponse(std::size_t filter_size, const Vector_double &a, int SR,
+                             stfnum::Func func, bool inverse)
+{
+    double SI=1.0/SR; //the sampling interval
+    Vector_double response(filter_size/2+1);
+    for (std::size_t n_point=0; n_point < response.size(); ++n_point) {
+        //calculate the frequency (in kHz) which corresponds to the index:
+        double f=n_point / (filter_size*SI);
+        response[n_point] = (!inverse? func(f,a) : 1.0-func(f,a));
+    }
+    return response;
+}
+
+// Filters the windows starting at filter_start of the data sets first to last-1.
+// p_fwd and p_inv have to be planned for last-first transforms of the window size.
+void filterWindows(const std::vector<const Vector_double*>& data, std::size_t first, std::size_t last,
+                   std::size_t filter_start, std::size_t filter_size, const Vector_double& response,
+                   fftw_plan p_fwd, fftw_plan p_inv, std::vector<Vector_double>& data_return)
+{
+    std::size_t howmany = last-first;
+    std::size_t n_freq = response.size();
+
+    //memory allocation as suggested by fftw; the windows are stored one after the other.
+    //fftw_complex is a double[2]; hence, out is an array of
+    //double[2] with out[n][0] being the real and out[n][1] being
+    //the imaginary part.
+    double *in =(double *)fftw_malloc(sizeof(double) * filter_size * howmany);
+    fftw_complex *out=(fftw_complex *)fftw_malloc(sizeof(fftw_complex) * n_freq * howmany);
+    Vector_double offset_0(howmany), offset_step(howmany);
+
+    for (std::size_t n_s=0; n_s < howmany; ++n_s) {
+        const Vector_double& d = *data[first+n_s];
+        double* in_s = &in[n_s*filter_size];
+        // calculate the offset (a straight line between the first and last points):
+        offset_0[n_s]=d[filter_start];
+        offset_step[n_s]=(d[filter_start+filter_size-1]-offset_0[n_s]) / (filter_size-1);
+
+        //fill the input array with data removing the offset:
+        for (std::size_t n_point=0;n_point<filter_size;++n_point) {
+            in_s[n_point]=d[n_point+filter_start]-(offset_0[n_s] + offset_step[n_s]*n_point);
+        }
+    }
+
+    fftw_execute_dft_r2c(p_fwd, in, out);
+
+    for (std::size_t n_s=0; n_s < howmany; ++n_s) {
+        fftw_complex* out_s = &out[n_s*n_freq];
+        for (std::size_t n_point=0; n_point < n_freq; ++n_point) {
+            out_s[n_point][0] *= response[n_point];
+            out_s[n_point][1] *= response[n_point];
+        }
+    }
+
+    //do the reverse fft:
+    fftw_execute_dft_c2r(p_inv, out, in);
+
+    //fill the return arrays, adding the offset, and scaling by filter_size
+    //(because fftw computes an unnormalized transform):
+    for (std::size_t n_s=0; n_s < howmany; ++n_s) {
+        const double* in_s = &in[n_s*filter_size];
+        Vector_double& d_return = data_return[first+n_s];
+        d_return.resize(filter_size);
+        for (std::size_t n_point=0; n_point < filter_size; ++n_point) {
+            d_return[n_point]=(in_s[n_point]/filter_size + offset_0[n_s] + offset_step[n_s]*n_point);
+        }
+    }
+    fftw_free(in);fftw_free(out);
+}
+
+}
+
+stfnum::FFTPlanPtr stfnum::fftPlan(std::size_t size, std::size_t howmany, stfnum::fft_direction direction, bool aligned) {
+    if (size == 0 || howmany == 0) {
+        throw std::out_of_range("Empty transform in stfnum::fftPlan()");
+    }
+    FFTPlanPtr plan;
+    // Evicted plans are released outside of the critical section, since
+    // destroying them requires the lock:
+    FFTPlanPtr evicted;
+#ifdef _OPENMP
+#pragma omp critical(stfnum_fftw_planner)
+#endif
+    {
+        FFTPlanKey key = {size, howmany, direction, aligned, fftPlannerFlags};
+        std::map<FFTPlanKey, FFTPlanList::iterator>::iterator it = fftPlanIndex.find(key);
+        if (it != fftPlanIndex.end()) {
+            fftPlans.splice(fftPlans.begin(), fftPlans, it->second);
+            plan = it->second->second;
+        } else {
+            int n = (int)size;
+            int n_freq = (int)(size/2)+1;
+            unsigned flags = key.flags | (aligned ? 0 : FFTW_UNALIGNED);
+            // The planner may overwrite the arrays, so that it gets scratch arrays:
+            double* in = (double *)fftw_malloc(sizeof(double) * size * howmany);
+            fftw_complex* out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * n_freq * howmany);
+            fftw_plan p = NULL;
+            if (direction == fft_forward) {
+                p = fftw_plan_many_dft_r2c(1, &n, (int)howmany, in, NULL, 1, n,
+                                           out, NULL, 1, n_freq, flags);
+            } else {
+                p = fftw_plan_many_dft_c2r(1, &n, (int)howmany, out, NULL, 1, n_freq,
+                                           in, NULL, 1, n, flags);
+            }
+            fftw_free(in);
+            fftw_free(out);
+            if (p != NULL) {
+                plan = FFTPlanPtr(p, FFTPlanDeleter());
+                fftPlans.push_front(std::make_pair(key, plan));
+                fftPlanIndex[key] = fftPlans.begin();
+                if (fftPlans.size() > FFT_PLAN_CACHE_SIZE) {
+                    evicted = fftPlans.back().second;
+                    fftPlanIndex.erase(fftPlans.back().first);
+                    fftPlans.pop_back();
+                }
+            }
+        }
+    }
+    if (!plan) {
+        throw std::runtime_error("Couldn't create plan in stfnum::fftPlan()");
+    }
+    return plan;
+}
+
+void stfnum::setFFTPlannerFlags(unsigned flags) {
+#ifdef _OPENMP
+#pragma omp critical(stfnum_fftw_planner)
+#endif
+    fftPlannerFlags = flags;
+}
+
+bool stfnum::importFFTWisdom(const std::string& filename) {
+    int success;
+#ifdef _OPENMP
+#pragma omp critical(stfnum_fftw_planner)
+#endif
+    success = fftw_import_wisdom_from_filename(filename.c_str());
+    return success != 0;
+}
+
+bool stfnum::exportFFTWisdom(const std::string& filename) {
+    int success;
+#ifdef _OPENMP
+#pragma omp critical(stfnum_fftw_planner)
+#endif
+    success = fftw_export_wisdom_to_filename(filename.c_str());
+    return success != 0;
+}
+
 Vector_double
 stfnum::filter( const Vector_double& data, std::size_t filter_start,
         std::size_t filter_end, const Vector_double &a, int SR,
@@ -179,165 +371,398 @@ stfnum::filter( const Vector_double& data, std::size_t filter_start,
         throw e;
     }
     std::size_t filter_size=filter_end-filter_start+1;
-    Vector_double data_return(filter_size);
-    double SI=1.0/SR; //the sampling interval
+    Vector_double response = filterResponse(filter_size, a, SR, func, inverse);
+
+    std::vector<const Vector_double*> windows(1, &data);
+    std::vector<Vector_double> data_return(1);
+    filterWindows(windows, 0, 1, filter_start, filter_size, response,
+                  fftPlan(filter_size, 1, fft_forward).get(), fftPlan(filter_size, 1, fft_backward).get(),
+                  data_return);
+    return data_return[0];
+}
 
-    double *in;
-    //fftw_complex is a double[2]; hence, out is an array of
-    //double[2] with out[n][0] being the real and out[n][1] being
-    //the imaginary part.
-    fftw_complex *out;
-    fftw_plan p1, p2;
+std::vector<Vector_double>
+stfnum::filterBatch( const Channel& channel, const std::vector<std::size_t>& sections,
+        std::size_t filter_start, std::size_t filter_end, const Vector_double &a, int SR,
+        stfnum::Func func, bool inverse, bool parallel ) {
+    std::vector<Vector_double> data_return(sections.size());
+    if (sections.empty()) {
+        return data_return;
+    }
+    std::vector<const Vector_double*> windows(sections.size());
+    for (std::size_t n_s=0; n_s < sections.size(); ++n_s) {
+        const Vector_double& data = channel.at(sections[n_s]).get();
+        if (filter_start>filter_end || filter_end>=data.size()) {
+            std::out_of_range e("subscript out of range in stfnum::filterBatch()");
+            throw e;
+        }
+        windows[n_s] = &data;
+    }
+    std::size_t filter_size=filter_end-filter_start+1;
+    Vector_double response = filterResponse(filter_size, a, SR, func, inverse);
+
+    // The sections are transformed in one block per thread. Plans are
+    // obtained up front, since exceptions mustn't leave the parallel region:
+    int n_blocks = 1;
+#ifdef _OPENMP
+    if (parallel) {
+        n_blocks = (int)std::min((std::size_t)omp_get_max_threads(), sections.size());
+    }
+#endif
+    std::vector<std::size_t> first(n_blocks+1);
+    std::vector<FFTPlanPtr> p_fwd(n_blocks), p_inv(n_blocks);
+    for (int n_b=0; n_b <= n_blocks; ++n_b) {
+        first[n_b] = n_b * sections.size() / n_blocks;
+    }
+    for (int n_b=0; n_b < n_blocks; ++n_b) {
+        p_fwd[n_b] = fftPlan(filter_size, first[n_b+1]-first[n_b], fft_forward);
+        p_inv[n_b] = fftPlan(filter_size, first[n_b+1]-first[n_b], fft_backward);
+    }
 
-    //memory allocation as suggested by fftw:
-    in =(double *)fftw_malloc(sizeof(double) * filter_size);
-    out=(fftw_complex *)fftw_malloc(sizeof(fftw_complex) * ((int)(filter_size/2)+1));
+#ifdef _OPENMP
+#pragma omp parallel for if(n_blocks > 1)
+#endif
+    for (int n_b=0; n_b < n_blocks; ++n_b) {
+        filterWindows(windows, first[n_b], first[n_b+1], filter_start, filter_size, response,
+                      p_fwd[n_b].get(), p_inv[n_b].get(), data_return);
+    }
+    return data_return;
+}
 
-    // calculate the offset (a straight line between the first and last points):
-    double offset_0=data[filter_start];
-    double offset_1=data[filter_end]-offset_0;
-    double offset_step=offset_1 / (filter_size-1);
+namespace {
+
+// Cross-correlation corr[k] = sum_j templ[j]*data[k+j] for a range of k.
+// Long templates use FFTs on overlapping blocks of the data (overlap-save),
+// which reduces the cost from O(N*M) to O(N*log(M)). The blocks start at
+// multiples of Step(), so that a range starting there gets exactly the same
+// values as the whole trace. Ranges can be computed concurrently.
+class SlidingDotProduct {
+  public:
+    SlidingDotProduct(const Vector_double& data, const Vector_double& templ);
+    ~SlidingDotProduct();
+
+    // Offsets at which ranges have to start.
+    std::size_t Step() const { return step; }
+
+    // Computes corr[k] for k = first..last-1; first has to be a multiple of Step().
+    void operator()(std::size_t first, std::size_t last, Vector_double& corr) const;
+
+  private:
+    SlidingDotProduct(const SlidingDotProduct&);
+    SlidingDotProduct& operator=(const SlidingDotProduct&);
+
+    const Vector_double& data;
+    const Vector_double& templ;
+    std::size_t block, step, n_freq;
+    fftw_complex* out_templ;
+    stfnum::FFTPlanPtr p_fwd, p_inv;
+};
+
+SlidingDotProduct::SlidingDotProduct(const Vector_double& data_, const Vector_double& templ_)
+    : data(data_), templ(templ_), block(0), step(1), n_freq(0), out_templ(NULL), p_fwd(), p_inv()
+{
+    // Direct summation is faster for short templates:
+    if (templ.size() <= 64) {
+        return;
+    }
 
-    //fill the input array with data removing the offset:
-    for (std::size_t n_point=0;n_point<filter_size;++n_point) {
-        in[n_point]=data[n_point+filter_start]-(offset_0 + offset_step*n_point);
+    // Block length: a power of 2 that is large compared to the template:
+    block = 4096;
+    while (block < 4*templ.size()) {
+        block *= 2;
     }
+    // Number of valid correlation values per block:
+    step = block-templ.size()+1;
+    n_freq = block/2+1;
+    p_fwd = stfnum::fftPlan(block, 1, stfnum::fft_forward);
+    p_inv = stfnum::fftPlan(block, 1, stfnum::fft_backward);
+
+    // Transform of the zero-padded template:
+    double* in = (double *)fftw_malloc(sizeof(double) * block);
+    out_templ = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * n_freq);
+    std::fill(in, in+block, 0.0);
+    std::copy(templ.begin(), templ.end(), in);
+    fftw_execute_dft_r2c(p_fwd.get(), in, out_templ);
+    fftw_free(in);
+}
 
-    //plan the fft and execute it:
-    p1 =fftw_plan_dft_r2c_1d((int)filter_size,in,out,FFTW_ESTIMATE);
-    fftw_execute(p1);
+SlidingDotProduct::~SlidingDotProduct() {
+    if (out_templ != NULL) {
+        fftw_free(out_templ);
+    }
+}
 
-    for (std::size_t n_point=0; n_point < (unsigned int)(filter_size/2)+1; ++n_point) {
-        //calculate the frequency (in kHz) which corresponds to the index:
-        double f=n_point / (filter_size*SI);
-        double rslt= (!inverse? func(f,a) : 1.0-func(f,a));
-        out[n_point][0] *= rslt;
-        out[n_point][1] *= rslt;
+void SlidingDotProduct::operator()(std::size_t first, std::size_t last, Vector_double& corr) const {
+    std::size_t n_templ = templ.size();
+    if (block == 0) {
+        const double* t = &templ[0];
+        const double* d = &data[0];
+        double* c = &corr[0];
+        for (std::size_t n_data = first; n_data < last; ++n_data) {
+            double sum = 0.0;
+            for (std::size_t i = 0; i < n_templ; ++i) {
+                sum += t[i]*d[n_data+i];
+            }
+            c[n_data] = sum;
+        }
+        return;
     }
 
-    //do the reverse fft:
-    p2=fftw_plan_dft_c2r_1d((int)filter_size,out,in,FFTW_ESTIMATE);
-    fftw_execute(p2);
+    double* in = (double *)fftw_malloc(sizeof(double) * block);
+    fftw_complex* out_data = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * n_freq);
+    for (std::size_t start = first; start < last; start += step) {
+        std::size_t n_valid = std::min(step, last-start);
+        std::size_t n_in = std::min(block, data.size()-start);
+        std::copy(data.begin()+start, data.begin()+start+n_in, in);
+        std::fill(in+n_in, in+block, 0.0);
+        fftw_execute_dft_r2c(p_fwd.get(), in, out_data);
+        // Correlation corresponds to multiplication with the complex conjugate:
+        for (std::size_t n_f = 0; n_f < n_freq; ++n_f) {
+            double re = out_data[n_f][0]*out_templ[n_f][0] + out_data[n_f][1]*out_templ[n_f][1];
+            double im = out_data[n_f][1]*out_templ[n_f][0] - out_data[n_f][0]*out_templ[n_f][1];
+            out_data[n_f][0] = re;
+            out_data[n_f][1] = im;
+        }
+        fftw_execute_dft_c2r(p_inv.get(), out_data, in);
+        // fftw computes an unnormalized transform:
+        for (std::size_t n = 0; n < n_valid; ++n) {
+            corr[start+n] = in[n]/(double)block;
+        }
+    }
+    fftw_free(in);
+    fftw_free(out_data);
+}
 
-    //fill the return array, adding the offset, and scaling by filter_size
-    //(because fftw computes an unnormalized transform):
-    data_return.resize(filter_size);
-    for (std::size_t n_point=0; n_point < filter_size; ++n_point) {
-        data_return[n_point]=(in[n_point]/filter_size + offset_0 + offset_step*n_point);
+// Minimal number of template offsets per chunk of the detection functions.
+// Chunks are processed in parallel if OpenMP is enabled. Their borders don't
+// depend on the number of threads, and neither do the results.
+const std::size_t DETECT_CHUNK = 65536;
+
+// Mean of the data within the template window, and the sum of squared
+// deviations from that mean. m2_max is the largest sum of squares since
+// the sums were last computed directly.
+struct WindowSums {
+    double mean, m2, m2_max;
+};
+
+// Computes the sums for the template window that starts at n_data directly.
+void initWindow(const Vector_double& data_c, std::size_t n_data, std::size_t n_templ,
+                WindowSums& sums)
+{
+    sums.mean=0.0;
+    for (std::size_t n = n_data; n < n_data+n_templ; ++n) {
+        sums.mean+=data_c[n];
     }
-    fftw_destroy_plan(p1);
-    fftw_destroy_plan(p2);
-    fftw_free(in);fftw_free(out);
-    return data_return;
+    sums.mean/=n_templ;
+    sums.m2=0.0;
+    for (std::size_t n = n_data; n < n_data+n_templ; ++n) {
+        sums.m2+=stfnum::SQR(data_c[n]-sums.mean);
+    }
+    sums.m2_max=sums.m2;
 }
 
-Vector_double
-stfnum::detectionCriterion(const Vector_double& data, const Vector_double& templ, stfio::ProgressInfo& progDlg)
+// Moves the template window by one data point: adds the new value and
+// removes the first one. The sum of squares is updated from the deviations
+// (Welford's method) rather than from the squares of the data. Its rounding
+// errors are proportional to the largest sum of squares that has passed
+// through the window (e.g. at a step in the baseline), so it is computed
+// directly again once it has become much smaller than that.
+inline void slideWindow(const Vector_double& data_c, std::size_t n_data, std::size_t n_templ,
+                        WindowSums& sums)
 {
-    bool skipped=false;
-    // variable names are taken from Clements & Bekkers (1997) as long
-    // as they don't interfere with C++ keywords (such as "template")
-    Vector_double detection_criterion(data.size()-templ.size());
-    // avoid redundant computations:
-    double sum_templ_data=0.0, sum_templ=0.0, sum_templ_sqr=0.0, sum_data=0.0, sum_data_sqr=0.0;
-    for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-        sum_templ_data+=templ[n_templ]*data[0+n_templ];
-        sum_data+=data[0+n_templ];
-        sum_data_sqr+=data[0+n_templ]*data[0+n_templ];
-        sum_templ+=templ[n_templ];
-        sum_templ_sqr+=templ[n_templ]*templ[n_templ];
-    }
-    double y_old=0.0;
-    double y2_old=0.0;
-    int progCounter=0;
-    double progFraction=(data.size()-templ.size())/100.0;
-    for (unsigned n_data=0; n_data<data.size()-templ.size(); ++n_data) {
-        if (n_data/progFraction>progCounter) {
-            progDlg.Update( (int)((double)n_data/(double)(data.size()-templ.size())*100.0),
-                            "Calculating detection criterion", &skipped );
-            if (skipped) {
-                detection_criterion.resize(0);
-                return detection_criterion;
-            }
-            progCounter++;
-        }
-        if (n_data!=0) {
-            sum_templ_data=0.0;
-            // The product has to be computed in full length:
-            for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-                sum_templ_data+=templ[n_templ]*data[n_data+n_templ];
-            }
-            // The new value that will be added is:
-            double y_new=data[n_data+templ.size()-1];
-            double y2_new=data[n_data+templ.size()-1]*data[n_data+templ.size()-1];
-            sum_data+=y_new-y_old;
-            sum_data_sqr+=y2_new-y2_old;
-        }
-        // The first value that was added (and will have to be subtracted during
-        // the next loop):
-        y_old=data[n_data+0];
-        y2_old=data[n_data+0]*data[n_data+0];
-
-        double scale=(sum_templ_data-sum_templ*sum_data/templ.size())/
-            (sum_templ_sqr-sum_templ*sum_templ/templ.size());
-        double offset=(sum_data-scale*sum_templ)/templ.size();
-        double sse=sum_data_sqr+scale*scale*sum_templ_sqr+templ.size()*offset*offset -
-            2.0*(scale*sum_templ_data +
-                 offset*sum_data-scale*offset*sum_templ);
-        double standard_error=sqrt(sse/(templ.size()-1));
-        detection_criterion[n_data]=(scale/standard_error);
+    double y_new=data_c[n_data+n_templ-1];
+    double y_old=data_c[n_data-1];
+    double mean_old=sums.mean;
+    sums.mean+=(y_new-y_old)/n_templ;
+    sums.m2+=(y_new-y_old)*(y_new-sums.mean+y_old-mean_old);
+    if (sums.m2 > sums.m2_max) {
+        sums.m2_max=sums.m2;
+    } else if (sums.m2 < 1.0e-6*sums.m2_max) {
+        initWindow(data_c, n_data, n_templ, sums);
     }
-    return detection_criterion;
 }
 
-std::vector<int>
-stfnum::peakIndices(const Vector_double& data, double threshold,
-                 int minDistance)
+// Does nothing with the values that are final.
+struct IgnoreFinal {
+    void operator()(std::size_t) {}
+};
+
+// Computes out[n] = fit(sum_templ_data, mean_data, m2_data) for every
+// offset n of the template, where the sums are taken over the (mean-free)
+// data within the template window. Chunks of offsets are processed in
+// parallel in waves; after each wave, onFinal(n) is called with the number
+// of final values. The running sums are updated serially, so that every chunk
+// starts with the same rounding errors as a single pass over the data.
+// Returns false if the computation was cancelled by the user.
+template <class Fit, class Final>
+bool slidingTemplateFit(const Vector_double& data_c, const Vector_double& templ, Vector_double& out,
+                        const Fit& fit, Final& onFinal,
+                        stfio::ProgressInfo& progDlg, const std::string& progStr)
 {
-    // to avoid unnecessary copying, we first reserve quite
-    // a bit of space for the vector:
-    std::vector<int> peakInd;
-    peakInd.reserve(data.size());
-    for (unsigned n_data=0; n_data<data.size(); ++n_data) {
-        // check whether the data point is above threshold...
-        int llp=n_data;
-        int ulp=n_data+1;
-        if (data[n_data]>threshold) {
-            // ... and if so, find the data point where the threshold
-            // is crossed again in the opposite direction, ...
-            for (;;) {
-                if (n_data>data.size()-2) {
-                    ulp=(int)data.size()-1;
-                    break;
-                }
-                n_data++;
-                if (data[n_data]<threshold && (int)n_data-ulp>minDistance) {
-                    // ... making this the upper limit of the peak window:
-                    ulp=n_data;
-                    break;
-                }
+    std::size_t n_templ = templ.size(), n_out = out.size();
+    if (n_out == 0) {
+        return true;
+    }
+    SlidingDotProduct dotProduct(data_c, templ);
+    std::size_t chunk = dotProduct.Step() * std::max((std::size_t)1, DETECT_CHUNK/dotProduct.Step());
+    std::size_t n_chunks = (n_out+chunk-1)/chunk;
+    std::size_t n_wave = 1;
+#ifdef _OPENMP
+    n_wave = 4*omp_get_max_threads();
+#endif
+
+    WindowSums sums;
+    initWindow(data_c, 0, n_templ, sums);
+    std::size_t n_sums = 0; // offset of the window of sums
+    std::vector<WindowSums> chunkSums(n_wave);
+    bool skipped = false;
+    for (std::size_t wave = 0; wave < n_chunks; wave += n_wave) {
+        progDlg.Update( (int)((double)wave/(double)n_chunks*100.0), progStr, &skipped );
+        if (skipped) {
+            return false;
+        }
+        int c_end = (int)std::min(n_wave, n_chunks-wave);
+        for (int c = 0; c < c_end; ++c) {
+            for (std::size_t first = (wave+c)*chunk; n_sums < first; ) {
+                slideWindow(data_c, ++n_sums, n_templ, sums);
             }
-            // Now, find the peak within the window:
-            double max=-1e8;
-            int peakIndex=llp;
-            for (int n_p=llp; n_p<=ulp; ++n_p) {
-                if (data[n_p]>max) {
-                    max=data[n_p];
-                    peakIndex=n_p;
+            chunkSums[c] = sums;
+        }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if(c_end > 1)
+#endif
+        for (int c = 0; c < c_end; ++c) {
+            std::size_t first = (wave+c)*chunk;
+            std::size_t last = std::min(n_out, first+chunk);
+            dotProduct(first, last, out);
+            // Local copies, so that the compiler knows that they don't change while out is written:
+            const Fit chunk_fit(fit);
+            WindowSums chunk_sums = chunkSums[c];
+            double* chunk_out = &out[0];
+            for (std::size_t n_data = first; n_data < last; ++n_data) {
+                if (n_data != first) {
+                    slideWindow(data_c, n_data, n_templ, chunk_sums);
                 }
+                chunk_out[n_data] = chunk_fit(chunk_out[n_data], chunk_sums.mean, chunk_sums.m2);
             }
-            peakInd.push_back(peakIndex);
         }
+        onFinal(std::min(n_out, (wave+c_end)*chunk));
     }
-    // Trim peakInd's reserved memory:
-    std::vector<int>(peakInd.begin(),peakInd.end()).swap(peakInd);
-    return peakInd;
+    return true;
 }
 
-Vector_double
-stfnum::linCorr(const Vector_double& data, const Vector_double& templ, stfio::ProgressInfo& progDlg)
+// Returns a copy of data without its mean. The detection functions don't
+// depend on a constant offset of the data; removing the mean improves the
+// accuracy of the running sums.
+Vector_double meanFree(const Vector_double& data) {
+    double mean_data = 0.0;
+    for (std::size_t n = 0; n < data.size(); ++n) {
+        mean_data += data[n];
+    }
+    mean_data /= data.size();
+    Vector_double data_c(data.size());
+    for (std::size_t n = 0; n < data.size(); ++n) {
+        data_c[n] = data[n]-mean_data;
+    }
+    return data_c;
+}
+
+// Optimally scaled template according to Clements & Bekkers (1997); variable
+// names are taken from the paper as long as they don't interfere with C++
+// keywords (such as "template").
+class CriterionFit {
+  public:
+    explicit CriterionFit(const Vector_double& templ)
+        : n_templ(templ.size()), sum_templ(0.0), sum_templ_sqr(0.0)
+    {
+        for (std::size_t n = 0; n < n_templ; ++n) {
+            sum_templ+=templ[n];
+            sum_templ_sqr+=templ[n]*templ[n];
+        }
+    }
+
+    // Returns the detection criterion.
+    double operator()(double sum_templ_data, double mean_data, double m2_data) const {
+        double sum_data=mean_data*n_templ;
+        double sum_data_sqr=m2_data+sum_data*mean_data;
+        double scale=(sum_templ_data-sum_templ*sum_data/n_templ)/
+            (sum_templ_sqr-sum_templ*sum_templ/n_templ);
+        double offset=(sum_data-scale*sum_templ)/n_templ;
+        double sse=sum_data_sqr+scale*scale*sum_templ_sqr+n_templ*offset*offset -
+            2.0*(scale*sum_templ_data +
+                 offset*sum_data-scale*offset*sum_templ);
+        double standard_error=sqrt(sse/(n_templ-1));
+        return scale/standard_error;
+    }
+
+  private:
+    std::size_t n_templ;
+    double sum_templ, sum_templ_sqr;
+};
+
+// Linear correlation between the data and the optimally scaled template.
+class CorrelationFit {
+  public:
+    explicit CorrelationFit(const Vector_double& templ)
+        : n_templ(templ.size()), sum_templ(0.0), sum_templ_sqr(0.0), sd_templ_raw(0.0)
+    {
+        for (std::size_t n = 0; n < n_templ; ++n) {
+            sum_templ+=templ[n];
+            sum_templ_sqr+=templ[n]*templ[n];
+        }
+        // The SD of the template doesn't depend on the offset. The optimal
+        // template scale*templ+offset has an SD of fabs(scale)*sd_templ_raw.
+        double mean_templ=sum_templ/n_templ;
+        for (std::size_t i=0;i<n_templ;++i) {
+            sd_templ_raw+=stfnum::SQR(templ[i]-mean_templ);
+        }
+        sd_templ_raw=sqrt(sd_templ_raw/n_templ);
+    }
+
+    // Returns the correlation coefficient, or 0 if the data or the template are constant.
+    double operator()(double sum_templ_data, double mean_data, double m2_data) const {
+        double scale=(sum_templ_data-sum_templ*mean_data)/
+            (sum_templ_sqr-sum_templ*sum_templ/n_templ);
+
+        // Now that the optimal template has been found,
+        // compute the correlation between data and optimal template.
+        // Get SDs:
+        double sd_data=sqrt(m2_data > 0.0 ? m2_data/n_templ : 0.0);
+        double sd_templ=fabs(scale)*sd_templ_raw;
+        if (sd_data == 0.0 || sd_templ == 0.0) {
+            return 0.0;
+        }
+
+        // Get correlation:
+        double r=scale*(sum_templ_data-mean_data*sum_templ);
+        r/=((n_templ-1)*sd_data*sd_templ);
+        return r;
+    }
+
+  private:
+    std::size_t n_templ;
+    double sum_templ, sum_templ_sqr, sd_templ_raw;
+};
+
+template <class Final>
+bool criterionTrace(const Vector_double& data, const Vector_double& templ, Vector_double& detection_criterion,
+                    Final& onFinal, stfio::ProgressInfo& progDlg)
+{
+    if (data.size()<templ.size()) {
+        throw std::runtime_error("Template larger than data in stfnum::detectionCriterion");
+    }
+    detection_criterion.resize(data.size()-templ.size());
+    if (detection_criterion.empty() || templ.empty()) {
+        return true;
+    }
+    return slidingTemplateFit(meanFree(data), templ, detection_criterion, CriterionFit(templ),
+                              onFinal, progDlg, "Calculating detection criterion");
+}
+
+template <class Final>
+bool correlationTrace(const Vector_double& data, const Vector_double& templ, Vector_double& Corr,
+                      Final& onFinal, stfio::ProgressInfo& progDlg)
 {
-    bool skipped = false;
     // the template has to be smaller than the data waveform:
     if (data.size()<templ.size()) {
         throw std::runtime_error("Template larger than data in stfnum::crossCorr");
@@ -345,84 +770,253 @@ stfnum::linCorr(const Vector_double& data, const Vector_double& templ, stfio::Pr
     if (data.size()==0 || templ.size()==0) {
         throw std::runtime_error("Array of size 0 in stfnum::crossCorr");
     }
-    Vector_double Corr(data.size()-templ.size());
-
-    // Optimal scaling & offset:
-    // avoid redundant computations:
-    double sum_templ_data=0.0, sum_templ=0.0, sum_templ_sqr=0.0, sum_data=0.0, sum_data_sqr=0.0;
-    for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-        sum_templ_data+=templ[n_templ]*data[0+n_templ];
-        sum_data+=data[0+n_templ];
-        sum_data_sqr+=data[0+n_templ]*data[0+n_templ];
-        sum_templ+=templ[n_templ];
-        sum_templ_sqr+=templ[n_templ]*templ[n_templ];
-    }
-    double y_old=0.0;
-    double y2_old=0.0;
-    int progCounter=0;
-    double progFraction=(data.size()-templ.size())/100.0;
-    for (unsigned n_data=0; n_data<data.size()-templ.size(); ++n_data) {
-        if (n_data/progFraction>progCounter) {
-            progDlg.Update( (int)((double)n_data/(double)(data.size()-templ.size())*100.0),
-                            "Calculating correlation coefficient", &skipped );
-            if (skipped) {
-                Corr.resize(0);
-                return Corr;
-            }
-            progCounter++;
+    Corr.resize(data.size()-templ.size());
+    return slidingTemplateFit(meanFree(data), templ, Corr, CorrelationFit(templ),
+                              onFinal, progDlg, "Calculating correlation coefficient");
+}
+
+// Window of an event found by peakIndices(): data points first..last.
+struct PeakWindow {
+    int first, last, peak;
+};
+
+// Marks a peak search that needs data points which are not final yet.
+const std::size_t PEAK_PENDING = std::numeric_limits<std::size_t>::max();
+
+// Examines data point n_data of the peak search. If it's above threshold, it
+// starts an event window that ends where the data are below threshold again,
+// at least minDistance points later; the window and its largest value are
+// appended to windows. Returns the data point that is examined next, or
+// PEAK_PENDING if the window reaches beyond the first 'available' data points.
+std::size_t peakStep(const Vector_double& data, std::size_t available, std::size_t n_data,
+                     double threshold, int minDistance, std::vector<PeakWindow>& windows)
+{
+    // check whether the data point is above threshold...
+    if (!(data[n_data]>threshold)) {
+        return n_data+1;
+    }
+    int llp=(int)n_data;
+    int ulp=(int)n_data+1;
+    // ... and if so, find the data point where the threshold
+    // is crossed again in the opposite direction, ...
+    for (;;) {
+        if (n_data+2>data.size()) {
+            ulp=(int)data.size()-1;
+            break;
         }
-        if (n_data!=0) {
-            sum_templ_data=0.0;
-            // The product has to be computed in full length:
-            for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-                sum_templ_data+=templ[n_templ]*data[n_data+n_templ];
-            }
-            // The new value that will be added is:
-            double y_new=data[n_data+templ.size()-1];
-            double y2_new=data[n_data+templ.size()-1]*data[n_data+templ.size()-1];
-            sum_data+=y_new-y_old;
-            sum_data_sqr+=y2_new-y2_old;
+        n_data++;
+        if (n_data>=available) {
+            return PEAK_PENDING;
+        }
+        if (data[n_data]<threshold && (int)n_data-ulp>minDistance) {
+            // ... making this the upper limit of the peak window:
+            ulp=(int)n_data;
+            break;
         }
-        // The first value that was added (and will have to be subtracted during
-        // the next loop):
-        y_old=data[n_data+0];
-        y2_old=data[n_data+0]*data[n_data+0];
+    }
+    // Now, find the peak within the window:
+    double max=-1e8;
+    int peakIndex=llp;
+    for (int n_p=llp; n_p<=ulp; ++n_p) {
+        if (data[n_p]>max) {
+            max=data[n_p];
+            peakIndex=n_p;
+        }
+    }
+    PeakWindow window = {llp, ulp, peakIndex};
+    windows.push_back(window);
+    return ulp+1;
+}
 
-        double scale=(sum_templ_data-sum_templ*sum_data/templ.size())/
-        (sum_templ_sqr-sum_templ*sum_templ/templ.size());
-        double offset=(sum_data-scale*sum_templ)/templ.size();
+// Number of data points per chunk of the peak search.
+const std::size_t PEAK_CHUNK = 1 << 18;
+
+// Peak search of a chunk of data points, starting at its first point as if
+// no event window were open there.
+struct PeakChunk {
+    std::size_t first, last;
+    std::vector<PeakWindow> windows;
+    std::size_t next;  // data point examined next; the start of the open window if pending
+    bool pending;
+
+    void Search(const Vector_double& data, std::size_t available, double threshold, int minDistance) {
+        next = first;
+        pending = false;
+        while (next < last) {
+            // Data points below threshold are skipped quickly:
+            if (!(data[next]>threshold)) {
+                ++next;
+                continue;
+            }
+            std::size_t n_data = peakStep(data, available, next, threshold, minDistance, windows);
+            if (n_data == PEAK_PENDING) {
+                pending = true;
+                break;
+            }
+            next = n_data;
+        }
+    }
 
-        // Now that the optimal template has been found,
-        // compute the correlation between data and optimal template.
-        // The correlation coefficient is computed in a way that avoids
-        // numerical instability; therefore, the sum of squares
-        // computed above can't be re-used.
-        // Get the means:
-        double mean_data=sum_data/templ.size();
-        double sum_optTempl=sum_templ*scale+offset*templ.size();
-        double mean_optTempl=sum_optTempl/templ.size();
+    // Indicates whether the search of the chunk examines data point n_data.
+    bool Examines(std::size_t n_data) const {
+        if (n_data < first || n_data >= last || (pending && n_data > next)) {
+            return false;
+        }
+        // The last window that starts at or before n_data:
+        std::size_t lo = 0, hi = windows.size();
+        while (lo < hi) {
+            std::size_t mid = (lo+hi)/2;
+            if ((std::size_t)windows[mid].first <= n_data) {
+                lo = mid+1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo == 0 || n_data == (std::size_t)windows[lo-1].first ||
+            n_data > (std::size_t)windows[lo-1].last;
+    }
+};
+
+// Finds the same peaks as a single pass of peakIndices() over the data, with
+// chunks that are searched in parallel if OpenMP is enabled. Where the single
+// pass is at a different state at the start of a chunk (because an event
+// window reaches into it), the single pass is continued until it meets the
+// search of the chunk; from there on, both examine the same data points.
+class PeakSearch {
+  public:
+    PeakSearch(const Vector_double& data_, double threshold_, int minDistance_)
+        : data(data_), threshold(threshold_), minDistance(minDistance_), n_next(0) {}
+
+    // Searches the first 'available' data points, which have to be final, and
+    // appends the new peaks to peakInd.
+    void Advance(std::size_t available, std::vector<int>& peakInd);
+
+  private:
+    const Vector_double& data;
+    double threshold;
+    int minDistance;
+    std::size_t n_next; // data point examined next by the single pass
+};
+
+void PeakSearch::Advance(std::size_t available, std::vector<int>& peakInd) {
+    if (n_next >= available) {
+        return;
+    }
+    int n_chunks = (int)((available-n_next+PEAK_CHUNK-1)/PEAK_CHUNK);
+    std::vector<PeakChunk> chunks(n_chunks);
+    for (int c = 0; c < n_chunks; ++c) {
+        chunks[c].first = n_next + c*PEAK_CHUNK;
+        chunks[c].last = std::min(available, chunks[c].first+PEAK_CHUNK);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if(n_chunks > 1)
+#endif
+    for (int c = 0; c < n_chunks; ++c) {
+        chunks[c].Search(data, available, threshold, minDistance);
+    }
 
-        // Get SDs:
-        double sd_data=0.0;
-        double sd_templ=0.0;
-        for (int i=0;i<(int)templ.size();++i) {
-            sd_data+=SQR(data[i+n_data]-mean_data);
-            sd_templ+=SQR(templ[i]*scale+offset-mean_optTempl);
+    std::vector<PeakWindow> windows;
+    for (int c = 0; c < n_chunks; ++c) {
+        const PeakChunk& chunk = chunks[c];
+        while (n_next < chunk.last && !chunk.Examines(n_next)) {
+            windows.clear();
+            std::size_t n_data = peakStep(data, available, n_next, threshold, minDistance, windows);
+            if (n_data == PEAK_PENDING) {
+                return;
+            }
+            if (!windows.empty()) {
+                peakInd.push_back(windows[0].peak);
+            }
+            n_next = n_data;
+        }
+        if (n_next >= chunk.last) {
+            continue;
+        }
+        for (std::size_t n_w = 0; n_w < chunk.windows.size(); ++n_w) {
+            if ((std::size_t)chunk.windows[n_w].first >= n_next) {
+                peakInd.push_back(chunk.windows[n_w].peak);
+            }
+        }
+        n_next = chunk.next;
+        if (chunk.pending) {
+            return;
         }
-        sd_data=sqrt(sd_data/templ.size());
-        sd_templ=sqrt(sd_templ/templ.size());
+    }
+}
 
-        // Get correlation:
-        double r=0.0;
-        for (int i=0;i<(int)templ.size();++i) {
-            r+=(data[i+n_data]-mean_data)*(templ[i]*scale+offset-mean_optTempl);
+// Searches the detection criterion for peaks whenever a part of it is final,
+// and passes the new events to a sink.
+class EventStream {
+  public:
+    EventStream(const Vector_double& detect, double threshold, int minDistance,
+                const stfnum::EventSink& sink_)
+        : search(detect, threshold, minDistance), sink(sink_), events() {}
+
+    void operator()(std::size_t available) {
+        std::size_t n_old = events.size();
+        search.Advance(available, events);
+        if (sink && events.size() > n_old) {
+            sink(std::vector<int>(events.begin()+n_old, events.end()));
         }
-        r/=((templ.size()-1)*sd_data*sd_templ);
-        Corr[n_data]=r;
+    }
+
+    const std::vector<int>& Events() const { return events; }
+
+  private:
+    PeakSearch search;
+    const stfnum::EventSink& sink;
+    std::vector<int> events;
+};
+
+}
+
+Vector_double
+stfnum::detectionCriterion(const Vector_double& data, const Vector_double& templ, stfio::ProgressInfo& progDlg)
+{
+    Vector_double detection_criterion;
+    IgnoreFinal ignore;
+    if (!criterionTrace(data, templ, detection_criterion, ignore, progDlg)) {
+        detection_criterion.resize(0);
+    }
+    return detection_criterion;
+}
+
+std::vector<int>
+stfnum::peakIndices(const Vector_double& data, double threshold,
+                 int minDistance)
+{
+    std::vector<int> peakInd;
+    PeakSearch search(data, threshold, minDistance);
+    search.Advance(data.size(), peakInd);
+    return peakInd;
+}
+
+Vector_double
+stfnum::linCorr(const Vector_double& data, const Vector_double& templ, stfio::ProgressInfo& progDlg)
+{
+    Vector_double Corr;
+    IgnoreFinal ignore;
+    if (!correlationTrace(data, templ, Corr, ignore, progDlg)) {
+        Corr.resize(0);
     }
     return Corr;
 }
 
+std::vector<int>
+stfnum::detectEvents(const Vector_double& data, const Vector_double& templ, stfnum::detection_method method,
+                     double threshold, int minDistance, stfio::ProgressInfo& progDlg,
+                     const stfnum::EventSink& sink)
+{
+    Vector_double detect;
+    EventStream stream(detect, threshold, minDistance, sink);
+    if (method == stfnum::detect_correlation) {
+        correlationTrace(data, templ, detect, stream, progDlg);
+    } else {
+        criterionTrace(data, templ, detect, stream, progDlg);
+    }
+    return stream.Events();
+}
+
 double stfnum::integrate_simpson(
         const Vector_double& input,
         std::size_t i1,
@@ -652,6 +1246,27 @@ Vector_double stfnum::nojac(double x, const Vector_double& p) {
     return Vector_double(0);
 }
 
+void stfnum::storedFunc::eval(const double* x, std::size_t n, const Vector_double& p, double* out) const {
+    if (batchFunc) {
+        batchFunc(x, n, p, out);
+        return;
+    }
+    for (std::size_t n_x=0; n_x<n; ++n_x) {
+        out[n_x] = func(x[n_x], p);
+    }
+}
+
+void stfnum::storedFunc::evalJac(const double* x, std::size_t n, const Vector_double& p, double* out) const {
+    if (batchJac) {
+        batchJac(x, n, p, out);
+        return;
+    }
+    for (std::size_t n_x=0; n_x<n; ++n_x) {
+        Vector_double jac_x(jac(x[n_x], p));
+        std::copy(jac_x.begin(), jac_x.end(), &out[n_x*p.size()]);
+    }
+}
+
 double stfnum::noscale(double param, double xscale, double oldx, double yscale, double yoff) {
     return param;
 }
@@ -687,8 +1302,8 @@ stfnum::histogram(const Vector_double& data, int nbins) {
         nbins = int(data.size()/100.0);
     }
 
-    double fmax = *std::max_element(data.begin(), data.end());
-    double fmin = *std::min_element(data.begin(), data.end());
+    double fmax = *std::max_element(data.begin(), data.end());
+    double fmin = *std::min_element(data.begin(), data.end());
     fmax += (fmax-fmin)*1e-9;
 
     double bin = (fmax-fmin)/nbins;
@@ -737,25 +1352,21 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
     //fftw_complex is a double[2]; hence, out is an array of
     //double[2] with out[n][0] being the real and out[n][1] being
     //the imaginary part.
-    fftw_plan p_data, p_templ, p_inv;
+    stfnum::FFTPlanPtr p_fwd = stfnum::fftPlan(data.size(), 1, stfnum::fft_forward);
 
     //memory allocation as suggested by fftw:
     double* in_data =(double *)fftw_malloc(sizeof(double) * data.size());
     std::copy(data.begin(), data.end(), in_data);
     fftw_complex* out_data = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * ((int)(data.size()/2)+1));
 
-    //plan the ffts and execute them:
-    p_data =fftw_plan_dft_r2c_1d((int)data.size(), in_data, out_data,
-                                 FFTW_ESTIMATE);
-    fftw_execute(p_data);
+    //execute the ffts:
+    fftw_execute_dft_r2c(p_fwd.get(), in_data, out_data);
     if (isnan(out_data[0][0]) || isinf(out_data[0][0])) {
         data_return.resize(0);
         throw std::runtime_error("Unstable fft; try again avoiding any test pulses (if present)");
     }
     fftw_complex* out_templ_padded = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * ((int)(data.size()/2)+1));
-    p_templ =fftw_plan_dft_r2c_1d((int)data.size(),
-                                  in_templ_padded, out_templ_padded, FFTW_ESTIMATE);
-    fftw_execute(p_templ);
+    fftw_execute_dft_r2c(p_fwd.get(), in_templ_padded, out_templ_padded);
 
     double SI=1.0/SR; //the sampling interval
     progDlg.Update( 25, "Performing deconvolution...", &skipped );
@@ -793,8 +1404,7 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
     }
 
     //do the reverse fft:
-    p_inv = fftw_plan_dft_c2r_1d((int)data.size(),out_data, in_data, FFTW_ESTIMATE);
-    fftw_execute(p_inv);
+    fftw_execute_dft_c2r(stfnum::fftPlan(data.size(), 1, stfnum::fft_backward).get(), out_data, in_data);
 
     //fill the return array, adding the offset, and scaling by data.size()
     //(because fftw computes an unnormalized transform):
@@ -802,10 +1412,6 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
         data_return[n_point]= in_data[n_point]/data.size();
     }
 
-    fftw_destroy_plan(p_data);
-    fftw_destroy_plan(p_templ);
-    fftw_destroy_plan(p_inv);
-
     fftw_free(in_data);
     fftw_free(out_data);
     fftw_free(in_templ_padded);
@@ -79,6 +79,21 @@ typedef boost::function<Vector_double(double, const Vector_double&)> Jac;
 //! Scaling function for fit parameters
 typedef boost::function<double(double, double, double, double, double)> Scale;
 
+//! Receives the indices of events while they are being detected.
+typedef boost::function<void(const std::vector<int>&)> EventSink;
+
+//! Evaluates a stfnum::Func at many x-values at once.
+/*! Arguments are the x-values, their number, the parameters and the
+ *  array that receives one y-value per x-value.
+ */
+typedef boost::function<void(const double*, std::size_t, const Vector_double&, double*)> BatchFunc;
+
+//! Evaluates a stfnum::Jac at many x-values at once.
+/*! Arguments are the x-values, their number \e n, the parameters \e p and a
+ *  row-major array of \e n x \e p.size() that receives the derivatives.
+ */
+typedef boost::function<void(const double*, std::size_t, const Vector_double&, double*)> BatchJac;
+
 #else
 
 typedef std::function<double(double, const Vector_double&)> Func;
@@ -89,6 +104,21 @@ typedef std::function<Vector_double(double, const Vector_double&)> Jac;
 //! Scaling function for fit parameters
 typedef std::function<double(double, double, double, double, double)> Scale;
 
+//! Receives the indices of events while they are being detected.
+typedef std::function<void(const std::vector<int>&)> EventSink;
+
+//! Evaluates a stfnum::Func at many x-values at once.
+/*! Arguments are the x-values, their number, the parameters and the
+ *  array that receives one y-value per x-value.
+ */
+typedef std::function<void(const double*, std::size_t, const Vector_double&, double*)> BatchFunc;
+
+//! Evaluates a stfnum::Jac at many x-values at once.
+/*! Arguments are the x-values, their number \e n, the parameters \e p and a
+ *  row-major array of \e n x \e p.size() that receives the derivatives.
+ */
+typedef std::function<void(const double*, std::size_t, const Vector_double&, double*)> BatchJac;
+
 #endif
 //! Dummy function, serves as a placeholder to initialize functions without a Jacobian.
 Vector_double nojac( double x, const Vector_double& p);
@@ -264,12 +294,16 @@ struct StfioDll storedFunc {
      *  \param hasJac_ true if a Jacobian is available.
      *  \param init_ A function for initialising the parameters.
      *  \param output_ Output of the fit.
+     *  \param batchFunc_ Evaluates func_ at many x-values at once; optional.
+     *  \param batchJac_ Evaluates jac_ at many x-values at once; optional.
      */
     storedFunc( const std::string& name_, const std::vector<parInfo>& pInfo_,
             const Func& func_, const Init& init_, const Jac& jac_, bool hasJac_ = true,
-            const Output& output_ = defaultOutput /*,
+            const Output& output_ = defaultOutput,
+            const BatchFunc& batchFunc_ = BatchFunc(), const BatchJac& batchJac_ = BatchJac() /*,
             bool hasId_ = true*/
-    ) : name(name_),pInfo(pInfo_),func(func_),init(init_),jac(jac_),hasJac(hasJac_),output(output_) /*, hasId(hasId_)*/
+    ) : name(name_),pInfo(pInfo_),func(func_),init(init_),jac(jac_),hasJac(hasJac_),output(output_),
+        batchFunc(batchFunc_),batchJac(batchJac_) /*, hasId(hasId_)*/
     {
 /*        if (hasId) {
             id = NextId();
@@ -283,6 +317,24 @@ struct StfioDll storedFunc {
     //! Destructor
     ~storedFunc() { }
 
+    //! Evaluates the function at many x-values.
+    /*! Uses batchFunc if available, func otherwise.
+     *  \param x The x-values.
+     *  \param n The number of x-values.
+     *  \param p The parameters of the function.
+     *  \param out On exit, the n y-values.
+     */
+    void eval(const double* x, std::size_t n, const Vector_double& p, double* out) const;
+
+    //! Evaluates the Jacobian at many x-values.
+    /*! Uses batchJac if available, jac otherwise.
+     *  \param x The x-values.
+     *  \param n The number of x-values.
+     *  \param p The parameters of the function.
+     *  \param out On exit, a row-major array of n x p.size() derivatives.
+     */
+    void evalJac(const double* x, std::size_t n, const Vector_double& p, double* out) const;
+
 //    static int n_funcs;          /*!< Static function counter */
 //    int id;                      /*!< Function id; set automatically upon construction, so don't touch. */
     std::string name;            /*!< Function name. */
@@ -292,6 +344,8 @@ struct StfioDll storedFunc {
     Jac jac;                     /*!< Jacobian of func. */
     bool hasJac;                 /*!< True if the function has an analytic Jacobian. */
     Output output;               /*!< Output of the fit. */
+    BatchFunc batchFunc;         /*!< Evaluates func at many x-values at once; may be empty. */
+    BatchJac batchJac;           /*!< Evaluates jac at many x-values at once; may be empty. */
 //    bool hasId;                  /*!< Determines whether a function should have an id. */
 
 };
@@ -344,6 +398,85 @@ StfioDll Vector_double
 deconvolve(const Vector_double& data, const Vector_double& templ,
            int SR, double hipass, double lopass, stfio::ProgressInfo& progDlg);
 
+//! Convolves the same window of several sections with a filter function.
+/*! All windows are transformed with a single batched FFTW plan, and the
+ *  filter function is evaluated only once for all sections.
+ *  \param channel The channel containing the sections.
+ *  \param sections Indices of the sections to be filtered.
+ *  \param filter_start The index from which to start filtering.
+ *  \param filter_end The index at which to stop filtering.
+ *  \param a A valarray of parameters for the filter function.
+ *  \param SR The sampling rate.
+ *  \param func The filter function in the frequency domain.
+ *  \param inverse true if (1- \e func) should be used as the filter function, false otherwise
+ *  \param parallel true if the sections should be split between OpenMP threads.
+ *  \return The convolved data sets, in the order of \e sections.
+ */
+StfioDll std::vector<Vector_double>
+filterBatch(
+        const Channel& channel,
+        const std::vector<std::size_t>& sections,
+        std::size_t filter_start,
+        std::size_t filter_end,
+        const Vector_double &a,
+        int SR,
+        stfnum::Func func,
+        bool inverse = false,
+        bool parallel = false
+);
+
+//! Direction of a fast Fourier transform of real data.
+enum fft_direction {
+    fft_forward,  /*!< Real to complex. */
+    fft_backward  /*!< Complex to real; overwrites the input array. */
+};
+
+//! Shared ownership of an FFTW plan.
+#if (__cplusplus < 201103)
+typedef boost::shared_ptr<fftw_plan_s> FFTPlanPtr;
+#else
+typedef std::shared_ptr<fftw_plan_s> FFTPlanPtr;
+#endif
+
+//! Returns a cached plan for contiguous one-dimensional real-data transforms.
+/*! The most recently used plans are cached, so that repeated transforms of
+ *  the same size are planned only once. A plan stays valid as long as the
+ *  returned pointer is held, even if it has been evicted from the cache in
+ *  the meantime. As it can be shared, it has to be executed with
+ *  fftw_execute_dft_r2c() or fftw_execute_dft_c2r(). Planning is serialised,
+ *  so that this can be called from OpenMP threads. Throws std::runtime_error
+ *  if FFTW can't create the plan.
+ *  \param size Number of real data points per transform.
+ *  \param howmany Number of transforms; the arrays hold them one after the other,
+ *         with size real or size/2+1 complex data points each.
+ *  \param direction The direction of the transforms.
+ *  \param aligned false if the arrays may not be SIMD-aligned (i.e. they were
+ *         not allocated with fftw_malloc()).
+ *  \return The plan.
+ */
+StfioDll FFTPlanPtr
+fftPlan(std::size_t size, std::size_t howmany, stfnum::fft_direction direction, bool aligned = true);
+
+//! Sets the FFTW planner flags for plans that are not cached yet.
+/*! FFTW_ESTIMATE is used by default. FFTW_MEASURE yields faster transforms,
+ *  but takes some time to plan every new size unless the plans are known
+ *  from imported wisdom.
+ *  \param flags The planner flags, e.g. FFTW_ESTIMATE or FFTW_MEASURE.
+ */
+StfioDll void setFFTPlannerFlags(unsigned flags);
+
+//! Adds FFTW wisdom from a file to the planner.
+/*! \param filename The wisdom file.
+ *  \return false if the file couldn't be read.
+ */
+StfioDll bool importFFTWisdom(const std::string& filename);
+
+//! Writes the accumulated FFTW wisdom to a file.
+/*! \param filename The wisdom file.
+ *  \return false if the file couldn't be written.
+ */
+StfioDll bool exportFFTWisdom(const std::string& filename);
+
 //! Interpolates a dataset using cubic splines.
 /*! \param y The valarray to be interpolated.
  *  \param oldF The original sampling frequency.
@@ -456,6 +589,31 @@ StfioDll std::vector<int> peakIndices(const Vector_double& data, double threshol
  */
 StfioDll Vector_double linCorr(const Vector_double& va1, const Vector_double& va2, stfio::ProgressInfo& progDlg); 
 
+//! Template matching methods for event detection.
+enum detection_method {
+    detect_criterion,  /*!< Detection criterion (see detectionCriterion()). */
+    detect_correlation /*!< Linear correlation (see linCorr()). */
+};
+
+//! Detects events by template matching.
+/*! Gives the same events as peakIndices() of detectionCriterion() or linCorr(),
+ *  but the trace is split into chunks that are processed in parallel if
+ *  OpenMP is enabled, and events are passed to \e sink as soon as they are found.
+ *  \param data The trace from which to extract events.
+ *  \param templ A template waveform that is used for event detection.
+ *  \param method The template matching method.
+ *  \param threshold Minimal amplitude of a peak of the detection criterion or correlation.
+ *  \param minDistance Minimal distance between subsequent peaks.
+ *  \param progDlg Progress indicator.
+ *  \param sink Receives batches of event indices in ascending order; may be empty.
+ *  \return The indices of all events, or of the events found so far if the
+ *          detection was cancelled.
+ */
+StfioDll std::vector<int>
+detectEvents(const Vector_double& data, const Vector_double& templ, stfnum::detection_method method,
+             double threshold, int minDistance, stfio::ProgressInfo& progDlg,
+             const stfnum::EventSink& sink = stfnum::EventSink());
+
 //! Computes a Gaussian that can be used as a filter kernel.
 /*! \f[
  *      f(x) = \mathrm{e}^{-0.3466 \left( \frac{x}{p_{0}} \right) ^2}   
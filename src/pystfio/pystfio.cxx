@@ -84,7 +84,51 @@ stfio::filetype gettype(const std::string& ftype) {
     return stftype;
 }
 
+namespace {
+
+// The name of a file type, as accepted by gettype().
+const char* gettypename(stfio::filetype stftype) {
+    switch (stftype) {
+    case stfio::cfs: return "cfs";
+    case stfio::hdf5: return "hdf5";
+    case stfio::abf: return "abf";
+    case stfio::atf: return "atf";
+    case stfio::axg: return "axg";
+    case stfio::biosig: return "biosig";
+    case stfio::heka: return "heka";
+    case stfio::igor: return "igor";
+    case stfio::tdms: return "tdms";
+    case stfio::intan: return "intan";
+    default: return "";
+    }
+}
+
+}
+
 bool _read(const std::string& filename, const std::string& ftype, bool verbose, Recording& Data) {
+    return _read_selection(filename, ftype, verbose, Data, NULL, 0, 0, 0, 0, 0);
+}
+
+bool _read_selection(const std::string& filename, const std::string& ftype, bool verbose, Recording& Data,
+                     int* channels, int n_channels, int first_section, int n_sections,
+                     int first_point, int n_points)
+{
+    if (first_section < 0 || n_sections < 0 || first_point < 0 || n_points < 0) {
+        std::cerr << "Error importing file:\nNegative selection" << std::endl;
+        return false;
+    }
+    stfio::importRequest request;
+    for (int n_c=0; n_c < n_channels; ++n_c) {
+        if (channels[n_c] < 0) {
+            std::cerr << "Error importing file:\nNegative channel index" << std::endl;
+            return false;
+        }
+        request.channels.push_back(channels[n_c]);
+    }
+    request.firstSection = first_section;
+    request.nSections = n_sections;
+    request.firstPoint = first_point;
+    request.nPoints = n_points;
 
 #ifndef TEST_MINIMAL
     stfio::filetype stftype = gettype(ftype);
@@ -96,7 +140,7 @@ bool _read(const std::string& filename, const std::string& ftype, bool verbose,
     stfio::StdoutProgressInfo progDlg("File import", "Starting file import", 100, verbose);
     
     try {
-        if (!stfio::importFile(filename, stftype, Data, tis, progDlg)) {
+        if (!stfio::importFile(filename, stftype, Data, tis, progDlg, request)) {
             std::cerr << "Error importing file\n";
             return false;
         }
@@ -109,6 +153,64 @@ bool _read(const std::string& filename, const std::string& ftype, bool verbose,
     return true;
 }
 
+PyObject* _read_metadata(const std::string& filename, const std::string& ftype)
+{
+#ifndef TEST_MINIMAL
+    stfio::filetype stftype = gettype(ftype);
+#else
+    const stfio::filetype stftype = stfio::none;
+#endif // TEST_MINIMAL
+
+    stfio::fileMetadata metadata;
+    try {
+        metadata = stfio::importMetadata(filename, stftype);
+    } catch (const std::exception& e) {
+        std::cerr << "Error reading file header:\n"
+                  << e.what() << std::endl;
+        return Py_BuildValue("");
+    }
+
+    PyObject* channels = PyList_New(metadata.channelNames.size());
+    if (channels == NULL) {
+        return NULL;
+    }
+    for (std::size_t n_c=0; n_c < metadata.channelNames.size(); ++n_c) {
+        PyObject* channel = Py_BuildValue("{s:s,s:s,s:n}",
+                                          "name", metadata.channelNames[n_c].c_str(),
+                                          "yunits", metadata.yUnits[n_c].c_str(),
+                                          "sections", (Py_ssize_t)metadata.nSections[n_c]);
+        if (channel == NULL) {
+            Py_DECREF(channels);
+            return NULL;
+        }
+        PyList_SET_ITEM(channels, n_c, channel);
+    }
+    const struct tm& t = metadata.datetime;
+    return Py_BuildValue("{s:s,s:d,s:s,s:N,s:(iiiiii),s:s,s:s,s:s}",
+                         "ftype", gettypename(metadata.type),
+                         "dt", metadata.dt,
+                         "xunits", metadata.xUnits.c_str(),
+                         "channels", channels,
+                         "datetime", t.tm_year+1900, t.tm_mon+1, t.tm_mday,
+                                     t.tm_hour, t.tm_min, t.tm_sec,
+                         "comment", metadata.comment.c_str(),
+                         "file_description", metadata.fileDescription.c_str(),
+                         "section_description", metadata.globalSectionDescription.c_str());
+}
+
+PyObject* sniff_statistics()
+{
+    stfio::sniffStatistics counts = stfio::getSniffStatistics();
+    return Py_BuildValue("{s:n,s:n}",
+                         "hits", (Py_ssize_t)counts.hits,
+                         "misses", (Py_ssize_t)counts.misses);
+}
+
+void reset_sniff_statistics()
+{
+    stfio::resetSniffStatistics();
+}
+
 PyObject* detect_events(double* data, int size_data, double* templ, int size_templ,
                         double dt, const std::string& mode, bool norm, double lowpass, double highpass)
 {
@@ -208,3 +310,83 @@ double risetime(double* invec, int size, double base, double amp, double frac) {
     }
     return stfnum::risetime2(data, base, amp, 0, argmax, frac, itLoReal, itHiReal, otLoReal, otHiReal);
 }
+
+PyObject* section_view(Section& sec, PyObject* owner) {
+    wrap_array();
+
+    // Detaches the section from its source, so that the data can't be released:
+    Vector_double& data = sec.get_w();
+    npy_intp dims[1] = {(npy_intp)data.size()};
+    if (data.empty()) {
+        return PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    }
+    PyObject* np_array = PyArray_SimpleNewFromData(1, dims, NPY_DOUBLE, &data[0]);
+    if (np_array == NULL) {
+        return NULL;
+    }
+    /* The array keeps the section alive */
+    Py_INCREF(owner);
+    if (PyArray_SetBaseObject((PyArrayObject*)np_array, owner) < 0) {
+        Py_DECREF(np_array);
+        return NULL;
+    }
+    return np_array;
+}
+
+PyObject* channel_array(const Channel& ch) {
+    wrap_array();
+
+    std::size_t npoints = ch.size() > 0 ? ch[0].size() : 0;
+    for (std::size_t n_s = 1; n_s < ch.size(); ++n_s) {
+        if (ch[n_s].size() != npoints) {
+            PyErr_SetString(PyExc_ValueError, "Sections differ in length");
+            return NULL;
+        }
+    }
+    npy_intp dims[2] = {(npy_intp)ch.size(), (npy_intp)npoints};
+    PyObject* np_array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    if (np_array == NULL) {
+        return NULL;
+    }
+    double* gDataP = (double*)array_data(np_array);
+
+    /* fill; lazily decoded sections are read directly into the array */
+    for (std::size_t n_s = 0; n_s < ch.size(); ++n_s) {
+        ch[n_s].GetWindow(0, npoints, &gDataP[n_s*npoints]);
+    }
+    return np_array;
+}
+
+PyObject* recording_concatenated(const Recording& rec) {
+    wrap_array();
+
+    std::size_t npoints = 0;
+    for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+        std::size_t chpoints = 0;
+        for (std::size_t n_s = 0; n_s < rec[n_c].size(); ++n_s) {
+            chpoints += rec[n_c][n_s].size();
+        }
+        if (n_c == 0) {
+            npoints = chpoints;
+        } else if (chpoints != npoints) {
+            PyErr_SetString(PyExc_ValueError, "Channels differ in length");
+            return NULL;
+        }
+    }
+    npy_intp dims[2] = {(npy_intp)rec.size(), (npy_intp)npoints};
+    PyObject* np_array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    if (np_array == NULL) {
+        return NULL;
+    }
+    double* gDataP = (double*)array_data(np_array);
+
+    /* fill */
+    for (std::size_t n_c = 0; n_c < rec.size(); ++n_c) {
+        double* dest = &gDataP[n_c*npoints];
+        for (std::size_t n_s = 0; n_s < rec[n_c].size(); ++n_s) {
+            rec[n_c][n_s].GetWindow(0, rec[n_c][n_s].size(), dest);
+            dest += rec[n_c][n_s].size();
+        }
+    }
+    return np_array;
+}
@@ -17,10 +17,36 @@ wrap_array();
 
 stfio::filetype gettype(const std::string& ftype);
 bool _read(const std::string& filename, const std::string& ftype, bool verbose, Recording& Data);
+bool _read_selection(const std::string& filename, const std::string& ftype, bool verbose, Recording& Data,
+                     int* channels, int n_channels, int first_section, int n_sections,
+                     int first_point, int n_points);
+//! Reads the header information of a file into a dictionary.
+/*! \return None if the file can't be read.
+ */
+PyObject* _read_metadata(const std::string& filename, const std::string& ftype);
+//! Returns the counts of stfio::getSniffStatistics() as a dictionary.
+PyObject* sniff_statistics();
+void reset_sniff_statistics();
 PyObject* detect_events(double* data, int size_data, double* templ, int size_templ, double dt,
                         const std::string& mode="criterion",
                         bool norm=true, double lowpass=0.5, double highpass=0.0001);
 PyObject* peak_detection(double* invec, int size, double threshold, int min_distance);
 double risetime(double* invec, int size, double base, double amp, double frac=0.2);
 
+//! Returns a NumPy array that shares its memory with a section.
+/*! \param sec The section; its data are materialised if necessary.
+ *  \param owner The Python object that owns the section; kept alive by the array.
+ */
+PyObject* section_view(Section& sec, PyObject* owner);
+
+//! Returns all sections of a channel as a 2D NumPy array (sections x data points).
+/*! Sets a ValueError if the sections differ in length.
+ */
+PyObject* channel_array(const Channel& ch);
+
+//! Returns the concatenated sections of all channels as a 2D NumPy array (channels x data points).
+/*! Sets a ValueError if the channels differ in length.
+ */
+PyObject* recording_concatenated(const Recording& rec);
+
 #endif
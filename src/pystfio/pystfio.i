@@ -42,6 +42,7 @@ static int myErr = 0; // flag to save error state
 %enddef    /* %apply_numpy_typemaps() macro */
 
 %apply_numpy_typemaps(double)
+%apply (int* IN_ARRAY1, int DIM1) {(int* channels, int n_channels)};
 
 class Recording {
  public:
@@ -88,6 +89,13 @@ class Section {
     }
 }
 
+// Sections and channels refer to memory of their recording, which therefore
+// has to be kept alive for as long as they (or NumPy views of them) are used:
+%feature("pythonappend") Recording::__getitem__ "val._owner = self"
+%feature("pythonappend") Channel::__getitem__ "val._owner = self"
+
+%feature("kwargs") Recording::write;
+
 %exception Section::__getitem__ {
     assert(!myErr);
     $action
@@ -151,6 +159,10 @@ class Section {
     }
     int __len__() { return $self->size(); }
 
+    PyObject* _concatenated() {
+        return recording_concatenated(*($self));
+    }
+
     %feature("autodoc", "Writes a Recording to a file.
 
     Arguments:
@@ -161,14 +173,27 @@ class Section {
     ftype  -- file type (string). At present, \"hdf5\", \"gdf\", \"cfs\" and \"ibw\" are supported.
 #endif // TEST_MINIMAL
     verbose-- Show info while writing
+    chunked-- hdf5 only: Store each channel as a single chunked
+              dataset of sections x data points instead of one
+              dataset per section
+    compression-- hdf5 only: Deflate compression level (1-9) of
+              chunked channels; 0 disables compression
+    int16  -- hdf5 only: Store chunked channels as 16 bit integers
+              scaled to the range of the channel instead of
+              32 bit floats
 
     Returns:
     True upon successful completion.") write;
-    bool write(const std::string& fname, const std::string& ftype="hdf5", bool verbose=false) {
+    bool write(const std::string& fname, const std::string& ftype="hdf5", bool verbose=false,
+               bool chunked=false, int compression=0, bool int16=false) {
         stfio::filetype stftype = gettype(ftype);
         stfio::StdoutProgressInfo progDlg("File export", "Writing file", 100, verbose);
+        stfio::hdf5ExportSettings hdf5Export;
+        hdf5Export.channelDatasets = chunked;
+        hdf5Export.compression = compression;
+        hdf5Export.int16 = int16;
         try {
-            return stfio::exportFile(fname, stftype, *($self), progDlg);
+            return stfio::exportFile(fname, stftype, *($self), progDlg, hdf5Export);
         } catch (const std::exception& e) {
             std::cerr << "Couldn't write to file:\n"
                       << e.what() << std::endl;
@@ -187,10 +212,11 @@ class Section {
                 has_pandas = False
             if has_pandas:
                 chnames = [ch.name for ch in self]
-                channels = np.array([np.concatenate([sec for sec in ch]) for ch in self])
+                channels = self._concatenated()
                 date_range = pd.date_range(start=self.datetime, periods=channels.shape[1],
                                            freq='%dU' % np.round(self.dt*1e3))
-                return pd.DataFrame(channels.transpose(), index=date_range, columns=chnames)
+                return pd.DataFrame(channels.transpose(), index=date_range, columns=chnames,
+                                    copy=False)
             else:
                 sys.stderr.write("Pandas is not available on this system\n")
                 return None
@@ -304,6 +330,13 @@ class Section {
         }
     }
     int __len__() { return $self->size(); }
+
+    %feature("autodoc", "Returns all sections as a 2D numpy array of shape
+(number of sections, number of data points). Raises a ValueError
+if the sections differ in length.") asarray;
+    PyObject* asarray() {
+        return channel_array(*($self));
+    }
 }
 
 %{
@@ -350,17 +383,40 @@ class Section {
     }
     int __len__() { return $self->size(); }
 
-    %feature("autodoc", "Returns the section as a numpy array.") asarray;
-    PyObject* asarray() {
-        npy_intp dims[1] = {$self->size()};
+    PyObject* _asarray_view(PyObject* owner) {
+        return section_view(*($self), owner);
+    }
+
+    PyObject* _asarray_copy() {
+        wrap_array();
+        npy_intp dims[1] = {(npy_intp)$self->size()};
         PyObject* np_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
         double* gDataP = (double*)array_data(np_array);
 
-        std::copy( $self->get().begin(),
-                   $self->get().end(),
-                   gDataP);
+        $self->GetWindow(0, $self->size(), gDataP);
         return np_array;
     };
+
+    %pythoncode {
+        def asarray(self, copy=False):
+            """Returns the section as a numpy array.
+
+            Arguments:
+            copy -- If False (default), the array shares its memory with
+                    the section, so that no data are copied and changes
+                    to the array change the section. If True, an
+                    independent copy is returned.
+            """
+            if copy:
+                return self._asarray_copy()
+            return self._asarray_view(self)
+
+        def __array__(self, dtype=None, copy=None):
+            arr = self.asarray(copy=bool(copy))
+            if dtype is not None:
+                arr = arr.astype(dtype, copy=False)
+            return arr
+    }
 }
 
 //--------------------------------------------------------------------
@@ -381,6 +437,59 @@ A recording object.") _read;
 bool _read(const std::string& filename, const std::string& ftype, bool verbose, Recording& Data);
 //--------------------------------------------------------------------
 
+//--------------------------------------------------------------------
+%feature("autodoc", 0) _read_selection;
+%feature("docstring", "Reads part of a file into a recording object.
+
+Arguments:
+filename      -- file name
+ftype         -- File type
+verbose       -- Show info while reading
+channels      -- Indices of the channels to be read; empty reads all channels
+first_section -- Index of the first section to be read
+n_sections    -- Number of sections; 0 reads all remaining sections
+first_point   -- Index of the first data point of each section
+n_points      -- Number of data points; 0 reads up to the end of each section
+
+Returns:
+A recording object.") _read_selection;
+bool _read_selection(const std::string& filename, const std::string& ftype, bool verbose, Recording& Data,
+                     int* channels, int n_channels, int first_section, int n_sections,
+                     int first_point, int n_points);
+//--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+%feature("autodoc", 0) _read_metadata;
+%feature("docstring", "Reads the header information of a file without its data.
+
+Arguments:
+filename -- file name
+ftype    -- File type
+
+Returns:
+A dictionary, or None if the file can't be read. Its \"ftype\" is the
+file type that was used to read the file.") _read_metadata;
+PyObject* _read_metadata(const std::string& filename, const std::string& ftype);
+//--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+%feature("autodoc", 0) sniff_statistics;
+%feature("docstring", "Returns how many files have been read whose format
+was identified from their first bytes.
+
+Returns:
+A dictionary with the number of identified files (\"hits\") and of
+files whose format wasn't identified (\"misses\"). Files that are
+read by worker processes, as in scan(), are counted in those processes.") sniff_statistics;
+PyObject* sniff_statistics();
+//--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+%feature("autodoc", 0) reset_sniff_statistics;
+%feature("docstring", "Resets the counts returned by sniff_statistics().") reset_sniff_statistics;
+void reset_sniff_statistics();
+//--------------------------------------------------------------------
+
 //--------------------------------------------------------------------
 %feature("autodoc", 0) detect_events;
 %feature("kwargs") detect_events;
@@ -432,9 +541,36 @@ filetype = {
     '.atf':'atf',
     '.axgd':'axg',
     '.axgx':'axg',
-    '.clp':'intan'}
-
-def read(fname, ftype=None, verbose=False):
+    '.clp':'intan',
+    '.tdms':'tdms',
+    # Formats that are only read by libbiosig:
+    '.gdf':'biosig',
+    '.edf':'biosig',
+    '.bdf':'biosig',
+    '.ibw':'biosig',
+    '.wcp':'biosig',
+    '.smr':'biosig'}
+
+def _selection(sel, name):
+    """Converts a slice or a (start, stop) pair to a start index and a count,
+    where a count of 0 selects everything up to the end."""
+    if sel is None:
+        return 0, 0
+    if isinstance(sel, slice):
+        if sel.step not in (None, 1):
+            raise StfIOException('%s can\'t be read with a step' % name)
+        start, stop = sel.start, sel.stop
+    else:
+        start, stop = sel
+    if start is None:
+        start = 0
+    if start < 0 or (stop is not None and stop <= start):
+        raise StfIOException('Invalid selection of %s: %s' % (name, sel))
+    if stop is None:
+        return start, 0
+    return start, stop-start
+
+def read(fname, ftype=None, verbose=False, channels=None, sections=None, points=None):
     """Reads a file and returns a Recording object.
 
     Arguments:
@@ -448,6 +584,7 @@ def read(fname, ftype=None, verbose=False):
               "axg"  - Axograph X binary file
               "heka" - HEKA binary file
               "intan" - INTAN clamp binary file
+              "tdms" - National Instruments TDMS file
               if ftype is None (default), it will be guessed from the
               extension.
 #else
@@ -457,6 +594,14 @@ def read(fname, ftype=None, verbose=False):
               parameter become obsolete; eventually it will be removed.
 #endif // TEST_MINIMAL
     verbose-- Show info while reading file
+    channels -- Indices of the channels to be read (sequence of ints).
+              None (default) reads all channels.
+    sections -- Sections to be read, as a slice or a (start, stop)
+              pair; stop may be None. None (default) reads all sections.
+    points -- Data points to be read from each section, as a slice or
+              a (start, stop) pair. None (default) reads all points.
+              Unselected data are skipped while reading where the file
+              format allows it (ABF, HDF5, CFS, Intan, TDMS, biosig).
 
     Returns:
     A Recording object.
@@ -465,16 +610,21 @@ def read(fname, ftype=None, verbose=False):
         raise StfIOException('File %s does not exist' % fname)
 
 #ifndef TEST_MINIMAL
-    if ftype is None:
-        ext = os.path.splitext(fname)[1]
-        try:
-            ftype = filetype[ext]
-        except KeyError:
-            raise StfIOException('Couldn\'t guess file type from extension (%s)' % ext)
+    ftype = _guess_type(fname, ftype)
 #endif // TEST_MINIMAL
 
+    import numpy as np
+    if channels is None:
+        channels = []
+    elif len(channels) == 0:
+        raise StfIOException('No channels selected')
+    first_section, n_sections = _selection(sections, 'sections')
+    first_point, n_points = _selection(points, 'points')
+
     rec = Recording()
-    if not _read(fname, ftype, verbose, rec):
+    if not _read_selection(fname, ftype, verbose, rec,
+                           np.asarray(channels, dtype=np.intc),
+                           first_section, n_sections, first_point, n_points):
         raise StfIOException('Error reading file')
 
     if verbose:
@@ -483,50 +633,122 @@ def read(fname, ftype=None, verbose=False):
     return rec
 
 
-def read_tdms(fn):
-    import numpy as np
-    import sys
+def _guess_type(fname, ftype):
+    if ftype is None:
+        ext = os.path.splitext(fname)[1]
+        try:
+            ftype = filetype[ext]
+        except KeyError:
+            raise StfIOException('Couldn\'t guess file type from extension (%s)' % ext)
+    return ftype
+
+def read_metadata(fname, ftype=None):
+    """Reads the header information of a file without reading its data.
+
+    Arguments:
+    fname  -- file name
+    ftype  -- file type (string), as in read(). If ftype is None
+              (default), it will be guessed from the extension.
+
+    Returns:
+    A dictionary with the file name ("filename"), the file type that
+    was used to read the file ("ftype"),
+    the sampling interval ("dt") and its units ("xunits"), the date and time
+    of recording ("datetime"), "comment", "file_description",
+    "section_description" and a list of channels ("channels"), each of
+    them a dictionary with "name", "yunits" and the number of
+    sections ("sections").
+    """
+    if not os.path.exists(fname):
+        raise StfIOException('File %s does not exist' % fname)
+
+#ifndef TEST_MINIMAL
+    ftype = _guess_type(fname, ftype)
+#else
+    if ftype is None:
+        ftype = ''
+#endif // TEST_MINIMAL
+
+    metadata = _read_metadata(fname, ftype)
+    if metadata is None:
+        raise StfIOException('Error reading file header')
+
+    import datetime
+    try:
+        metadata["datetime"] = datetime.datetime(*metadata["datetime"])
+    except ValueError:
+        metadata["datetime"] = None
+    metadata["filename"] = fname
+    return metadata
+
+def _scan_file(args):
+    fname, ftype = args
     try:
-        from nptdms import TdmsFile
-    except ImportError:
-        sys.stderr.write("nptdms module unavailable")
-        return None
+        return read_metadata(fname, ftype)
+    except Exception as e:
+        return {"filename": fname, "ftype": ftype, "error": str(e)}
 
-    tdms_file = TdmsFile(fn)
+def scan(path, extensions=None, recursive=True, processes=None):
+    """Reads the header information of all files in a directory.
 
+    The files are read in parallel by a pool of worker processes.
+
+    Arguments:
+    path       -- directory to be scanned
+    extensions -- file extensions to be read (sequence of strings, such
+                  as [".abf", ".h5"]). None (default) reads all files
+                  whose type can be guessed from the extension.
+    recursive  -- scan subdirectories as well
+    processes  -- number of worker processes; None (default) uses one
+                  process per CPU
+
+    Returns:
+    A list with a dictionary for each file, as returned by read_metadata(),
+    sorted by file name. Files that can't be read have an "error" entry
+    instead. The list can be turned into a table with
+    pandas.DataFrame(scan(path)).
+    """
+    if extensions is None:
+        extensions = filetype.keys()
+    extensions = set(ext.lower() for ext in extensions)
+
+    files = []
+    for root, dirs, names in os.walk(path):
+        if not recursive:
+            dirs[:] = []
+        for name in names:
+            ext = os.path.splitext(name)[1].lower()
+            if ext in extensions:
+                files.append((os.path.join(root, name), filetype.get(ext)))
+    files.sort()
+    if len(files) == 0:
+        return []
+
+    import multiprocessing
+    if processes is None:
+        processes = multiprocessing.cpu_count()
+    processes = max(1, min(processes, len(files)))
+    # Send the files in chunks, so that small headers don't wait for the
+    # workers, while still spreading the load evenly:
+    chunksize = max(1, len(files) // (processes*8))
+    pool = multiprocessing.Pool(processes)
     try:
-        times = np.array(
-            [[channel.data
-              for channel in tdms_file.group_channels(group)
-              if channel.data is not None]
-             for group in tdms_file.groups()
-             if group.lower() == "time"][0][0])
-        dt = np.mean(np.diff(times))
-    except IndexError:
-        if not "Sampling Rate" in tdms_file.object().properties.keys():
-            if not "Sampling Rate(AI)" in tdms_file.object().properties.keys():
-                dt = 1.0
-            else:
-                sr = float(tdms_file.object().properties['Sampling Rate(AI)'])
-                if sr > 0:
-                    dt = 1e3/sr
-                else:
-                    dt = 1.0/25.0
-        else:
-            sr = float(tdms_file.object().properties['Sampling Rate'])
-            if sr > 0:
-                dt = 1e3/sr
-            else:
-                dt = 1.0/25.0
+        return pool.map(_scan_file, files, chunksize)
+    finally:
+        pool.close()
+        pool.join()
+
+def read_tdms(fn):
+    """Reads a TDMS file and returns a dictionary with the data of the
+    analog input and output groups ("data", a list of lists of arrays)
+    and the sampling interval ("dt")."""
+    import numpy as np
 
+    rec = read(fn, "tdms")
     return_dict = {
-        "data": [
-            [channel.data.astype(np.float64)
-             for channel in tdms_file.group_channels(group)
-             if channel.data is not None]
-                 for group in tdms_file.groups()
-            if group.lower()[:2] == "ai" or group.lower()[:2] == "ao"],
-        "dt": dt,
+        "data": [[np.array(section, dtype=np.float64) for section in channel]
+                 for channel in rec],
+        "dt": rec.dt,
     }
     return return_dict
 }
@@ -74,6 +74,36 @@ class DataListTest(unittest.TestCase):
         res = rec.write('new.abf', 'abf')
         self.assertEquals(False, res)
 
+    def testWriteChunked(self):
+        """ testWriteChunked() Writes channels as chunked datasets """
+        rec = stfio.read('test.h5')
+        self.assertTrue(rec.write('chunked.h5', chunked=True, compression=4))
+        rec2 = stfio.read('chunked.h5')
+        self.assertEqual(len(rec2), len(rec))
+        self.assertEqual(len(rec2[1]), len(rec[1]))
+        self.assertEqual(rec2[1].yunits, rec[1].yunits)
+        np.testing.assert_array_equal(rec2[1][2].asarray(),
+                                      rec[1][2].asarray().astype(np.float32))
+
+        self.assertTrue(rec.write('int16.h5', chunked=True, int16=True))
+        rec2 = stfio.read('int16.h5')
+        arr = rec[1].asarray()
+        tol = (arr.max()-arr.min())/65534.0
+        np.testing.assert_allclose(rec2[1].asarray(), arr, atol=tol)
+
+    def testReadSelection(self):
+        """ testReadSelection() reads a subset of channels, sections and points """
+        part = stfio.read('test.h5', channels=[3, 1], sections=slice(1, 3),
+                          points=(1000, 2000))
+        self.assertEqual(len(part), 2)
+        self.assertEqual(part[0].yunits, rec[1].yunits)
+        self.assertEqual(len(part[1]), 2)
+        self.assertEqual(len(part[1][0]), 1000)
+        np.testing.assert_array_equal(part[1][1].asarray(),
+                                      rec[3][2].asarray()[1000:2000])
+        self.assertRaises(stfio.StfIOException, stfio.read, 'test.h5',
+                          sections=(2, 1))
+
     def testNumberofChannels(self):
         """ testNumberofChannels() returns the number of channels """
         self.assertEquals(4,len(rec))
@@ -96,6 +126,26 @@ class DataListTest(unittest.TestCase):
         """ testArrayCreation() creation of a numpy array""" 
         self.assertTrue(type(rec[0][0].asarray()), type(np.empty(0)))
 
+    def testArrayView(self):
+        """ testArrayView() arrays share their memory with the section """
+        rec = stfio.read('test.h5')
+        sec = rec[0][0]
+        view = sec.asarray()
+        copy = sec.asarray(copy=True)
+        np.testing.assert_array_equal(view, copy)
+        view[0] += 1.0
+        self.assertEqual(view[0], sec[0])
+        self.assertNotEqual(copy[0], sec[0])
+        # the view keeps the recording alive:
+        del rec, sec
+        self.assertEqual(view[0], copy[0]+1.0)
+
+    def testChannelArray(self):
+        """ testChannelArray() a channel as a 2D numpy array """
+        arr = rec[1].asarray()
+        self.assertEqual(arr.shape, (3, 40000))
+        np.testing.assert_array_equal(arr[2], np.asarray(rec[1][2]))
+
     def testChannelName(self):
         """ testChannelName() returns the names of the channels """
         names = [rec[i].name for i in range(len(rec))]
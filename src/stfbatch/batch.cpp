@@ -0,0 +1,482 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "hdf5.h"
+#if H5_VERS_MINOR > 6
+  #include "hdf5_hl.h"
+#else
+  #include "H5TA.h"
+#endif
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "./batch.h"
+#include "../libstfnum/measure.h"
+
+namespace {
+
+const char* labels[] = {
+    "Base", "Base SD", "Slope threshold", "Slope threshold time",
+    "Peak (from 0)", "Peak (from baseline)", "Peak (from threshold)", "Peak time",
+    "RT Lo-Hi%", "inner Rise Time Lo-Hi%", "Outer Rise Time Lo-Hi%",
+    "duration Amp/2", "start Amp/2", "end Amp/2",
+    "Max. slope rise", "Max. slope decay", "Time of max. rise", "Time of max. decay",
+    "Latency"
+};
+
+const std::size_t nLabels = sizeof(labels)/sizeof(labels[0]);
+
+std::string trim(const std::string& str) {
+    std::size_t first = 0, last = str.size();
+    while (first < last && isspace((unsigned char)str[first])) ++first;
+    while (last > first && isspace((unsigned char)str[last-1])) --last;
+    return str.substr(first, last-first);
+}
+
+long toLong(const std::string& key, const std::string& value) {
+    char* end = NULL;
+    long result = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0') {
+        throw std::runtime_error("Invalid integer value for " + key + ": " + value);
+    }
+    return result;
+}
+
+double toDouble(const std::string& key, const std::string& value) {
+    char* end = NULL;
+    double result = strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0') {
+        throw std::runtime_error("Invalid value for " + key + ": " + value);
+    }
+    return result;
+}
+
+std::size_t toIndex(const std::string& key, const std::string& value) {
+    long result = toLong(key, value);
+    if (result < 0) {
+        throw std::runtime_error("Negative cursor position for " + key + ": " + value);
+    }
+    return (std::size_t)result;
+}
+
+stfbatch::latency_mode toLatencyMode(const std::string& key, const std::string& value) {
+    long mode = toLong(key, value);
+    if (mode < stfbatch::manualMode || mode > stfbatch::footMode) {
+        throw std::runtime_error("Invalid latency mode for " + key + ": " + value);
+    }
+    return (stfbatch::latency_mode)mode;
+}
+
+std::string lowerExtension(const std::string& fName) {
+    std::size_t dot = fName.rfind('.');
+    std::size_t sep = fName.find_last_of("/\\");
+    if (dot == std::string::npos || (sep != std::string::npos && dot < sep)) {
+        return "";
+    }
+    std::string ext = fName.substr(dot);
+    for (std::size_t n = 0; n < ext.size(); ++n) {
+        ext[n] = tolower((unsigned char)ext[n]);
+    }
+    return ext;
+}
+
+// Fixed-length string array for HDF5:
+void writeStrings(hid_t file_id, const char* path, const std::vector<std::string>& strings) {
+    std::size_t length = 1;
+    for (std::size_t n = 0; n < strings.size(); ++n) {
+        if (strings[n].length() > length) length = strings[n].length();
+    }
+    std::vector<char> data(strings.size()*length, '\0');
+    for (std::size_t n = 0; n < strings.size(); ++n) {
+        std::copy(strings[n].begin(), strings[n].end(), data.begin()+n*length);
+    }
+    hsize_t dims[1] = { strings.size() };
+    hid_t string_type = H5Tcopy( H5T_C_S1 );
+    H5Tset_size( string_type, length );
+    herr_t status = H5LTmake_dataset(file_id, path, 1, dims, string_type,
+                                     data.empty() ? NULL : &data[0]);
+    H5Tclose(string_type);
+    if (status < 0) {
+        throw std::runtime_error(std::string("Exception while writing ") + path + " in stfbatch::WriteHDF5");
+    }
+}
+
+// Converts the batch settings for a section of n sampling points.
+stfnum::MeasurementSettings measurementSettings(const stfbatch::Settings& settings, std::size_t n, double dt) {
+    double SR = 1.0/dt;
+    stfnum::MeasurementSettings ms;
+    ms.baseBeg = settings.baseBeg;
+    ms.baseEnd = settings.baseEnd;
+    ms.peakBeg = settings.peakBeg;
+    ms.peakEnd = settings.peakAtEnd ? n-1 : settings.peakEnd;
+    ms.pM = settings.pM;
+    ms.dir = settings.direction;
+    ms.baselineMethod = settings.baselineMethod;
+    ms.slopeForThreshold = settings.slopeForThreshold/SR;
+    ms.rtFactor = settings.RTFactor*0.01;
+    ms.fromBase = settings.fromBase;
+    // See wxStfDoc::GetMeasurementSettings() for the choice of the window length:
+    long windowLength = lround(0.05*SR);
+    ms.windowLength = (windowLength < 1) ? 1 : windowLength;
+    return ms;
+}
+
+// Measures a section with a kernel that is re-used for all sections of a file.
+Vector_double measure(stfnum::MeasurementKernel& kernel, const stfbatch::Settings& settings,
+                      const Section& sec, const Section* reference, double dt)
+{
+    const Vector_double& data = sec.get();
+    if (data.empty()) {
+        throw std::out_of_range("Empty section in stfbatch::Measure");
+    }
+    stfnum::MeasurementSettings ms = measurementSettings(settings, data.size(), dt);
+    // The stfnum functions return NaN for invalid cursors; report them instead:
+    if (ms.baseBeg > ms.baseEnd || ms.baseEnd >= data.size() ||
+        ms.peakBeg > ms.peakEnd || ms.peakEnd >= data.size())
+    {
+        throw std::out_of_range("Cursor positions exceed the section in stfbatch::Measure");
+    }
+    double SR = 1.0/dt;
+    kernel.SetSettings(ms);
+    stfnum::MeasurementResults r = kernel.Measure(data);
+
+    // Start of latency measurement, from the reference channel:
+    double latStart = settings.latencyBeg;
+    if (reference != NULL && settings.latencyStartMode != stfbatch::manualMode) {
+        stfnum::ReferenceResults ref = kernel.MeasureReference(reference->get());
+        switch (settings.latencyStartMode) {
+         case stfbatch::peakMode: latStart = ref.maxT; break;
+         case stfbatch::riseMode: latStart = ref.maxRiseT; break;
+         case stfbatch::halfMode: latStart = ref.t50LeftReal; break;
+         default: break;
+        }
+    }
+
+    double tHiReal = r.tLoReal+r.rtLoHi;
+    double latEnd = settings.latencyEnd;
+    switch (settings.latencyEndMode) {
+     case stfbatch::footMode: latEnd = r.tLoReal-(tHiReal-r.tLoReal)/3.0; break;
+     case stfbatch::riseMode: latEnd = r.maxRiseT; break;
+     case stfbatch::halfMode: latEnd = r.t50LeftReal; break;
+     case stfbatch::peakMode: latEnd = r.maxT; break;
+     default: break;
+    }
+
+    Vector_double results(nLabels);
+    std::size_t n = 0;
+    results[n++] = r.base;
+    results[n++] = r.baseSD;
+    results[n++] = r.threshold;
+    results[n++] = r.thrT*dt;
+    results[n++] = r.peak;
+    results[n++] = r.peak-r.base;
+    results[n++] = r.peak-r.threshold;
+    results[n++] = r.maxT*dt;
+    results[n++] = r.rtLoHi*dt;
+    results[n++] = (r.innerHiRT-r.innerLoRT)*dt;
+    results[n++] = (r.outerHiRT-r.outerLoRT)*dt;
+    results[n++] = r.halfDuration*dt;
+    results[n++] = r.t50LeftReal*dt;
+    results[n++] = (r.t50LeftReal+r.halfDuration)*dt;
+    results[n++] = r.maxRise*SR;
+    results[n++] = r.maxDecay*SR;
+    results[n++] = r.maxRiseT*dt;
+    results[n++] = r.maxDecayT*dt;
+    results[n++] = (latEnd-latStart)*dt;
+    return results;
+}
+
+}
+
+stfbatch::Settings::Settings()
+    : channel(0), referenceChannel(-1), baseBeg(1), baseEnd(20), peakBeg(0), peakEnd(0),
+      peakAtEnd(true), baselineMethod(stfnum::mean_sd), direction(stfnum::both), pM(1),
+      RTFactor(20), slopeForThreshold(20.0), fromBase(true),
+      latencyStartMode(manualMode), latencyEndMode(manualMode), latencyBeg(0), latencyEnd(2)
+{}
+
+stfbatch::Settings stfbatch::ReadSettings(const std::string& fName) {
+    std::ifstream config(fName.c_str());
+    if (!config) {
+        throw std::runtime_error("Couldn't open configuration file " + fName);
+    }
+    Settings settings;
+    // Without an explicit peak window, Stimfit's defaults are used:
+    bool peakBegSet = false, peakEndSet = false, peakAtEndSet = false;
+    std::string group, line;
+    while (std::getline(config, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+        if (line[0] == '[') {
+            group = trim(line.substr(1, line.find(']')-1));
+            continue;
+        }
+        if (!group.empty() && group != "Settings") {
+            continue;
+        }
+        std::size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            throw std::runtime_error("Invalid line in configuration file: " + line);
+        }
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq+1));
+
+        if (key == "Channel") {
+            settings.channel = toLong(key, value);
+        } else if (key == "ReferenceChannel") {
+            settings.referenceChannel = toLong(key, value);
+        } else if (key == "BaseBegin") {
+            settings.baseBeg = toIndex(key, value);
+        } else if (key == "BaseEnd") {
+            settings.baseEnd = toIndex(key, value);
+        } else if (key == "PeakBegin") {
+            settings.peakBeg = toIndex(key, value);
+            peakBegSet = true;
+        } else if (key == "PeakEnd") {
+            settings.peakEnd = toIndex(key, value);
+            peakEndSet = true;
+        } else if (key == "PeakAtEnd") {
+            settings.peakAtEnd = (toLong(key, value) != 0);
+            peakAtEndSet = true;
+        } else if (key == "BaselineMethod") {
+            settings.baselineMethod = (toLong(key, value) == 1) ? stfnum::median_iqr : stfnum::mean_sd;
+        } else if (key == "Direction") {
+            switch (toLong(key, value)) {
+             case 0: settings.direction = stfnum::up; break;
+             case 1: settings.direction = stfnum::down; break;
+             case 2: settings.direction = stfnum::both; break;
+             default: throw std::runtime_error("Invalid direction: " + value);
+            }
+        } else if (key == "PeakMean") {
+            settings.pM = toLong(key, value);
+        } else if (key == "RTFactor") {
+            settings.RTFactor = toLong(key, value);
+        } else if (key == "Slope") {
+            settings.slopeForThreshold = toDouble(key, value);
+        } else if (key == "FromBase") {
+            settings.fromBase = (toLong(key, value) != 0);
+        } else if (key == "LatencyStartMode") {
+            settings.latencyStartMode = toLatencyMode(key, value);
+        } else if (key == "LatencyEndMode") {
+            settings.latencyEndMode = toLatencyMode(key, value);
+        } else if (key == "LatencyStartCursor") {
+            settings.latencyBeg = toDouble(key, value);
+        } else if (key == "LatencyEndCursor") {
+            settings.latencyEnd = toDouble(key, value);
+        }
+    }
+    if (!peakAtEndSet) {
+        settings.peakAtEnd = !(peakBegSet && peakEndSet);
+    }
+    if (settings.pM < 1 || settings.RTFactor <= 0 || settings.RTFactor >= 50) {
+        throw std::runtime_error("Invalid PeakMean or RTFactor in configuration file " + fName);
+    }
+    if (settings.channel < 0) {
+        throw std::runtime_error("Invalid channel in configuration file " + fName);
+    }
+    return settings;
+}
+
+std::vector<std::string> stfbatch::MeasurementLabels() {
+    return std::vector<std::string>(labels, labels+nLabels);
+}
+
+Vector_double stfbatch::Measure(const Settings& settings, const Section& sec, const Section* reference, double dt) {
+    stfnum::MeasurementKernel kernel;
+    return measure(kernel, settings, sec, reference, dt);
+}
+
+stfnum::Table stfbatch::Analyse(const std::vector<std::string>& files, stfio::filetype type,
+                                const Settings& settings, std::vector<std::string>& errors, bool verbose)
+{
+    std::vector<std::string> measLabels = MeasurementLabels();
+    // One result table per file; concatenated in the order of the files:
+    std::vector< std::vector<std::string> > rowLabels(files.size());
+    std::vector< std::vector<Vector_double> > rows(files.size());
+    std::vector< std::vector<std::string> > fileErrors(files.size());
+    std::size_t n_done = 0;
+
+    int nfiles = (int)files.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int n_f = 0; n_f < nfiles; ++n_f) {
+        const std::string& fName = files[n_f];
+        Recording rec;
+        bool imported = false;
+        // Not all of the file readers are reentrant (e.g. the HDF5 library
+        // and the Axon file tables), so files are imported one at a time.
+        // Sections of memory-mapped files are decoded while they are
+        // measured, outside of the critical section.
+#ifdef _OPENMP
+#pragma omp critical(stfbatch_import)
+#endif
+        {
+            try {
+                stfio::filetype ftype = type;
+                if (ftype == stfio::none) {
+                    ftype = stfio::findType("*" + lowerExtension(fName));
+                }
+                stfio::txtImportSettings tis;
+                stfio::StdoutProgressInfo progDlg("File import", "Importing " + fName, 100, false);
+                imported = stfio::importFile(fName, ftype, rec, tis, progDlg);
+                if (!imported) {
+                    fileErrors[n_f].push_back(fName + ": couldn't import file");
+                }
+            }
+            catch (const std::exception& e) {
+                fileErrors[n_f].push_back(fName + ": " + e.what());
+            }
+        }
+        if (imported) {
+            if ((std::size_t)settings.channel >= rec.size() ||
+                (settings.referenceChannel >= 0 && (std::size_t)settings.referenceChannel >= rec.size()))
+            {
+                fileErrors[n_f].push_back(fName + ": channel index out of range");
+            } else {
+                Channel& ch = rec[settings.channel];
+                Channel* refCh = settings.referenceChannel >= 0 ? &rec[settings.referenceChannel] : NULL;
+                stfnum::MeasurementKernel kernel;
+                for (std::size_t n_s = 0; n_s < ch.size(); ++n_s) {
+                    std::ostringstream label;
+                    label << fName << ", section " << n_s+1;
+                    rowLabels[n_f].push_back(label.str());
+                    Section* refSec = (refCh != NULL && n_s < refCh->size()) ? &(*refCh)[n_s] : NULL;
+                    try {
+                        rows[n_f].push_back(measure(kernel, settings, ch[n_s], refSec, rec.GetXScale()));
+                    }
+                    catch (const std::exception& e) {
+                        fileErrors[n_f].push_back(label.str() + ": " + e.what());
+                        rows[n_f].push_back(Vector_double());
+                    }
+                    // Only one section per thread is held in memory at a time:
+                    ch[n_s] = Section();
+                    if (refSec != NULL) *refSec = Section();
+                }
+            }
+        }
+#ifdef _OPENMP
+#pragma omp critical(stfbatch_progress)
+#endif
+        {
+            ++n_done;
+            if (verbose) {
+                std::cout << "\r";
+                std::cout.width(3);
+                std::cout << (int)(100.0*n_done/files.size()) << "% Processed " << fName << std::endl;
+            }
+        }
+    }
+
+    std::size_t nRows = 0;
+    for (std::size_t n_f = 0; n_f < files.size(); ++n_f) {
+        nRows += rows[n_f].size();
+    }
+    stfnum::Table table(nRows, measLabels.size());
+    for (std::size_t n_c = 0; n_c < measLabels.size(); ++n_c) {
+        table.SetColLabel(n_c, measLabels[n_c]);
+    }
+    std::size_t n_row = 0;
+    for (std::size_t n_f = 0; n_f < files.size(); ++n_f) {
+        for (std::size_t n_s = 0; n_s < rows[n_f].size(); ++n_s, ++n_row) {
+            table.SetRowLabel(n_row, rowLabels[n_f][n_s]);
+            const Vector_double& row = rows[n_f][n_s];
+            for (std::size_t n_c = 0; n_c < measLabels.size(); ++n_c) {
+                if (row.empty()) {
+                    table.SetEmpty(n_row, n_c);
+                } else {
+                    table.at(n_row, n_c) = row[n_c];
+                }
+            }
+        }
+        errors.insert(errors.end(), fileErrors[n_f].begin(), fileErrors[n_f].end());
+    }
+    return table;
+}
+
+void stfbatch::WriteCSV(const std::string& fName, const stfnum::Table& table) {
+    std::ofstream csv(fName.c_str());
+    if (!csv) {
+        throw std::runtime_error("Couldn't open " + fName + " for writing");
+    }
+    csv.precision(12);
+    csv << "\"Trace\"";
+    for (std::size_t n_c = 0; n_c < table.nCols(); ++n_c) {
+        csv << ",\"" << table.GetColLabel(n_c) << "\"";
+    }
+    csv << "\n";
+    for (std::size_t n_r = 0; n_r < table.nRows(); ++n_r) {
+        // Double quotes within labels are escaped by doubling them:
+        std::string label = table.GetRowLabel(n_r);
+        std::string quoted;
+        for (std::size_t n = 0; n < label.size(); ++n) {
+            if (label[n] == '"') quoted += '"';
+            quoted += label[n];
+        }
+        csv << "\"" << quoted << "\"";
+        for (std::size_t n_c = 0; n_c < table.nCols(); ++n_c) {
+            csv << ",";
+            if (!table.IsEmpty(n_r, n_c)) {
+                csv << table.at(n_r, n_c);
+            }
+        }
+        csv << "\n";
+    }
+    if (!csv) {
+        throw std::runtime_error("Error while writing " + fName);
+    }
+}
+
+void stfbatch::WriteHDF5(const std::string& fName, const stfnum::Table& table) {
+    hid_t file_id = H5Fcreate(fName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file_id < 0) {
+        throw std::runtime_error("Couldn't create " + fName);
+    }
+    try {
+        Vector_double values(table.nRows()*table.nCols());
+        for (std::size_t n_r = 0; n_r < table.nRows(); ++n_r) {
+            for (std::size_t n_c = 0; n_c < table.nCols(); ++n_c) {
+                values[n_r*table.nCols()+n_c] = table.IsEmpty(n_r, n_c) ? NAN : table.at(n_r, n_c);
+            }
+        }
+        hsize_t dims[2] = { table.nRows(), table.nCols() };
+        herr_t status = H5LTmake_dataset(file_id, "/results", 2, dims, H5T_IEEE_F64LE,
+                                         values.empty() ? NULL : &values[0]);
+        if (status < 0) {
+            throw std::runtime_error("Exception while writing results in stfbatch::WriteHDF5");
+        }
+        std::vector<std::string> rowLabels(table.nRows()), colLabels(table.nCols());
+        for (std::size_t n_r = 0; n_r < table.nRows(); ++n_r) {
+            rowLabels[n_r] = table.GetRowLabel(n_r);
+        }
+        for (std::size_t n_c = 0; n_c < table.nCols(); ++n_c) {
+            colLabels[n_c] = table.GetColLabel(n_c);
+        }
+        writeStrings(file_id, "/rows", rowLabels);
+        writeStrings(file_id, "/columns", colLabels);
+    }
+    catch (...) {
+        H5Fclose(file_id);
+        throw;
+    }
+    H5Fclose(file_id);
+}
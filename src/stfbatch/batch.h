@@ -0,0 +1,133 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file batch.h
+ *  \author Christoph Schmidt-Hieber
+ *  \brief Headless batch analysis of many files.
+ */
+
+#ifndef _STFBATCH_H
+#define _STFBATCH_H
+
+#include <string>
+#include <vector>
+
+#include "../libstfnum/stfnum.h"
+
+//! Headless batch analysis without a graphical user interface.
+namespace stfbatch {
+
+/*! \addtogroup stfbatch
+ *  @{
+ */
+
+//! Latency cursor settings; same values as stf::latency_mode.
+enum latency_mode {
+    manualMode = 0, /*!< Use the latency cursor position from the settings. */
+    peakMode = 1,   /*!< Use the peak. */
+    riseMode = 2,   /*!< Use the maximal slope of rise. */
+    halfMode = 3,   /*!< Use the half-maximal amplitude. */
+    footMode = 4    /*!< Use the beginning of the event. */
+};
+
+//! Cursor and measurement settings.
+/*! The members correspond to the entries of the [Settings] group that
+ *  Stimfit writes to its configuration file, so that the configuration
+ *  of an interactive session can be used for a batch analysis.
+ */
+struct Settings {
+    //! Default settings, as used by Stimfit when no configuration exists.
+    Settings();
+
+    int channel;                  /*!< Index of the channel to be measured ("Channel"). */
+    int referenceChannel;         /*!< Index of the channel used for latency start modes, or -1 ("ReferenceChannel"). */
+    std::size_t baseBeg;          /*!< First data point of the baseline ("BaseBegin"). */
+    std::size_t baseEnd;          /*!< Last data point of the baseline ("BaseEnd"). */
+    std::size_t peakBeg;          /*!< First data point of the peak window ("PeakBegin"). */
+    std::size_t peakEnd;          /*!< Last data point of the peak window ("PeakEnd"). */
+    bool peakAtEnd;               /*!< Extend the peak window to the end of each section ("PeakAtEnd"). */
+    stfnum::baseline_method baselineMethod; /*!< Mean or median baseline ("BaselineMethod"). */
+    stfnum::direction direction;  /*!< Direction of peak detection ("Direction"). */
+    int pM;                       /*!< Number of points averaged for the peak ("PeakMean"). */
+    int RTFactor;                 /*!< Lower limit of the rise time in percent ("RTFactor"). */
+    double slopeForThreshold;     /*!< Slope for threshold detection ("Slope"). */
+    bool fromBase;                /*!< Measure amplitudes from the baseline rather than from the threshold ("FromBase"). */
+    latency_mode latencyStartMode; /*!< Start of latency measurement ("LatencyStartMode"). */
+    latency_mode latencyEndMode;  /*!< End of latency measurement ("LatencyEndMode"). */
+    double latencyBeg;            /*!< Manual latency start cursor ("LatencyStartCursor"). */
+    double latencyEnd;            /*!< Manual latency end cursor ("LatencyEndCursor"). */
+};
+
+//! Reads settings from a configuration file.
+/*! The file consists of "key=value" lines. Keys are read from the
+ *  [Settings] group or from lines that precede any group; unknown keys and
+ *  other groups are ignored, so that Stimfit's own configuration file can
+ *  be used. Throws std::runtime_error if the file can't be read or if a
+ *  value is invalid.
+ *  \param fName Path of the configuration file.
+ *  \return The settings, with defaults for missing keys.
+ */
+Settings ReadSettings(const std::string& fName);
+
+//! Retrieves the labels of the measurement columns.
+/*! \return One label for every value returned by Measure().
+ */
+std::vector<std::string> MeasurementLabels();
+
+//! Performs all measurements on a single section.
+/*! Uses a stfnum::MeasurementKernel, as wxStfDoc::Measure() does. Throws
+ *  std::out_of_range if the cursors exceed the section.
+ *  \param settings Cursor and measurement settings.
+ *  \param sec The section to be measured.
+ *  \param reference Section of the reference channel, or NULL.
+ *  \param dt The sampling interval.
+ *  \return The measured values, in the order given by MeasurementLabels().
+ */
+Vector_double Measure(const Settings& settings, const Section& sec, const Section* reference, double dt);
+
+//! Imports files and measures all of their sections.
+/*! Files are processed concurrently. Files that can't be imported or
+ *  measured are reported in \e errors; their rows are left empty.
+ *  \param files Paths of the files.
+ *  \param type The file type, or stfio::none to determine it from the file extension.
+ *  \param settings Cursor and measurement settings.
+ *  \param errors On exit, one message for every failed file or section.
+ *  \param verbose Print progress to stdout.
+ *  \return A table with one row for every section, labelled by file and section number.
+ */
+stfnum::Table Analyse(const std::vector<std::string>& files, stfio::filetype type,
+                      const Settings& settings, std::vector<std::string>& errors, bool verbose=false);
+
+//! Writes a table to a comma-separated text file.
+/*! The first column holds the row labels; empty cells are left blank.
+ *  Throws std::runtime_error if the file can't be written.
+ *  \param fName Path of the text file.
+ *  \param table The table.
+ */
+void WriteCSV(const std::string& fName, const stfnum::Table& table);
+
+//! Writes a table to an HDF5 file.
+/*! The values are stored as a two-dimensional dataset "/results" in which
+ *  empty cells are NaN; row and column labels are stored as string arrays
+ *  "/rows" and "/columns". Throws std::runtime_error on failure.
+ *  \param fName Path of the HDF5 file.
+ *  \param table The table.
+ */
+void WriteHDF5(const std::string& fName, const stfnum::Table& table);
+
+/*@}*/
+
+}
+
+#endif
@@ -0,0 +1,194 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file main.cpp
+ *  \author Christoph Schmidt-Hieber
+ *  \brief stfbatch: measures all sections of all files in a directory
+ *         with the cursor settings of an interactive Stimfit session.
+ */
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <dirent.h>
+  #include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include "./batch.h"
+
+namespace {
+
+void usage() {
+    std::cerr << "Usage: stfbatch [options] CONFIG DIRECTORY\n"
+              << "Measures every section of every file in DIRECTORY with the cursor\n"
+              << "settings in CONFIG (key=value lines, e.g. Stimfit's configuration file).\n\n"
+              << "Options:\n"
+              << "  -o FILE   Output file; written as HDF5 if FILE ends in .h5,\n"
+              << "            as comma-separated text otherwise (default: results.csv)\n"
+              << "  -t TYPE   File type (abf, atf, axg, cfs, hdf5, heka, igor, intan,\n"
+              << "            tdms, biosig); determined from the extension by default\n"
+              << "  -e EXT    Only process files ending in EXT (e.g. .abf)\n"
+              << "  -j N      Number of threads (default: number of cores)\n"
+              << "  -v        Print progress\n";
+}
+
+stfio::filetype gettype(const std::string& ftype) {
+    if (ftype == "cfs") return stfio::cfs;
+    else if (ftype == "hdf5") return stfio::hdf5;
+    else if (ftype == "abf") return stfio::abf;
+    else if (ftype == "atf") return stfio::atf;
+    else if (ftype == "axg") return stfio::axg;
+    else if (ftype == "biosig") return stfio::biosig;
+    else if (ftype == "heka") return stfio::heka;
+    else if (ftype == "igor") return stfio::igor;
+    else if (ftype == "tdms") return stfio::tdms;
+    else if (ftype == "intan") return stfio::intan;
+    else throw std::runtime_error("Unknown file type: " + ftype);
+}
+
+bool endsWith(const std::string& str, const std::string& suffix) {
+    if (suffix.size() > str.size()) return false;
+    for (std::size_t n = 0; n < suffix.size(); ++n) {
+        if (tolower((unsigned char)str[str.size()-suffix.size()+n]) != tolower((unsigned char)suffix[n]))
+            return false;
+    }
+    return true;
+}
+
+// Regular files in dirName, sorted by name:
+std::vector<std::string> listFiles(const std::string& dirName) {
+    std::vector<std::string> files;
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    HANDLE hFind = FindFirstFileA((dirName + "\\*").c_str(), &findData);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Couldn't open directory " + dirName);
+    }
+    do {
+        if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            files.push_back(dirName + "\\" + findData.cFileName);
+        }
+    } while (FindNextFileA(hFind, &findData));
+    FindClose(hFind);
+#else
+    DIR* dir = opendir(dirName.c_str());
+    if (dir == NULL) {
+        throw std::runtime_error("Couldn't open directory " + dirName);
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        std::string path = dirName + "/" + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            files.push_back(path);
+        }
+    }
+    closedir(dir);
+#endif
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string output("results.csv"), extension;
+    stfio::filetype type = stfio::none;
+    bool verbose = false;
+    std::vector<std::string> args;
+
+    try {
+        for (int n = 1; n < argc; ++n) {
+            std::string arg(argv[n]);
+            if (arg == "-h" || arg == "--help") {
+                usage();
+                return 0;
+            } else if (arg == "-v") {
+                verbose = true;
+            } else if ((arg == "-o" || arg == "-t" || arg == "-e" || arg == "-j") && n+1 < argc) {
+                std::string value(argv[++n]);
+                if (arg == "-o") {
+                    output = value;
+                } else if (arg == "-t") {
+                    type = gettype(value);
+                } else if (arg == "-e") {
+                    extension = value;
+                } else {
+                    int nthreads = atoi(value.c_str());
+                    if (nthreads < 1) {
+                        throw std::runtime_error("Invalid number of threads: " + value);
+                    }
+#ifdef _OPENMP
+                    omp_set_num_threads(nthreads);
+#endif
+                }
+            } else if (!arg.empty() && arg[0] == '-') {
+                usage();
+                return 1;
+            } else {
+                args.push_back(arg);
+            }
+        }
+        if (args.size() != 2) {
+            usage();
+            return 1;
+        }
+
+        stfbatch::Settings settings = stfbatch::ReadSettings(args[0]);
+
+        std::vector<std::string> allFiles = listFiles(args[1]), files;
+        for (std::size_t n = 0; n < allFiles.size(); ++n) {
+            if (!extension.empty()) {
+                if (!endsWith(allFiles[n], extension)) continue;
+            } else if (type == stfio::none) {
+                // Skip files with unknown extensions, e.g. the output of a previous run:
+                std::size_t dot = allFiles[n].rfind('.');
+                std::string ext = dot == std::string::npos ? "" : allFiles[n].substr(dot);
+                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                if (stfio::findType("*" + ext) == stfio::none) continue;
+            }
+            files.push_back(allFiles[n]);
+        }
+        if (files.empty()) {
+            std::cerr << "No files found in " << args[1] << std::endl;
+            return 1;
+        }
+
+        std::vector<std::string> errors;
+        stfnum::Table table = stfbatch::Analyse(files, type, settings, errors, verbose);
+        for (std::size_t n = 0; n < errors.size(); ++n) {
+            std::cerr << errors[n] << std::endl;
+        }
+
+        if (endsWith(output, ".h5")) {
+            stfbatch::WriteHDF5(output, table);
+        } else {
+            stfbatch::WriteCSV(output, table);
+        }
+        if (verbose) {
+            std::cout << table.nRows() << " sections measured, results written to " << output << std::endl;
+        }
+        return errors.empty() ? 0 : 2;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "stfbatch: " << e.what() << std::endl;
+        return 1;
+    }
+}
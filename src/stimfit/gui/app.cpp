@@ -29,6 +29,7 @@
 #include <wx/init.h>
 #include <wx/datetime.h>
 #include <wx/filename.h>
+#include <wx/stdpaths.h>
 #include <wx/stockitem.h>
 
 #ifdef __BORLANDC__
@@ -159,6 +160,15 @@ bool wxStfApp::OnInit(void)
     // Config:
     config.reset(new wxFileConfig(wxT("Stimfit")));
 
+    // FFTW plans are reused between sessions. Measured plans are faster,
+    // but take a while to be created for every new transform size:
+    if (wxGetProfileInt(wxT("Settings"), wxT("FFTWMeasure"), 0)) {
+        stfnum::setFFTPlannerFlags(FFTW_MEASURE);
+    }
+    if (wxFileName::FileExists(GetFFTWisdomFile())) {
+        stfnum::importFFTWisdom(stf::wx2std(GetFFTWisdomFile()));
+    }
+
     //// Create a document manager
     wxDocManager* docManager = new wxDocManager;
     //// Create a template relating drawing documents to their views
@@ -359,6 +369,10 @@ int wxStfApp::OnExit()
 
     delete GetDocManager();
 
+    if (wxFileName::Mkdir(wxStandardPaths::Get().GetUserDataDir(), wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+        stfnum::exportFFTWisdom(stf::wx2std(GetFFTWisdomFile()));
+    }
+
 #ifdef WITH_PYTHON
     Exit_wxPython();
 #endif
@@ -366,6 +380,10 @@ int wxStfApp::OnExit()
     return wxApp::OnExit();
 }
 
+wxString wxStfApp::GetFFTWisdomFile() const {
+    return wxFileName(wxStandardPaths::Get().GetUserDataDir(), wxT("fftw_wisdom")).GetFullPath();
+}
+
 // "Fake" registry
 void wxStfApp::wxWriteProfileInt(const wxString& main, const wxString& sub, int value) const {
     // create a wxConfig-compatible path:
@@ -502,6 +502,9 @@ private:
 #endif // WITH_PYTHON
 
     wxMenuBar* CreateUnifiedMenuBar(wxStfDoc* doc=NULL);
+
+    // Path of the file that keeps the FFTW wisdom between sessions
+    wxString GetFFTWisdomFile() const;
     
 #ifdef _WINDOWS
 #pragma optimize( "", off )
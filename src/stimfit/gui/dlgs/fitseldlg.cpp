@@ -21,7 +21,7 @@ END_EVENT_TABLE()
 wxStfFitSelDlg::wxStfFitSelDlg(wxWindow* parent, wxStfDoc* doc, int id, wxString title, wxPoint pos,
                                wxSize size, int style)
 : wxDialog( parent, id, title, pos, size, style ),
-    m_fselect(18), init_p(0), opts(6), noInput(false), use_scaling(false),
+    m_fselect(18), init_p(0), opts(6), noInput(false), use_scaling(false), warm_start(false),
     paramDescArray(MAXPAR),
     paramEntryArray(MAXPAR), pDoc(doc)
 {
@@ -231,7 +231,18 @@ void wxStfFitSelDlg::InitOptions(wxFlexGridSizer* optionsGrid) {
                                          wxDefaultPosition, wxDefaultSize, 0); 
     m_checkBox->SetValue(false);
     optionsGrid->Add( m_checkBox, 0, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL | wxALL, 2 );
-    
+
+    // Warm start (batch analysis only)----------------------------------
+    m_checkBoxWarmStart = new wxCheckBox(this, wxID_ANY, wxT("Start fits from previous trace"),
+                                         wxDefaultPosition, wxDefaultSize, 0);
+    m_checkBoxWarmStart->SetValue(false);
+    m_checkBoxWarmStart->Enable(noInput);
+    optionsGrid->Add( m_checkBoxWarmStart, 0, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL | wxALL, 2 );
+}
+
+void wxStfFitSelDlg::SetNoInput(bool noInput_) {
+    noInput=noInput_;
+    m_checkBoxWarmStart->Enable(noInput);
 }
 
 void wxStfFitSelDlg::OnButtonClick( wxCommandEvent& event ) {
@@ -372,4 +383,5 @@ void wxStfFitSelDlg::read_opts() {
     entryMaxpasses.ToDouble( &opts[5] );
 
     use_scaling = m_checkBox->GetValue();
+    warm_start = noInput && m_checkBoxWarmStart->GetValue();
 }
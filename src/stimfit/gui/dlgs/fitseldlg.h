@@ -39,7 +39,7 @@ private:
     int m_fselect;
     Vector_double init_p;
     Vector_double opts;
-    bool noInput, use_scaling;
+    bool noInput, use_scaling, warm_start;
 
     void SetPars();
     void SetOpts();
@@ -56,7 +56,7 @@ private:
     wxListCtrl* m_listCtrl;
     wxTextCtrl *m_textCtrlMu,*m_textCtrlJTE,*m_textCtrlDP,*m_textCtrlE2,
         *m_textCtrlMaxiter, *m_textCtrlMaxpasses;
-    wxCheckBox *m_checkBox;
+    wxCheckBox *m_checkBox, *m_checkBoxWarmStart;
     std::vector< wxStaticText* > paramDescArray;
     std::vector< wxTextCtrl* > paramEntryArray;
 
@@ -113,11 +113,16 @@ public:
      */
     bool UseScaling() const {return use_scaling;}
 
+    //! Start each fit of a batch analysis from the best-fit parameters of the previous trace
+    /*! \return True if fits should be warm-started
+     */
+    bool WarmStartFits() const {return warm_start;}
+
     //! Determines whether user-defined initial parameters are allowed.
     /*! \param noInput_ Set to true if the user may set the initial parameters, false otherwise.
      *         Needed for batch analysis.
      */
-    void SetNoInput(bool noInput_) {noInput=noInput_;}
+    void SetNoInput(bool noInput_);
 };
 
 /* @} */
@@ -465,7 +465,7 @@ public:
     /*! \return true if it should be printed, false otherwise.
      */
     bool PrintFitResults() const {return LookUp(id_fit).selection;}
-    
+
     //! Called upon ending a modal dialog.
     /*! \param retCode The dialog button id that ended the dialog
      *         (e.g. wxID_OK)
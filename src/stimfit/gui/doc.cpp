@@ -244,49 +244,35 @@ bool wxStfDoc::OnOpenDocument(const wxString& filename) {
             }
         }
 #endif
-        if (type == stfio::tdms) {
-#ifdef WITH_PYTHON
-            if (!LoadTDMS(stf::wx2std(filename), *this)) {
-                wxString errorMsg(wxT("Error opening file\n"));
-#else
-            {
-                wxString errorMsg(wxT("Error opening file - TDMS requires python \n"));
-#endif
-                wxGetApp().ExceptMsg(errorMsg);
-                get().clear();
-                return false;
-            }
-        } else {
-            try {
-                if (progress) {
-                    stf::wxProgressInfo progDlg("Reading file", "Opening file", 100);
-                    stfio::importFile(stf::wx2std(filename), type, *this, wxGetApp().GetTxtImport(), progDlg);
-                } else {
-                    stfio::StdoutProgressInfo progDlg("Reading file", "Opening file", 100, true);
-                    stfio::importFile(stf::wx2std(filename), type, *this, wxGetApp().GetTxtImport(), progDlg);
-                }
-            }
-            catch (const std::runtime_error& e) {
-                wxString errorMsg(wxT("Error opening file\n"));
-                errorMsg += wxString( e.what(),wxConvLocal );
-                wxGetApp().ExceptMsg(errorMsg);
-                get().clear();
-                return false;
-            }
-            catch (const std::exception& e) {
-                wxString errorMsg(wxT("Error opening file\n"));
-                errorMsg += wxString( e.what(), wxConvLocal );
-                wxGetApp().ExceptMsg(errorMsg);
-                get().clear();
-                return false;
-            }
-            catch (...) {
-                wxString errorMsg(wxT("Error opening file\n"));
-                wxGetApp().ExceptMsg(errorMsg);
-                get().clear();
-                return false;
+        try {
+            if (progress) {
+                stf::wxProgressInfo progDlg("Reading file", "Opening file", 100);
+                stfio::importFile(stf::wx2std(filename), type, *this, wxGetApp().GetTxtImport(), progDlg);
+            } else {
+                stfio::StdoutProgressInfo progDlg("Reading file", "Opening file", 100, true);
+                stfio::importFile(stf::wx2std(filename), type, *this, wxGetApp().GetTxtImport(), progDlg);
             }
         }
+        catch (const std::runtime_error& e) {
+            wxString errorMsg(wxT("Error opening file\n"));
+            errorMsg += wxString( e.what(),wxConvLocal );
+            wxGetApp().ExceptMsg(errorMsg);
+            get().clear();
+            return false;
+        }
+        catch (const std::exception& e) {
+            wxString errorMsg(wxT("Error opening file\n"));
+            errorMsg += wxString( e.what(), wxConvLocal );
+            wxGetApp().ExceptMsg(errorMsg);
+            get().clear();
+            return false;
+        }
+        catch (...) {
+            wxString errorMsg(wxT("Error opening file\n"));
+            wxGetApp().ExceptMsg(errorMsg);
+            get().clear();
+            return false;
+        }
         if (get().empty()) {
             wxGetApp().ErrorMsg(wxT("File is probably empty\n"));
             get().clear();
@@ -907,6 +893,15 @@ bool wxStfDoc::SetSection(std::size_t section){
         }
     }
     CheckBoundaries();
+    // The section that leaves view drops its decoded data points if they can
+    // be decoded again, so that memory scales with what is viewed:
+    if (section != GetCurSecIndex()) {
+        for (std::size_t n_c=0; n_c < get().size(); ++n_c) {
+            if (GetCurSecIndex() < get()[n_c].size()) {
+                get()[n_c][GetCurSecIndex()].Release();
+            }
+        }
+    }
     SetCurSecIndex(section);
     UpdateSelectedButton();
 
@@ -1028,9 +1023,6 @@ void wxStfDoc::CreateAverage(
         // check that we have more than one channel
         wxStfAlignDlg AlignDlg(GetDocumentWindow(), size()>1);
         if (AlignDlg.ShowModal() != wxID_OK) return;
-        //store current section and channel index:
-        std::size_t section_old=GetCurSecIndex();
-        std::size_t channel_old=GetCurChIndex();
         //initialize the lowest and the highest index:
         std::size_t min_index=0;
         try {
@@ -1045,62 +1037,57 @@ void wxStfDoc::CreateAverage(
             wxGetApp().ExceptMsg(msg);
             return;
         }
-        // swap channels temporarily:
-        // if (AlignDlg.UseReference())
-        //     SetCurChIndex(GetSecChIndex());
+        // Measure all selected sections of the aligned channel at once.
+        // The alignment points of the reference (==second) channel are
+        // measured like its action potential in Measure().
+        stfnum::MeasurementPlan plan(GetMeasurementSettings(), peakAtEnd);
+        std::vector<stfnum::MeasurementResults> results;
+        std::vector<stfnum::ReferenceResults> refResults;
+        try {
+            if (AlignDlg.UseReference())
+                refResults = plan.MeasureReference(get()[GetSecChIndex()], GetSelectedSections());
+            else
+                results = plan.Measure(get()[GetCurChIndex()], GetSelectedSections());
+        }
+        catch (const std::exception& e) {
+            Average.resize(0);
+            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+            return;
+        }
         std::size_t max_index=0, n=0;
         int_it it = shift.begin();
         //loop through all selected sections:
-        for (c_st_it cit = GetSelectedSections().begin();
-             cit != GetSelectedSections().end() && it != shift.end();
-             cit++)
-        {
-            //Set the selected section as the current section temporarily:
-            SetSection(*cit);
-            if (peakAtEnd) {
-                SetPeakEnd((int)get()[GetSecChIndex()][*cit].size()-1);
-            }
-            // Calculate all variables for the current settings
-            // APMaxSlopeT will be calculated for the second (==reference)
-            // channel, so channels may not be changed!
-            try {
-                Measure();
-            }
-            catch (const std::out_of_range& e) {
-                Average.resize(0);
-                SetSection(section_old);
-                SetCurChIndex(channel_old);
-                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-                return;
-            }
-
+        for (; n < GetSelectedSections().size() && it != shift.end(); n++, it++) {
             std::size_t alignIndex;
             //check whether the current index is a max or a min,
             //and if so, store it:
             switch (AlignDlg.AlignRise()) {
              case 0:	// align to peak time
                  if (AlignDlg.UseReference())
-                     alignIndex = lround(GetAPMaxT());
+                     alignIndex = lround(refResults[n].maxT);
                  else
-                     alignIndex = lround(GetMaxT());
+                     alignIndex = lround(results[n].maxT);
                  break;
              case 1:	// align to steepest slope time
                  if (AlignDlg.UseReference())
-                     alignIndex = lround(GetAPMaxRiseT());
+                     alignIndex = lround(refResults[n].maxRiseT);
                  else
-                     alignIndex = lround(GetMaxRiseT());
+                     alignIndex = lround(results[n].maxRiseT);
                  break;
              case 2:	// align to half amplitude time 
                  if (AlignDlg.UseReference())
-                     alignIndex = lround(GetAPT50LeftReal());
+                     alignIndex = lround(refResults[n].t50LeftReal);
                  else
-                     alignIndex = lround(GetT50LeftReal());
+                     alignIndex = lround(results[n].t50LeftReal);
                  break;
             case 3:     // align to onset
+                 // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
                  if (AlignDlg.UseReference())
-                     alignIndex = lround(GetAPT0Real());
+                     alignIndex = lround(refResults[n].tLoReal-refResults[n].rtLoHi/3.0);
+                 else if (latencyEndMode==stf::footMode)
+                     alignIndex = lround(results[n].tLoReal-results[n].rtLoHi/3.0);
                  else
-                     alignIndex = lround(GetT0Real());
+                     alignIndex = lround(results[n].t50LeftReal);
                  break;
             default:
                 wxGetApp().ExceptMsg(wxT("Invalid alignment method"));
@@ -1114,17 +1101,12 @@ void wxStfDoc::CreateAverage(
             if (alignIndex < min_index) {
                 min_index=alignIndex;
             }
-            n++;
-            it++;
         }
         //now that max and min indices are known, calculate the number of
         //points that need to be shifted:
         for (int_it it = shift.begin(); it != shift.end(); it++) {
             (*it) -= (int)min_index;
         }
-        //restore section and channel settings:
-        SetSection(section_old);
-        SetCurChIndex(channel_old);
         shift_size = (max_index-min_index);
     }
 
@@ -1208,7 +1190,7 @@ void wxStfDoc::FitDecay(wxCommandEvent& WXUNUSED(event)) {
         std::size_t fitSize = GetFitEnd() - GetFitBeg();
         Vector_double x( fitSize );
         //fill array:
-        std::copy(&cursec()[GetFitBeg()], &cursec()[GetFitBeg()+fitSize], &x[0]);
+        cursec().GetWindow(GetFitBeg(), fitSize, x);
         if (params.size() != n_params) {
             throw std::runtime_error("Wrong size of params in wxStfDoc::lmFit()");
         }
@@ -1266,7 +1248,7 @@ void wxStfDoc::LFit(wxCommandEvent& WXUNUSED(event)) {
 
     //fill array:
     Vector_double x(n_points);
-    std::copy(&cursec()[GetFitBeg()], &cursec()[GetFitBeg()+n_points], &x[0]);
+    cursec().GetWindow(GetFitBeg(), n_points, x);
     Vector_double t(x.size());
     for (std::size_t n_t=0;n_t<x.size();++n_t) t[n_t]=n_t*GetXScale();
 
@@ -1521,8 +1503,8 @@ void wxStfDoc::OnAnalysisBatch(wxCommandEvent &WXUNUSED(event)) {
         }
         threshold=myDlg.readInput()[0];
     }
-    wxProgressDialog progDlg( wxT("Batch analysis in progress"), wxT("Starting batch analysis"),
-            100, GetDocumentWindow(), wxPD_SMOOTH | wxPD_AUTO_HIDE | wxPD_APP_MODAL );
+    // The same dialog shows the progress of the measurements and of the fits:
+    stf::wxProgressInfo progDlg("Batch analysis in progress", "Starting batch analysis", 100);
 
     stfnum::Table table(GetSelectedSections().size(),colTitles.size());
     for (std::size_t nCol=0;nCol<colTitles.size();++nCol) {
@@ -1535,135 +1517,125 @@ void wxStfDoc::OnAnalysisBatch(wxCommandEvent &WXUNUSED(event)) {
             return;
         }
     }
+    // All selected sections are measured at once, concurrently if possible:
+    const Channel& channel = get()[GetCurChIndex()];
+    stfnum::MeasurementPlan plan(GetMeasurementSettings(), peakAtEnd);
+    std::vector<stfnum::MeasurementResults> results;
+    progDlg.Update( 0, "Measuring selected traces" );
+    try {
+        results = plan.Measure(channel, GetSelectedSections());
+    }
+    catch (const std::exception& e) {
+        wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+        return;
+    }
+    // Latencies and pSlopes depend on the cursor modes of the document and on
+    // the second channel, so they still require a full Measure() per trace:
+    bool measureDoc = SaveYtDialog.PrintLatencies();
+#ifdef WITH_PSLOPE
+    measureDoc = measureDoc || SaveYtDialog.PrintPSlopes();
+#endif
+
+    // The fits are collected while measuring and performed concurrently afterwards:
+    std::vector<stfnum::FitJob> fitJobs;
+    std::vector<std::size_t> fitSections, fitBegs, fitEnds;
+    std::size_t fitCol = 0;
     std::size_t n_s = 0;
+    const double dt = GetXScale(), sr = GetSR();
     for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
-        wxString progStr;
-        progStr << wxT("Processing trace # ") << (int)n_s+1 << wxT(" of ") << (int)GetSelectedSections().size();
-        progDlg.Update( (int)((double)n_s/ (double)GetSelectedSections().size()*100.0), progStr );
-        SetSection(*cit);
-        if (peakAtEnd)
-            SetPeakEnd((int)get()[GetCurChIndex()][*cit].size()-1);
-
-        //Calculate all variables for the current settings
-        try {
-            Measure();
-        }
-        catch (const std::out_of_range& e) {
-            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-            SetSection(section_old);
-            return;
-        }
-
-        // Set fit start cursor to new peak if necessary:
-        //if (wxGetApp().GetCursorsDialog() != NULL && wxGetApp().GetCursorsDialog()->GetStartFitAtPeak())
-        if ( startFitAtPeak )
-            SetFitBeg(GetMaxT());
-
-        Vector_double params;
-        int fitWarning = 0;
-        if (SaveYtDialog.PrintFitResults()) {
-            try {
-                n_params=(int)wxGetApp().GetFuncLib().at(fselect).pInfo.size();
-            }
-            catch (const std::out_of_range& e) {
-                wxString msg(wxT("Could not retrieve function from library:\n"));
-                msg+=wxString( e.what(), wxConvLocal );
-                wxGetApp().ExceptMsg(msg);
-                return;
-            }
-            // in this case, initialize parameters from init function,
-            // not from user input:
-            Vector_double x(GetFitEnd()-GetFitBeg());
-            //fill array:
-            std::copy(&cursec()[GetFitBeg()], &cursec()[GetFitEnd()], &x[0]);
-            params.resize(n_params);
-            wxGetApp().GetFuncLib().at(fselect).init( x, GetBase(), GetPeak(), GetRTLoHi(),
-                    GetHalfDuration(), GetXScale(), params );
-
-            std::string fitInfo;
+        std::ostringstream progStr;
+        progStr << "Processing trace # " << (int)n_s+1 << " of " << (int)GetSelectedSections().size();
+        progDlg.Update( (int)((double)n_s/ (double)GetSelectedSections().size()*100.0), progStr.str() );
+        const Section& sec = channel[*cit];
+        const stfnum::MeasurementResults& r = results[n_s];
+        if (measureDoc) {
+            SetSection(*cit);
+            if (peakAtEnd)
+                SetPeakEnd((int)sec.size()-1);
             try {
-                double chisqr = stfnum::lmFit( x, GetXScale(), wxGetApp().GetFuncLib()[fselect],
-                                            FitSelDialog.GetOpts(), FitSelDialog.UseScaling(),
-                                            params, fitInfo, fitWarning );
-                SetIsFitted( GetCurChIndex(), GetCurSecIndex(), params, wxGetApp().GetFuncLibPtr(fselect),
-                             chisqr, GetFitBeg(), GetFitEnd() );
+                Measure();
             }
-
             catch (const std::out_of_range& e) {
                 wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
                 SetSection(section_old);
                 return;
             }
-            catch (const std::runtime_error& e) {
-                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-                SetSection(section_old);
-                return;
-            }
-            catch (const std::exception& e) {
-                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-                SetSection(section_old);
-                return;
-            }
+        }
+
+        if (SaveYtDialog.PrintFitResults()) {
+            // Set fit start cursor to new peak if necessary:
+            std::size_t fitBegSec = startFitAtPeak ? (std::size_t)r.maxT : GetFitBeg();
+            std::size_t fitEndSec = GetFitEnd();
+            if (fitBegSec > fitEndSec)
+                std::swap(fitBegSec, fitEndSec);
+            if (fitEndSec > sec.size())
+                fitEndSec = sec.size();
+            // in this case, initialize parameters from init function,
+            // not from user input:
+            Vector_double x(sec.get().begin()+fitBegSec, sec.get().begin()+fitEndSec);
+            Vector_double params(n_params);
+            wxGetApp().GetFuncLib().at(fselect).init( x, r.base, r.peak, r.rtLoHi/sr,
+                    r.halfDuration/sr, dt, params );
+            fitJobs.push_back( stfnum::FitJob( x, dt, wxGetApp().GetFuncLib()[fselect], params,
+                                               FitSelDialog.GetOpts(), FitSelDialog.UseScaling() ) );
+            fitSections.push_back(*cit);
+            fitBegs.push_back(fitBegSec);
+            fitEnds.push_back(fitEndSec);
         }
 
         // count number of threshold crossings if needed:
         std::size_t n_crossings=0;
         if (SaveYtDialog.PrintThr()) {
-            n_crossings= stfnum::peakIndices( cursec().get(), threshold, 0 ).size();
+            n_crossings= stfnum::peakIndices( sec.get(), threshold, 0 ).size();
         }
         std::size_t nCol=0;
         //Write the variables of the current channel in a string
         try {
-            table.SetRowLabel(n_s, cursec().GetSectionDescription());
+            table.SetRowLabel(n_s, sec.GetSectionDescription());
 
             if (SaveYtDialog.PrintBase())
-                table.at(n_s,nCol++)=GetBase();
+                table.at(n_s,nCol++)=r.base;
             if (SaveYtDialog.PrintBaseSD())
-                table.at(n_s,nCol++)=GetBaseSD();
+                table.at(n_s,nCol++)=r.baseSD;
             if (SaveYtDialog.PrintThreshold())
-                table.at(n_s,nCol++)=GetThreshold();
+                table.at(n_s,nCol++)=r.threshold;
             if (SaveYtDialog.PrintSlopeThresholdTime())
-                table.at(n_s,nCol++)=GetThrT()*GetXScale();
+                table.at(n_s,nCol++)=r.thrT*dt;
             if (SaveYtDialog.PrintPeakZero())
-                table.at(n_s,nCol++)=GetPeak();
+                table.at(n_s,nCol++)=r.peak;
             if (SaveYtDialog.PrintPeakBase())
-                table.at(n_s,nCol++)=GetPeak()-GetBase();
+                table.at(n_s,nCol++)=r.peak-r.base;
             if (SaveYtDialog.PrintPeakThreshold())
-                table.at(n_s,nCol++)=GetPeak()-GetThreshold();
+                table.at(n_s,nCol++)=r.peak-r.threshold;
             if (SaveYtDialog.PrintPeakTime())
-                table.at(n_s,nCol++)=GetPeakTime()*GetXScale();
+                table.at(n_s,nCol++)=r.maxT*dt;
             if (SaveYtDialog.PrintRTLoHi())
-                table.at(n_s,nCol++)=GetRTLoHi();
+                table.at(n_s,nCol++)=r.rtLoHi/sr;
             if (SaveYtDialog.PrintInnerRTLoHi())
-                table.at(n_s,nCol++)=GetInnerRiseTime();
+                table.at(n_s,nCol++)=r.innerHiRT/sr-r.innerLoRT/sr;
             if (SaveYtDialog.PrintOuterRTLoHi())
-                table.at(n_s,nCol++)=GetOuterRiseTime();
+                table.at(n_s,nCol++)=r.outerHiRT/sr-r.outerLoRT/sr;
             if (SaveYtDialog.PrintT50())
-                table.at(n_s,nCol++)=GetHalfDuration();
+                table.at(n_s,nCol++)=r.halfDuration/sr;
             if (SaveYtDialog.PrintT50SE()) {
-                table.at(n_s,nCol++)=GetT50LeftReal()*GetXScale();
-                table.at(n_s,nCol++)=GetT50RightReal()*GetXScale();
+                table.at(n_s,nCol++)=r.t50LeftReal*dt;
+                table.at(n_s,nCol++)=(r.t50LeftReal+r.halfDuration)*dt;
             }
             if (SaveYtDialog.PrintSlopes()) {
-                table.at(n_s,nCol++)=GetMaxRise();
-                table.at(n_s,nCol++)=GetMaxDecay();
+                table.at(n_s,nCol++)=r.maxRise*sr;
+                table.at(n_s,nCol++)=r.maxDecay*sr;
             }
             if (SaveYtDialog.PrintSlopeTimes()) {
-                table.at(n_s,nCol++)=GetMaxRiseT()*GetXScale();
-                table.at(n_s,nCol++)=GetMaxDecayT()*GetXScale();
+                table.at(n_s,nCol++)=r.maxRiseT*dt;
+                table.at(n_s,nCol++)=r.maxDecayT*dt;
             }
             if (SaveYtDialog.PrintLatencies()) {
                 table.at(n_s,nCol++)=GetLatency()*GetXScale();
             }
             if (SaveYtDialog.PrintFitResults()) {
-                for (std::size_t n_pf=0;n_pf<n_params;++n_pf) {
-                    table.at(n_s,nCol++)=params[n_pf];
-                }
-                if (fitWarning != 0) {
-                    table.at(n_s,nCol++) = (double)fitWarning;
-                } else {
-                    table.SetEmpty(n_s,nCol++);
-                }
+                // filled in once all fits have been performed:
+                fitCol = nCol;
+                nCol += n_params+1;
             }
 #ifdef WITH_PSLOPE
             if (SaveYtDialog.PrintPSlopes()) {
@@ -1681,7 +1653,49 @@ void wxStfDoc::OnAnalysisBatch(wxCommandEvent &WXUNUSED(event)) {
         }
         n_s++;
     }
-    progDlg.Update(100,wxT("Finished"));
+    // The cursors end up where a measurement of the last trace would leave them:
+    if (!results.empty()) {
+        if (peakAtEnd)
+            SetPeakEnd((int)channel[GetSelectedSections().back()].size()-1);
+        if (startFitAtPeak)
+            SetFitBeg((int)results.back().maxT);
+    }
+
+    if (SaveYtDialog.PrintFitResults()) {
+        progDlg.Update( 0, "Fitting selected traces" );
+        stfnum::lmFitBatch( fitJobs, FitSelDialog.WarmStartFits(), progDlg );
+        std::string fitErrors;
+        for (std::size_t n_j=0; n_j<fitJobs.size(); ++n_j) {
+            const stfnum::FitJob& job = fitJobs[n_j];
+            try {
+                if (job.failed) {
+                    fitErrors += table.GetRowLabel(n_j) + ": " + job.error + "\n";
+                    for (std::size_t n_pf=0;n_pf<=n_params;++n_pf) {
+                        table.SetEmpty(n_j,fitCol+n_pf);
+                    }
+                    continue;
+                }
+                SetIsFitted( GetCurChIndex(), fitSections[n_j], job.p, wxGetApp().GetFuncLibPtr(fselect),
+                             job.chisqr, fitBegs[n_j], fitEnds[n_j] );
+                for (std::size_t n_pf=0;n_pf<n_params;++n_pf) {
+                    table.at(n_j,fitCol+n_pf)=job.p[n_pf];
+                }
+                if (job.warning != 0) {
+                    table.at(n_j,fitCol+n_params) = (double)job.warning;
+                } else {
+                    table.SetEmpty(n_j,fitCol+n_params);
+                }
+            }
+            catch (const std::exception& e) {
+                fitErrors += std::string(e.what()) + "\n";
+            }
+        }
+        if (!fitErrors.empty()) {
+            wxGetApp().ExceptMsg(wxT("Some fits failed:\n") + stf::std2wx(fitErrors));
+        }
+    }
+    progDlg.Update(100, "Finished");
+
     SetSection(section_old);
     wxStfChildFrame* pFrame=(wxStfChildFrame*)GetDocumentWindow();
     pFrame->ShowTable(table,wxT("Batch analysis results"));
@@ -2041,43 +2055,34 @@ void wxStfDoc::Filter(wxCommandEvent& WXUNUSED(event)) {
 
     /*sampling interval in ms*/
 
+    stfnum::Func func;
+    switch (fselect) {
+        case 3: func = stfnum::fgaussColqu; inverse = false; break;
+        case 2: func = stfnum::fbessel4; inverse = false; break;
+        case 1: func = stfnum::fgauss; break;
+        default: return;
+    }
+
+    // All selected sections are filtered in one batch:
+    std::vector<Vector_double> filtered;
+    try {
+        filtered = stfnum::filterBatch(get()[GetCurChIndex()], GetSelectedSections(),
+                                       llf, ulf, a, (int)GetSR(), func, inverse, true);
+    }
+    catch (const std::exception& e) {
+        wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+        return;
+    }
+
     Channel TempChannel(GetSelectedSections().size(), get()[GetCurChIndex()][GetSelectedSections()[0]].size());
     std::size_t n = 0;
     for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
-        try {
-            switch (fselect) {
-                case 3: {
-                    Section FftTemp(stfnum::filter(get()[GetCurChIndex()][*cit].get(),
-                            llf,ulf,a,(int)GetSR(),stfnum::fgaussColqu,false));
-		    FftTemp.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
-                    FftTemp.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
-                                                   ", filtered");
-                    TempChannel.InsertSection(FftTemp, n);
-                    break;
-                }
-                case 2: {
-                    Section FftTemp(stfnum::filter(get()[GetCurChIndex()][*cit].get(),
-                            llf,ulf,a,(int)GetSR(),stfnum::fbessel4,false));
-		    FftTemp.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
-                    FftTemp.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
-                                                   ", filtered" );
-                    TempChannel.InsertSection(FftTemp, n);
-                    break;
-                }
-                case 1: {
-                    Section FftTemp(stfnum::filter(get()[GetCurChIndex()][*cit].get(),
-                            llf,ulf,a,(int)GetSR(),stfnum::fgauss,inverse));
-		    FftTemp.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
-                    FftTemp.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
-                                                   std::string(", filtered") );
-                    TempChannel.InsertSection(FftTemp, n);
-                    break;
-                }
-            }
-        }
-        catch (const std::exception& e) {
-            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-        }
+        Section FftTemp(filtered[n]);
+        FftTemp.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
+        FftTemp.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
+                                       ", filtered" );
+        TempChannel.InsertSection(FftTemp, n);
+        Vector_double().swap(filtered[n]);
         n++;
     }
     if (TempChannel.size()>0) {
@@ -2269,16 +2274,19 @@ void wxStfDoc::MarkEvents(wxCommandEvent& WXUNUSED(event)) {
         templateWave = stfio::vec_scal_minus(templateWave, fmax);
         double minim=fabs(fmin);
         templateWave = stfio::vec_scal_div(templateWave, minim);
-        Vector_double detect( cursec().get().size() - templateWave.size() );
+        // Template matching and peak search run in parallel chunks:
+        std::vector<int> startIndices;
         switch (MiniDialog.GetMode()) {
          case stf::criterion: {
              stf::wxProgressInfo progDlg("Computing detection criterion...", "Computing detection criterion...", 100);
-             detect=stfnum::detectionCriterion(cursec().get(), templateWave, progDlg);
+             startIndices = stfnum::detectEvents(cursec().get(), templateWave, stfnum::detect_criterion,
+                                                 MiniDialog.GetThreshold(), MiniDialog.GetMinDistance(), progDlg);
              break;
          }
          case stf::correlation: {
              stf::wxProgressInfo progDlg("Computing linear correlation...", "Computing linear correlation...", 100);
-             detect=stfnum::linCorr(cursec().get(), templateWave, progDlg);
+             startIndices = stfnum::detectEvents(cursec().get(), templateWave, stfnum::detect_correlation,
+                                                 MiniDialog.GetThreshold(), MiniDialog.GetMinDistance(), progDlg);
              break;
          }
          case stf::deconvolution:
@@ -2290,16 +2298,15 @@ void wxStfDoc::MarkEvents(wxCommandEvent& WXUNUSED(event)) {
              if (myDlg.ShowModal()!=wxID_OK) return;
              Vector_double filter = myDlg.readInput();
              stf::wxProgressInfo progDlg("Computing deconvolution...", "Starting deconvolution...", 100);
-             detect=stfnum::deconvolve(cursec().get(), templateWave, (int)GetSR(), filter[1], filter[0], progDlg);
+             Vector_double detect=stfnum::deconvolve(cursec().get(), templateWave, (int)GetSR(), filter[1], filter[0], progDlg);
+             if (detect.empty()) {
+                 wxGetApp().ErrorMsg(wxT("Error: Detection criterion is empty."));
+                 return;
+             }
+             startIndices = stfnum::peakIndices( detect, MiniDialog.GetThreshold(),
+                                                 MiniDialog.GetMinDistance() );
              break;
         }
-        if (detect.empty()) {
-            wxGetApp().ErrorMsg(wxT("Error: Detection criterion is empty."));
-            return;
-        }
-        std::vector<int> startIndices(
-                stfnum::peakIndices( detect, MiniDialog.GetThreshold(),
-                        MiniDialog.GetMinDistance() ) );
         if (startIndices.empty()) {
             wxGetApp().ErrorMsg( wxT( "No events were found. Try to lower the threshold." ) );
             return;
@@ -2548,20 +2555,20 @@ void wxStfDoc::Threshold(wxCommandEvent& WXUNUSED(event)) {
     }
 }
 
-//Function calculates the peak and respective measures: base, Lo/Hi rise time
-//half duration, ratio of rise/slope and maximum slope
-void wxStfDoc::Measure( )
+stfnum::MeasurementSettings wxStfDoc::GetMeasurementSettings() const
 {
-    double var=0.0;
-    if (cursec().get().size() == 0) return;
-    try {
-        cursec().at(0);
-    }
-    catch (const std::out_of_range&) {
-        return;
-    }
+    stfnum::MeasurementSettings settings;
+    settings.baseBeg = baseBeg;
+    settings.baseEnd = baseEnd;
+    settings.peakBeg = peakBeg;
+    settings.peakEnd = peakEnd;
+    settings.pM = pM;
+    settings.dir = direction;
+    settings.baselineMethod = baselineMethod;
+    settings.slopeForThreshold = slopeForThreshold/GetSR();
+    settings.rtFactor = RTFactor*0.01;
+    settings.fromBase = fromBase;
 
-    long windowLength = 1;
     /*
        windowLength (defined in samples) determines the size of the window for computing slopes.
        if the window length larger than 1 is used, a kind of smoothing and low pass filtering is applied.
@@ -2573,83 +2580,70 @@ void wxStfDoc::Measure( )
        sampled with 20 kHz or lower, will use a 1 sample window, data with a larger sampling rate
        use a window of 0.05 ms for computing the slope.
     */
-    windowLength = lround(0.05 * GetSR());    // use window length of about 0.05 ms.
+    long windowLength = lround(0.05 * GetSR());    // use window length of about 0.05 ms.
     if (windowLength < 1) windowLength = 1;   // use a minimum window length of 1 sample
+    settings.windowLength = windowLength;
 
+    return settings;
+}
 
-    //Begin peak and base calculation
-    //-------------------------------
-    try {
-        base=stfnum::base(baselineMethod,var,cursec().get(),baseBeg,baseEnd);
-        baseSD=sqrt(var);
-        peak=stfnum::peak(cursec().get(),base,
-                       peakBeg,peakEnd,pM,direction,maxT);
-    }
-    catch (const std::out_of_range& e) {
-        base=0.0;
-        baseSD=0.0;
-        peak=0.0;
-        throw e;
-    }
-    try {
-        threshold = stfnum::threshold( cursec().get(), peakBeg, peakEnd, slopeForThreshold/GetSR(), thrT, windowLength );
-    } catch (const std::out_of_range& e) {
-        threshold = 0;
-        throw e;
-    }
-    //Begin Lo to Hi% Rise Time calculation
-    //-------------------------------------
-    // 2009-06-05: reference is either from baseline or from threshold
-    double reference = base;
-    if (!fromBase && thrT >= 0) {
-        reference = threshold;
-    }
-    double ampl=peak-reference;
-    
-    tLoReal=0.0;
-    double factor= RTFactor*0.01; /* normalized value */
-    InnerLoRT=NAN;
-    InnerHiRT=NAN;
-    OuterLoRT=NAN;
-    OuterHiRT=NAN;
-
+//Function calculates the peak and respective measures: base, Lo/Hi rise time
+//half duration, ratio of rise/slope and maximum slope
+void wxStfDoc::Measure( )
+{
+    if (cursec().get().size() == 0) return;
     try {
-        // 2008-04-27: changed limits to start from the beginning of the trace
-        // 2013-06-16: changed to accept different rise-time proportions
-        rtLoHi=stfnum::risetime2(cursec().get(),reference,ampl, (double)0/*(double)baseEnd*/,
-                             maxT, factor/*0.2*/, InnerLoRT, InnerHiRT, OuterLoRT, OuterHiRT);
-        InnerLoRT/=GetSR();
-        InnerHiRT/=GetSR();
-        OuterLoRT/=GetSR();
-        OuterHiRT/=GetSR();
+        cursec().at(0);
     }
-    catch (const std::out_of_range& e) {
-        throw e;
+    catch (const std::out_of_range&) {
+        return;
     }
 
+    stfnum::MeasurementSettings settings = GetMeasurementSettings();
 
+    //Begin peak and base calculation, threshold, rise time,
+    //half duration and maximal slopes of rise and decay
+    //-------------------------------
+    stfnum::MeasurementResults res;
     try {
-        // 2008-04-27: changed limits to start from the beginning of the trace
-        // 2013-06-16: changed to accept different rise-time proportions 
-        rtLoHi=stfnum::risetime(cursec().get(),reference,ampl, (double)0/*(double)baseEnd*/,
-                             maxT, factor/*0.2*/, tLoIndex, tHiIndex, tLoReal);
+        measureKernel.SetSettings(settings);
+        res = measureKernel.Measure(cursec().get());
     }
     catch (const std::out_of_range& e) {
+        base=0.0;
+        baseSD=0.0;
+        peak=0.0;
+        threshold=0.0;
         rtLoHi=0.0;
         throw e;
     }
+    base=res.base;
+    baseSD=res.baseSD;
+    peak=res.peak;
+    maxT=res.maxT;
+    threshold=res.threshold;
+    thrT=res.thrT;
 
+    // 2009-06-05: reference is either from baseline or from threshold
+    double reference = res.reference;
+    double ampl = res.ampl;
+
+    InnerLoRT=res.innerLoRT/GetSR();
+    InnerHiRT=res.innerHiRT/GetSR();
+    OuterLoRT=res.outerLoRT/GetSR();
+    OuterHiRT=res.outerHiRT/GetSR();
+
+    tLoIndex=res.tLoIndex;
+    tHiIndex=res.tHiIndex;
+    tLoReal=res.tLoReal;
+    rtLoHi=res.rtLoHi;
     tHiReal=tLoReal+rtLoHi;
     rtLoHi/=GetSR();
 
-    //Begin Half Duration calculation
-    //-------------------------------
-    //t50LeftReal=0.0;
-    // 2008-04-27: changed limits to start from the beginning of the trace
-    //             and to stop at the end of the trace
-    halfDuration = stfnum::t_half(cursec().get(), reference, ampl, (double)0 /*(double)baseBeg*/,
-            (double)cursec().size()-1 /*(double)peakEnd*/,maxT, t50LeftIndex, t50RightIndex, t50LeftReal);
-
+    t50LeftIndex=res.t50LeftIndex;
+    t50RightIndex=res.t50RightIndex;
+    t50LeftReal=res.t50LeftReal;
+    halfDuration=res.halfDuration;
     t50RightReal=t50LeftReal+halfDuration;
     halfDuration/=GetSR();
     t50Y=0.5*ampl + reference;
@@ -2661,76 +2655,44 @@ void wxStfDoc::Measure( )
         t0Real=t50LeftReal;
     }
 
-    //Begin Ratio of slopes rise/decay calculation
+    //Ratio of slopes rise/decay
     //--------------------------------------------
-    double left_rise = peakBeg;
-    maxRise=stfnum::maxRise(cursec().get(),left_rise,maxT,maxRiseT,maxRiseY,windowLength);
-    double t_half_3=t50RightIndex+2.0*(t50RightIndex-t50LeftIndex);
-    double right_decay=peakEnd<=t_half_3 ? peakEnd : t_half_3+1;
-    maxDecay=stfnum::maxDecay(cursec().get(),maxT,right_decay,maxDecayT,maxDecayY,windowLength);
-
-    //Slope ratio
-    if (maxDecay !=0) slopeRatio=maxRise/maxDecay;
-    else slopeRatio=0.0;
+    maxRise=res.maxRise;
+    maxRiseT=res.maxRiseT;
+    maxRiseY=res.maxRiseY;
+    maxDecay=res.maxDecay;
+    maxDecayT=res.maxDecayT;
+    maxDecayY=res.maxDecayY;
+    slopeRatio=res.slopeRatio;
     maxRise *= GetSR();
     maxDecay *= GetSR();
 
     if (size()>1) {
-        //Calculate the absolute peak of the (AP) Ch2 inbetween the peak boundaries
+        //Calculate the absolute peak of the (AP) Ch2 inbetween the peak boundaries,
+        //the maximal slope in the rise before the peak, the half-maximal amplitude
+        //and the onset in the second channel.
         //A direction dependent evaluation of the peak as in Ch1 does NOT exist!!
-
-        // endResting is set to 100 points arbitrarily in the pascal version
-        // (see measlib.pas) assuming that the resting potential is stable
-        // during the first 100 sampling points.
-        // const int endResting=100;
-        const int searchRange=100;
-        double APBase=0.0, APVar=0.0;
+        stfnum::ReferenceResults ref;
         try {
-            // in 2012-11-02: use baseline cursors and not arbitrarily 100 points
-            //APBase=stfnum::base(APVar,secsec().get(),0,endResting);
-            APBase=stfnum::base(baselineMethod,APVar,secsec().get(), baseBeg, baseEnd ); // use baseline cursors
-            //APPeak=stfnum::peak(secsec().get(),APBase,peakBeg,peakEnd,pM,stfnum::up,APMaxT);
-            APPeak=stfnum::peak( secsec().get(),APBase ,peakBeg ,peakEnd ,pM,direction ,APMaxT );
+            ref = measureKernel.MeasureReference(secsec().get());
         }
         catch (const std::out_of_range& e) {
             APBase=0.0;
             APPeak=0.0;
             throw e;
         }
-        //-------------------------------
-        //Maximal slope in the rise before the peak
-        //----------------------------
-        APMaxRiseT=0.0;
-        APMaxRiseY=0.0;
-        double left_APRise = peakBeg; 
-        //if (GetLatencyWindowMode() == stf::defaultMode ) {
-        left_APRise= APMaxT-searchRange>2.0 ? APMaxT-searchRange : 2.0;
-        try {
-            stfnum::maxRise(secsec().get(),left_APRise,APMaxT,APMaxRiseT,APMaxRiseY,windowLength);
-        }
-        catch (const std::out_of_range&) {
-            APMaxRiseT=0.0;
-            APMaxRiseY=0.0;
-            left_APRise = peakBeg; 
-        }
-
-        //End determination of the region of maximal slope in the second channel
-        //----------------------------
-
-        //-------------------------------
-        //Half-maximal amplitude
-        //----------------------------
-        //APt50LeftReal=0.0;
-        //std::size_t APt50LeftIndex,APt50RightIndex;
-        stfnum::t_half(secsec().get(), APBase, APPeak-APBase, left_APRise,
-                      (double)secsec().get().size(), APMaxT, APt50LeftIndex,
-                      APt50RightIndex, APt50LeftReal);
-        //End determination of the region of maximal slope in the second channel
-        //----------------------------
-
-        // Get onset in 2nd channel
-        APrtLoHi=stfnum::risetime(secsec().get(), APBase, APPeak-APBase, (double)0,
-                                  APMaxT, 0.2, APtLoIndex, APtHiIndex, APtLoReal);
+        APBase=ref.base;
+        APPeak=ref.peak;
+        APMaxT=ref.maxT;
+        APMaxRiseT=ref.maxRiseT;
+        APMaxRiseY=ref.maxRiseY;
+        APt50LeftIndex=ref.t50LeftIndex;
+        APt50RightIndex=ref.t50RightIndex;
+        APt50LeftReal=ref.t50LeftReal;
+        APtLoIndex=ref.tLoIndex;
+        APtHiIndex=ref.tHiIndex;
+        APtLoReal=ref.tLoReal;
+        APrtLoHi=ref.rtLoHi;
         APtHiReal = APtLoReal + APrtLoHi;
         APt0Real = APtLoReal-(APtHiReal-APtLoReal)/3.0;  // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
     }
@@ -2951,7 +2913,8 @@ double wxStfDoc::GetMeasValue() {
     if (measCursor>=curch().size()) {
         correctRangeR(measCursor);
     }
-    return cursec().at(measCursor);
+    // read-only access keeps the cached min/max pyramid of the section:
+    return cursec().get().at(measCursor);
 }
 
 void wxStfDoc::SetBaseBeg(int value) {
@@ -26,6 +26,7 @@
  */
 
 #include "./../stf.h"
+#include "./../../libstfnum/measure.h"
 
 //! The document class, derived from both wxDocument and Recording.
 /*! The document class can be used to model an application’s file-based data.
@@ -85,6 +86,8 @@ private:
 #endif 
     std::size_t baseBeg, baseEnd, peakBeg, peakEnd, fitBeg, fitEnd; 
     stfnum::baseline_method baselineMethod; // method for calculating baseline
+    stfnum::OrderStatistics baseStats; // working memory for the median baseline
+    stfnum::MeasurementKernel measureKernel; // measures the current section
 #ifdef WITH_PSLOPE
     std::size_t PSlopeBeg, PSlopeEnd;
     int DeltaT;  // distance (number of points) from the first cursor
@@ -301,6 +304,11 @@ public:
      *  and the latency.
      */
     void Measure();
+
+    //! Settings of a measurement of the current section.
+    /*! \return The cursor positions and settings that Measure() uses.
+     */
+    stfnum::MeasurementSettings GetMeasurementSettings() const;
     
     //! Put the current measurement results into a text table.
     stfnum::Table CurResultsTable();
@@ -1040,7 +1048,6 @@ public:
 
     void correctRangeR(int& value);
     void correctRangeR(std::size_t& value);
-    bool LoadTDMS(const std::string& filename, Recording& ReturnData);
     
     DECLARE_EVENT_TABLE()
 };
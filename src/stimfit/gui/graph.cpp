@@ -273,7 +273,7 @@ void wxStfGraph::OnDraw( wxDC& DC )
             //Draw current trace on display
             //For display use point to point drawing
             DC.SetPen(standardPen2);
-            PlotTrace(&DC,Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()].get(), reference);
+            PlotTrace(&DC,Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()], reference);
         } else {	//Draw second channel for print out
             //For print out use polyline tool
             DC.SetPen(standardPrintPen2);
@@ -287,7 +287,7 @@ void wxStfGraph::OnDraw( wxDC& DC )
                 //Draw current trace on display
                 //For display use point to point drawing
                 DC.SetPen(standardPen3);
-                PlotTrace(&DC,Doc()->get()[n][Doc()->GetCurSecIndex()].get(), background, n);
+                PlotTrace(&DC,Doc()->get()[n][Doc()->GetCurSecIndex()], background, n);
             }
         }
     }		//End plot of the second channel
@@ -298,7 +298,7 @@ void wxStfGraph::OnDraw( wxDC& DC )
 	//Draw current trace on display
         //For display use point to point drawing
         DC.SetPen(standardPen);
-        PlotTrace(&DC,Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetCurSecIndex()].get());
+        PlotTrace(&DC,Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetCurSecIndex()]);
     } else {
         //For print out use polyline tool
         DC.SetPen(standardPrintPen);
@@ -376,7 +376,7 @@ void wxStfGraph::PlotSelected(wxDC& DC) {
             //For display use point to point drawing
             PlotTrace(
                       &DC,
-                      Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetSelectedSections()[m]].get()
+                      Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetSelectedSections()[m]]
                       );
         }
     }  //End draw traces on display
@@ -396,7 +396,7 @@ void wxStfGraph::PlotAverage(wxDC& DC) {
     {	//Draw Average on display
         //For display use point to point drawing
         DC.SetPen(averagePen);
-        PlotTrace(&DC,Doc()->GetAverage()[0][0].get());
+        PlotTrace(&DC,Doc()->GetAverage()[0][0]);
     }	//End draw Average on display
     else
     {	//Draw average for print out
@@ -534,7 +534,7 @@ void wxStfGraph::PlotEvents(wxDC& DC) {
         eventArrow(&DC, (int)it->GetEventStartIndex());
         // Create circles indicating the peak of an event:
         try {
-            DrawCircle( &DC, it->GetEventPeakIndex(), Doc()->cursec().at(it->GetEventPeakIndex()), eventPen, eventPen );
+            DrawCircle( &DC, it->GetEventPeakIndex(), Doc()->cursec().get().at(it->GetEventPeakIndex()), eventPen, eventPen );
         }
         catch (const std::out_of_range& e) {
             wxGetApp().ExceptMsg( wxString( e.what(), wxConvLocal ) );
@@ -661,7 +661,8 @@ double wxStfGraph::get_plot_y2max() const {
     return SPY2()/YZ2();
 }
 
-void wxStfGraph::PlotTrace( wxDC* pDC, const Vector_double& trace, plottype pt, int bgno ) {
+void wxStfGraph::PlotTrace( wxDC* pDC, const Section& section, plottype pt, int bgno ) {
+    const Vector_double& trace = section.get();
     // speed up drawing by omitting points that are outside the window:
 
     // find point before left window border:
@@ -682,10 +683,11 @@ void wxStfGraph::PlotTrace( wxDC* pDC, const Vector_double& trace, plottype pt,
     if (xri>=0 && xri<(int)trace.size()-1) end=xri;
 
     // apply filter at half the new sampling frequency:
-    DoPlot(pDC, trace, start, end, 1, pt, bgno);
+    DoPlot(pDC, section, start, end, 1, pt, bgno);
 }
 
-void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int end, int step, plottype pt, int bgno) {
+void wxStfGraph::DoPlot( wxDC* pDC, const Section& section, int start, int end, int step, plottype pt, int bgno) {
+    const Vector_double& trace = section.get();
 #if (__cplusplus < 201103)
     boost::function<int(double)> yFormatFunc;
 #else
@@ -700,12 +702,10 @@ void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int e
          yFormatFunc = std::bind1st( std::mem_fun(&wxStfGraph::yFormatD2), this);
          break;
      case background:
-         Vector_double::const_iterator max_el = std::max_element(trace.begin(), trace.end());
-         Vector_double::const_iterator min_el = std::min_element(trace.begin(), trace.end());
-         double min = *min_el;
+         double min = 0.0, max = 0.0;
+         section.GetMinMax(0, trace.size(), min, max);
          if (min>1.0e12)  min= 1.0e12;
          if (min<-1.0e12) min=-1.0e12;
-         double max = *max_el;
          if (max>1.0e12)  max= 1.0e12;
          if (max<-1.0e12) max=-1.0e12;
          wxRect WindowRect=GetRect();
@@ -746,29 +746,30 @@ void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int e
 #else
     } else {
 #endif
-    double y_max = trace[start];
-    double y_min = trace[start];
-    for (int n=start; n<end-1; ++n) {
-        x_next = xFormat(n+1);
-        // if we are still in the same pixel column, find extrema:
-        if (x_next == x_last) {
-            if (trace[n+1] < y_min) {
-                y_min = trace[n+1];
-            }
-            if (trace[n+1] > y_max) {
-                y_max = trace[n+1];
-            }
-        } else {
-            // plot line between extrema of previous column:
-            pDC->DrawLine( x_last, yFormatFunc(y_min), x_last, yFormatFunc(y_max) );
-
-            // plot line between last point of previous and first point of this column:
-            pDC->DrawLine( x_last, yFormatFunc(trace[n]), x_next, yFormatFunc(trace[n+1]) );
-
-            y_min = trace[n+1];
-            y_max = trace[n+1];
-            x_last = x_next;
-        }
+    // The extrema of each pixel column are taken from the min/max pyramid
+    // of the section, so that the cost only depends on the number of columns:
+    int n_first = start;
+    while (n_first < end-1) {
+        // find the first point of the next pixel column:
+        int n_next = (int)ceil((x_last+1-SPX())/XZ());
+        if (n_next <= n_first) n_next = n_first+1;
+        if (n_next > end) n_next = end;
+        while (n_next > n_first+1 && xFormat(n_next-1) != x_last) --n_next;
+        while (n_next < end && xFormat(n_next) == x_last) ++n_next;
+        if (n_next >= end) break;
+
+        x_next = xFormat(n_next);
+        double y_min = 0.0, y_max = 0.0;
+        section.GetMinMax(n_first, n_next, y_min, y_max);
+
+        // plot line between extrema of previous column:
+        pDC->DrawLine( x_last, yFormatFunc(y_min), x_last, yFormatFunc(y_max) );
+
+        // plot line between last point of previous and first point of this column:
+        pDC->DrawLine( x_last, yFormatFunc(trace[n_next-1]), x_next, yFormatFunc(trace[n_next]) );
+
+        n_first = n_next;
+        x_last = x_next;
     }
 #ifdef BENCHMARK //def _STFDEBUG
     current_utc_time(&time1);
@@ -1064,7 +1065,7 @@ void wxStfGraph::DrawIntegral(wxDC* pDC) {
         quadTrace.push_back(
             wxPoint(
                     xFormat(sec_attr.storeIntEnd),
-                    yFormat(Doc()->cursec()[sec_attr.storeIntEnd])
+                    yFormat(Doc()->cursec().get()[sec_attr.storeIntEnd])
                     ));
     }
     quadTrace.push_back(
@@ -76,6 +76,7 @@
 #include "./../gui/childframe.h"
 #include "./../gui/dlgs/cursorsdlg.h"
 #include "./../../libstfnum/fit.h"
+#include "./../../libstfnum/measure.h"
 
 #ifdef WITH_PYTHON
 #define array_data(a)          (((PyArrayObject *)a)->data)
@@ -202,7 +203,7 @@ std::string get_versionstring() {
 }
 
 #ifdef WITH_PYTHON
-PyObject* get_trace(int trace, int channel) {
+PyObject* get_trace(int trace, int channel, bool copy) {
     wrap_array();
 
     if ( !check_doc() ) return NULL;
@@ -214,17 +215,76 @@ PyObject* get_trace(int trace, int channel) {
         channel = actDoc()->GetCurChIndex();
     }
 
-    npy_intp dims[1] = {(int)actDoc()->at(channel).at(trace).size()};
+    const Section& sec = actDoc()->at(channel).at(trace);
+    npy_intp dims[1] = {(npy_intp)sec.size()};
+    if ( !copy && sec.size() > 0 ) {
+        // Read-only view of the document's data; the document owns the memory
+        // and can't be kept alive by the array:
+        double* dataP = const_cast<double*>( &sec.get()[0] );
+        return PyArray_New( &PyArray_Type, 1, dims, NPY_DOUBLE, NULL, dataP, 0,
+                            NPY_ARRAY_C_CONTIGUOUS | NPY_ARRAY_ALIGNED, NULL );
+    }
     PyObject* np_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
     double* gDataP = (double*)array_data(np_array);
 
     /* fill */
-    std::copy( (*actDoc())[channel][trace].get().begin(),
-               (*actDoc())[channel][trace].get().end(),
-               gDataP);
+    sec.GetWindow( 0, sec.size(), gDataP );
     
     return np_array;
 }
+
+PyObject* get_traces(int channel) {
+    wrap_array();
+
+    if ( !check_doc() ) return NULL;
+
+    if ( channel == -1 ) {
+        channel = actDoc()->GetCurChIndex();
+    }
+    if ( channel < 0 || (std::size_t)channel >= actDoc()->size() ) {
+        PyErr_SetString( PyExc_IndexError, "Channel index out of range in get_traces()" );
+        return NULL;
+    }
+
+    const Channel& ch = actDoc()->at(channel);
+    std::size_t npoints = ch.size() > 0 ? ch[0].size() : 0;
+    for ( std::size_t n_s = 1; n_s < ch.size(); ++n_s ) {
+        if ( ch[n_s].size() != npoints ) {
+            PyErr_SetString( PyExc_ValueError, "Traces differ in length" );
+            return NULL;
+        }
+    }
+    npy_intp dims[2] = {(npy_intp)ch.size(), (npy_intp)npoints};
+    PyObject* np_array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    if ( np_array == NULL ) {
+        return NULL;
+    }
+    double* gDataP = (double*)array_data(np_array);
+
+    /* fill */
+    for ( std::size_t n_s = 0; n_s < ch.size(); ++n_s ) {
+        ch[n_s].GetWindow( 0, npoints, &gDataP[n_s*npoints] );
+    }
+
+    return np_array;
+}
+
+PyObject* running_median( double* invec, int size, int width ) {
+    wrap_array();
+
+    if ( width < 1 ) {
+        PyErr_SetString( PyExc_ValueError, "Width has to be at least one sampling point" );
+        return NULL;
+    }
+    npy_intp dims[1] = {(npy_intp)size};
+    PyObject* np_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    double* gDataP = (double*)array_data(np_array);
+
+    stfnum::OrderStatistics stats;
+    stats.runningMedian( invec, size, width, gDataP );
+
+    return np_array;
+}
 #endif
 
 bool new_window( double* invec, int size ) {
@@ -1649,35 +1709,8 @@ int leastsq_param_size( int fselect ) {
     return npar;
 }
 
-PyObject* leastsq( int fselect, bool refresh ) {
-    if ( !check_doc() ) return NULL;
-
-    wxStfDoc* pDoc = actDoc();
-    
-    wxCommandEvent wce;
-
-    int n_params = 0;
-    try {
-        n_params=(int)wxGetApp().GetFuncLib().at(fselect).pInfo.size();
-    }
-    catch (const std::out_of_range& e) {
-        wxString msg( wxT("Could not retrieve function from library:\n") );
-        msg << wxString( e.what(), wxConvLocal );
-        ShowError(msg);
-        return NULL;
-    }
-
-    std::vector< double > x( pDoc->GetFitEnd() - pDoc->GetFitBeg() );
-    //fill array:
-    std::copy(&pDoc->cursec()[pDoc->GetFitBeg()], &pDoc->cursec()[pDoc->GetFitEnd()], &x[0]);
-    
-    std::vector< double > params( n_params );            
-
-    // initialize parameters from init function,
-    wxGetApp().GetFuncLib().at(fselect).init( x, pDoc->GetBase(), pDoc->GetPeak(),
-            pDoc->GetRTLoHi(), pDoc->GetHalfDuration(), pDoc->GetXScale(), params );
-    std::string fitInfo;
-    int fitWarning = 0;
+// Options for the LM algorithm that are used from Python:
+static Vector_double leastsq_opts() {
     std::vector< double > opts( 6 );
     // check values in src/stimfit/gui/dlgs/fitseldlg.cpp
     // Respectively the scale factor for initial damping term \mu,
@@ -1690,23 +1723,69 @@ PyObject* leastsq( int fselect, bool refresh ) {
     opts[3] = 1E-32; //default: 1E-17;
     opts[4] = 64; //default: 64;
     opts[5] = 16;
-    double chisqr = 0.0;
-    try {
-        chisqr = stfnum::lmFit( x, pDoc->GetXScale(), wxGetApp().GetFuncLib().at(fselect),
-                             opts, true, params, fitInfo, fitWarning );
-        pDoc->SetIsFitted( pDoc->GetCurChIndex(), pDoc->GetCurSecIndex(), params,
-                           wxGetApp().GetFuncLibPtr(fselect),
-                           chisqr, pDoc->GetFitBeg(), pDoc->GetFitEnd() );
+    return opts;
+}
+
+// Creates a fit job for the data between the fit cursors of the current section:
+static stfnum::FitJob leastsq_job( wxStfDoc* pDoc, int fselect ) {
+    const stfnum::storedFunc& fitFunc = wxGetApp().GetFuncLib().at(fselect);
+
+    std::vector< double > x( pDoc->GetFitEnd() - pDoc->GetFitBeg() );
+    //fill array:
+    std::copy(&pDoc->cursec()[pDoc->GetFitBeg()], &pDoc->cursec()[pDoc->GetFitEnd()], &x[0]);
+
+    std::vector< double > params( fitFunc.pInfo.size() );
+
+    // initialize parameters from init function,
+    fitFunc.init( x, pDoc->GetBase(), pDoc->GetPeak(),
+            pDoc->GetRTLoHi(), pDoc->GetHalfDuration(), pDoc->GetXScale(), params );
+
+    return stfnum::FitJob( x, pDoc->GetXScale(), fitFunc, params, leastsq_opts(), true );
+}
+
+// Converts the result of a fit job to a dictionary:
+static PyObject* leastsq_dict( const stfnum::FitJob& job, bool with_warning ) {
+    // Dictionaries apparently grow as needed; no initial size is required.
+    PyObject* retDict = PyDict_New( );
+    for ( std::size_t n_dict = 0; n_dict < job.p.size(); ++n_dict ) {
+         PyDict_SetItemString( retDict, job.fitFunc->pInfo.at(n_dict).desc.c_str(), 
+                PyFloat_FromDouble( job.p[n_dict] ) );
+    }
+    PyDict_SetItemString( retDict, "SSE", PyFloat_FromDouble( job.chisqr ) );
+    if ( with_warning ) {
+        PyDict_SetItemString( retDict, "warning", PyInt_FromLong( (long)job.warning ) );
     }
+
+    return retDict;
+}
+
+PyObject* leastsq( int fselect, bool refresh ) {
+    if ( !check_doc() ) return NULL;
+
+    wxStfDoc* pDoc = actDoc();
     
+    std::vector< stfnum::FitJob > jobs;
+    try {
+        jobs.push_back( leastsq_job( pDoc, fselect ) );
+    }
     catch (const std::out_of_range& e) {
-        ShowExcept( e );
+        wxString msg( wxT("Could not retrieve function from library:\n") );
+        msg << wxString( e.what(), wxConvLocal );
+        ShowError(msg);
         return NULL;
     }
-    catch (const std::runtime_error& e) {
-        ShowExcept( e );
+
+    stfio::StdoutProgressInfo progDlg( "Fitting", "Fitting", 100, false );
+    stfnum::lmFitBatch( jobs, false, progDlg );
+    if ( jobs[0].failed ) {
+        ShowError( stf::std2wx( jobs[0].error ) );
         return NULL;
     }
+    try {
+        pDoc->SetIsFitted( pDoc->GetCurChIndex(), pDoc->GetCurSecIndex(), jobs[0].p,
+                           wxGetApp().GetFuncLibPtr(fselect),
+                           jobs[0].chisqr, pDoc->GetFitBeg(), pDoc->GetFitEnd() );
+    }
     catch (const std::exception& e) {
         ShowExcept( e );
         return NULL;
@@ -1716,14 +1795,112 @@ PyObject* leastsq( int fselect, bool refresh ) {
         if ( !refresh_graph() ) return NULL;
     }
     
-    // Dictionaries apparently grow as needed; no initial size is required.
+    return leastsq_dict( jobs[0], false );
+}
+
+PyObject* leastsq_selected( int fselect, bool warm_start, bool refresh ) {
+    if ( !check_doc() ) return NULL;
+
+    wxStfDoc* pDoc = actDoc();
+    if ( pDoc->GetSelectedSections().empty() ) {
+        ShowError( wxT("No selected traces") );
+        return NULL;
+    }
+
+    // Measure all selected sections and collect the fits:
+    std::size_t section_old = pDoc->GetCurSecIndex();
+    std::vector< stfnum::FitJob > jobs;
+    std::vector< std::size_t > sections, fitBegs, fitEnds;
+    for ( c_st_it cit = pDoc->GetSelectedSections().begin();
+          cit != pDoc->GetSelectedSections().end(); ++cit ) {
+        try {
+            pDoc->SetSection( *cit );
+            if ( pDoc->GetPeakAtEnd() )
+                pDoc->SetPeakEnd( (int)pDoc->get()[pDoc->GetCurChIndex()][*cit].size()-1 );
+            pDoc->Measure();
+            if ( pDoc->GetStartFitAtPeak() )
+                pDoc->SetFitBeg( pDoc->GetMaxT() );
+            jobs.push_back( leastsq_job( pDoc, fselect ) );
+        }
+        catch (const std::exception& e) {
+            pDoc->SetSection( section_old );
+            ShowExcept( e );
+            return NULL;
+        }
+        sections.push_back( *cit );
+        fitBegs.push_back( pDoc->GetFitBeg() );
+        fitEnds.push_back( pDoc->GetFitEnd() );
+    }
+    pDoc->SetSection( section_old );
+
+    stf::wxProgressInfo progDlg( "Fitting selected traces", "Starting...", 100 );
+    stfnum::lmFitBatch( jobs, warm_start, progDlg );
+
+    PyObject* retTuple = PyTuple_New( (int)jobs.size() );
+    for ( std::size_t n_j = 0; n_j < jobs.size(); ++n_j ) {
+        if ( jobs[n_j].failed ) {
+            Py_INCREF( Py_None );
+            PyTuple_SetItem( retTuple, n_j, Py_None );
+            continue;
+        }
+        try {
+            pDoc->SetIsFitted( pDoc->GetCurChIndex(), sections[n_j], jobs[n_j].p,
+                               wxGetApp().GetFuncLibPtr(fselect),
+                               jobs[n_j].chisqr, fitBegs[n_j], fitEnds[n_j] );
+        }
+        catch (const std::exception& e) {
+            Py_DECREF( retTuple );
+            ShowExcept( e );
+            return NULL;
+        }
+        PyTuple_SetItem( retTuple, n_j, leastsq_dict( jobs[n_j], true ) );
+    }
+
+    if ( refresh ) {
+        if ( !refresh_graph() ) {
+            Py_DECREF( retTuple );
+            return NULL;
+        }
+    }
+
+    return retTuple;
+}
+
+PyObject* measure_selected( ) {
+    if ( !check_doc() ) return NULL;
+
+    wxStfDoc* pDoc = actDoc();
+    if ( pDoc->GetSelectedSections().empty() ) {
+        ShowError( wxT("No selected traces") );
+        return NULL;
+    }
+
+    // The selected sections are measured concurrently, without changing
+    // the active section or the cursors:
+    stfnum::MeasurementPlan plan( pDoc->GetMeasurementSettings(), pDoc->GetPeakAtEnd() );
+    stfnum::Table table( 0, 0 );
+    try {
+        table = plan.MeasureTable( pDoc->get()[pDoc->GetCurChIndex()],
+                                   pDoc->GetSelectedSections(), pDoc->GetXScale() );
+    }
+    catch (const std::exception& e) {
+        ShowExcept( e );
+        return NULL;
+    }
+
+    wrap_array();
     PyObject* retDict = PyDict_New( );
-    for ( std::size_t n_dict = 0; n_dict < params.size(); ++n_dict ) {
-         PyDict_SetItemString( retDict, wxGetApp().GetFuncLib()[fselect].pInfo.at(n_dict).desc.c_str(), 
-                PyFloat_FromDouble( params[n_dict] ) );
+    npy_intp dims[1] = {(npy_intp)table.nRows()};
+    for ( std::size_t nCol = 0; nCol < table.nCols(); ++nCol ) {
+        PyObject* np_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+        double* gDataP = (double*)array_data(np_array);
+        for ( std::size_t nRow = 0; nRow < table.nRows(); ++nRow ) {
+            gDataP[nRow] = table.at( nRow, nCol );
+        }
+        PyDict_SetItemString( retDict, table.GetColLabel(nCol).c_str(), np_array );
+        Py_DECREF( np_array );
     }
-    PyDict_SetItemString( retDict, "SSE", PyFloat_FromDouble( chisqr ) );
-    
+
     return retDict;
 }
 
@@ -10,7 +10,9 @@
 std::string get_versionstring( );
 
 #ifdef WITH_PYTHON
-PyObject* get_trace(int trace=-1, int channel=-1);
+PyObject* get_trace(int trace=-1, int channel=-1, bool copy=true);
+PyObject* get_traces(int channel=-1);
+PyObject* running_median( double* invec, int size, int width );
 #endif
 
 bool new_window( double* invec, int size );
@@ -67,6 +69,8 @@ bool subtract_base( );
 int leastsq_param_size( int fselect );
 #ifdef WITH_PYTHON
 PyObject* leastsq( int fselect, bool refresh = true );
+PyObject* leastsq_selected( int fselect, bool warm_start = false, bool refresh = true );
+PyObject* measure_selected( );
 PyObject* get_fit( int trace = -1, int channel = -1 );
 #endif 
 
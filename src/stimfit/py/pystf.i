@@ -56,9 +56,47 @@ channel -- ZERO-BASED index of the channel. This is independent
            of whether a channel is active or not.
            The default value of -1 returns the currently
            active channel.
+copy --    If True (default), the trace is copied. If False, a
+           read-only array that shares its memory with the trace
+           is returned; it must not be used after the file has
+           been closed or the trace has been changed.
 Returns:
 The trace as a 1D NumPy array.""") get_trace;
-PyObject* get_trace(int trace=-1, int channel=-1);
+PyObject* get_trace(int trace=-1, int channel=-1, bool copy=true);
+//--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+%feature("autodoc", 0) get_traces;
+%feature("kwargs") get_traces;
+%feature("docstring", """Returns all traces of a channel as a 2-dimensional
+NumPy array of shape (number of traces, number of sampling points).
+Raises a ValueError if the traces differ in length.
+
+Arguments:       
+channel -- ZERO-BASED index of the channel. This is independent
+           of whether a channel is active or not.
+           The default value of -1 returns the currently
+           active channel.
+Returns:
+The traces as a 2D NumPy array.""") get_traces;
+PyObject* get_traces(int channel=-1);
+//--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+%feature("autodoc", 0) running_median;
+%feature("docstring", """Computes a running median of a 1D NumPy array.
+The median of a window is updated as the window slides
+along the array instead of being computed from scratch.
+
+Arguments:       
+invec --   The NumPy array.
+width --   Width of the window in sampling points.
+
+Returns:
+A 1D NumPy array of the same size as invec. Element i is the
+median of invec[i:i+width]; towards the end of the array,
+all of the remaining points are used.""") running_median;
+PyObject* running_median( double* invec, int size, int width );
 //--------------------------------------------------------------------
 
 //--------------------------------------------------------------------
@@ -368,6 +406,45 @@ error, or a null pointer upon failure.") leastsq;
 PyObject* leastsq( int fselect, bool refresh = true );
 //--------------------------------------------------------------------
 
+//--------------------------------------------------------------------
+%feature("autodoc", 0) leastsq_selected;
+%feature("kwargs") leastsq_selected;
+%feature("docstring", "Fits a function to the data between the fit
+cursors of all selected traces. The traces are measured one after
+another, and the fits are then performed concurrently.
+
+Arguments:
+fselect    -- Zero-based index of the function as it appears in the fit
+              selection dialog.
+warm_start -- If True, each fit starts from the best-fit parameters
+              of the previous selected trace if that fit converged.
+refresh    -- To avoid flicker during batch analysis, this may be set to
+              False so that the fitted functions will not immediately
+              be drawn.
+
+Returns:
+A tuple with one dictionary per selected trace, containing the best-fit
+parameters, the least-squared error (\"SSE\") and the fit warning code
+(\"warning\", 0 if the fit converged), or None for traces that could
+not be fitted. A null pointer upon failure.") leastsq_selected;
+PyObject* leastsq_selected( int fselect, bool warm_start = false, bool refresh = true );
+//--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+%feature("autodoc", 0) measure_selected;
+%feature("docstring", "Measures all selected traces of the active
+channel with the current cursor and measurement settings. The traces
+are measured concurrently; the active trace and the cursors are not
+changed.
+
+Returns:
+A dictionary that maps the name of each measured value (e.g.
+\"Base\", \"Peak (from baseline)\", \"RT Lo-Hi%\") to a 1D NumPy
+array with one element per selected trace. Times are given in units
+of the x axis. A null pointer upon failure.") measure_selected;
+PyObject* measure_selected( );
+//--------------------------------------------------------------------
+
 //--------------------------------------------------------------------
 %feature("autodoc", 0) get_fit;
 %feature("kwargs") get_fit;
@@ -113,6 +113,33 @@ def rmean(binwidth, trace=-1, channel=-1):
 
     stf.new_window(dsweep)
 
+def rmedian(binwidth, trace=-1, channel=-1):
+    """
+    Calculates a running median of a single trace
+
+    Arguments:
+
+    binwidth    -- size of the bin in sampling points (pt).
+    Obviously, it should be smaller than the length of the trace.
+
+    trace:  -- ZERO-BASED index of the trace within the channel.
+    Note that this is one less than what is shown in the drop-down box.
+    The default value of -1 returns the currently displayed trace.
+
+    channel  -- ZERO-BASED index of the channel. This is independent
+    of whether a channel is active or not. The default value of -1
+    returns the currently active channel.
+
+    Returns:
+
+    A smoothed traced in a new stf window.
+
+    """
+    # as in rmean(), the window starts at each point and is shortened
+    # towards the end of the trace:
+    sweep = stf.get_trace(trace, channel)
+    stf.new_window(stf.running_median(sweep, binwidth))
+
 def get_amplitude(base, peak, delta, trace=None):
     """ Calculates the amplitude deviation (peak-base) in units of the Y-axis
 
@@ -0,0 +1,145 @@
+#include "../libstfio/stfio.h"
+#include "../libstfio/abf/abflib.h"
+#include "../libstfio/abf/axon/Common/axodefn.h"
+#include "../libstfio/abf/axon/AxAbfFio32/abffiles.h"
+#include "./testutils.h"
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Writes a synthetic episodic ABF 1.x file with nch multiplexed channels.
+// Sample i of channel c in episode e holds the raw ADC value (c+1)*100 + e*10 + i%7.
+bool writeTestABF(const std::string& fName, int nch, int nepisodes, int nsamples) {
+    ABFFileHeader FH;
+    ABFH_Initialize(&FH);
+    FH.nOperationMode = ABF_WAVEFORMFILE;
+    FH.nADCNumChannels = nch;
+    FH.lNumSamplesPerEpisode = nch * nsamples;
+    FH.lActualEpisodes = nepisodes;
+    FH.lEpisodesPerRun = nepisodes;
+    FH.lActualAcqLength = FH.lNumSamplesPerEpisode * nepisodes;
+    FH.nDataFormat = ABF_INTEGERDATA;
+    FH.lDataSectionPtr = sizeof(ABFFileHeader) / ABF_BLOCKSIZE;
+    FH.lSynchArrayPtr = 0;
+    FH.lSynchArraySize = 0;
+    for (int c = 0; c < nch; ++c) {
+        FH.nADCSamplingSeq[c] = c;
+        FH.nADCPtoLChannelMap[c] = c;
+    }
+
+    FILE* fp = fopen(fName.c_str(), "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    fwrite(&FH, sizeof(ABFFileHeader), 1, fp);
+    std::vector<short> data(FH.lActualAcqLength);
+    for (int e = 0; e < nepisodes; ++e) {
+        for (int i = 0; i < nsamples; ++i) {
+            for (int c = 0; c < nch; ++c) {
+                data[(e*nsamples + i)*nch + c] = (short)((c+1)*100 + e*10 + i%7);
+            }
+        }
+    }
+    fwrite(&data[0], sizeof(short), data.size(), fp);
+    fclose(fp);
+    return true;
+}
+
+}
+
+TEST(ABF_test, demultiplex)
+{
+    const int nch = 4, nepisodes = 3, nsamples = 1000;
+    stftest::TempFile tmp(".abf");
+    const std::string& fName = tmp.str();
+    ASSERT_TRUE( writeTestABF(fName, nch, nepisodes, nsamples) );
+
+    // Single-pass de-multiplexing has to be identical to reading channels one by one:
+    int hFile = 0, nError = 0;
+    UINT uMaxSamples = 0;
+    DWORD dwMaxEpi = 0;
+    ABFFileHeader FH;
+    ASSERT_TRUE( ABF_ReadOpen(fName.c_str(), &hFile, ABF_DATAFILE, &FH,
+                              &uMaxSamples, &dwMaxEpi, &nError) );
+    std::vector<Vector_double> lastEpisode;
+    for (DWORD dwEpisode = 1; dwEpisode <= (DWORD)nepisodes; ++dwEpisode) {
+        std::vector<Vector_double> bulk(nch, Vector_double(nsamples));
+        std::vector<double*> buffers(nch);
+        for (int c = 0; c < nch; ++c) {
+            buffers[c] = &bulk[c][0];
+        }
+        UINT uNumSamples = 0;
+        ASSERT_TRUE( ABF_ReadChannels(hFile, &FH, dwEpisode, &buffers[0], nsamples,
+                                      &uNumSamples, &nError) );
+        EXPECT_EQ( uNumSamples, (UINT)nsamples );
+        for (int c = 0; c < nch; ++c) {
+            Vector_float single(nsamples);
+            ASSERT_TRUE( ABF_ReadChannel(hFile, &FH, FH.nADCSamplingSeq[c], dwEpisode, single,
+                                         &uNumSamples, &nError) );
+            for (int i = 0; i < nsamples; ++i) {
+                EXPECT_EQ( bulk[c][i], (double)single[i] );
+            }
+        }
+        lastEpisode = bulk;
+    }
+    ABF_Close(hFile, &nError);
+
+    Recording rec;
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    stfio::importABFFile(fName, rec, progDlg);
+    ASSERT_EQ( rec.size(), (std::size_t)nch );
+    for (int c = 0; c < nch; ++c) {
+        ASSERT_EQ( rec[c].size(), (std::size_t)nepisodes );
+        ASSERT_EQ( rec[c][nepisodes-1].size(), (std::size_t)nsamples );
+        // Sections are decoded from the file mapping on first access only:
+        EXPECT_FALSE( rec[c][nepisodes-1].IsMaterialized() );
+    }
+    Vector_double window;
+    rec[1][0].GetWindow(7, 7, window);
+    EXPECT_FALSE( rec[1][0].IsMaterialized() );
+    EXPECT_EQ( window[0], rec[1][0][0] );
+    EXPECT_TRUE( rec[1][0].IsMaterialized() );
+    for (int c = 0; c < nch; ++c) {
+        for (int i = 0; i < nsamples; ++i) {
+            EXPECT_EQ( rec[c][nepisodes-1][i], lastEpisode[c][i] );
+        }
+    }
+    // Relative values are preserved regardless of the ADC scaling:
+    double scale = (rec[1][0][0] - rec[0][0][0]) / 100.0;
+    EXPECT_NE( scale, 0.0 );
+    EXPECT_NEAR( rec[nch-1][nepisodes-1][5] - rec[0][0][5],
+                 scale * ((nch-1)*100 + (nepisodes-1)*10), 1e-3 * std::fabs(scale) );
+}
+
+// Import time as a function of the number of channels.
+// Run with --gtest_also_run_disabled_tests
+TEST(ABF_test, DISABLED_benchmark_channels)
+{
+    const int nepisodes = 50, nsamples = 20000;
+    for (int nch = 1; nch <= 16; nch *= 2) {
+        stftest::TempFile tmp(".abf");
+        const std::string& fName = tmp.str();
+        ASSERT_TRUE( writeTestABF(fName, nch, nepisodes, nsamples) );
+        Recording rec;
+        stfio::StdoutProgressInfo progDlg("", "", 100, false);
+        std::clock_t start = std::clock();
+        stfio::importABFFile(fName, rec, progDlg);
+        double opened = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+        ASSERT_EQ( rec.size(), (std::size_t)nch );
+        // Sections are decoded on first access:
+        for (std::size_t c = 0; c < rec.size(); ++c) {
+            for (std::size_t n = 0; n < rec[c].size(); ++n) {
+                rec[c][n].Materialize();
+            }
+        }
+        double elapsed = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+        std::cout << nch << " channels: opened in " << opened << " s, decoded in "
+                  << elapsed << " s (" << elapsed / nch << " s per channel)" << std::endl;
+    }
+}
@@ -0,0 +1,111 @@
+#include "../libstfio/stfio.h"
+#include "../libstfio/recording.h"
+#include "../libstfio/ascii/asciilib.h"
+#include "../libstfio/atf/atflib.h"
+#include "./testutils.h"
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST(ASCII_test, parse)
+{
+    std::string text("0\t1.5\t-2e-3\r\n"
+                     "\n"
+                     "0.05, 1e300 ,4\n"
+                     "  0.1 -0 12345678901234567890 extra\n");
+    stfio::TextColumnParser parser(text.data(), text.data()+text.size());
+    ASSERT_EQ( parser.rows(), (std::size_t)3 );
+    Vector_double a(3), b(3);
+    std::vector<double*> dest;
+    dest.push_back(NULL);
+    dest.push_back(&a[0]);
+    dest.push_back(&b[0]);
+    parser.parse(dest);
+    EXPECT_EQ( a[0], 1.5 );
+    EXPECT_EQ( b[0], -2e-3 );
+    EXPECT_EQ( a[1], 1e300 );
+    EXPECT_EQ( b[1], 4.0 );
+    EXPECT_EQ( a[2], 0.0 );
+    EXPECT_TRUE( std::signbit(a[2]) );
+    EXPECT_EQ( b[2], 12345678901234567890.0 );
+
+    // A row with too few values:
+    std::string bad("1 2\n3\n");
+    stfio::TextColumnParser badParser(bad.data(), bad.data()+bad.size());
+    dest.pop_back();
+    EXPECT_THROW( badParser.parse(dest), std::runtime_error );
+}
+
+TEST(ASCII_test, roundtrip)
+{
+    // Numbers are written with as few digits as possible but read back exactly:
+    const int n = 10000;
+    Vector_double values(n);
+    for (int i = 0; i < n; ++i) {
+        values[i] = std::sin(i*0.37) * std::pow(10.0, i%40 - 20);
+    }
+    values[1] = 0.1;
+    values[2] = 5e-324;
+    values[3] = -1.7976931348623157e308;
+    std::vector<const double*> columns(1, &values[0]);
+    std::vector<std::size_t> sizes(1, values.size());
+    stftest::TempFile tmp(".txt");
+    std::string fName = tmp.str();
+    stfio::writeTextColumns(fName, "", columns, sizes, 0.5, "\n");
+
+    FILE* fp = fopen(fName.c_str(), "rb");
+    ASSERT_TRUE( fp != NULL );
+    std::vector<char> text(n*64);
+    std::size_t size = fread(&text[0], 1, text.size(), fp);
+    fclose(fp);
+    EXPECT_EQ( std::string(&text[0], 8), std::string("0\t0\n0.5\t") );
+    EXPECT_EQ( std::string(&text[8], 4), std::string("0.1\n") );
+
+    stfio::TextColumnParser parser(&text[0], &text[0]+size);
+    ASSERT_EQ( parser.rows(), (std::size_t)n );
+    Vector_double time(n), back(n);
+    std::vector<double*> dest;
+    dest.push_back(&time[0]);
+    dest.push_back(&back[0]);
+    parser.parse(dest);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ( time[i], i*0.5 );
+        EXPECT_EQ( back[i], values[i] );
+    }
+}
+
+TEST(ASCII_test, atf)
+{
+    Recording rec(1, 3, 100);
+    for (std::size_t n_s = 0; n_s < rec[0].size(); ++n_s) {
+        for (std::size_t i = 0; i < rec[0][n_s].size(); ++i) {
+            rec[0][n_s][i] = (double)(float)std::cos(i + n_s*0.1);
+        }
+    }
+    rec[0][2].resize(90);
+    rec.SetXScale(0.05);
+    rec[0].SetYUnits("pA");
+
+    stftest::TempFile tmp(".atf");
+    std::string fName = tmp.str();
+    ASSERT_TRUE( stfio::exportATFFile(fName, rec) );
+    Recording back;
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    stfio::importATFFile(fName, back, progDlg);
+    ASSERT_EQ( back.size(), (std::size_t)1 );
+    ASSERT_EQ( back[0].size(), (std::size_t)3 );
+    EXPECT_EQ( back[0].GetYUnits(), "pA" );
+    EXPECT_DOUBLE_EQ( back.GetXScale(), 0.05 );
+    for (std::size_t n_s = 0; n_s < back[0].size(); ++n_s) {
+        // Shorter sections are padded with zeros:
+        ASSERT_EQ( back[0][n_s].size(), (std::size_t)100 );
+        for (std::size_t i = 0; i < back[0][n_s].size(); ++i) {
+            double expected = (i < rec[0][n_s].size()) ? rec[0][n_s][i] : 0.0;
+            EXPECT_EQ( back[0][n_s][i], expected );
+        }
+    }
+}
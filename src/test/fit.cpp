@@ -922,3 +922,216 @@ TEST(fitlib_test, id_12_fgaussian){
     //data.clear();
 
 }
+
+//=========================================================================
+// Tests that concurrent fits don't interfere with each other
+//=========================================================================
+TEST(fitlib_test, concurrent_fits){
+
+    const int nfits = 16;
+    std::vector< Vector_double > traces(nfits), serial(nfits), parallel(nfits);
+    Vector_double chisqr_serial(nfits), chisqr_parallel(nfits);
+    for (int n = 0; n < nfits; ++n) {
+        Vector_double mypars(3);
+        mypars[0] = 10.0 + n;     /* amplitude */
+        mypars[1] = 5.0 + 2.0*n;  /* time constant */
+        mypars[2] = -20.0;        /* end  */
+        traces[n] = fexp_simple(mypars);
+
+        serial[n] = Vector_double(3);
+        serial[n][0] = 0.0;
+        serial[n][1] = 5.0;
+        serial[n][2] = -35.0;
+        parallel[n] = serial[n];
+    }
+
+    for (int n = 0; n < nfits; ++n) {
+        std::string info;
+        int warning;
+        chisqr_serial[n] = stfnum::lmFit(traces[n], dt, funcLib[n%2], opts,
+                                         true, serial[n], info, warning );
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int n = 0; n < nfits; ++n) {
+        std::string info;
+        int warning;
+        chisqr_parallel[n] = stfnum::lmFit(traces[n], dt, funcLib[n%2], opts,
+                                           true, parallel[n], info, warning );
+    }
+
+    for (int n = 0; n < nfits; ++n) {
+        EXPECT_EQ(chisqr_parallel[n], chisqr_serial[n]);
+        for (std::size_t n_p = 0; n_p < serial[n].size(); ++n_p) {
+            EXPECT_EQ(parallel[n][n_p], serial[n][n_p]);
+        }
+    }
+}
+
+//=========================================================================
+// Tests the batch fitting engine
+//=========================================================================
+TEST(fitlib_test, batch_fits){
+
+    const int nfits = 24;
+    std::vector< stfnum::FitJob > jobs;
+    std::vector< Vector_double > mypars(nfits);
+    for (int n = 0; n < nfits; ++n) {
+        mypars[n] = Vector_double(3);
+        mypars[n][0] = 50.0 + n;      /* amplitude */
+        mypars[n][1] = 17.0 + 0.5*n;  /* time constant */
+        mypars[n][2] = -20.0;         /* end  */
+
+        Vector_double pars(3);
+        pars[0] = 0.0;
+        pars[1] = 5.0;
+        pars[2] = -35.0;
+        jobs.push_back(stfnum::FitJob(fexp_simple(mypars[n]), dt, funcLib[0], pars, opts));
+    }
+    // a job without data has to fail without affecting the others:
+    jobs[nfits/2].data.clear();
+
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    std::vector< stfnum::FitJob > cold(jobs);
+    EXPECT_EQ(stfnum::lmFitBatch(cold, false, progDlg), (std::size_t)1);
+    EXPECT_TRUE(cold[nfits/2].failed);
+    EXPECT_NE(cold[nfits/2].error, "");
+
+    for (int n = 0; n < nfits; ++n) {
+        if (n == nfits/2) continue;
+        // identical to a single fit:
+        Vector_double pars(jobs[n].p);
+        std::string info;
+        int warning;
+        double chisqr = stfnum::lmFit(jobs[n].data, dt, funcLib[0], opts, true,
+                                      pars, info, warning);
+        EXPECT_FALSE(cold[n].failed);
+        EXPECT_FALSE(cold[n].warmStarted);
+        EXPECT_EQ(cold[n].warning, warning);
+        EXPECT_EQ(cold[n].chisqr, chisqr);
+        for (std::size_t n_p = 0; n_p < pars.size(); ++n_p) {
+            EXPECT_EQ(cold[n].p[n_p], pars[n_p]);
+        }
+    }
+
+    std::vector< stfnum::FitJob > warm(jobs);
+    EXPECT_EQ(stfnum::lmFitBatch(warm, true, progDlg), (std::size_t)1);
+    // the first job has no neighbour to start from:
+    EXPECT_FALSE(warm[0].warmStarted);
+    EXPECT_FALSE(warm[nfits/2+1].warmStarted);
+    int n_warm = 0;
+    for (int n = 0; n < nfits; ++n) {
+        if (n == nfits/2) continue;
+        n_warm += warm[n].warmStarted;
+        EXPECT_FALSE(warm[n].failed);
+        EXPECT_EQ(warm[n].warning, 0);
+        par_test(warm[n].p[0], mypars[n][0], tol);
+        par_test(warm[n].p[1], mypars[n][1], tol);
+        par_test(warm[n].p[2], mypars[n][2], tol);
+    }
+#ifdef _OPENMP
+    if (omp_get_max_threads() <= nfits/4)
+#endif
+        EXPECT_GT(n_warm, 0);
+}
+
+// Cancels the operation on the first update.
+class CancelProgressInfo : public stfio::ProgressInfo {
+  public:
+    CancelProgressInfo() : stfio::ProgressInfo("", "", 100, false), nUpdates(0) {}
+    bool Update(int value, const std::string& newmsg="", bool* skip=NULL) {
+        ++nUpdates;
+        if (skip != NULL) *skip = true;
+        return false;
+    }
+    int nUpdates;
+};
+
+TEST(fitlib_test, batch_cancel){
+
+    const int nfits = 24;
+    std::vector< stfnum::FitJob > jobs;
+    for (int n = 0; n < nfits; ++n) {
+        Vector_double mypars(3);
+        mypars[0] = 50.0 + n;      /* amplitude */
+        mypars[1] = 17.0 + 0.5*n;  /* time constant */
+        mypars[2] = -20.0;         /* end  */
+
+        Vector_double pars(3);
+        pars[0] = 0.0;
+        pars[1] = 5.0;
+        pars[2] = -35.0;
+        jobs.push_back(stfnum::FitJob(fexp_simple(mypars), dt, funcLib[0], pars, opts));
+    }
+
+    // The calling thread keeps polling for cancellation when it has run out of
+    // jobs, so that the other chains stop early, too:
+    CancelProgressInfo progDlg;
+    std::size_t n_failed = stfnum::lmFitBatch(jobs, true, progDlg);
+    EXPECT_GT(progDlg.nUpdates, 0);
+    std::size_t n_skipped = 0;
+    for (int n = 0; n < nfits; ++n) {
+        EXPECT_EQ(jobs[n].failed, jobs[n].error == "Skipped");
+        n_skipped += jobs[n].failed;
+    }
+    EXPECT_EQ(n_failed, n_skipped);
+#ifdef _OPENMP
+    if (omp_get_max_threads() <= nfits/2)
+#endif
+        EXPECT_GT(n_skipped, (std::size_t)0);
+}
+
+TEST(fitlib_test, batch_eval){
+
+    /* x-values on both sides of the delays */
+    Vector_double x(200);
+    for (std::size_t n = 0; n < x.size(); ++n) {
+        x[n] = n*dt*2.0;
+    }
+    for (std::size_t n_f = 0; n_f < funcLib.size(); ++n_f) {
+        const stfnum::storedFunc& f = funcLib[n_f];
+        Vector_double p(f.pInfo.size());
+        for (std::size_t n_p = 0; n_p < p.size(); ++n_p) {
+            p[n_p] = 0.2 + 0.3*n_p;
+        }
+        Vector_double y(x.size());
+        f.eval(&x[0], x.size(), p, &y[0]);
+        for (std::size_t n = 0; n < x.size(); ++n) {
+            EXPECT_DOUBLE_EQ(y[n], f.func(x[n], p)) << f.name << " at x=" << x[n];
+        }
+        if (!f.hasJac) continue;
+        Vector_double jac(x.size()*p.size());
+        f.evalJac(&x[0], x.size(), p, &jac[0]);
+        for (std::size_t n = 0; n < x.size(); ++n) {
+            Vector_double jac_x = f.jac(x[n], p);
+            for (std::size_t n_p = 0; n_p < p.size(); ++n_p) {
+                EXPECT_DOUBLE_EQ(jac[n*p.size()+n_p], jac_x[n_p]) << f.name << " at x=" << x[n];
+            }
+        }
+    }
+
+    /* functions without batch evaluation are fitted as before */
+    Vector_double mypars(5);
+    mypars[0] = 25.0;  mypars[1] = 5.0;
+    mypars[2] = 50.0;  mypars[3] = 20.0;
+    mypars[4] = -20.0;
+    Vector_double data = fexp(mypars);
+    stfnum::storedFunc scalar(funcLib[4]);
+    scalar.batchFunc = stfnum::BatchFunc();
+    scalar.batchJac = stfnum::BatchJac();
+    Vector_double pars(5), scalarPars(5);
+    pars[0] = 10.0; pars[1] = 1.0;
+    pars[2] = 10.0; pars[3] = 10.0;
+    pars[4] = -20.0;
+    scalarPars = pars;
+    std::string info;
+    int warning;
+    double chisqr = stfnum::lmFit(data, dt, funcLib[4], opts, true, pars, info, warning);
+    double scalarChisqr = stfnum::lmFit(data, dt, scalar, opts, true, scalarPars, info, warning);
+    EXPECT_DOUBLE_EQ(chisqr, scalarChisqr);
+    for (std::size_t n_p = 0; n_p < pars.size(); ++n_p) {
+        EXPECT_DOUBLE_EQ(pars[n_p], scalarPars[n_p]);
+    }
+}
@@ -2,7 +2,9 @@
 #include "../libstfnum/measure.h"
 #include <gtest/gtest.h>
 #include <cmath>
+#include <ctime>
 #include <fstream>
+#include <iostream>
 #if (__cplusplus < 201103)
     #include <boost/random.hpp>
     #include <boost/random/normal_distribution.hpp>
@@ -216,6 +218,59 @@ TEST(measlib_test, baseline_out_of_range_exceptions) {
 
 }
 
+//=========================================================================
+// test median baseline and inter-quartile range
+//=========================================================================
+TEST(measlib_test, baseline_median) {
+
+    double var;
+    stfnum::OrderStatistics stats;
+
+    /* odd number of points: 1 2 3 4 5 6 7 8 9 */
+    double odd[] = {9, 2, 7, 4, 5, 6, 3, 8, 1};
+    std::vector<double> data(odd, odd+9);
+    EXPECT_EQ(stfnum::base(stfnum::median_iqr, var, data, 0, data.size()-1, stats), 5);
+    EXPECT_EQ(var, 4); /* ((7+6) - (3+2))/2 */
+
+    /* even number of points: 1 2 ... 8 */
+    data.erase(data.begin());
+    EXPECT_EQ(stfnum::base(stfnum::median_iqr, var, data, 0, data.size()-1, stats), 4.5);
+    EXPECT_EQ(var, 4); /* 6 - 2 */
+    EXPECT_EQ(data[0], 2); /* data is not reordered */
+
+    /* window within the data, without re-using memory */
+    EXPECT_EQ(stfnum::base(stfnum::median_iqr, var, data, 1, 3), 5);
+
+    /* a single point */
+    EXPECT_EQ(stfnum::base(stfnum::median_iqr, var, data, 2, 2, stats), 4);
+    EXPECT_EQ(var, 0);
+
+}
+
+//=========================================================================
+// test running median
+//=========================================================================
+TEST(measlib_test, running_median) {
+
+    std::vector<double> data = rand(N_MAX);
+    stfnum::OrderStatistics stats;
+    int widths[] = {1, 2, 7, 100, N_MAX, 2*N_MAX};
+    for (int n_w = 0; n_w < 6; ++n_w) {
+        std::size_t width = widths[n_w];
+        std::vector<double> rmed = stfnum::runningMedian(data, width);
+        ASSERT_EQ(rmed.size(), data.size());
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            /* the window is shortened towards the end */
+            std::size_t last = std::min(data.size(), i+width) - 1;
+            double var;
+            EXPECT_EQ(rmed[i], stfnum::base(stfnum::median_iqr, var, data, i, last, stats));
+        }
+    }
+
+    EXPECT_THROW(stfnum::runningMedian(data, 0), std::out_of_range);
+
+}
+
 //=========================================================================
 // test peak 
 //=========================================================================
@@ -874,3 +929,228 @@ TEST(measlib_validation, threshold) {
     
 
 }
+
+//=========================================================================
+// measurement kernel
+//=========================================================================
+
+/* The measurements of wxStfDoc::Measure(), one function after another */
+stfnum::MeasurementResults legacyMeasure(const std::vector<double>& data,
+                                         const stfnum::MeasurementSettings& s)
+{
+    stfnum::MeasurementResults r;
+    double var = 0.0;
+    r.base = stfnum::base(s.baselineMethod, var, data, s.baseBeg, s.baseEnd);
+    r.baseSD = sqrt(var);
+    r.peak = stfnum::peak(data, r.base, s.peakBeg, s.peakEnd, s.pM, s.dir, r.maxT);
+    r.threshold = stfnum::threshold(data, s.peakBeg, s.peakEnd, s.slopeForThreshold,
+                                    r.thrT, s.windowLength);
+    r.reference = r.base;
+    if (!s.fromBase && r.thrT >= 0)
+        r.reference = r.threshold;
+    r.ampl = r.peak - r.reference;
+    stfnum::risetime2(data, r.reference, r.ampl, 0.0, r.maxT, s.rtFactor,
+                      r.innerLoRT, r.innerHiRT, r.outerLoRT, r.outerHiRT);
+    r.rtLoHi = stfnum::risetime(data, r.reference, r.ampl, 0.0, r.maxT, s.rtFactor,
+                                r.tLoIndex, r.tHiIndex, r.tLoReal);
+    r.halfDuration = stfnum::t_half(data, r.reference, r.ampl, 0.0, (double)data.size()-1,
+                                    r.maxT, r.t50LeftIndex, r.t50RightIndex, r.t50LeftReal);
+    r.maxRise = stfnum::maxRise(data, s.peakBeg, r.maxT, r.maxRiseT, r.maxRiseY, s.windowLength);
+    double t_half_3 = r.t50RightIndex+2.0*(r.t50RightIndex-r.t50LeftIndex);
+    double right_decay = s.peakEnd<=t_half_3 ? s.peakEnd : t_half_3+1;
+    r.maxDecay = stfnum::maxDecay(data, r.maxT, right_decay, r.maxDecayT, r.maxDecayY, s.windowLength);
+    r.slopeRatio = (r.maxDecay != 0) ? r.maxRise/r.maxDecay : 0.0;
+    return r;
+}
+
+/* true if both values are equal or both are NaN */
+bool same(double a, double b) {
+    return a == b || (isnan(a) && isnan(b));
+}
+
+void expectSameResults(const stfnum::MeasurementResults& a, const stfnum::MeasurementResults& b) {
+    EXPECT_TRUE(same(a.base, b.base));
+    EXPECT_TRUE(same(a.baseSD, b.baseSD));
+    EXPECT_TRUE(same(a.peak, b.peak));
+    EXPECT_TRUE(same(a.maxT, b.maxT));
+    EXPECT_TRUE(same(a.threshold, b.threshold));
+    EXPECT_TRUE(same(a.thrT, b.thrT));
+    EXPECT_TRUE(same(a.ampl, b.ampl));
+    EXPECT_TRUE(same(a.rtLoHi, b.rtLoHi));
+    EXPECT_TRUE(same(a.tLoReal, b.tLoReal));
+    EXPECT_TRUE(same(a.innerLoRT, b.innerLoRT));
+    EXPECT_TRUE(same(a.innerHiRT, b.innerHiRT));
+    EXPECT_TRUE(same(a.outerLoRT, b.outerLoRT));
+    EXPECT_TRUE(same(a.outerHiRT, b.outerHiRT));
+    EXPECT_TRUE(same(a.halfDuration, b.halfDuration));
+    EXPECT_TRUE(same(a.t50LeftReal, b.t50LeftReal));
+    EXPECT_TRUE(same(a.maxRise, b.maxRise));
+    EXPECT_TRUE(same(a.maxRiseT, b.maxRiseT));
+    EXPECT_TRUE(same(a.maxRiseY, b.maxRiseY));
+    EXPECT_TRUE(same(a.maxDecay, b.maxDecay));
+    EXPECT_TRUE(same(a.maxDecayT, b.maxDecayT));
+    EXPECT_TRUE(same(a.maxDecayY, b.maxDecayY));
+    EXPECT_TRUE(same(a.slopeRatio, b.slopeRatio));
+}
+
+/* a noisy alpha-shaped event that peaks at 300 sampling points */
+std::vector<double> eventwave(long length, double amp) {
+    std::vector<double> noise = rand(length);
+    std::vector<double> wave(length);
+    for (long i = 0; i < length; ++i) {
+        double t = (i-200)/100.0;
+        wave[i] = 0.1*noise[i] + (t > 0 ? amp*t*std::exp(1.0-t) : 0.0);
+    }
+    return wave;
+}
+
+TEST(measlib_test, measurement_kernel) {
+    std::vector<double> data = eventwave(1000, 5.0);
+    stfnum::MeasurementKernel kernel;
+
+    stfnum::direction dirs[] = {stfnum::up, stfnum::down, stfnum::both};
+    int pMs[] = {1, 4, -1};
+    std::size_t windows[] = {1, 3};
+    /* peak windows within the trace, at its end and beyond */
+    std::size_t peakEnds[] = {600, 998, 999, 1000};
+    for (int n_d = 0; n_d < 3; ++n_d) {
+        for (int n_p = 0; n_p < 3; ++n_p) {
+            for (int n_w = 0; n_w < 2; ++n_w) {
+                for (int n_e = 0; n_e < 4; ++n_e) {
+                    stfnum::MeasurementSettings s;
+                    s.baseBeg = 0;
+                    s.baseEnd = 150;
+                    s.peakBeg = 180;
+                    s.peakEnd = peakEnds[n_e];
+                    s.pM = pMs[n_p];
+                    s.dir = dirs[n_d];
+                    s.baselineMethod = (n_e % 2) ? stfnum::median_iqr : stfnum::mean_sd;
+                    s.slopeForThreshold = 0.02;
+                    s.rtFactor = 0.2;
+                    s.fromBase = (n_w == 0);
+                    s.windowLength = windows[n_w];
+                    kernel.SetSettings(s);
+                    expectSameResults(kernel.Measure(data), legacyMeasure(data, s));
+                }
+            }
+        }
+    }
+
+    /* an upward event is measured as such */
+    stfnum::MeasurementSettings s;
+    s.baseEnd = 150;
+    s.peakBeg = 180;
+    s.peakEnd = 600;
+    s.dir = stfnum::up;
+    kernel.SetSettings(s);
+    stfnum::MeasurementResults r = kernel.Measure(data);
+    EXPECT_NEAR(r.maxT, 300, 20);
+    EXPECT_NEAR(r.peak - r.base, 5.0, 0.2);
+    EXPECT_GT(r.maxRise, 0);
+    EXPECT_GT(r.halfDuration, 0);
+}
+
+TEST(measlib_test, DISABLED_benchmark_measurement_kernel) {
+    /* 1 s at 20 kHz with the peak window spanning the whole trace */
+    std::vector<double> data = eventwave(20000, 5.0);
+    stfnum::MeasurementSettings s;
+    s.baseEnd = 150;
+    s.peakBeg = 180;
+    s.peakEnd = data.size()-1;
+    s.baselineMethod = stfnum::median_iqr;
+    s.slopeForThreshold = 0.02;
+    s.dir = stfnum::up;
+    stfnum::MeasurementKernel kernel(s);
+    const int n_rep = 2000;
+
+    std::clock_t start = std::clock();
+    for (int i = 0; i < n_rep; ++i)
+        legacyMeasure(data, s);
+    double t_legacy = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+    start = std::clock();
+    for (int i = 0; i < n_rep; ++i)
+        kernel.Measure(data);
+    double t_kernel = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+    std::cout << n_rep << " measurements: one function after another " << t_legacy
+              << " s, measurement kernel " << t_kernel << " s" << std::endl;
+    expectSameResults(kernel.Measure(data), legacyMeasure(data, s));
+}
+
+namespace {
+
+/* a source that can't be decoded */
+class FailingSource : public stfio::SectionSource {
+public:
+    FailingSource(std::size_t n) : npoints(n) {}
+    std::size_t size() const { return npoints; }
+    void read(std::size_t, std::size_t, double*) const {
+        throw std::out_of_range("FailingSource");
+    }
+private:
+    std::size_t npoints;
+};
+
+}
+
+TEST(measlib_test, measurement_plan) {
+    /* sections of different lengths with events at different times */
+    Channel ch(8);
+    std::vector<std::size_t> sections;
+    for (std::size_t n = 0; n < ch.size(); ++n) {
+        std::vector<double> data = eventwave(1000 + 50*n, 1.0 + n);
+        ch[n].get_w() = data;
+        sections.push_back(ch.size()-1-n);
+    }
+    stfnum::MeasurementSettings s;
+    s.baseEnd = 150;
+    s.peakBeg = 180;
+    s.peakEnd = 800;
+    s.baselineMethod = stfnum::median_iqr;
+    s.slopeForThreshold = 0.02;
+    s.dir = stfnum::up;
+
+    /* every section is measured like a single one with the same settings */
+    stfnum::MeasurementPlan plan(s);
+    std::vector<stfnum::MeasurementResults> results = plan.Measure(ch, sections);
+    std::vector<stfnum::ReferenceResults> reference = plan.MeasureReference(ch, sections);
+    ASSERT_EQ(results.size(), sections.size());
+    ASSERT_EQ(reference.size(), sections.size());
+    stfnum::MeasurementKernel kernel(s);
+    for (std::size_t n = 0; n < sections.size(); ++n) {
+        const std::vector<double>& data = ch[sections[n]].get();
+        expectSameResults(results[n], kernel.Measure(data));
+        stfnum::ReferenceResults r = kernel.MeasureReference(data);
+        EXPECT_TRUE(same(reference[n].maxT, r.maxT));
+        EXPECT_TRUE(same(reference[n].maxRiseT, r.maxRiseT));
+        EXPECT_TRUE(same(reference[n].t50LeftReal, r.t50LeftReal));
+        EXPECT_TRUE(same(reference[n].tLoReal, r.tLoReal));
+    }
+
+    /* the peak window can extend to the end of each section */
+    plan.SetPeakAtEnd(true);
+    results = plan.Measure(ch, sections);
+    for (std::size_t n = 0; n < sections.size(); ++n) {
+        const std::vector<double>& data = ch[sections[n]].get();
+        s.peakEnd = data.size()-1;
+        kernel.SetSettings(s);
+        expectSameResults(results[n], kernel.Measure(data));
+    }
+
+    stfnum::Table table = plan.MeasureTable(ch, sections, dt);
+    EXPECT_EQ(table.nRows(), sections.size());
+    EXPECT_DOUBLE_EQ(table.at(0, 7), results[0].maxT*dt);
+
+    sections.push_back(ch.size());
+    EXPECT_THROW(plan.Measure(ch, sections), std::out_of_range);
+
+    /* exceptions of the threads are passed on as they are */
+    sections.back() = 0;
+    ch[0] = Section(stfio::SectionSourcePtr(new FailingSource(1000)));
+    try {
+        plan.Measure(ch, sections);
+        FAIL() << "No exception thrown";
+    }
+    catch (const std::out_of_range& e) {
+        EXPECT_STREQ(e.what(), "FailingSource");
+    }
+}
@@ -1,6 +1,11 @@
 #include "../libstfio/stfio.h"
+#include "./testutils.h"
 #include <gtest/gtest.h>
 
+#include <cstring>
+#include <limits>
+#include <vector>
+
 TEST(Recording_test, constructors)
 {
     Recording rec0;
@@ -58,3 +63,178 @@ TEST(Recording_test, data_access)
     EXPECT_THROW( rec3[recsize-1].at(chsize), std::out_of_range );
     EXPECT_THROW( rec3[recsize-1][chsize-1].at(secsize), std::out_of_range );
 }
+
+TEST(Recording_test, import_request)
+{
+    stfio::importRequest request;
+    EXPECT_TRUE( request.IsComplete() );
+    EXPECT_TRUE( request.HasChannel(3) );
+    EXPECT_EQ( request.SectionEnd(16), 16 );
+
+    Recording rec1(4, 16, 1000);
+    rec1[2].SetChannelName("Channel 2");
+    rec1[2][5][100] = 1.0;
+    stfio::applyImportRequest(rec1, request);
+    EXPECT_EQ( rec1.size(), 4 );
+    EXPECT_EQ( rec1[0].size(), 16 );
+
+    request.channels.push_back(2);
+    request.channels.push_back(0);
+    request.firstSection = 4;
+    request.nSections = 3;
+    request.firstPoint = 100;
+    request.nPoints = 200;
+    EXPECT_FALSE( request.IsComplete() );
+    EXPECT_FALSE( request.HasChannel(1) );
+    EXPECT_TRUE( request.HasSection(6, 16) );
+    EXPECT_FALSE( request.HasSection(7, 16) );
+    EXPECT_EQ( request.SectionEnd(5), 5 );
+    EXPECT_EQ( request.SectionEnd(2), 4 );
+
+    std::size_t start = 0, n = 0;
+    request.Window(250, start, n);
+    EXPECT_EQ( start, 100 );
+    EXPECT_EQ( n, 150 );
+    request.Window(50, start, n);
+    EXPECT_EQ( start, 50 );
+    EXPECT_EQ( n, 0 );
+
+    // Channels are kept in the order of the recording:
+    stfio::applyImportRequest(rec1, request);
+    EXPECT_EQ( rec1.size(), 2 );
+    EXPECT_EQ( rec1[1].GetChannelName(), "Channel 2" );
+    EXPECT_EQ( rec1[1].size(), 3 );
+    EXPECT_EQ( rec1[1][0].size(), 200 );
+    EXPECT_EQ( rec1[1][1][0], 1.0 );
+}
+
+TEST(Recording_test, metadata)
+{
+    Recording rec(2, 3, 500);
+    rec[0].SetChannelName("Vm");
+    rec[0].SetYUnits("mV");
+    rec[1].SetChannelName("Im");
+    rec[1].SetYUnits("pA");
+    rec.SetXScale(0.1);
+    rec.SetComment("metadata test");
+
+    stftest::TempDir dir;
+    std::string fName = dir.path("metadata.h5");
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    ASSERT_TRUE( stfio::exportFile(fName, stfio::hdf5, rec, progDlg) );
+
+    stfio::fileMetadata metadata = stfio::importMetadata(fName, stfio::hdf5);
+    EXPECT_EQ( metadata.type, stfio::hdf5 );
+    // The type of the reader that was used is reported, not the one passed in:
+    EXPECT_EQ( stfio::importMetadata(fName, stfio::abf).type, stfio::hdf5 );
+    EXPECT_DOUBLE_EQ( metadata.dt, 0.1 );
+    ASSERT_EQ( metadata.channelNames.size(), 2 );
+    EXPECT_EQ( metadata.channelNames[1], "Im" );
+    EXPECT_EQ( metadata.yUnits[0], "mV" );
+    EXPECT_EQ( metadata.nSections[0], 3 );
+    EXPECT_EQ( metadata.nSections[1], 3 );
+    EXPECT_STREQ( metadata.comment.c_str(), "metadata test" );
+
+    EXPECT_THROW( stfio::importMetadata(dir.path("missing.h5"), stfio::hdf5),
+                  std::runtime_error );
+}
+
+TEST(Recording_test, sniff)
+{
+    stfio::resetSniffStatistics();
+
+    Recording rec(1, 2, 100);
+    stftest::TempDir dir;
+    std::string fName = dir.path("sniff.h5");
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    ASSERT_TRUE( stfio::exportFile(fName, stfio::hdf5, rec, progDlg) );
+    stfio::fileSignature signature = stfio::sniffFile(fName);
+    EXPECT_EQ( signature.type, stfio::hdf5 );
+    EXPECT_EQ( signature.format, "HDF5" );
+
+    // The format in the file takes precedence over the type that is passed in:
+    Recording back;
+    stfio::txtImportSettings txtImport;
+    ASSERT_TRUE( stfio::importFile(fName, stfio::abf, back, txtImport, progDlg) );
+    EXPECT_EQ( back[0].size(), 2 );
+
+    const unsigned char abf2[] = { 'A', 'B', 'F', '2', 0, 0, 3, 2 };
+    fName = dir.path("sniff.abf");
+    FILE* fp = fopen(fName.c_str(), "wb");
+    ASSERT_TRUE( fp != NULL );
+    fwrite(abf2, 1, sizeof(abf2), fp);
+    fclose(fp);
+    signature = stfio::sniffFile(fName);
+    EXPECT_EQ( signature.type, stfio::abf );
+    EXPECT_EQ( signature.format, "ABF2" );
+    EXPECT_DOUBLE_EQ( signature.version, 2.03 );
+
+    // EDF files are only identified if the fixed header fields are valid:
+    std::vector<char> edf(512, ' ');
+    edf[0] = '0';
+    memcpy(&edf[168], "01.02.03", 8);
+    memcpy(&edf[176], "04.05.06", 8);
+    memcpy(&edf[184], "512", 3);
+    edf[252] = '1';
+    fName = dir.path("sniff.edf");
+    fp = fopen(fName.c_str(), "wb");
+    ASSERT_TRUE( fp != NULL );
+    fwrite(&edf[0], 1, edf.size(), fp);
+    fclose(fp);
+    signature = stfio::sniffFile(fName);
+    EXPECT_EQ( signature.type, stfio::biosig );
+    EXPECT_EQ( signature.format, "EDF" );
+
+    memcpy(&edf[184], "768", 3);
+    fName = dir.path("sniff.txt");
+    fp = fopen(fName.c_str(), "wb");
+    ASSERT_TRUE( fp != NULL );
+    fwrite(&edf[0], 1, edf.size(), fp);
+    fclose(fp);
+    EXPECT_EQ( stfio::sniffFile(fName).type, stfio::none );
+
+    signature = stfio::sniffFile(dir.path("missing.abf"));
+    EXPECT_EQ( signature.type, stfio::none );
+    EXPECT_EQ( signature.format, "" );
+
+    stfio::sniffStatistics counts = stfio::getSniffStatistics();
+    EXPECT_EQ( counts.hits, 4 );
+    EXPECT_EQ( counts.misses, 2 );
+    stfio::resetSniffStatistics();
+    EXPECT_EQ( stfio::getSniffStatistics().hits, 0 );
+}
+
+TEST(Recording_test, channel_datasets)
+{
+    Recording rec(1, 2, 100);
+    rec[0][0].SetSectionDescription("baseline");
+    for (std::size_t n = 0; n < rec[0][1].size(); ++n) {
+        rec[0][1][n] = n;
+    }
+    stftest::TempDir dir;
+    std::string fName = dir.path("channels.h5");
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    stfio::hdf5ExportSettings hdf5Export;
+    hdf5Export.channelDatasets = true;
+    hdf5Export.int16 = true;
+    ASSERT_TRUE( stfio::exportFile(fName, stfio::hdf5, rec, progDlg, hdf5Export) );
+
+    // Section names are kept; unnamed sections are numbered:
+    Recording back;
+    stfio::txtImportSettings txtImport;
+    ASSERT_TRUE( stfio::importFile(fName, stfio::hdf5, back, txtImport, progDlg) );
+    ASSERT_EQ( back[0].size(), 2 );
+    EXPECT_EQ( back[0][0].GetSectionDescription(), "baseline" );
+    EXPECT_EQ( back[0][1].GetSectionDescription(), "sec1" );
+    EXPECT_NEAR( back[0][1][99], 99.0, 0.01 );
+
+    // NaN and infinite samples have no 16 bit representation:
+    rec[0][1][50] = std::numeric_limits<double>::quiet_NaN();
+    EXPECT_THROW( stfio::exportFile(fName, stfio::hdf5, rec, progDlg, hdf5Export),
+                  std::runtime_error );
+    rec[0][1][50] = std::numeric_limits<double>::infinity();
+    EXPECT_THROW( stfio::exportFile(fName, stfio::hdf5, rec, progDlg, hdf5Export),
+                  std::runtime_error );
+    hdf5Export.int16 = false;
+    EXPECT_TRUE( stfio::exportFile(fName, stfio::hdf5, rec, progDlg, hdf5Export) );
+}
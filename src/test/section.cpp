@@ -1,4 +1,6 @@
 #include "../libstfio/stfio.h"
+#include "../libstfio/compactsource.h"
+#include "../libstfio/envelope.h"
 #include <gtest/gtest.h>
 
 TEST(Section_test, constructors) {
@@ -22,3 +24,185 @@ TEST(Section_test, data_access) {
     EXPECT_EQ( sec2[sec2.size()-1], 0 );
     EXPECT_THROW( sec2.at( sec2.size() ), std::out_of_range );
 }
+
+namespace {
+
+class RampSource : public stfio::SectionSource {
+public:
+    RampSource(std::size_t n) : npoints(n) {}
+    std::size_t size() const { return npoints; }
+    void read(std::size_t start, std::size_t n, double* dest) const {
+        for (std::size_t i = 0; i < n; ++i) {
+            dest[i] = (double)(start+i);
+        }
+    }
+private:
+    std::size_t npoints;
+};
+
+class FailingSource : public stfio::SectionSource {
+public:
+    FailingSource(std::size_t n) : npoints(n) {}
+    std::size_t size() const { return npoints; }
+    void read(std::size_t, std::size_t, double*) const {
+        throw std::runtime_error("FailingSource");
+    }
+private:
+    std::size_t npoints;
+};
+
+}
+
+TEST(Section_test, lazy) {
+    Section sec1(stfio::SectionSourcePtr(new RampSource(32768)), "Test section");
+    EXPECT_EQ( sec1.size(), 32768 );
+    EXPECT_FALSE( sec1.IsMaterialized() );
+
+    Vector_double window;
+    sec1.GetWindow(100, 10, window);
+    EXPECT_EQ( window.size(), 10 );
+    EXPECT_EQ( window[9], 109 );
+    EXPECT_FALSE( sec1.IsMaterialized() );
+    EXPECT_THROW( sec1.GetWindow(32760, 10, window), std::out_of_range );
+    double buffer[10];
+    sec1.GetWindow(32758, 10, buffer);
+    EXPECT_EQ( buffer[0], 32758 );
+    EXPECT_FALSE( sec1.IsMaterialized() );
+    EXPECT_THROW( sec1.GetWindow(32760, 10, buffer), std::out_of_range );
+
+    // Copies share the source until they are accessed:
+    Section sec2(sec1);
+    EXPECT_EQ( sec2[sec2.size()-1], 32767 );
+    EXPECT_TRUE( sec2.IsMaterialized() );
+    EXPECT_FALSE( sec1.IsMaterialized() );
+    sec2[0] = -1;
+    EXPECT_EQ( sec1.at(0), 0 );
+    EXPECT_TRUE( sec1.IsMaterialized() );
+    EXPECT_THROW( sec1.at( sec1.size() ), std::out_of_range );
+
+    // Errors of the source are passed on, and the section stays pending:
+    Section sec3(stfio::SectionSourcePtr(new FailingSource(10)));
+    EXPECT_THROW( sec3.get(), std::runtime_error );
+    EXPECT_FALSE( sec3.IsMaterialized() );
+    EXPECT_THROW( sec3.get(), std::runtime_error );
+}
+
+TEST(Section_test, window) {
+    Section sec1(stfio::SectionSourcePtr(new RampSource(32768)), "Test section");
+    sec1.SetXScale(0.5);
+
+    // Windows of pending sections decode only their own range:
+    Section win1 = sec1.Window(1000, 100);
+    EXPECT_EQ( win1.size(), 100 );
+    EXPECT_FALSE( win1.IsMaterialized() );
+    EXPECT_EQ( win1.GetXScale(), 0.5 );
+    EXPECT_EQ( win1.GetSectionDescription(), "Test section" );
+    EXPECT_EQ( win1[0], 1000 );
+    EXPECT_EQ( win1[99], 1099 );
+    EXPECT_FALSE( sec1.IsMaterialized() );
+    EXPECT_THROW( sec1.Window(32700, 100), std::out_of_range );
+
+    Section win2 = sec1.Window(0, 0);
+    EXPECT_EQ( win2.size(), 0 );
+
+    // Materialised sections are copied:
+    Section sec2(Vector_double(10, 1.0));
+    sec2[5] = 2.0;
+    Section win3 = sec2.Window(5, 5);
+    EXPECT_EQ( win3.size(), 5 );
+    EXPECT_EQ( win3[0], 2.0 );
+    win3[0] = 3.0;
+    EXPECT_EQ( sec2[5], 2.0 );
+}
+
+TEST(Section_test, compact) {
+    std::vector<short> raw(32768);
+    for (std::size_t n = 0; n < raw.size(); ++n) {
+        raw[n] = (short)(n - 16384);
+    }
+    std::vector<short> raw_cp(raw);
+    const float factor = 0.0305f, shift = -1.5f;
+    Section sec1(stfio::SectionSourcePtr(
+                     new stfio::ScaledSectionSource<short, float>(raw_cp, factor, shift)));
+    // the raw samples have been moved into the source:
+    EXPECT_EQ( raw_cp.size(), 0 );
+    EXPECT_EQ( sec1.size(), 32768 );
+
+    // Decoded values have to be identical to eager scaling in float precision:
+    const Section& csec1 = sec1;
+    Section win1 = csec1.Window(100, 10);
+    for (std::size_t n = 0; n < raw.size(); ++n) {
+        EXPECT_EQ( csec1[n], (double)(float)(raw[n]*factor + shift) );
+    }
+    EXPECT_TRUE( csec1.IsMaterialized() );
+
+    // The raw samples are dropped once they have been decoded, so there is
+    // nothing to release:
+    sec1.Release();
+    EXPECT_TRUE( sec1.IsMaterialized() );
+    EXPECT_EQ( sec1.size(), 32768 );
+    EXPECT_EQ( csec1.get()[100], (double)(float)(raw[100]*factor + shift) );
+
+    // Windows that were taken before keep the raw samples alive:
+    EXPECT_FALSE( win1.IsMaterialized() );
+    EXPECT_EQ( win1.at(0), (double)(float)(raw[100]*factor + shift) );
+    EXPECT_TRUE( win1.IsMaterialized() );
+
+    // Written sections are detached from their source:
+    sec1[0] = 1.0;
+    sec1.Release();
+    EXPECT_TRUE( sec1.IsMaterialized() );
+    EXPECT_EQ( sec1[0], 1.0 );
+
+    Vector_float fsamples(16, 0.1f);
+    Section sec2(stfio::SectionSourcePtr(new stfio::Float32SectionSource(fsamples)));
+    EXPECT_EQ( sec2.size(), 16 );
+    EXPECT_EQ( sec2.at(15), (double)0.1f );
+}
+
+TEST(Section_test, envelope) {
+    // a noisy sine wave that doesn't fill complete blocks:
+    Vector_double data(100003);
+    unsigned int seed = 1;
+    for (std::size_t n = 0; n < data.size(); ++n) {
+        seed = seed * 1103515245u + 12345u;
+        data[n] = sin(n/1000.0) + (double)(seed >> 16 & 0x7fff) / 32767.0;
+    }
+    stfio::MinMaxPyramid pyramid(data);
+    EXPECT_EQ( pyramid.size(), data.size() );
+    EXPECT_GT( pyramid.levels(), (std::size_t)1 );
+
+    // Ranges of all lengths, aligned or not, have to give the exact extrema:
+    std::size_t starts[] = {0, 1, 31, 32, 33, 127, 128, 5000, 99999};
+    std::size_t lengths[] = {1, 2, 31, 32, 33, 100, 128, 129, 4097, 60000, 100003};
+    for (std::size_t ns = 0; ns < sizeof(starts)/sizeof(starts[0]); ++ns) {
+        for (std::size_t nl = 0; nl < sizeof(lengths)/sizeof(lengths[0]); ++nl) {
+            std::size_t start = starts[ns];
+            std::size_t end = std::min(start + lengths[nl], data.size());
+            double ymin = 0, ymax = 0;
+            pyramid.MinMax(data, start, end, ymin, ymax);
+            EXPECT_EQ( ymin, *std::min_element(data.begin()+start, data.begin()+end) );
+            EXPECT_EQ( ymax, *std::max_element(data.begin()+start, data.begin()+end) );
+        }
+    }
+    double ymin, ymax;
+    EXPECT_THROW( pyramid.MinMax(data, 10, 10, ymin, ymax), std::out_of_range );
+    EXPECT_THROW( pyramid.MinMax(data, 0, data.size()+1, ymin, ymax), std::out_of_range );
+
+    // Sections drop the cached pyramid when they are modified:
+    Section sec(data);
+    sec.GetMinMax(0, sec.size(), ymin, ymax);
+    EXPECT_EQ( ymax, *std::max_element(data.begin(), data.end()) );
+    sec[50000] = 10.0;
+    sec.GetMinMax(0, sec.size(), ymin, ymax);
+    EXPECT_EQ( ymax, 10.0 );
+    sec.get_w()[50001] = -10.0;
+    sec.GetMinMax(49000, 51000, ymin, ymax);
+    EXPECT_EQ( ymin, -10.0 );
+
+    // Short sections don't have any complete blocks:
+    Section short_sec(Vector_double(3, 2.0));
+    short_sec.GetMinMax(1, 3, ymin, ymax);
+    EXPECT_EQ( ymin, 2.0 );
+    EXPECT_EQ( ymax, 2.0 );
+}
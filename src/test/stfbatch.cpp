@@ -0,0 +1,131 @@
+#include "../stfbatch/batch.h"
+#include "./testutils.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+// A section with a baseline of -60 and a downward event of amplitude 10
+// starting at sampling point 200:
+Section eventSection(double ampl) {
+    Vector_double data(1000, -60.0);
+    for (std::size_t n = 200; n < data.size(); ++n) {
+        double t = (double)(n-200);
+        data[n] -= ampl * (exp(-t/100.0) - exp(-t/10.0)) / 0.7;
+    }
+    return Section(data);
+}
+
+}
+
+TEST(stfbatch_test, settings) {
+    stftest::TempDir dir;
+    const std::string fName = dir.path("stfbatch_test.cfg");
+    {
+        std::ofstream cfg(fName.c_str());
+        cfg << "[Settings]\n"
+            << "BaseBegin=10\nBaseEnd=150\n"
+            << "PeakBegin=190\nPeakEnd=600\n"
+            << "Direction=1\nPeakMean=3\nRTFactor=10\nSlope=5.5\n"
+            << "[RecentFiles]\nPeakBegin=5\n";
+    }
+    stfbatch::Settings settings = stfbatch::ReadSettings(fName);
+    EXPECT_EQ( settings.baseBeg, 10 );
+    EXPECT_EQ( settings.baseEnd, 150 );
+    // keys outside of [Settings] are ignored:
+    EXPECT_EQ( settings.peakBeg, 190 );
+    EXPECT_EQ( settings.peakEnd, 600 );
+    EXPECT_FALSE( settings.peakAtEnd );
+    EXPECT_EQ( settings.direction, stfnum::down );
+    EXPECT_EQ( settings.pM, 3 );
+    EXPECT_EQ( settings.RTFactor, 10 );
+    EXPECT_DOUBLE_EQ( settings.slopeForThreshold, 5.5 );
+    {
+        std::ofstream cfg(fName.c_str());
+        cfg << "Direction=down\n";
+    }
+    EXPECT_THROW( stfbatch::ReadSettings(fName), std::runtime_error );
+    remove(fName.c_str());
+    EXPECT_THROW( stfbatch::ReadSettings(fName), std::runtime_error );
+}
+
+TEST(stfbatch_test, measure) {
+    stfbatch::Settings settings;
+    settings.baseBeg = 0;
+    settings.baseEnd = 150;
+    settings.peakBeg = 150;
+    settings.peakEnd = 800;
+    settings.peakAtEnd = false;
+    settings.direction = stfnum::down;
+    double dt = 0.1;
+
+    std::vector<std::string> labels = stfbatch::MeasurementLabels();
+    Vector_double results = stfbatch::Measure(settings, eventSection(10.0), NULL, dt);
+    ASSERT_EQ( results.size(), labels.size() );
+    EXPECT_EQ( labels[0], "Base" );
+    EXPECT_NEAR( results[0], -60.0, 1e-9 );
+    EXPECT_NEAR( results[1], 0.0, 1e-9 );
+    // peak of the difference of exponentials at t = ln(10)*100/9:
+    double tpeak = log(10.0)*100.0/9.0;
+    double peak = 10.0*(exp(-tpeak/100.0)-exp(-tpeak/10.0))/0.7;
+    EXPECT_NEAR( results[5], -peak, 1e-2 );
+    EXPECT_NEAR( results[7], (200.0+tpeak)*dt, 1.0*dt );
+
+    // Latency from the peak of a reference section with the same time course:
+    settings.latencyStartMode = stfbatch::peakMode;
+    settings.latencyEndMode = stfbatch::peakMode;
+    Section reference = eventSection(20.0);
+    results = stfbatch::Measure(settings, eventSection(10.0), &reference, dt);
+    EXPECT_NEAR( results[labels.size()-1], 0.0, 1e-9 );
+
+    settings.peakEnd = 2000;
+    EXPECT_THROW( stfbatch::Measure(settings, eventSection(10.0), NULL, dt), std::out_of_range );
+}
+
+TEST(stfbatch_test, analyse) {
+    std::deque<Section> sections;
+    for (int n = 0; n < 4; ++n) {
+        sections.push_back(eventSection(5.0*(n+1)));
+    }
+    Channel ch(sections);
+    Recording rec(ch);
+    rec.SetXScale(0.1);
+    rec[0].SetYUnits("mV");
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    stftest::TempDir dir;
+    std::vector<std::string> fileNames;
+    fileNames.push_back(dir.path("stfbatch_test1.h5"));
+    fileNames.push_back(dir.path("stfbatch_test2.h5"));
+    ASSERT_TRUE( stfio::exportFile(fileNames[0], stfio::hdf5, rec, progDlg) );
+    ASSERT_TRUE( stfio::exportFile(fileNames[1], stfio::hdf5, rec, progDlg) );
+    fileNames.push_back(dir.path("stfbatch_test_missing.h5"));
+
+    stfbatch::Settings settings;
+    settings.baseEnd = 150;
+    settings.direction = stfnum::down;
+    std::vector<std::string> errors;
+    stfnum::Table table = stfbatch::Analyse(fileNames, stfio::none, settings, errors);
+    // one row per section; the missing file is reported:
+    ASSERT_EQ( table.nRows(), 8 );
+    EXPECT_EQ( table.nCols(), stfbatch::MeasurementLabels().size() );
+    EXPECT_EQ( errors.size(), 1 );
+    for (std::size_t n_r = 0; n_r < table.nRows(); ++n_r) {
+        Vector_double results = stfbatch::Measure(settings, sections[n_r % 4], NULL, 0.1);
+        for (std::size_t n_c = 0; n_c < table.nCols(); ++n_c) {
+            // single precision in the HDF5 file:
+            EXPECT_NEAR( table.at(n_r, n_c), results[n_c], 1e-3*std::max(1.0, fabs(results[n_c])) );
+        }
+    }
+    EXPECT_EQ( table.GetRowLabel(5), fileNames[1] + ", section 2" );
+
+    const std::string csvName = dir.path("stfbatch_test.csv");
+    stfbatch::WriteCSV(csvName, table);
+    std::ifstream csv(csvName.c_str());
+    std::string line;
+    std::size_t nLines = 0;
+    while (std::getline(csv, line)) ++nLines;
+    EXPECT_EQ( nLines, table.nRows()+1 );
+    stfbatch::WriteHDF5(dir.path("stfbatch_test_results.h5"), table);
+}
@@ -0,0 +1,268 @@
+#include "../stimfit/stf.h"
+#include "../libstfnum/stfnum.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+
+namespace {
+
+// A noisy trace with exponentially decaying events every 1000 sampling points.
+Vector_double eventTrace(std::size_t size) {
+    Vector_double trace(size);
+    unsigned int seed = 12345;
+    for (std::size_t n = 0; n < size; ++n) {
+        // linear congruential generator; reproducible across platforms:
+        seed = seed * 1103515245u + 12345u;
+        trace[n] = -65.0 + 0.5 * ((double)(seed >> 16 & 0x7fff) / 32767.0 - 0.5);
+    }
+    for (std::size_t start = 500; start < size; start += 1000) {
+        for (std::size_t n = start; n < size && n < start + 800; ++n) {
+            trace[n] -= 5.0 * exp(-(double)(n-start)/100.0);
+        }
+    }
+    return trace;
+}
+
+Vector_double eventTemplate(std::size_t size) {
+    Vector_double templ(size);
+    for (std::size_t n = 0; n < size; ++n) {
+        templ[n] = -exp(-(double)n/(size/8.0)) * (1.0 - exp(-(double)n/(size/80.0)));
+    }
+    return templ;
+}
+
+// Direct O(N*M) reference implementations of the Clements & Bekkers (1997)
+// detection criterion and of the linear correlation.
+Vector_double refDetectionCriterion(const Vector_double& data, const Vector_double& templ) {
+    std::size_t m = templ.size();
+    Vector_double dc(data.size()-m);
+    double sum_templ=0.0, sum_templ_sqr=0.0;
+    for (std::size_t i = 0; i < m; ++i) {
+        sum_templ += templ[i];
+        sum_templ_sqr += templ[i]*templ[i];
+    }
+    for (std::size_t n = 0; n < dc.size(); ++n) {
+        double sum_templ_data=0.0, sum_data=0.0, sum_data_sqr=0.0;
+        for (std::size_t i = 0; i < m; ++i) {
+            sum_templ_data += templ[i]*data[n+i];
+            sum_data += data[n+i];
+            sum_data_sqr += data[n+i]*data[n+i];
+        }
+        double scale = (sum_templ_data-sum_templ*sum_data/m)/(sum_templ_sqr-sum_templ*sum_templ/m);
+        double offset = (sum_data-scale*sum_templ)/m;
+        double sse = sum_data_sqr+scale*scale*sum_templ_sqr+m*offset*offset -
+            2.0*(scale*sum_templ_data + offset*sum_data-scale*offset*sum_templ);
+        dc[n] = scale/sqrt(sse/(m-1));
+    }
+    return dc;
+}
+
+Vector_double refLinCorr(const Vector_double& data, const Vector_double& templ) {
+    std::size_t m = templ.size();
+    Vector_double corr(data.size()-m);
+    for (std::size_t n = 0; n < corr.size(); ++n) {
+        double mean_data=0.0, mean_templ=0.0;
+        for (std::size_t i = 0; i < m; ++i) {
+            mean_data += data[n+i];
+            mean_templ += templ[i];
+        }
+        mean_data /= m;
+        mean_templ /= m;
+        double sd_data=0.0, sd_templ=0.0, r=0.0;
+        for (std::size_t i = 0; i < m; ++i) {
+            sd_data += (data[n+i]-mean_data)*(data[n+i]-mean_data);
+            sd_templ += (templ[i]-mean_templ)*(templ[i]-mean_templ);
+            r += (data[n+i]-mean_data)*(templ[i]-mean_templ);
+        }
+        // correlation with the optimally scaled template:
+        double scale = r/sd_templ;
+        corr[n] = scale*r/((m-1)*sqrt(sd_data/m)*fabs(scale)*sqrt(sd_templ/m));
+    }
+    return corr;
+}
+
+// Serial reference implementation of the peak search.
+std::vector<int> refPeakIndices(const Vector_double& data, double threshold, int minDistance) {
+    std::vector<int> peaks;
+    for (std::size_t n = 0; n < data.size(); ++n) {
+        if (data[n] <= threshold) {
+            continue;
+        }
+        std::size_t first = n, last = data.size()-1;
+        for (std::size_t i = n+1; i < data.size(); ++i) {
+            if (data[i] < threshold && (int)i-(int)first-1 > minDistance) {
+                last = i;
+                break;
+            }
+        }
+        peaks.push_back((int)(std::max_element(data.begin()+first, data.begin()+last+1)-data.begin()));
+        n = last;
+    }
+    return peaks;
+}
+
+void expectClose(const Vector_double& result, const Vector_double& reference, double tol) {
+    ASSERT_EQ( result.size(), reference.size() );
+    for (std::size_t n = 0; n < result.size(); ++n) {
+        EXPECT_NEAR( result[n], reference[n], tol*std::max(1.0, fabs(reference[n])) );
+    }
+}
+
+}
+
+TEST(stfnum_test, detection_criterion) {
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Vector_double data = eventTrace(10000);
+    // short templates are correlated directly, long ones with FFTs:
+    std::size_t sizes[] = {10, 50, 400, 2000};
+    for (std::size_t n = 0; n < sizeof(sizes)/sizeof(sizes[0]); ++n) {
+        Vector_double templ = eventTemplate(sizes[n]);
+        expectClose( stfnum::detectionCriterion(data, templ, progDlg),
+                     refDetectionCriterion(data, templ), 1e-6 );
+    }
+    EXPECT_THROW( stfnum::detectionCriterion(Vector_double(10), Vector_double(20), progDlg),
+                  std::runtime_error );
+}
+
+TEST(stfnum_test, linear_correlation) {
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Vector_double data = eventTrace(10000);
+    std::size_t sizes[] = {10, 50, 400, 2000};
+    for (std::size_t n = 0; n < sizeof(sizes)/sizeof(sizes[0]); ++n) {
+        Vector_double templ = eventTemplate(sizes[n]);
+        expectClose( stfnum::linCorr(data, templ, progDlg),
+                     refLinCorr(data, templ), 1e-6 );
+    }
+
+    // A large step in the baseline mustn't cancel out the variance of the windows:
+    Vector_double stepped(data);
+    for (std::size_t n = stepped.size()/2; n < stepped.size(); ++n) {
+        stepped[n] += 1.0e6;
+    }
+    Vector_double templ = eventTemplate(50);
+    expectClose( stfnum::linCorr(stepped, templ, progDlg), refLinCorr(stepped, templ), 1e-6 );
+
+    // Constant data aren't correlated with anything:
+    Vector_double corr = stfnum::linCorr(Vector_double(1000, -65.0), templ, progDlg);
+    for (std::size_t n = 0; n < corr.size(); ++n) {
+        EXPECT_EQ( corr[n], 0.0 );
+    }
+}
+
+TEST(stfnum_test, peak_indices) {
+    // Long enough to be searched in several chunks; some event windows
+    // span chunk borders:
+    Vector_double data = eventTrace(1000000);
+    for (std::size_t n = 0; n < data.size(); ++n) {
+        data[n] = -data[n];
+    }
+    int distances[] = {0, 20, 1500};
+    for (std::size_t n = 0; n < sizeof(distances)/sizeof(distances[0]); ++n) {
+        std::vector<int> peaks = stfnum::peakIndices(data, 65.1, distances[n]);
+        EXPECT_FALSE( peaks.empty() );
+        EXPECT_EQ( peaks, refPeakIndices(data, 65.1, distances[n]) );
+    }
+}
+
+namespace {
+
+struct EventBatches {
+    void operator()(const std::vector<int>& batch) {
+        ASSERT_FALSE( batch.empty() );
+        if (!events.empty()) {
+            EXPECT_LT( events.back(), batch.front() );
+        }
+        events.insert(events.end(), batch.begin(), batch.end());
+    }
+    std::vector<int> events;
+};
+
+}
+
+TEST(stfnum_test, detect_events) {
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Vector_double data = eventTrace(300000);
+    std::size_t sizes[] = {50, 400};
+    for (std::size_t n = 0; n < sizeof(sizes)/sizeof(sizes[0]); ++n) {
+        Vector_double templ = eventTemplate(sizes[n]);
+        // The events equal those of the serial path exactly:
+        EventBatches batches;
+        std::vector<int> events = stfnum::detectEvents(data, templ, stfnum::detect_criterion,
+                                                       4.0, 100, progDlg, stfnum::EventSink(std::ref(batches)));
+        EXPECT_GE( events.size(), 300u );
+        EXPECT_EQ( events, stfnum::peakIndices(stfnum::detectionCriterion(data, templ, progDlg), 4.0, 100) );
+        EXPECT_EQ( batches.events, events );
+
+        events = stfnum::detectEvents(data, templ, stfnum::detect_correlation, 0.5, 100, progDlg);
+        EXPECT_EQ( events, stfnum::peakIndices(stfnum::linCorr(data, templ, progDlg), 0.5, 100) );
+    }
+}
+
+TEST(stfnum_test, filter_batch) {
+    Vector_double a(1, 1.0);
+    Channel ch(4);
+    for (std::size_t n_s = 0; n_s < ch.size(); ++n_s) {
+        Vector_double trace = eventTrace(5000);
+        std::rotate(trace.begin(), trace.begin()+n_s*250, trace.end());
+        ch.InsertSection(Section(trace), n_s);
+    }
+    std::vector<std::size_t> sections;
+    sections.push_back(3);
+    sections.push_back(0);
+    sections.push_back(2);
+    for (int parallel = 0; parallel < 2; ++parallel) {
+        std::vector<Vector_double> filtered =
+            stfnum::filterBatch(ch, sections, 100, 4098, a, 20, stfnum::fgaussColqu, false, parallel != 0);
+        ASSERT_EQ( filtered.size(), sections.size() );
+        for (std::size_t n_s = 0; n_s < sections.size(); ++n_s) {
+            expectClose( filtered[n_s],
+                         stfnum::filter(ch[sections[n_s]].get(), 100, 4098, a, 20, stfnum::fgaussColqu),
+                         1e-9 );
+        }
+    }
+    EXPECT_THROW( stfnum::filterBatch(ch, sections, 100, 5000, a, 20, stfnum::fgaussColqu),
+                  std::out_of_range );
+    // Plans are created once and then taken from the cache:
+    EXPECT_EQ( stfnum::fftPlan(4999, 3, stfnum::fft_forward),
+               stfnum::fftPlan(4999, 3, stfnum::fft_forward) );
+    EXPECT_NE( stfnum::fftPlan(4999, 3, stfnum::fft_forward),
+               stfnum::fftPlan(4999, 3, stfnum::fft_backward) );
+
+    // Only the most recently used plans are cached, but plans that are
+    // still held stay valid after they have been evicted:
+    stfnum::FFTPlanPtr held = stfnum::fftPlan(64, 1, stfnum::fft_forward);
+    for (std::size_t size = 65; size < 1065; ++size) {
+        stfnum::fftPlan(size, 1, stfnum::fft_forward);
+    }
+    double* in = (double*)fftw_malloc(sizeof(double) * 64);
+    fftw_complex* out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * 33);
+    std::fill(in, in+64, 1.0);
+    fftw_execute_dft_r2c(held.get(), in, out);
+    EXPECT_NEAR( out[0][0], 64.0, 1e-9 );
+    EXPECT_NEAR( out[1][0], 0.0, 1e-9 );
+    fftw_free(in);
+    fftw_free(out);
+}
+
+// Template matching time as a function of the template length.
+// Run with --gtest_also_run_disabled_tests
+TEST(stfnum_test, DISABLED_benchmark_template_matching) {
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    // 1 minute at 20 kHz:
+    Vector_double data = eventTrace(1200000);
+    std::size_t sizes[] = {50, 100, 200, 500, 1000, 2000, 5000};
+    for (std::size_t n = 0; n < sizeof(sizes)/sizeof(sizes[0]); ++n) {
+        Vector_double templ = eventTemplate(sizes[n]);
+        std::clock_t start = std::clock();
+        Vector_double dc = stfnum::detectionCriterion(data, templ, progDlg);
+        double t_dc = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+        start = std::clock();
+        Vector_double corr = stfnum::linCorr(data, templ, progDlg);
+        double t_corr = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+        std::cout << "Template length " << sizes[n] << ": detectionCriterion "
+                  << t_dc << " s, linCorr " << t_corr << " s" << std::endl;
+        ASSERT_EQ( dc.size(), data.size()-templ.size() );
+    }
+}
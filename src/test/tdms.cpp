@@ -0,0 +1,225 @@
+#include "../libstfio/stfio.h"
+#include "../libstfio/recording.h"
+#include "../libstfio/tdms/tdmslib.h"
+#include "./testutils.h"
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+const unsigned kTocMetaData = 1 << 1;
+const unsigned kTocRawData = 1 << 3;
+const unsigned kTocInterleavedData = 1 << 5;
+const unsigned kTocBigEndian = 1 << 6;
+const unsigned kTocNewObjList = 1 << 2;
+
+// Appends little- or big-endian values to a byte buffer.
+class TdmsWriter {
+  public:
+    explicit TdmsWriter(bool bigEndian=false) : big(bigEndian) {}
+
+    template <class T> void put(T value) {
+        unsigned char b[sizeof(T)];
+        memcpy(b, &value, sizeof(T));
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            bytes.push_back(big ? b[sizeof(T)-1-i] : b[i]);
+        }
+    }
+    void put(const std::string& s) {
+        put((unsigned)s.size());
+        bytes.insert(bytes.end(), s.begin(), s.end());
+    }
+    // An object with a raw data index of n values of the given type.
+    void object(const std::string& path, unsigned type, unsigned long long n) {
+        put(path);
+        put((unsigned)20);
+        put(type);
+        put((unsigned)1);
+        put(n);
+        put((unsigned)0);
+    }
+    // A string object with a raw data index of n values in totalSize bytes.
+    void stringObject(const std::string& path, unsigned long long n, unsigned long long totalSize) {
+        put(path);
+        put((unsigned)28);
+        put((unsigned)0x20);
+        put((unsigned)1);
+        put(n);
+        put(totalSize);
+        put((unsigned)0);
+    }
+    // An object without raw data and with a single string property.
+    void object(const std::string& path, const std::string& prop="", const std::string& value="") {
+        put(path);
+        put((unsigned)0xFFFFFFFF);
+        put((unsigned)(prop.empty() ? 0 : 1));
+        if (!prop.empty()) {
+            put(prop);
+            put((unsigned)0x20);
+            put(value);
+        }
+    }
+
+    std::vector<unsigned char> bytes;
+
+  private:
+    bool big;
+};
+
+// Writes one segment. The ToC mask is always little-endian; the rest of the
+// lead-in has the byte order of the segment.
+void writeSegment(FILE* fp, unsigned toc, const TdmsWriter& meta, const TdmsWriter& raw) {
+    TdmsWriter lead;
+    lead.bytes.push_back('T'); lead.bytes.push_back('D');
+    lead.bytes.push_back('S'); lead.bytes.push_back('m');
+    lead.put(toc);
+    TdmsWriter rest((toc & kTocBigEndian) != 0);
+    rest.put((unsigned)4713);
+    rest.put((unsigned long long)(meta.bytes.size() + raw.bytes.size()));
+    rest.put((unsigned long long)meta.bytes.size());
+    lead.bytes.insert(lead.bytes.end(), rest.bytes.begin(), rest.bytes.end());
+    fwrite(&lead.bytes[0], 1, lead.bytes.size(), fp);
+    if (!meta.bytes.empty())
+        fwrite(&meta.bytes[0], 1, meta.bytes.size(), fp);
+    if (!raw.bytes.empty())
+        fwrite(&raw.bytes[0], 1, raw.bytes.size(), fp);
+}
+
+// Group "ai0" holds two channels: "a" (int16) and "b" (double); group "ao0"
+// holds "c" (float, big-endian segment only). Value i of a channel is
+// 10*i + 1, 10*i + 2 and 10*i + 3, respectively.
+bool writeTestTDMS(const std::string& fName) {
+    FILE* fp = fopen(fName.c_str(), "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    int ia = 0, ib = 0, ic = 0;
+
+    // Contiguous segment with two chunks of 5 values:
+    TdmsWriter meta, raw;
+    meta.put((unsigned)5);
+    meta.object("/", "Sampling Rate", "20000");
+    meta.object("/'ai0'");
+    meta.object("/'ai0'/'a'", 2, 5);
+    meta.object("/'ai0'/'b'", 10, 5);
+    meta.object("/'ao0'");
+    for (int chunk = 0; chunk < 2; ++chunk) {
+        for (int i = 0; i < 5; ++i) raw.put((short)(10*ia++ + 1));
+        for (int i = 0; i < 5; ++i) raw.put((double)(10*ib++ + 2));
+    }
+    writeSegment(fp, kTocMetaData | kTocNewObjList | kTocRawData, meta, raw);
+
+    // Raw data only, with the object list of the previous segment:
+    raw = TdmsWriter();
+    for (int i = 0; i < 5; ++i) raw.put((short)(10*ia++ + 1));
+    for (int i = 0; i < 5; ++i) raw.put((double)(10*ib++ + 2));
+    writeSegment(fp, kTocRawData, TdmsWriter(), raw);
+
+    // Interleaved segment with 4 values per channel:
+    meta = TdmsWriter();
+    raw = TdmsWriter();
+    meta.put((unsigned)2);
+    meta.object("/'ai0'/'a'", 2, 4);
+    meta.object("/'ai0'/'b'", 10, 4);
+    for (int i = 0; i < 4; ++i) {
+        raw.put((short)(10*ia++ + 1));
+        raw.put((double)(10*ib++ + 2));
+    }
+    writeSegment(fp, kTocMetaData | kTocNewObjList | kTocRawData | kTocInterleavedData, meta, raw);
+
+    // Big-endian segment that adds "c" and promotes "a" to int32:
+    meta = TdmsWriter(true);
+    raw = TdmsWriter(true);
+    meta.put((unsigned)2);
+    meta.object("/'ai0'/'a'", 3, 3);
+    meta.object("/'ao0'/'c'", 9, 6);
+    for (int i = 0; i < 3; ++i) raw.put((int)(10*ia++ + 1));
+    for (int i = 0; i < 6; ++i) raw.put((float)(10*ic++ + 3));
+    writeSegment(fp, kTocMetaData | kTocNewObjList | kTocRawData | kTocBigEndian, meta, raw);
+
+    fclose(fp);
+    return true;
+}
+
+}
+
+TEST(TDMS_test, import)
+{
+    stftest::TempFile fName(".tdms");
+    ASSERT_TRUE( writeTestTDMS(fName.str()) );
+
+    Recording rec;
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    stfio::importTDMSFile(fName.str(), rec, progDlg);
+    ASSERT_EQ( rec.size(), (std::size_t)2 );
+    EXPECT_EQ( rec[0].GetChannelName(), "ai0" );
+    EXPECT_EQ( rec[1].GetChannelName(), "ao0" );
+    EXPECT_NEAR( rec.GetXScale(), 0.05, 1e-12 );
+
+    ASSERT_EQ( rec[0].size(), (std::size_t)2 );
+    ASSERT_EQ( rec[0][0].size(), (std::size_t)22 );
+    ASSERT_EQ( rec[0][1].size(), (std::size_t)19 );
+    for (std::size_t i = 0; i < rec[0][0].size(); ++i) {
+        EXPECT_EQ( rec[0][0][i], 10.0*i + 1 );
+    }
+    for (std::size_t i = 0; i < rec[0][1].size(); ++i) {
+        EXPECT_EQ( rec[0][1][i], 10.0*i + 2 );
+    }
+    ASSERT_EQ( rec[1].size(), (std::size_t)1 );
+    ASSERT_EQ( rec[1][0].size(), (std::size_t)6 );
+    for (std::size_t i = 0; i < rec[1][0].size(); ++i) {
+        EXPECT_EQ( rec[1][0][i], 10.0*i + 3 );
+    }
+}
+
+TEST(TDMS_test, request)
+{
+    stftest::TempFile fName(".tdms");
+    ASSERT_TRUE( writeTestTDMS(fName.str()) );
+
+    // Points that span the contiguous and the interleaved segments:
+    stfio::importRequest request;
+    request.channels.push_back(0);
+    request.firstSection = 1;
+    request.firstPoint = 8;
+    request.nPoints = 8;
+
+    Recording rec;
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    stfio::importTDMSFile(fName.str(), rec, progDlg, request);
+    ASSERT_EQ( rec.size(), (std::size_t)1 );
+    ASSERT_EQ( rec[0].size(), (std::size_t)1 );
+    ASSERT_EQ( rec[0][0].size(), (std::size_t)8 );
+    for (std::size_t i = 0; i < rec[0][0].size(); ++i) {
+        EXPECT_EQ( rec[0][0][i], 10.0*(i+8) + 2 );
+    }
+}
+
+TEST(TDMS_test, empty_strings)
+{
+    stftest::TempFile fName(".tdms");
+    ASSERT_TRUE( writeTestTDMS(fName.str()) );
+
+    // A segment whose only channel is a string channel without raw data bytes:
+    FILE* fp = fopen(fName.c_str(), "ab");
+    ASSERT_TRUE( fp != NULL );
+    TdmsWriter meta, raw;
+    meta.put((unsigned)1);
+    meta.stringObject("/'ao0'/'s'", 2, 0);
+    raw.put((unsigned)0);
+    raw.put((unsigned)0);
+    writeSegment(fp, kTocMetaData | kTocNewObjList | kTocRawData, meta, raw);
+    fclose(fp);
+
+    Recording rec;
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    stfio::importTDMSFile(fName.str(), rec, progDlg);
+    ASSERT_EQ( rec.size(), (std::size_t)2 );
+    ASSERT_EQ( rec[0][0].size(), (std::size_t)22 );
+    ASSERT_EQ( rec[1].size(), (std::size_t)1 );
+    EXPECT_EQ( rec[1][0].size(), (std::size_t)6 );
+}
@@ -0,0 +1,122 @@
+// Helpers that are shared by the unit tests.
+
+#ifndef _STFTEST_TESTUTILS_H
+#define _STFTEST_TESTUTILS_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+  #include <direct.h>
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+namespace stftest {
+
+// Creates a file with a unique name in the temporary directory and
+// removes it again when it goes out of scope.
+class TempFile {
+public:
+    explicit TempFile(const std::string& suffix) : name() {
+#ifdef _WIN32
+        char* tmpl = _tempnam(NULL, "stf");
+        if (tmpl == NULL) {
+            throw std::runtime_error("Couldn't create a temporary file name");
+        }
+        name = std::string(tmpl) + suffix;
+        free(tmpl);
+        FILE* fp = fopen(name.c_str(), "wb");
+        if (fp == NULL) {
+            throw std::runtime_error("Couldn't create " + name);
+        }
+        fclose(fp);
+#else
+        const char* tmpdir = getenv("TMPDIR");
+        std::string tmpl = std::string(tmpdir != NULL && *tmpdir != '\0' ? tmpdir : "/tmp")
+            + "/stimfittest_XXXXXX" + suffix;
+        std::vector<char> buf(tmpl.begin(), tmpl.end());
+        buf.push_back('\0');
+        int fd = mkstemps(&buf[0], (int)suffix.size());
+        if (fd < 0) {
+            throw std::runtime_error("Couldn't create " + tmpl);
+        }
+        close(fd);
+        name = &buf[0];
+#endif
+    }
+
+    ~TempFile() { remove(name.c_str()); }
+
+    const std::string& str() const { return name; }
+
+    const char* c_str() const { return name.c_str(); }
+
+private:
+    TempFile(const TempFile&);
+    TempFile& operator=(const TempFile&);
+
+    std::string name;
+};
+
+// Creates a directory with a unique name in the temporary directory. The
+// files that were named with path() and the directory itself are removed
+// when it goes out of scope.
+class TempDir {
+public:
+    TempDir() : name(), files() {
+#ifdef _WIN32
+        char* tmpl = _tempnam(NULL, "stf");
+        if (tmpl == NULL) {
+            throw std::runtime_error("Couldn't create a temporary directory name");
+        }
+        name = tmpl;
+        free(tmpl);
+        if (_mkdir(name.c_str()) != 0) {
+            throw std::runtime_error("Couldn't create " + name);
+        }
+#else
+        const char* tmpdir = getenv("TMPDIR");
+        std::string tmpl = std::string(tmpdir != NULL && *tmpdir != '\0' ? tmpdir : "/tmp")
+            + "/stimfittest_XXXXXX";
+        std::vector<char> buf(tmpl.begin(), tmpl.end());
+        buf.push_back('\0');
+        if (mkdtemp(&buf[0]) == NULL) {
+            throw std::runtime_error("Couldn't create " + tmpl);
+        }
+        name = &buf[0];
+#endif
+    }
+
+    ~TempDir() {
+        for (std::size_t n = 0; n < files.size(); ++n) {
+            remove(files[n].c_str());
+        }
+#ifdef _WIN32
+        _rmdir(name.c_str());
+#else
+        rmdir(name.c_str());
+#endif
+    }
+
+    // Returns the full path of a file within the directory.
+    std::string path(const std::string& fileName) {
+        files.push_back(name + "/" + fileName);
+        return files.back();
+    }
+
+private:
+    TempDir(const TempDir&);
+    TempDir& operator=(const TempDir&);
+
+    std::string name;
+    std::vector<std::string> files;
+};
+
+}
+
+#endif